@@ -0,0 +1,60 @@
+#ifndef MSX_TOOLS_BASEROM_H
+#define MSX_TOOLS_BASEROM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapeadores.h"
+#include "mapeamento.h"
+
+struct RomConhecida {
+  std::string titulo;
+  MapeadorRom mapeador;
+  uint8_t sha1[20];
+  uint32_t crc;
+  // Falso se a ROM nao esta' na base e o mapeador e' so' um palpite.
+  bool conhecida;
+};
+
+// Base de ROMs conhecidas num arquivo binario usado direto do mmap, sem
+// nada para interpretar ao abrir: registros de tamanho fixo ordenados pelo
+// SHA-1, um indice de CRC-32 ordenado e os titulos. Como o SHA-1 e'
+// uniforme, a busca por ele e' por interpolacao e acerta em poucos passos;
+// a por CRC e' binaria.
+//
+// O arquivo e' gerado a partir da softwaredb.xml do openMSX ou de listas
+// em texto com "HASH MAPEADOR [titulo]" por linha, onde o hash e' um CRC-32
+// (8 digitos) ou um SHA-1 (40 digitos).
+class BaseRoms {
+  public:
+    BaseRoms();
+    bool abrir(std::string arquivo);
+    void fechar();
+    bool aberta() const;
+    size_t getRegistros() const;
+
+    bool procurarSha1(const uint8_t sha1[20], RomConhecida &rom) const;
+    bool procurarCrc(uint32_t crc, RomConhecida &rom) const;
+
+    static bool gerar(const std::vector<std::string> &fontes, std::string destino, size_t *registros = nullptr);
+
+  private:
+    struct Registro;
+    struct IndiceCrc;
+
+    ArquivoMapeado mapa;
+    const Registro *registros;
+    size_t totalRegistros;
+    // Os primeiros comSha1 registros tem SHA-1; o resto so' tem CRC.
+    size_t comSha1;
+    const IndiceCrc *indiceCrc;
+    size_t totalCrc;
+    const char *textos;
+    uint64_t tamanhoTextos;
+
+    void preencher(const Registro &r, RomConhecida &rom) const;
+};
+
+#endif //MSX_TOOLS_BASEROM_H
@@ -0,0 +1,68 @@
+#ifndef MSX_TOOLS_BASIC_H
+#define MSX_TOOLS_BASIC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Converte programas MSX-BASIC tokenizados (.BAS comecando com 0xFF) na
+// listagem ASCII que o LIST mostraria, com linhas terminadas em CR LF.
+// O texto vai para um unico buffer, dimensionado uma vez pelo pior caso do
+// programa e reaproveitado nas conversoes seguintes: converter milhares de
+// arquivos com o mesmo objeto nao aloca nada por token nem por linha.
+class Detokenizador {
+  public:
+    Detokenizador();
+
+    // Falso se o arquivo nao for BASIC tokenizado ou terminar no meio de
+    // uma linha; o que deu para converter fica no texto.
+    bool converter(const uint8_t *programa, size_t tamanho);
+    const char *getTexto() const;
+    size_t getTamanho() const;
+
+  private:
+    std::vector<char> saida;
+    size_t usado;
+    // Endereco na memoria e numero de cada linha, para os ponteiros do RUN.
+    std::vector<std::pair<uint16_t, uint16_t>> linhas;
+
+    bool linhaDoPonteiro(uint16_t ponteiro, uint16_t &linha) const;
+};
+
+// O caminho contrario: monta a imagem .BAS a partir da listagem ASCII,
+// como o MSX faria digitando linha por linha (linhas fora de ordem sao
+// ordenadas, uma linha repetida substitui a anterior e um numero sozinho
+// apaga a linha). As palavras reservadas sao reconhecidas por uma trie
+// montada em tempo de compilacao a partir das mesmas tabelas do
+// Detokenizador, entao cada posicao do texto e' examinada uma vez so'.
+class Tokenizador {
+  public:
+    Tokenizador();
+
+    // endereco: onde o programa fica na memoria do MSX, para os ponteiros
+    // de linha; 0x8001 e' o inicio do BASIC. Falso se alguma linha nao
+    // tiver numero valido ou tiver uma constante fora do alcance; nesse
+    // caso getLinhaErro() diz qual linha do texto.
+    bool converter(const char *texto, size_t tamanho, uint16_t endereco = 0x8001);
+    const uint8_t *getPrograma() const;
+    size_t getTamanho() const;
+    size_t getLinhaErro() const;
+
+  private:
+    struct Linha {
+      uint16_t numero;
+      size_t inicio;
+      size_t tamanho;
+    };
+
+    std::vector<uint8_t> rascunho;
+    std::vector<Linha> linhas;
+    std::vector<uint8_t> saida;
+    size_t usado;
+    size_t linhaErro;
+
+    bool tokenizarLinha(const char *p, const char *fim);
+};
+
+#endif //MSX_TOOLS_BASIC_H
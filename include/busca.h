@@ -0,0 +1,63 @@
+#ifndef MSX_TOOLS_BUSCA_H
+#define MSX_TOOLS_BUSCA_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tabelapecas.h"
+
+// Sequencia de bytes onde cada posicao so' compara os bits da mascara:
+// "CD ?? 00 C9" vira mascaras FF 00 FF FF e "3?" vira a mascara F0.
+struct Padrao {
+  std::vector<uint8_t> valor;
+  std::vector<uint8_t> mascara;
+};
+
+// Le pares de nibbles hexadecimais ou '?', com ou sem espacos entre bytes.
+bool padraoHex(const std::string &texto, Padrao &padrao);
+// Texto UTF-8 convertido para o conjunto de caracteres do MSX.
+bool padraoTexto(const std::string &texto, Padrao &padrao);
+
+// Busca em segundo plano. O documento e' dividido em blocos que as threads
+// vao pegando; em cada bloco os candidatos saem de uma varredura SSE2/AVX2
+// por dois bytes ancora do padrao e so' eles sao comparados por inteiro.
+// Os resultados de cada bloco entram na lista assim que o bloco termina.
+class Busca {
+  public:
+    Busca();
+    ~Busca();
+    Busca(const Busca&) = delete;
+    Busca& operator=(const Busca&) = delete;
+
+    // A tabela nao pode ser editada enquanto a busca estiver rodando.
+    void iniciar(const TabelaPecas &pecas, const Padrao &padrao, unsigned threads = 0);
+    void cancelar();
+
+    bool rodando() const;
+    uint64_t getProgresso() const;
+    uint64_t getTotal() const;
+    size_t getQuantidade() const;
+    // Copia os resultados a partir do indice 'de', na ordem em que chegaram.
+    size_t resultados(std::vector<uint64_t> &destino, size_t de = 0) const;
+
+  private:
+    const TabelaPecas *pecas;
+    Padrao padrao;
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> proximoBloco;
+    std::atomic<uint64_t> varridos;
+    std::atomic<unsigned> ativas;
+    std::atomic<bool> parar;
+    mutable std::mutex trava;
+    std::vector<uint64_t> lista;
+    uint64_t total;
+
+    void trabalhar();
+    void buscarBloco(uint64_t inicio, uint64_t fim, std::vector<uint64_t> &achados);
+};
+
+#endif //MSX_TOOLS_BUSCA_H
@@ -0,0 +1,74 @@
+#ifndef MSX_TOOLS_CASSETE_H
+#define MSX_TOOLS_CASSETE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "disco.h"
+#include "mapeamento.h"
+
+enum TipoCassete {
+  casseteBasic,
+  casseteAscii,
+  casseteBinario,
+  // Bloco sem cabecalho de arquivo antes (carregadores proprios dos jogos).
+  casseteDados
+};
+
+const char *nomeTipoCassete(TipoCassete tipo);
+
+// Trecho de dados de um bloco, do fim do seu cabecalho ate' o proximo.
+struct BlocoCassete {
+  uint64_t inicio;
+  uint64_t tamanho;
+};
+
+struct ArquivoCassete {
+  // 6 caracteres, sem os espacos do fim; vazio em casseteDados.
+  std::string nome;
+  TipoCassete tipo;
+  // So' os blocos de dados; o bloco com o nome nao entra.
+  std::vector<BlocoCassete> blocos;
+  // Enderecos do BLOAD; zero nos outros tipos.
+  uint16_t inicio;
+  uint16_t fim;
+  uint16_t execucao;
+  // Bytes que extrair() devolve.
+  uint64_t tamanho;
+};
+
+// Imagem de fita .CAS. Cada bloco comeca com o cabecalho de 8 bytes
+// 1F A6 DE BA CC 13 7D 74, sempre numa posicao multipla de 8; os
+// cabecalhos sao achados com comparacoes de 8 bytes em SSE2/AVX2 e o
+// indice de arquivos e' montado uma vez ao abrir. Extrair um arquivo so'
+// copia os trechos do indice, sem varrer a imagem de novo.
+class Cassete {
+  public:
+    bool abrir(std::string arquivo);
+    void fechar();
+    bool aberto() const;
+
+    const std::vector<ArquivoCassete> &getArquivos() const;
+    // Conteudo como fica num arquivo do PC: programa BASIC com o #FF do
+    // inicio, texto ASCII ate' o fim de arquivo (#1A) e binario com o
+    // cabecalho de 7 bytes do BLOAD.
+    bool extrair(const ArquivoCassete &arquivo, std::vector<uint8_t> &dados) const;
+    // Grava todos os arquivos em 'destino' (NOME.BAS, NOME.ASC, NOME.BIN ou
+    // BLOCOnn.DAT); nomes repetidos ganham um sufixo. Um cabecalho sem bloco
+    // de dados depois (fita cortada) e' pulado com um aviso, sem falhar.
+    bool extrairTudo(std::string destino, uint64_t *bytes = nullptr, Gravador *gravador = nullptr,
+                     std::vector<std::string> *avisos = nullptr) const;
+
+    // Posicoes dos cabecalhos de bloco em dados[0, n).
+    static void procurarCabecalhos(const uint8_t *dados, size_t n, std::vector<uint64_t> &posicoes);
+
+  private:
+    ArquivoMapeado mapa;
+    std::vector<ArquivoCassete> arquivos;
+
+    void indexar();
+};
+
+#endif //MSX_TOOLS_CASSETE_H
@@ -0,0 +1,60 @@
+#ifndef MSX_TOOLS_COMPARACAO_H
+#define MSX_TOOLS_COMPARACAO_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Compara duas imagens em segundo plano. Cada thread pega blocos e acha as
+// faixas diferentes com comparacoes SSE2/AVX2 de 16/32 bytes por vez; no fim
+// as faixas dos blocos viram um indice unico, ordenado e sem faixas
+// encostadas, onde proxima/anterior sao buscas binarias.
+class Comparacao {
+  public:
+    struct Faixa {
+      uint64_t inicio;
+      uint64_t fim;
+    };
+
+    Comparacao();
+    ~Comparacao();
+    Comparacao(const Comparacao&) = delete;
+    Comparacao& operator=(const Comparacao&) = delete;
+
+    // Os dois buffers (normalmente mapeamentos) tem que viver ate' o fim.
+    void iniciar(const uint8_t *a, uint64_t tamanhoA, const uint8_t *b, uint64_t tamanhoB,
+                 unsigned threads = 0);
+    void cancelar();
+
+    bool pronta() const;
+    uint64_t getProgresso() const;
+    uint64_t getTotal() const;
+
+    // So' valem depois de pronta().
+    const std::vector<Faixa> &getFaixas() const;
+    uint64_t getBytesDiferentes() const;
+    bool diferente(uint64_t pos) const;
+    // Inicio da proxima faixa depois de pos, ou da faixa anterior a pos.
+    bool proxima(uint64_t pos, uint64_t &destino) const;
+    bool anterior(uint64_t pos, uint64_t &destino) const;
+
+  private:
+    const uint8_t *a;
+    const uint8_t *b;
+    uint64_t comum;
+    uint64_t total;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<Faixa>> blocos;
+    std::vector<Faixa> faixas;
+    std::atomic<uint64_t> proximoBloco;
+    std::atomic<uint64_t> comparados;
+    std::atomic<unsigned> ativas;
+    std::atomic<bool> parar;
+    std::atomic<bool> terminada;
+
+    void trabalhar();
+    void juntar();
+};
+
+#endif //MSX_TOOLS_COMPARACAO_H
@@ -0,0 +1,65 @@
+#ifndef MSX_TOOLS_CONVERSOR_H
+#define MSX_TOOLS_CONVERSOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tarefas.h"
+#include "tela.h"
+
+// Converte imagens RGB em telas do MSX: SCREEN 2 (duas cores por trecho de
+// 8x1 pixels), SCREEN 5 (16 cores escolhidas entre as 512 do V9938),
+// SCREEN 8 (as 256 cores fixas) e SCREEN 12 (YJK: grupos de 4 pixels com a
+// mesma cor e brilho proprio).
+//
+// O que cada bloco pode ser e' resolvido sem olhar os vizinhos, em tarefas
+// independentes no pool: os pares de cores candidatos de cada trecho do
+// SCREEN 2, o histograma, a paleta e a tabela de cor mais proxima do
+// SCREEN 5. A difusao de erro (Floyd-Steinberg) depende da linha de cima,
+// entao as linhas andam em frente de onda: cada tarefa pega a proxima linha
+// livre e so' entra num trecho depois que a linha de cima ja' passou dele.
+class ConversorTela {
+  public:
+    // As tarefas vao para 'pool'; quem chama nao pode ser uma delas.
+    explicit ConversorTela(PoolTarefas &pool);
+
+    // modo: 2, 5, 8 ou 12. A imagem e' redimensionada (vizinho mais proximo)
+    // para 256x192, ou 256x212 nos modos de bitmap se tiver mais de 192
+    // linhas. 'vram' recebe a tela a partir do endereco 0, ate' o fim do
+    // bitmap ou da paleta, pronta para gravarBsave.
+    bool converter(const ImagemRGBA &imagem, unsigned modo, bool difusao, std::vector<uint8_t> &vram);
+
+  private:
+    PoolTarefas &pool;
+    ImagemRGBA alvo;
+    bool difusao;
+    // Erro acumulado de cada pixel, R, G e B em 1/16.
+    std::vector<int32_t> erro;
+    std::unique_ptr<std::atomic<unsigned>[]> progresso;
+    std::atomic<unsigned> proximaLinha;
+
+    // Divide [0, n) em faixas, uma por tarefa.
+    void paralelo(size_t n, const std::function<void(size_t, size_t)> &faixa);
+    // Chama trecho(x, y) para cada 'passo' pixels de cada linha. 'direita'
+    // e' o alcance do erro para a direita, que decide quanto a linha de
+    // cima tem que estar na frente.
+    void frenteOnda(unsigned passo, unsigned direita, const std::function<void(unsigned, unsigned)> &trecho);
+    // Pixel com o erro recebido, limitado a 0..255.
+    void ajustado(unsigned x, unsigned y, int cor[3]) const;
+    void espalhar(unsigned x, unsigned y, const int e[3], unsigned direita = 1);
+
+    void screen2(std::vector<uint8_t> &vram);
+    void screen5(std::vector<uint8_t> &vram);
+    void screen8(std::vector<uint8_t> &vram);
+    void screen12(std::vector<uint8_t> &vram);
+};
+
+// Arquivo do BSAVE ,S com os dados a partir do endereco 0.
+bool gravarBsave(std::string arquivo, const std::vector<uint8_t> &dados);
+
+#endif //MSX_TOOLS_CONVERSOR_H
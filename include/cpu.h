@@ -0,0 +1,82 @@
+#ifndef MSX_TOOLS_CPU_H
+#define MSX_TOOLS_CPU_H
+
+#include <cstdint>
+
+// O que o Z80 enxerga: 64 KB em 8 paginas de 8 KB e as portas de E/S. As
+// leituras e escritas de memoria vao direto pelos ponteiros das paginas, que
+// quem monta o mapa (slots, mapeadores) troca quando ele muda; so' uma
+// pagina com ponteiro nulo chama ler()/escrever(), para registradores
+// mapeados em memoria e trocas de banco. As portas sempre passam por
+// entrada()/saida().
+class Barramento {
+  public:
+    Barramento();
+    virtual ~Barramento();
+
+    virtual uint8_t ler(uint16_t endereco);
+    virtual void escrever(uint16_t endereco, uint8_t valor);
+    virtual uint8_t entrada(uint16_t porta);
+    virtual void saida(uint16_t porta, uint8_t valor);
+
+  protected:
+    const uint8_t *leitura[8];
+    uint8_t *escrita[8];
+
+    friend class CpuZ80;
+};
+
+struct RegistradoresZ80 {
+  uint16_t af, bc, de, hl;
+  uint16_t af2, bc2, de2, hl2;
+  uint16_t ix, iy, sp, pc;
+  // MEMPTR, que aparece nos bits 3 e 5 do F depois de BIT n,(HL).
+  uint16_t wz;
+  uint8_t i, r;
+  bool iff1, iff2;
+  uint8_t im;
+};
+
+// Z80 com todas as instrucoes, documentadas ou nao, inclusive os bits 3 e 5
+// do F. O laco e' "threaded": cada instrucao termina buscando a proxima e
+// saltando direto para o rotulo dela por uma tabela de enderecos (computed
+// goto do GCC), sem um switch central; CB, ED, DD/FD e DDCB tem tabelas
+// proprias. Durante o laco os registradores ficam em variaveis locais e so'
+// voltam para RegistradoresZ80 no fim. S, Z, paridade e os bits 3 e 5 vem
+// de tabelas de 256 entradas, meio-carry e overflow de tabelas de 8 pelos
+// bits 3 e 7 dos operandos e do resultado.
+//
+// Os ciclos sao os T-states de cada instrucao, inclusive saltos tomados e
+// repeticoes de LDIR, CPIR...; com esperaM1 cada ciclo M1 custa um a mais,
+// como no MSX.
+class CpuZ80 {
+  public:
+    explicit CpuZ80(Barramento &barramento, bool esperaM1 = true);
+
+    void reiniciar();
+    // Executa pelo menos 'ciclos' T-states (a ultima instrucao vai ate' o
+    // fim) e devolve quantos foram.
+    uint64_t executar(uint64_t ciclos);
+    // Linha INT, por nivel como a do VDP; pode mudar dentro de entrada() e
+    // saida().
+    void setInt(bool ativa);
+    void nmi();
+
+    RegistradoresZ80 &getRegistradores();
+    uint64_t getCiclos() const;
+    // Em HALT.
+    bool getParado() const;
+
+  private:
+    Barramento &barramento;
+    uint64_t esperaM1;
+    RegistradoresZ80 regs;
+    uint64_t ciclos;
+    bool linhaInt;
+    bool nmiPendente;
+    bool parado;
+    // Logo depois do EI a proxima instrucao ainda nao aceita interrupcao.
+    bool depoisEI;
+};
+
+#endif //MSX_TOOLS_CPU_H
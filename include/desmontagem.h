@@ -0,0 +1,55 @@
+#ifndef MSX_TOOLS_DESMONTAGEM_H
+#define MSX_TOOLS_DESMONTAGEM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "tabelapecas.h"
+#include "z80.h"
+
+struct LinhaDesmontagem {
+  uint64_t posicao;
+  uint8_t tamanho;
+  uint8_t bytes[4];
+  uint8_t comprimento;
+  char texto[Desmontador::tamanhoTexto];
+};
+
+// Desmontagem sob demanda de um documento do editor: so' as instrucoes da
+// tela sao decodificadas. Para achar onde comeca a instrucao que contem uma
+// posicao qualquer, o documento e' dividido em blocos de 'passo' bytes e a
+// primeira fronteira de instrucao de cada bloco e' guardada quando passa por
+// ela. Um bloco sem ponto conhecido continua a partir do ponto mais proximo
+// antes dele; se nao ha' nenhum perto, recua alguns bytes e decodifica dali,
+// porque o codigo Z80 volta a sincronizar em poucas instrucoes.
+class Desmontagem {
+  public:
+    explicit Desmontagem(uint16_t org = 0x4000, uint64_t passo = 256);
+
+    // O documento mudou a partir de pos: os pontos dali em diante caem.
+    void invalidar(uint64_t pos);
+
+    // Inicio da instrucao que contem pos.
+    uint64_t inicio(const TabelaPecas &pecas, uint64_t pos);
+    // Inicio da instrucao antes de pos.
+    uint64_t anterior(const TabelaPecas &pecas, uint64_t pos);
+    // Ate' n instrucoes a partir de pos, que deve ser inicio de instrucao.
+    void linhas(const TabelaPecas &pecas, uint64_t pos, unsigned n, std::vector<LinhaDesmontagem> &saida);
+
+    uint16_t getOrg() const;
+
+  private:
+    static constexpr uint16_t semPonto = 0xFFFF;
+
+    Desmontador desmontador;
+    uint16_t org;
+    uint64_t passo;
+    // Deslocamento, dentro de cada bloco, da primeira instrucao que comeca nele.
+    std::vector<uint16_t> pontos;
+    std::vector<uint8_t> buffer;
+
+    uint64_t ponto(const TabelaPecas &pecas, uint64_t bloco);
+    uint8_t tamanhoEm(const uint8_t *p, size_t n, uint64_t pos) const;
+};
+
+#endif //MSX_TOOLS_DESMONTAGEM_H
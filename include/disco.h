@@ -0,0 +1,173 @@
+#ifndef MSX_TOOLS_DISCO_H
+#define MSX_TOOLS_DISCO_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct EntradaDisco {
+  std::string nome;
+  uint8_t atributos;
+  uint32_t cluster;
+  uint32_t tamanho;
+  uint16_t hora;
+  uint16_t data;
+
+  bool diretorio() const;
+};
+
+// Particao de uma imagem de disco rigido, em setores de 512 bytes a partir
+// do inicio da imagem. Logicas dentro de uma estendida ja' vem resolvidas.
+struct ParticaoDisco {
+  uint8_t tipo;
+  uint64_t inicio;
+  uint64_t setores;
+};
+
+// Destino dos arquivos extraidos. O padrao grava direto no sistema de
+// arquivos; o lote de extracao troca por um que grava em segundo plano.
+class Gravador {
+  public:
+    virtual ~Gravador();
+    virtual bool criarDiretorio(const std::string &caminho);
+    virtual bool gravar(const std::string &caminho, std::vector<uint8_t> &&dados);
+};
+
+// Imagem de disco MSX-DOS 1/2 (.DSK ou .DMK) com FAT12, ou particao FAT16
+// do Nextor numa imagem de disco rigido. Nada e' lido adiantado: entradas
+// da FAT e setores de diretorio passam por um cache LRU de setores, entao
+// listar um diretorio so' le os setores dele e os da FAT que a cadeia usa.
+// Extrair um arquivo faz uma leitura direta por sequencia de clusters
+// contiguos, sem passar pelo cache. Imagens DMK (trilhas brutas) sao
+// convertidas para setores na memoria ao abrir, e ficam so' para leitura.
+//
+// Aberta para escrita, cada adicionar/apagar/renomear e' uma transacao: os
+// dados de um arquivo novo vao direto para clusters livres, e os setores de
+// FAT e diretorio alterados ficam na memoria ate' o fim da operacao. Ai'
+// vao primeiro para o diario <imagem>.jnl e so' depois para a imagem. Um
+// diario completo encontrado ao abrir e' aplicado de novo; um incompleto e'
+// descartado. Se a imagem falhar depois do diario gravado, o disco passa a
+// so' leitura ate' ser aberto de novo, o que aplica o diario. Aberta so'
+// para leitura, a imagem nunca e' tocada: um diario completo pendente faz
+// o abrir falhar, e um incompleto e' ignorado. Nenhum outro setor da
+// imagem e' regravado.
+class Disco {
+  public:
+    Disco();
+    ~Disco();
+    Disco(const Disco&) = delete;
+    Disco& operator=(const Disco&) = delete;
+
+    // particao: indice em getParticoes(); ignorado em imagens sem tabela.
+    bool abrir(std::string arquivo, unsigned particao = 0, bool escrita = false);
+    // Usa a imagem de setores ja' carregada, sem arquivo por tras.
+    bool abrirMemoria(std::vector<uint8_t> &&imagem, unsigned particao = 0);
+    void fechar();
+    bool aberto() const;
+    bool getEscrita() const;
+
+    // Particoes FAT da tabela da imagem; vazio para disquetes.
+    const std::vector<ParticaoDisco> &getParticoes() const;
+    bool getFat16() const;
+    uint32_t getBytesSetor() const;
+    uint32_t getBytesCluster() const;
+    uint32_t getTotalClusters() const;
+    // Percorre a FAT inteira na primeira chamada.
+    uint32_t getClustersLivres();
+
+    // caminho: "" ou "/" para a raiz, "JOGOS/MSX2" para subdiretorios.
+    bool listar(std::string caminho, std::vector<EntradaDisco> &entradas);
+    bool procurar(std::string caminho, EntradaDisco &entrada);
+    bool extrair(const EntradaDisco &entrada, std::vector<uint8_t> &dados);
+    // Grava todos os arquivos do disco em 'destino', recriando os diretorios.
+    bool extrairTudo(std::string destino, uint64_t *bytes = nullptr, Gravador *gravador = nullptr);
+
+    // caminho: "JOGOS/NOVO.ROM"; o diretorio tem que existir e o nome ser 8.3.
+    bool adicionar(std::string caminho, const std::vector<uint8_t> &dados);
+    // Diretorios so' se estiverem vazios.
+    bool apagar(std::string caminho);
+    // So' troca o nome; o arquivo continua no mesmo diretorio.
+    bool renomear(std::string caminho, std::string novoNome);
+
+    // Converte uma imagem DMK em setores logicos; falso se nao for DMK.
+    static bool converterDMK(const uint8_t *dmk, uint64_t tamanho, std::vector<uint8_t> &setores);
+
+  private:
+    struct Trecho {
+      uint64_t setor;
+      uint32_t setores;
+    };
+
+    struct LinhaCache {
+      uint64_t setor;
+      std::vector<uint8_t> dados;
+    };
+
+    typedef std::function<bool(uint64_t setor, uint32_t pos, const uint8_t *entrada)> Visita;
+
+    int fd;
+    std::string arquivo;
+    bool escrita;
+    std::vector<uint8_t> memoria;
+    std::vector<ParticaoDisco> particoes;
+    uint64_t base;
+    uint32_t bytesSetor;
+    uint32_t setoresCluster;
+    uint32_t reservados;
+    uint32_t numFats;
+    uint32_t entradasRaiz;
+    uint32_t totalSetores;
+    uint32_t setoresFat;
+    uint8_t midia;
+    uint32_t inicioRaiz;
+    uint32_t inicioDados;
+    uint32_t totalClusters;
+    bool fat16;
+    uint32_t fimCadeia;
+    int64_t livres;
+
+    // Mais recente na frente; 'ultima' evita a busca no indice quando a
+    // mesma linha e' pedida seguidas vezes, o caso comum ao seguir a FAT.
+    std::list<LinhaCache> cache;
+    std::unordered_map<uint64_t, std::list<LinhaCache>::iterator> indiceCache;
+    const LinhaCache *ultima;
+
+    // Setores de FAT e diretorio alterados pela operacao em andamento.
+    std::map<uint64_t, std::vector<uint8_t>> alterados;
+    uint32_t dicaLivre;
+
+    bool lerBruto(uint64_t pos, uint64_t n, uint8_t *destino);
+    bool ler(uint64_t setor, uint64_t setores, uint8_t *destino);
+    const uint8_t *setorCache(uint64_t setor);
+    void esquecer(uint64_t setor, uint64_t setores);
+    bool gravarBruto(uint64_t pos, uint64_t n, const uint8_t *origem);
+    uint8_t *alterarSetor(uint64_t setor);
+    bool confirmar();
+    void descartar();
+    bool montar(unsigned particao);
+    bool lerParticoes(const uint8_t *mbr);
+    bool lerBPB(const uint8_t *boot);
+    bool geometriaPadrao(uint8_t midia);
+    bool proximo(uint32_t cluster, uint32_t &seguinte);
+    bool cadeia(uint32_t cluster, std::vector<Trecho> &trechos);
+    bool definir(uint32_t cluster, uint32_t valor);
+    bool alocar(uint32_t n, std::vector<uint32_t> &clusters);
+    bool liberar(uint32_t cluster);
+    bool gravarClusters(const std::vector<uint32_t> &clusters, const uint8_t *dados, uint64_t n);
+    // Chama 'visita' para cada entrada de 32 bytes, inclusive as livres, ate' ela devolver falso.
+    bool percorrer(uint32_t cluster, const Visita &visita);
+    bool lerDiretorio(uint32_t cluster, std::vector<EntradaDisco> &entradas);
+    bool diretorioPai(std::string caminho, uint32_t &cluster, std::string &nome);
+    bool localizar(uint32_t pai, const uint8_t *nome, uint64_t &setor, uint32_t &pos);
+    // Cada subdiretorio e' extraido uma vez so'; 'nivel' conta a distancia
+    // da raiz.
+    bool extrairDiretorio(uint32_t cluster, std::string destino, uint64_t *bytes, Gravador &gravador,
+                          std::set<uint32_t> &visitados, unsigned nivel);
+};
+
+#endif //MSX_TOOLS_DISCO_H
@@ -0,0 +1,154 @@
+#ifndef MSX_TOOLS_FITA_H
+#define MSX_TOOLS_FITA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Formato das amostras de um arquivo WAV PCM.
+struct FormatoWav {
+  unsigned taxa;
+  unsigned canais;
+  unsigned bits;
+  // Bytes de amostras no arquivo; 0 se o cabecalho nao disser (gravacao
+  // interrompida), e ai' vai ate' o fim do arquivo.
+  uint64_t tamanho;
+};
+
+struct ResultadoFita {
+  FormatoWav formato;
+  double segundos;
+  unsigned blocos;
+  uint64_t bytes;
+  // Bytes perdidos: blocos que pararam no meio de um byte.
+  unsigned erros;
+  // Velocidade do ultimo tom de sincronismo, 1200 ou 2400 (aproximada).
+  unsigned baud;
+};
+
+// Demodulador FSK das fitas do MSX: o bit 0 e' um ciclo na frequencia
+// baixa e o bit 1 sao dois na alta (1200/2400 Hz a 1200 baud, 2400/4800
+// Hz a 2400 baud); cada byte vai com um bit 0 de partida e dois bits 1 de
+// parada, e cada bloco comeca com um tom de bits 1. Nada depende da taxa
+// de amostragem nem da velocidade: o tom de cada bloco da' o tamanho do
+// ciclo curto e os bits sao medidos em relacao a ele.
+//
+// As amostras entram em pedacos de qualquer tamanho; os cruzamentos de
+// zero sao achados 32 amostras por vez (SSE2/AVX2) e so' eles sao
+// examinados um a um, entao a memoria fica constante qualquer que seja a
+// duracao da fita. Cada bloco achado vira um cabecalho .CAS na saida.
+class DecodificadorFita {
+  public:
+    DecodificadorFita(std::ostream &saida, unsigned taxa);
+
+    // Amostras de 16 bits de um canal.
+    void processar(const int16_t *amostras, size_t n);
+    void terminar();
+
+    unsigned getBlocos() const;
+    uint64_t getBytes() const;
+    unsigned getErros() const;
+    unsigned getBaud() const;
+
+  private:
+    enum Estado {
+      procurando,
+      tom,
+      bits
+    };
+
+    std::ostream &saida;
+    unsigned taxa;
+    uint64_t escritos;
+    unsigned blocos;
+    unsigned erros;
+    unsigned baud;
+
+    // Sinal: nivel medio, distancia dos limites ao centro, ultima amostra
+    // e posicao do ultimo cruzamento.
+    int32_t centro;
+    int32_t histerese;
+    // Filtro: fim do pedaco anterior seguido do atual, e o resultado.
+    std::vector<int16_t> historico;
+    std::vector<int16_t> filtrado;
+    int16_t anterior;
+    bool negativo;
+    uint64_t amostra;
+    double ultimoCruzamento;
+
+    // Maquina de estados sobre as meias ondas entre cruzamentos.
+    Estado estado;
+    // Ciclo curto (o bit 1 tem dois) e meias ondas de cada polaridade, em amostras.
+    double curto;
+    double meias[2];
+    int paridade;
+    double ultimaMeia;
+    unsigned seguidas;
+    double primeira;
+    bool temPrimeira;
+    int bit;
+    bool segundoCurto;
+    unsigned curtos;
+    unsigned byte;
+    // Meia onda ainda nao entregue, para juntar ruidos a ela.
+    double guardada;
+    bool temGuardada;
+    bool juntar;
+
+    void cruzamento(double posicao);
+    void meiaOnda(double duracao);
+    void ciclo(double duracao);
+    void perder();
+    void escrever(uint8_t valor);
+};
+
+// O caminho contrario: gera o audio da fita em PCM mono de 16 bits. As
+// formas de onda do bit 0 e do bit 1 sao calculadas uma vez no construtor,
+// com os dois tamanhos inteiros em volta de taxa/baud amostras; cada bit
+// copia a sua, escolhendo o tamanho por um acumulador de erro para a
+// velocidade media ser exata. As amostras vao para um buffer grande que so'
+// e' gravado quando enche.
+class SintetizadorFita {
+  public:
+    SintetizadorFita(std::ostream &saida, unsigned taxa, unsigned baud);
+    ~SintetizadorFita();
+    SintetizadorFita(const SintetizadorFita&) = delete;
+    SintetizadorFita& operator=(const SintetizadorFita&) = delete;
+
+    void silencio(double segundos);
+    // Tom de sincronismo, em bits 1.
+    void tom(unsigned bits);
+    // Cada byte com o bit de partida e os dois de parada.
+    void bytes(const uint8_t *dados, size_t n);
+    void esvaziar();
+
+    uint64_t getAmostras() const;
+
+  private:
+    std::ostream &saida;
+    unsigned taxa;
+    unsigned baud;
+    // formas[bit][0]: bit com floor(taxa/baud) amostras; [1]: com uma a mais.
+    std::vector<int16_t> formas[2][2];
+    unsigned erro;
+    std::vector<int16_t> buffer;
+    size_t usado;
+    uint64_t amostras;
+
+    void bit(int valor);
+};
+
+// Le o cabecalho RIFF/WAVE; so' PCM de 8 ou 16 bits.
+bool lerCabecalhoWav(std::istream &entrada, FormatoWav &formato);
+// Cabecalho de 44 bytes de um WAV PCM mono de 16 bits.
+void cabecalhoWav(uint8_t h[44], unsigned taxa, uint64_t amostras);
+// Converte uma gravacao de fita inteira em .CAS, lendo o WAV em pedacos.
+bool converterWavCas(std::string wav, std::string cas, ResultadoFita &resultado);
+// Gera a gravacao de uma fita .CAS inteira. Blocos de nome levam o tom
+// longo, depois de 2 s de silencio; os de dados, o curto, depois de 1 s.
+bool converterCasWav(std::string cas, std::string wav, unsigned taxa = 44100, unsigned baud = 1200,
+                     double *segundos = nullptr);
+
+#endif //MSX_TOOLS_FITA_H
@@ -0,0 +1,25 @@
+#ifndef MSX_TOOLS_HASH_H
+#define MSX_TOOLS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 do zip e do PNG (polinomio refletido 0xEDB88320), o usado nas
+// listas DAT de ROMs. Para continuar um calculo, passe o resultado anterior.
+// Usa PCLMULQDQ quando o processador tem; senao, tabelas de 8 em 8 bytes.
+uint32_t crc32(const uint8_t *dados, size_t n, uint32_t crc = 0);
+// SHA-1 e MD5 de um bloco inteiro (normalmente um arquivo mapeado). O SHA-1
+// usa as extensoes SHA do processador quando existem.
+void sha1(const uint8_t *dados, size_t n, uint8_t resumo[20]);
+void md5(const uint8_t *dados, size_t n, uint8_t resumo[16]);
+
+struct Resumos {
+  uint32_t crc;
+  uint8_t sha1[20];
+  uint8_t md5[16];
+};
+
+// Os tres de uma vez, numa so' passada pelos dados.
+void resumir(const uint8_t *dados, size_t n, Resumos &resumos);
+
+#endif //MSX_TOOLS_HASH_H
@@ -1,6 +1,12 @@
 #ifndef HEXEDITOR_H_INCLUDED
 #define HEXEDITOR_H_INCLUDED
 
-int hexeditor(string);
+#include <cstdint>
+#include <string>
+
+// orcamentoHistorico: bytes do historico de desfazer mantidos na memoria.
+int hexeditor(int ac, char *av[], std::string arquivo, uint64_t orcamentoHistorico = 16 << 20);
+// Duas imagens lado a lado, navegando pelas faixas diferentes.
+int hexeditorDiff(int ac, char *av[], std::string arquivoA, std::string arquivoB);
 
 #endif // HEX-EDITOR_H_INCLUDED
@@ -0,0 +1,67 @@
+#ifndef MSX_TOOLS_HISTORICO_H
+#define MSX_TOOLS_HISTORICO_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Historico de desfazer/refazer sem limite de niveis. Cada edicao e' um
+// delta "na posicao P, os bytes antigos viraram os novos": sobrescrever tem
+// os dois lados do mesmo tamanho, inserir nao tem antigos e apagar nao tem
+// novos. Os bytes ficam numa arena unica; quando ela passa do orcamento, as
+// edicoes mais velhas vao para um arquivo temporario.
+class Historico {
+  public:
+    struct Edicao {
+      uint64_t posicao;
+      std::vector<uint8_t> antigos;
+      std::vector<uint8_t> novos;
+    };
+
+    Historico(uint64_t orcamento = 16 << 20);
+    ~Historico();
+    Historico(const Historico&) = delete;
+    Historico& operator=(const Historico&) = delete;
+
+    void setOrcamento(uint64_t bytes);
+    uint64_t getOrcamento() const;
+    void limpar();
+
+    // Registra uma edicao. Digitacao continua (bytes adjacentes, ou o mesmo
+    // byte de novo) e' juntada na edicao anterior ate' fecharGrupo().
+    void registrar(uint64_t posicao, const uint8_t *antigos, uint64_t nAntigos,
+                   const uint8_t *novos, uint64_t nNovos);
+    void fecharGrupo();
+
+    bool podeDesfazer() const;
+    bool podeRefazer() const;
+    // Devolvem a edicao a aplicar: ao desfazer, os novos voltam a ser os
+    // antigos; ao refazer, os antigos viram os novos de novo.
+    bool desfazer(Edicao &edicao);
+    bool refazer(Edicao &edicao);
+
+  private:
+    struct Entrada {
+      uint64_t posicao;
+      uint64_t inicio;
+      uint64_t nAntigos;
+      uint64_t nNovos;
+      bool despejada;
+    };
+
+    std::vector<Entrada> entradas;
+    std::vector<uint8_t> arena;
+    uint64_t baseArena;
+    uint64_t primeiraNaArena;
+    size_t atual;
+    bool grupoAberto;
+    uint64_t orcamento;
+    FILE *despejo;
+    uint64_t fimDespejo;
+
+    void truncarRefazer();
+    void despejar();
+    bool ler(const Entrada &e, Edicao &edicao);
+};
+
+#endif //MSX_TOOLS_HISTORICO_H
@@ -0,0 +1,100 @@
+#ifndef MSX_TOOLS_LOTE_H
+#define MSX_TOOLS_LOTE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cassete.h"
+#include "conversor.h"
+#include "hash.h"
+#include "msx.h"
+#include "padroes.h"
+
+struct ResultadoLote {
+  uint64_t imagens;
+  uint64_t falhas;
+  uint64_t bytesLidos;
+  uint64_t bytesGravados;
+  double segundos;
+  std::vector<std::string> erros;
+};
+
+// Extrai todas as imagens .DSK/.DMK que casam com o padrao (glob) para
+// destino/<nome da imagem>/. As imagens sao divididas num PoolTarefas e os
+// arquivos extraidos vao para uma fila de gravacao limitada a
+// 'memoriaGravacao' bytes, gravada por threads proprias enquanto os
+// trabalhadores ja' leem as proximas imagens.
+bool extrairLote(std::string padrao, std::string destino, unsigned threads, ResultadoLote &resultado,
+                 uint64_t memoriaGravacao = 64 << 20);
+
+struct MapeadorArquivo {
+  std::string arquivo;
+  MapeadorRom mapeador;
+  bool lido;
+};
+
+// Detecta o mapeador de todas as ROMs que casam com o padrao (glob), uma
+// ROM por tarefa de um PoolTarefas. O resultado segue a ordem do glob.
+bool detectarLote(const MSX &msx, std::string padrao, unsigned threads, std::vector<MapeadorArquivo> &resultado);
+
+struct HashArquivo {
+  std::string arquivo;
+  uint64_t tamanho;
+  Resumos resumos;
+  bool lido;
+};
+
+// CRC-32, SHA-1 e MD5 de todos os arquivos que casam com os padroes (glob),
+// cada um mapeado e resumido numa tarefa de um PoolTarefas. O resultado
+// segue a ordem dos padroes e, dentro de cada um, a do glob.
+bool resumirLote(const std::vector<std::string> &padroes, unsigned threads, std::vector<HashArquivo> &resultado);
+// Lista no formato DAT do ClrMamePro, um "game" por arquivo lido.
+void escreverDat(std::ostream &saida, const std::vector<HashArquivo> &arquivos);
+
+struct IndiceCassete {
+  std::string arquivo;
+  std::vector<ArquivoCassete> arquivos;
+  // Arquivos pulados na extracao, como um cabecalho sem dados no fim da fita.
+  std::vector<std::string> avisos;
+  bool lido;
+};
+
+// Indexa todas as fitas .CAS que casam com o padrao (glob), uma por tarefa
+// de um PoolTarefas. Com 'destino', tambem extrai os arquivos de cada fita
+// para destino/<nome da fita>/ enquanto ela ainda esta' aberta.
+bool indexarCassetes(std::string padrao, std::string destino, unsigned threads, std::vector<IndiceCassete> &resultado);
+
+// Gera destino/<nome da fita>.wav para todas as fitas .CAS que casam com o
+// padrao (glob), uma por tarefa de um PoolTarefas. A taxa tem que ter pelo
+// menos 8 amostras por bit.
+bool sintetizarLote(std::string padrao, std::string destino, unsigned taxa, unsigned baud, unsigned threads,
+                    ResultadoLote &resultado);
+
+// Grava destino/<nome da tela>.png para todas as telas (BSAVE ou VRAM) que
+// casam com o padrao (glob), uma por tarefa de um PoolTarefas. modo 0 tira
+// o modo da extensao de cada arquivo; fator > 1 reduz a imagem (miniatura).
+bool telasLote(const MSX &msx, std::string padrao, std::string destino, unsigned modo, unsigned fator,
+               unsigned threads, ResultadoLote &resultado);
+
+// Converte todas as imagens PNG que casam com o padrao (glob) para
+// destino/<nome>.SC2, .SC5, .SC8 ou .SCC (BSAVE). As imagens vao uma de
+// cada vez, cada uma dividida pelo PoolTarefas inteiro; a leitura do PNG
+// seguinte e a gravacao do anterior correm numa thread propria enquanto
+// isso.
+bool converterPngLote(std::string padrao, std::string destino, unsigned modo, bool difusao, unsigned threads,
+                      ResultadoLote &resultado);
+
+// Acrescenta ao indice de padroes (criado se nao existir) todos os arquivos
+// que casam com os padroes (glob), na ordem dos padroes e do glob.
+bool indexarPadroes(const std::vector<std::string> &padroes, std::string indice, unsigned threads,
+                    ResultadoLote &resultado);
+
+// Gera destino/<nome>.wav para todas as musicas VGM/VGZ que casam com o
+// padrao (glob), uma por tarefa de um PoolTarefas. 'audio' recebe a
+// duracao somada dos WAVs, em segundos.
+bool renderizarLote(std::string padrao, std::string destino, unsigned taxa, unsigned voltas, unsigned threads,
+                    ResultadoLote &resultado, double &audio);
+
+#endif //MSX_TOOLS_LOTE_H
@@ -0,0 +1,38 @@
+#ifndef MSX_TOOLS_MAPEADORES_H
+#define MSX_TOOLS_MAPEADORES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Mapeadores de MegaROM. Os quatro primeiros depois do linear sao achados
+// pelas escritas de troca de banco; os outros so' pela base de ROMs.
+enum MapeadorRom {
+  mapeadorLinear,
+  mapeadorGenerico8,
+  mapeadorKonami,
+  mapeadorKonamiSCC,
+  mapeadorASCII8,
+  mapeadorASCII16,
+  // Game Master 2 (Konami RC755), com SRAM.
+  mapeadorRC755,
+  mapeadorRType,
+  mapeadorCrossBlaim,
+  mapeadorHarryFox,
+  mapeadorHalnote,
+  mapeadorZemina,
+  // Conhecido pela base, mas sem equivalente aqui.
+  mapeadorOutro,
+  totalMapeadores
+};
+
+const char *nomeMapeador(MapeadorRom mapeador);
+// Aceita os nomes de nomeMapeador, sem diferenca de maiusculas.
+bool mapeadorPorNome(const std::string &nome, MapeadorRom &mapeador);
+
+// Palpite pelo codigo: conta os "LD (nnnn),A" (#32 nn nn) para cada
+// endereco de troca de banco conhecido e fica com o mapeador que mais
+// explica as escritas. ROMs de ate' 64 KB sao lineares.
+MapeadorRom adivinharMapeador(const uint8_t *rom, size_t tamanho);
+
+#endif //MSX_TOOLS_MAPEADORES_H
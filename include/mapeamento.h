@@ -0,0 +1,36 @@
+#ifndef MSX_TOOLS_MAPEAMENTO_H
+#define MSX_TOOLS_MAPEAMENTO_H
+
+#include <cstdint>
+#include <string>
+
+// Visao somente leitura de um arquivo inteiro via mmap. Nada e' copiado
+// na abertura: o kernel so' carrega as paginas que forem acessadas, entao
+// abrir uma imagem de 4 GB custa o mesmo que abrir uma ROM de 16 KB.
+class ArquivoMapeado {
+  private:
+    int fd;
+    const uint8_t *base;
+    uint64_t tamanho;
+  public:
+    ArquivoMapeado();
+    ~ArquivoMapeado();
+    ArquivoMapeado(const ArquivoMapeado&) = delete;
+    ArquivoMapeado& operator=(const ArquivoMapeado&) = delete;
+    ArquivoMapeado(ArquivoMapeado&& outro) noexcept;
+    ArquivoMapeado& operator=(ArquivoMapeado&& outro) noexcept;
+
+    bool abrir(std::string arquivo);
+    void fechar();
+    bool aberto() const;
+
+    const uint8_t *getDados() const;
+    uint64_t getTamanho() const;
+    int getDescritor() const;
+
+    // Dicas para o kernel sobre o padrao de acesso de um trecho.
+    void preparar(uint64_t inicio, uint64_t n) const;
+    void setSequencial(bool sequencial) const;
+};
+
+#endif //MSX_TOOLS_MAPEAMENTO_H
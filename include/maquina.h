@@ -0,0 +1,106 @@
+#ifndef MSX_TOOLS_MAQUINA_H
+#define MSX_TOOLS_MAQUINA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "mapeadores.h"
+#include "msx.h"
+
+// Um MSX1 minimo para rodar cartuchos sem tela: no slot 0 uma BIOS de
+// mentira (a rotina de interrupcao, ENASLT, RSLREG, as de VRAM e PSG...; o
+// resto das entradas e' RET), no slot 1 o cartucho com o mapeador dele,
+// nada no 2 e 64 KB de RAM no 3, sem slots expandidos. Cada slot tem os
+// ponteiros das suas 8 paginas de 8 KB; a porta A8 e as trocas de banco so'
+// copiam ponteiros para o Barramento, e so' as paginas de um cartucho com
+// mapeador deixam a escrita sem ponteiro, para chegar em escrever(). O VDP
+// guarda VRAM e registradores e levanta a interrupcao de quadro; PSG e
+// teclado respondem "nada apertado".
+class MaquinaTeste : public Barramento {
+  public:
+    MaquinaTeste();
+
+    // Liga com a ROM no slot 1 e o PC no INIT do cabecalho AB, como a BIOS
+    // faz; falso sem INIT ou com mapeador que a maquina nao tem.
+    bool carregar(const uint8_t *dados, size_t tamanho, MapeadorRom mapeador);
+    // Roda ate' 'quadros' quadros de 1/60 s; para antes se a CPU travar
+    // (HALT com interrupcoes desligadas) ou sair da memoria.
+    void rodar(unsigned quadros);
+
+    bool getTravada();
+    // PC numa pagina sem memoria, executando #FF.
+    bool getPerdida();
+    // O INIT voltou para a BIOS.
+    bool getVoltou();
+    uint64_t getCiclos() const;
+    uint64_t getEscritasVram() const;
+
+    void escrever(uint16_t endereco, uint8_t valor) override;
+    uint8_t entrada(uint16_t porta) override;
+    void saida(uint16_t porta, uint8_t valor) override;
+
+  private:
+    CpuZ80 cpu;
+    std::vector<uint8_t> rom;
+    MapeadorRom mapeador;
+    uint8_t bios[0x8000];
+    uint8_t ram[0x10000];
+    // Leitura de pagina vazia e escrita em ROM.
+    uint8_t vazia[0x2000];
+    uint8_t descarte[0x2000];
+    const uint8_t *leituraSlot[4][8];
+    uint8_t *escritaSlot[4][8];
+    // Porta A8.
+    uint8_t slots;
+    uint8_t vram[0x4000];
+    uint8_t registradoresVdp[8];
+    uint8_t statusVdp;
+    uint8_t latchVdp;
+    bool segundoByte;
+    uint16_t enderecoVram;
+    uint8_t leituraVram;
+    uint64_t escritasVram;
+    uint8_t registradoresPsg[16];
+    uint8_t registradorPsg;
+    uint8_t linhaTeclado;
+
+    void mapear();
+    void trocarBanco(unsigned pagina, unsigned banco);
+    void atualizarInt();
+};
+
+enum EstadoTeste {
+  // Rodou todos os quadros.
+  testeRodando,
+  testeTravado,
+  testePerdido,
+  testeVoltou,
+  // Sem cabecalho AB com INIT, ou mapeador sem suporte.
+  testeInvalido
+};
+
+const char *nomeEstado(EstadoTeste estado);
+
+struct ResultadoTeste {
+  std::string arquivo;
+  MapeadorRom mapeador;
+  bool lido;
+  EstadoTeste estado;
+  uint64_t ciclos;
+  uint64_t escritasVram;
+  // Tempo de CPU do teste.
+  double segundos;
+};
+
+// Teste de fumaca: roda a ROM 'quadros' quadros na MaquinaTeste, com o
+// mapeador detectado pelo msx.
+bool testarRom(const MSX &msx, std::string arquivo, unsigned quadros, ResultadoTeste &resultado);
+// Testa todas as ROMs que casam com o padrao (glob), uma por tarefa de um
+// PoolTarefas. O resultado segue a ordem do glob; falso se alguma nao abriu.
+bool testarLote(const MSX &msx, std::string padrao, unsigned quadros, unsigned threads,
+                std::vector<ResultadoTeste> &resultado);
+
+#endif //MSX_TOOLS_MAQUINA_H
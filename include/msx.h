@@ -5,16 +5,55 @@
 #ifndef MSX_TOOLS_MSX_H
 #define MSX_TOOLS_MSX_H
 
+#include <memory>
 #include <string>
 
+#include "baserom.h"
+#include "cassete.h"
+#include "disco.h"
+#include "mapeadores.h"
+#include "tela.h"
+
 class MSX {
   private:
     std::string modelo;
     std::string versao;
+    std::shared_ptr<Disco> disco;
+    std::shared_ptr<Cassete> cassete;
+    // Base de ROMs conhecidas; as copias do MSX compartilham a mesma.
+    std::shared_ptr<BaseRoms> baseRoms;
   public:
     std::string getModelo();
     std::string getVersao();
     MSX(std::string descricao, std::string numver);
+
+    // Imagem de disco em uso; as copias do MSX compartilham a mesma.
+    // particao: para imagens de disco rigido do Nextor, indice da particao.
+    bool abrirDisco(std::string imagem, unsigned particao = 0, bool escrita = false);
+    Disco *getDisco();
+    // Fita .CAS em uso, compartilhada como o disco.
+    bool abrirCassete(std::string imagem);
+    Cassete *getCassete();
+
+    // Alteracoes no disco em uso, que tem que ter sido aberto para escrita.
+    // origem e' um arquivo do PC; os caminhos no disco sao como "JOGOS/A.ROM".
+    bool copiarParaDisco(std::string origem, std::string destino);
+    bool apagarDoDisco(std::string caminho);
+    bool renomearNoDisco(std::string caminho, std::string novoNome);
+
+    // Base de ROMs conhecidas gerada por BaseRoms::gerar.
+    bool abrirBaseRoms(std::string arquivo);
+    // Pela base, se a ROM estiver nela; senao, pelo palpite das escritas de
+    // troca de banco. SHA-1 e CRC so' sao calculados se houver base aberta.
+    MapeadorRom detectarMapeador(const uint8_t *rom, size_t tamanho) const;
+    bool detectarMapeador(std::string arquivo, MapeadorRom &mapeador) const;
+    // Procura a ROM na base pelo SHA-1 e depois pelo CRC-32. Fora da base, o
+    // titulo fica vazio, conhecida fica falso e o mapeador e' o palpite.
+    bool identificar(std::string arquivo, RomConhecida &rom) const;
+
+    // Imagem de um BSAVE de tela ou copia da VRAM. modo: 2 a 12, ou 0 para
+    // tirar da extensao (.SC2 a .SC8, .SCA a .SCC).
+    bool decodificarTela(std::string arquivo, unsigned modo, ImagemRGBA &imagem) const;
 };
 
 #endif //MSX_TOOLS_MSX_H
@@ -0,0 +1,96 @@
+#ifndef MSX_TOOLS_PADROES_H
+#define MSX_TOOLS_PADROES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Um padrao de 8x8 (8 bytes) ou sprite de 16x16 (32 bytes) no indice.
+struct EntradaPadrao {
+  // Os 8 bytes do padrao embaralhados de forma reversivel (sem colisao),
+  // ou o hash de 64 bits dos 32 bytes do sprite.
+  uint64_t chave;
+  // Menor numero de arquivo que tem o padrao.
+  uint32_t primeiro;
+  uint32_t arquivos;
+  uint32_t ocorrencias;
+  uint32_t tamanho;
+};
+
+// Quantos padroes 'arquivo' tem em comum com 'outro', um arquivo anterior
+// do indice que foi o primeiro a ter cada um deles.
+struct Compartilhamento {
+  uint32_t arquivo;
+  uint32_t outro;
+  uint64_t padroes;
+};
+
+// Indice de padroes e sprites de um acervo inteiro de ROMs e copias da
+// VRAM, para achar graficos repetidos sem comparar arquivo com arquivo.
+// E' uma tabela hash de enderecamento aberto (sondagem linear) num arquivo
+// usado direto do mmap: cabecalho, entradas de 24 bytes e, no fim, os
+// nomes dos arquivos indexados. A tabela dobra quando passa de 70% de uso,
+// regravada num arquivo novo que substitui o antigo.
+//
+// Telas (.SC2 a .SCC, BSAVE ou VRAM crua) contribuem as tabelas de padroes
+// e de sprites do modo; nas ROMs, cada 8 bytes alinhados sao um padrao e
+// cada 32 um sprite. Padroes com todos os bytes iguais (vazios ou cheios)
+// ficam de fora.
+class IndicePadroes {
+  public:
+    IndicePadroes();
+    ~IndicePadroes();
+    IndicePadroes(const IndicePadroes&) = delete;
+    IndicePadroes& operator=(const IndicePadroes&) = delete;
+
+    // Com escrita, cria o arquivo se nao existir.
+    bool abrir(std::string arquivo, bool escrita = true);
+    // Aberto para escrita, grava os nomes e o cabecalho.
+    bool fechar();
+    bool aberto() const;
+
+    // Varre os arquivos num PoolTarefas; os numeros deles seguem a ordem do
+    // vetor, depois dos que ja' estavam no indice. Nomes que ja' estao no
+    // indice (ou repetidos no vetor) sao pulados, e os que nao puderam ser
+    // lidos ficam fora dele.
+    bool adicionar(const std::vector<std::string> &arquivos, unsigned threads, std::vector<std::string> &erros);
+
+    bool procurar(const uint8_t *padrao, size_t tamanho, EntradaPadrao &entrada) const;
+    uint64_t getUsados() const;
+    uint64_t getCapacidade() const;
+    const std::vector<std::string> &getArquivos() const;
+
+    // Varre de novo cada arquivo do indice e conta, para cada um, os padroes
+    // que um arquivo anterior ja' tinha. Ordenado por arquivo e, dentro de
+    // cada um, do outro com mais padroes para o com menos.
+    bool compartilhamentos(unsigned threads, std::vector<Compartilhamento> &resultado) const;
+
+    // Chaves dos padroes do arquivo (com repeticoes), 8 bytes e 32 bytes.
+    static bool varrer(std::string arquivo, std::vector<uint64_t> &padroes, std::vector<uint64_t> &sprites);
+    static uint64_t chave(const uint8_t *padrao, size_t tamanho);
+
+  private:
+    struct Cabecalho;
+
+    std::string nome;
+    int fd;
+    bool escrita;
+    uint8_t *base;
+    size_t tamanhoMapa;
+    EntradaPadrao *entradas;
+    uint64_t capacidade;
+    uint64_t usados;
+    std::vector<std::string> arquivos;
+
+    bool mapear(uint64_t capacidade);
+    bool gravarCabecalho();
+    bool crescer();
+    void inserir(uint64_t chave, uint32_t tamanho, uint32_t arquivo, uint32_t ocorrencias);
+    // Numero do proximo arquivo para os padroes e sprites agrupados, e o
+    // nome no fim da lista.
+    bool inserirArquivo(const std::string &arquivo, const std::vector<std::pair<uint64_t, uint32_t>> (&grupos)[2]);
+};
+
+#endif //MSX_TOOLS_PADROES_H
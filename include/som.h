@@ -0,0 +1,132 @@
+#ifndef MSX_TOOLS_SOM_H
+#define MSX_TOOLS_SOM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Os chips de som do MSX, para tocar os registradores gravados num VGM.
+// Nenhum deles anda amostra por amostra: o que acontece entre duas escritas
+// de registrador e' gerado em blocos de ate' amostrasBloco amostras, um
+// canal de cada vez, 4 ou 8 amostras por instrucao (SSE2/AVX2). Cada chip
+// soma os seus canais em 'saida', em ponto flutuante (cerca de +-1 com
+// todos no maximo).
+static const size_t amostrasBloco = 256;
+
+// AY-3-8910 (PSG): tres tons quadrados, ruido de 17 bits e um envelope
+// compartilhado. O tom de cada amostra e' a media da onda quadrada durante
+// ela (a integral da onda, um triangulo, entre o comeco e o fim), o que
+// tira a maior parte do serrilhado dos tons agudos. Ruido e envelope mudam
+// no maximo uma vez por ciclo do divisor e sao tabelados para o bloco antes
+// dos canais.
+class ChipPsg {
+  public:
+    ChipPsg(double relogio, unsigned taxa);
+
+    void escrever(uint8_t registrador, uint8_t valor);
+    // n <= amostrasBloco.
+    void gerar(float *saida, size_t n);
+
+  private:
+    double relogio;
+    unsigned taxa;
+    uint8_t registradores[16];
+    // Fase de cada tom, 2^32 por ciclo.
+    uint32_t fases[3];
+    double faseRuido;
+    uint32_t lfsr;
+    double faseEnvelope;
+    unsigned passoEnvelope;
+    bool subindo;
+    bool parado;
+    unsigned nivelParado;
+    // Ruido (0 ou 1) e volume do envelope de cada amostra do bloco.
+    float ruido[amostrasBloco];
+    float envelope[amostrasBloco];
+};
+
+// Konami SCC (K051649): cinco canais de 32 amostras de 8 bits com sinal;
+// os dois ultimos dividem a forma de onda (no SCC+ o quinto tem a sua). As
+// portas sao as do comando 0xD2 do VGM: 0 forma de onda, 1 frequencia,
+// 2 volume, 3 canais ligados, 4 forma de onda do quinto canal (SCC+).
+class ChipScc {
+  public:
+    // 'mais': SCC+ (K052539), com a forma de onda do quinto canal separada.
+    ChipScc(double relogio, unsigned taxa, bool mais);
+
+    void escrever(uint8_t porta, uint8_t registrador, uint8_t valor);
+    void gerar(float *saida, size_t n);
+
+  private:
+    double relogio;
+    unsigned taxa;
+    bool mais;
+    int8_t ondas[5][32];
+    uint16_t periodos[5];
+    uint8_t volumes[5];
+    uint8_t ligados;
+    // 2^32 por volta da tabela.
+    uint32_t fases[5];
+};
+
+// Yamaha YM2413 (OPLL, MSX-MUSIC): nove canais FM de dois operadores, com
+// os 15 instrumentos da ROM, um do usuario e, no modo ritmo, bumbo, caixa,
+// tom-tom, prato e chimbal nos canais 6 a 8. E' uma aproximacao: a senoide
+// e' um polinomio, os envelopes andam em dB linearmente dentro do bloco e
+// os LFOs de vibrato e tremolo mudam uma vez por bloco; bate com o chip em
+// timbre e volume, nao amostra por amostra. A realimentacao do modulador
+// depende da amostra anterior, entao so' ele anda uma amostra por vez
+// quando ela esta' ligada.
+class ChipOpll {
+  public:
+    ChipOpll(double relogio, unsigned taxa);
+
+    void escrever(uint8_t registrador, uint8_t valor);
+    void gerar(float *saida, size_t n);
+
+  private:
+    enum Etapa {
+      ataque,
+      decaimento,
+      sustentacao,
+      liberacao,
+      desligado
+    };
+
+    struct Operador {
+      // Em ciclos, 0 a 1.
+      double fase;
+      Etapa etapa;
+      // Atenuacao do envelope.
+      double db;
+      bool chave;
+      // Duas ultimas saidas, para a realimentacao.
+      float saida1;
+      float saida2;
+    };
+
+    double relogio;
+    unsigned taxa;
+    uint8_t registradores[64];
+    // Modulador e portadora de cada canal.
+    Operador operadores[18];
+    uint64_t amostras;
+    uint32_t lfsr;
+    // Saida do modulador de cada canal.
+    float modulacao[9][amostrasBloco];
+    float ruido[amostrasBloco];
+
+    // Os 8 bytes do instrumento do canal.
+    const uint8_t *instrumento(unsigned canal) const;
+    bool ritmo() const;
+    void atualizarChaves();
+    // Anda o envelope n amostras; devolve a atenuacao total no comeco e no
+    // fim do bloco, em dB.
+    void envelope(unsigned canal, unsigned o, size_t n, double am, double &inicio, double &fim);
+    // Ciclos por amostra.
+    double incremento(unsigned canal, unsigned o, double vibrato) const;
+};
+
+// Para 16 bits com saturacao.
+void converterPcm(const float *entrada, size_t n, int16_t *saida);
+
+#endif //MSX_TOOLS_SOM_H
@@ -0,0 +1,99 @@
+#ifndef MSX_TOOLS_TABELAPECAS_H
+#define MSX_TOOLS_TABELAPECAS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tabela de pecas sobre os bytes originais (normalmente um ArquivoMapeado).
+// O documento e' uma sequencia de pecas, cada uma apontando para um trecho
+// do original ou do buffer de adicionados, guardada numa treap indexada por
+// posicao: sobrescrever, inserir e apagar custam O(log n) pecas, sem nunca
+// copiar o arquivo para a memoria.
+class TabelaPecas {
+  public:
+    TabelaPecas(const uint8_t *original = nullptr, uint64_t tamanho = 0);
+    void reiniciar(const uint8_t *original, uint64_t tamanho);
+
+    uint64_t getTamanho() const;
+    bool getModificado() const;
+
+    uint8_t byte(uint64_t pos) const;
+    uint64_t ler(uint64_t pos, uint8_t *destino, uint64_t n) const;
+
+    void sobrescrever(uint64_t pos, const uint8_t *bytes, uint64_t n);
+    void inserir(uint64_t pos, const uint8_t *bytes, uint64_t n);
+    void apagar(uint64_t pos, uint64_t n);
+
+    // Chama f(posicao, ponteiro, tamanho) para cada trecho contiguo do
+    // intervalo [pos, pos + n). Os ponteiros valem ate' a proxima edicao.
+    template<class F> void paraCadaTrecho(uint64_t pos, uint64_t n, F f) const;
+
+    // Grava o documento. Com noLugar, 'arquivo' e' o proprio arquivo do
+    // original: se o tamanho nao mudou so' as regioes alteradas sao escritas;
+    // senao o documento vai para um temporario que substitui o arquivo.
+    bool salvar(std::string arquivo, bool noLugar);
+
+  private:
+    enum Origem : uint8_t { ORIGINAL, ADICIONADO };
+
+    struct Peca {
+      uint64_t inicio;
+      uint64_t tamanho;
+      uint64_t total;
+      uint32_t esq;
+      uint32_t dir;
+      uint32_t prioridade;
+      Origem origem;
+    };
+
+    const uint8_t *original;
+    uint64_t tamanhoOriginal;
+    std::vector<uint8_t> adicionados;
+    std::vector<Peca> nos;
+    std::vector<uint32_t> livres;
+    uint32_t raiz;
+    uint32_t semente;
+    bool modificado;
+
+    uint32_t novaPeca(Origem origem, uint64_t inicio, uint64_t tamanho);
+    void liberar(uint32_t t);
+    void atualizar(uint32_t t);
+    void dividir(uint32_t t, uint64_t pos, uint32_t &a, uint32_t &b);
+    uint32_t juntar(uint32_t a, uint32_t b);
+    bool estenderUltimo(uint32_t &t, uint64_t n);
+    const uint8_t *dadosPeca(const Peca &p) const;
+    template<class F> void visitar(uint32_t t, uint64_t base, uint64_t de, uint64_t ate, F &f) const;
+};
+
+template<class F> void TabelaPecas::visitar(uint32_t t, uint64_t base, uint64_t de, uint64_t ate, F &f) const {
+  while(t) {
+    const Peca &p = nos[t];
+    uint64_t inicioPeca = base + (p.esq ? nos[p.esq].total : 0);
+    uint64_t fimPeca = inicioPeca + p.tamanho;
+
+    if(de < inicioPeca)
+      visitar(p.esq, base, de, ate, f);
+    if(de < fimPeca && ate > inicioPeca) {
+      uint64_t a = de > inicioPeca ? de : inicioPeca;
+      uint64_t b = ate < fimPeca ? ate : fimPeca;
+      f(a, dadosPeca(p) + (a - inicioPeca), b - a);
+    }
+    if(ate <= fimPeca)
+      return;
+    t = p.dir;
+    base = fimPeca;
+  }
+}
+
+template<class F> void TabelaPecas::paraCadaTrecho(uint64_t pos, uint64_t n, F f) const {
+  uint64_t tamanho = getTamanho();
+
+  if(pos >= tamanho)
+    return;
+  if(n > tamanho - pos)
+    n = tamanho - pos;
+  visitar(raiz, 0, pos, pos + n, f);
+}
+
+#endif //MSX_TOOLS_TABELAPECAS_H
@@ -0,0 +1,51 @@
+#ifndef MSX_TOOLS_TAREFAS_H
+#define MSX_TOOLS_TAREFAS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool de threads com roubo de tarefas. Cada trabalhador tem sua propria
+// fila: tira tarefas do fim da sua e, quando ela esvazia, rouba do comeco
+// das filas dos outros, entao lotes desiguais (um disco de 2 MB no meio de
+// mil de 360 KB) nao deixam threads paradas.
+class PoolTarefas {
+  public:
+    explicit PoolTarefas(unsigned threads = 0);
+    ~PoolTarefas();
+    PoolTarefas(const PoolTarefas&) = delete;
+    PoolTarefas& operator=(const PoolTarefas&) = delete;
+
+    void adicionar(std::function<void()> tarefa);
+    // Bloqueia ate' todas as tarefas adicionadas terminarem.
+    void esperar();
+
+    unsigned getThreads() const;
+    // Indice do trabalhador que esta' rodando a tarefa atual, ou -1 fora do pool.
+    static int trabalhadorAtual();
+
+  private:
+    struct Fila {
+      std::mutex trava;
+      std::deque<std::function<void()>> tarefas;
+    };
+
+    std::vector<std::unique_ptr<Fila>> filas;
+    std::vector<std::thread> threads;
+    std::mutex trava;
+    std::condition_variable temTarefa;
+    std::condition_variable terminou;
+    std::atomic<uint64_t> pendentes;
+    std::atomic<unsigned> proximaFila;
+    bool parar;
+
+    bool pegar(unsigned indice, std::function<void()> &tarefa);
+    void trabalhar(unsigned indice);
+};
+
+#endif //MSX_TOOLS_TAREFAS_H
@@ -0,0 +1,83 @@
+#ifndef MSX_TOOLS_TELA_H
+#define MSX_TOOLS_TELA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pixels de 32 bits com R no byte mais baixo, depois G, B e A: na memoria,
+// a ordem RGBA que o PNG espera.
+struct ImagemRGBA {
+  unsigned largura;
+  unsigned altura;
+  std::vector<uint32_t> pixels;
+};
+
+// Niveis de 3 bits (paleta) e de 5 bits (YJK) do VDP em 8 bits.
+struct NiveisCor {
+  uint8_t n3[8] = {};
+  uint8_t n5[32] = {};
+
+  constexpr NiveisCor() {
+    for(int i = 0; i < 8; i++)
+      n3[i] = uint8_t(i * 255 / 7);
+    for(int i = 0; i < 32; i++)
+      n5[i] = uint8_t((i << 3) | (i >> 2));
+  }
+};
+
+constexpr NiveisCor niveisCor = NiveisCor();
+
+// VRAM de 128 KB e a imagem da pagina 0 nos modos SCREEN 2 a 8 e 10 a 12,
+// com as tabelas nos enderecos que o BASIC usa. So' o fundo: sprites nao
+// sao desenhados. A paleta vem da copia que o BASIC guarda na VRAM, ou e'
+// a padrao do V9938 se essa copia nao estiver no arquivo.
+//
+// Cada modo converte por tabela: os de 4 bits por pixel pegam dois pixels
+// prontos por byte, o SCREEN 6 quatro, e o SCREEN 8 tem as 256 cores
+// fixas. O YJK do SCREEN 10 a 12 e' convertido 8 (SSE2) ou 16 (AVX2)
+// pixels por vez; no SCREEN 10/11, os pixels de paleta (YAE) entram por
+// pshufb no AVX2 e sao corrigidos um a um no SSE2.
+class Tela {
+  public:
+    static constexpr size_t tamanhoVram = 128 << 10;
+
+    Tela();
+
+    // Arquivo do BSAVE ,S (cabecalho #FE), posto no endereco inicial dele,
+    // ou copia crua da VRAM de 16, 64 ou 128 KB a partir do endereco 0.
+    bool carregar(const uint8_t *dados, size_t n);
+    bool abrir(std::string arquivo);
+
+    // modo: 2 a 8 ou 10 a 12. 212 linhas nos modos de bitmap se o arquivo
+    // chegar ate' a ultima delas; senao, 192.
+    bool decodificar(unsigned modo, ImagemRGBA &imagem) const;
+    // As 16 cores do modo, em RGBA.
+    void paleta(unsigned modo, uint32_t cores[16]) const;
+
+    const std::vector<uint8_t> &getVram() const;
+
+  private:
+    std::vector<uint8_t> vram;
+    // Trecho que veio do arquivo; o resto da VRAM fica zerado.
+    size_t inicio;
+    size_t fim;
+
+    void padroes(const uint32_t cores[16], ImagemRGBA &imagem) const;
+    void multicor(const uint32_t cores[16], ImagemRGBA &imagem) const;
+    void bitmap(unsigned modo, const uint32_t cores[16], ImagemRGBA &imagem) const;
+};
+
+// Pela extensao: .SC2 a .SC8, .SCA (10), .SCB (11) e .SCC (12); 0 se nao for.
+unsigned modoPorExtensao(std::string arquivo);
+// YJK de 'n' bytes (multiplo de 4) para RGBA. Com 'paleta', e' o YJK+YAE
+// do SCREEN 10/11: bytes com o bit 3 ligado sao a cor paleta[byte >> 4].
+void converterYJK(const uint8_t *dados, size_t n, uint32_t *saida, const uint32_t *paleta = nullptr);
+// Media de cada bloco de fator x fator pixels; 1 so' copia.
+void reduzir(const ImagemRGBA &origem, unsigned fator, ImagemRGBA &destino);
+bool gravarPng(std::string arquivo, const ImagemRGBA &imagem);
+// Qualquer PNG, convertido para RGBA de 8 bits.
+bool lerPng(std::string arquivo, ImagemRGBA &imagem);
+
+#endif //MSX_TOOLS_TELA_H
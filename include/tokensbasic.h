@@ -0,0 +1,77 @@
+#ifndef MSX_TOOLS_TOKENSBASIC_H
+#define MSX_TOOLS_TOKENSBASIC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Palavras reservadas do MSX-BASIC, indexadas pelo token menos 0x80.
+// "" marca os codigos sem palavra. Comandos e operadores usam um byte;
+// as funcoes vem depois do prefixo 0xFF.
+constexpr std::string_view tokensComandos[0x80] = {
+  "", "END", "FOR", "NEXT", "DATA", "INPUT", "DIM", "READ",                                 // 80
+  "LET", "GOTO", "RUN", "IF", "RESTORE", "GOSUB", "RETURN", "REM",                          // 88
+  "STOP", "PRINT", "CLEAR", "LIST", "NEW", "ON", "WAIT", "DEF",                             // 90
+  "POKE", "CONT", "CSAVE", "CLOAD", "OUT", "LPRINT", "LLIST", "CLS",                        // 98
+  "WIDTH", "ELSE", "TRON", "TROFF", "SWAP", "ERASE", "ERROR", "RESUME",                     // A0
+  "DELETE", "AUTO", "RENUM", "DEFSTR", "DEFINT", "DEFSNG", "DEFDBL", "LINE",                // A8
+  "OPEN", "FIELD", "GET", "PUT", "CLOSE", "LOAD", "MERGE", "FILES",                         // B0
+  "LSET", "RSET", "SAVE", "LFILES", "CIRCLE", "COLOR", "DRAW", "PAINT",                     // B8
+  "BEEP", "PLAY", "PSET", "PRESET", "SOUND", "SCREEN", "VPOKE", "SPRITE",                   // C0
+  "VDP", "BASE", "CALL", "TIME", "KEY", "MAX", "MOTOR", "BLOAD",                            // C8
+  "BSAVE", "DSKO$", "SET", "NAME", "KILL", "IPL", "COPY", "CMD",                            // D0
+  "LOCATE", "TO", "THEN", "TAB(", "STEP", "USR", "FN", "SPC(",                              // D8
+  "NOT", "ERL", "ERR", "STRING$", "USING", "INSTR", "'", "VARPTR",                          // E0
+  "CSRLIN", "ATTR$", "DSKI$", "OFF", "INKEY$", "POINT", ">", "=",                           // E8
+  "<", "+", "-", "*", "/", "^", "AND", "OR",                                                // F0
+  "XOR", "EQV", "IMP", "MOD", "\\", "", "", ""                                              // F8
+};
+
+constexpr std::string_view tokensFuncoes[0x80] = {
+  "", "LEFT$", "RIGHT$", "MID$", "SGN", "INT", "ABS", "SQR",                                // 80
+  "RND", "SIN", "LOG", "EXP", "COS", "TAN", "ATN", "FRE",                                   // 88
+  "INP", "POS", "LEN", "STR$", "VAL", "ASC", "CHR$", "PEEK",                                // 90
+  "VPEEK", "SPACE$", "OCT$", "HEX$", "LPOS", "BIN$", "CINT", "CSNG",                        // 98
+  "CDBL", "FIX", "STICK", "STRIG", "PDL", "PAD", "DSKF", "FPOS",                            // A0
+  "CVI", "CVS", "CVD", "EOF", "LOC", "LOF", "MKI$", "MKS$",                                 // A8
+  "MKD$", "", "", "", "", "", "", "",                                                      // B0
+  "", "", "", "", "", "", "", "",                                                           // B8
+  "", "", "", "", "", "", "", "",                                                           // C0
+  "", "", "", "", "", "", "", "",                                                           // C8
+  "", "", "", "", "", "", "", "",                                                           // D0
+  "", "", "", "", "", "", "", "",                                                           // D8
+  "", "", "", "", "", "", "", "",                                                           // E0
+  "", "", "", "", "", "", "", "",                                                           // E8
+  "", "", "", "", "", "", "", "",                                                           // F0
+  "", "", "", "", "", "", "", ""                                                            // F8
+};
+
+// Tokens com tratamento especial na conversao.
+constexpr uint8_t tokenData = 0x84;
+constexpr uint8_t tokenRem = 0x8F;
+constexpr uint8_t tokenElse = 0xA1;
+constexpr uint8_t tokenApostrofo = 0xE6;
+constexpr uint8_t prefixoFuncao = 0xFF;
+
+// Constantes numericas dentro das linhas.
+constexpr uint8_t numeroOctal = 0x0B;     // &O, 2 bytes
+constexpr uint8_t numeroHex = 0x0C;       // &H, 2 bytes
+constexpr uint8_t numeroPonteiro = 0x0D;  // linha ja' resolvida pelo RUN, 2 bytes
+constexpr uint8_t numeroLinha = 0x0E;     // numero de linha, 2 bytes
+constexpr uint8_t numeroByte = 0x0F;      // inteiro 10-255, 1 byte
+constexpr uint8_t numeroZero = 0x11;      // 0x11-0x1A: inteiros 0-9
+constexpr uint8_t numeroInteiro = 0x1C;   // inteiro, 2 bytes
+constexpr uint8_t numeroSimples = 0x1D;   // precisao simples, 4 bytes BCD
+constexpr uint8_t numeroDupla = 0x1F;     // precisao dupla, 8 bytes BCD
+
+// Maior palavra das tabelas; limita quanto um byte de token pode crescer.
+constexpr size_t maiorToken() {
+  size_t maior = 0;
+  for(size_t i = 0; i < 0x80; i++) {
+    maior = tokensComandos[i].size() > maior ? tokensComandos[i].size() : maior;
+    maior = tokensFuncoes[i].size() > maior ? tokensFuncoes[i].size() : maior;
+  }
+  return maior;
+}
+
+#endif //MSX_TOOLS_TOKENSBASIC_H
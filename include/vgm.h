@@ -0,0 +1,51 @@
+#ifndef MSX_TOOLS_VGM_H
+#define MSX_TOOLS_VGM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Cabecalho de um VGM: duracoes em amostras de 44100 Hz e relogio dos chips
+// do MSX, 0 se o arquivo nao usa o chip.
+struct InfoVgm {
+  uint32_t versao;
+  uint32_t amostras;
+  uint32_t amostrasVolta;
+  uint32_t relogioPsg;
+  uint32_t relogioScc;
+  uint32_t relogioOpll;
+  bool sccMais;
+};
+
+// Gravacao VGM (ou VGZ, o mesmo com gzip) das escritas nos registradores
+// do PSG (comando 0xA0), do SCC (0xD2) e do YM2413 (0x51); os comandos dos
+// outros chips sao pulados pelo tamanho. O arquivo inteiro fica na memoria
+// (as musicas tem dezenas de KB).
+class Vgm {
+  public:
+    Vgm();
+
+    bool abrir(std::string arquivo);
+    const InfoVgm &getInfo() const;
+
+    // Toca os comandos e grava PCM mono de 16 bits na taxa pedida. Cada
+    // espera entre escritas vira blocos de amostrasBloco para os chips (as
+    // de 44100 Hz passam para a taxa por um acumulador, sem deriva), e
+    // 'voltas' repete o trecho de loop. Devolve as amostras gravadas.
+    uint64_t renderizar(std::ostream &saida, unsigned taxa, unsigned voltas) const;
+
+  private:
+    std::vector<uint8_t> dados;
+    InfoVgm info;
+    size_t inicio;
+    // Posicao do loop nos dados, 0 se nao tem.
+    size_t volta;
+};
+
+// Gera o WAV (PCM mono de 16 bits) de um VGM/VGZ.
+bool converterVgmWav(std::string vgm, std::string wav, unsigned taxa = 44100, unsigned voltas = 0,
+                     double *segundos = nullptr);
+
+#endif //MSX_TOOLS_VGM_H
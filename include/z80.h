@@ -0,0 +1,154 @@
+#ifndef MSX_TOOLS_Z80_H
+#define MSX_TOOLS_Z80_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mapeadores.h"
+
+class PoolTarefas;
+class Rastreador;
+
+// Efeito de uma instrucao no fluxo de execucao, para quem segue o codigo.
+enum FluxoZ80 {
+  fluxoSegue,
+  fluxoSalto,
+  fluxoSaltoCondicional,
+  fluxoChamada,
+  fluxoChamadaCondicional,
+  fluxoRetorno,
+  fluxoRetornoCondicional,
+  fluxoIndireto
+};
+
+struct InstrucaoZ80 {
+  uint8_t tamanho;
+  FluxoZ80 fluxo;
+  // Endereco de saltos, chamadas e RST.
+  uint16_t destino;
+  // Falso quando os bytes nao formam instrucao e viram um DB.
+  bool valida;
+};
+
+// Desmontador Z80 com todos os prefixos (CB, DD, ED, FD, DDCB, FDCB) e as
+// instrucoes nao documentadas (IXH/IXL, SLL, as copias do DDCB com
+// registrador, IN F,(C), OUT (C),0...); com r800, tambem MULUB e MULUW.
+// Cada opcode e' uma entrada de tabela constexpr com o formato do texto e
+// as marcas dos operandos, entao decodificar e' indexar e copiar. A
+// listagem vai para um buffer de texto reaproveitado entre chamadas.
+class Desmontador {
+  public:
+    explicit Desmontador(bool r800 = false);
+
+    // Tamanho e efeito no fluxo da instrucao em p, sem gerar texto.
+    InstrucaoZ80 decodificar(const uint8_t *p, size_t n, uint16_t endereco) const;
+    // Texto da instrucao ("LD A,(IX+#05)") em destino, que deve ter
+    // tamanhoTexto bytes; devolve quantos caracteres escreveu.
+    size_t formatar(const uint8_t *p, size_t n, uint16_t endereco, char *destino, InstrucaoZ80 *instrucao = nullptr) const;
+
+    // Acrescenta ao buffer uma linha "endereco  bytes  instrucao" por
+    // instrucao. Com fim falso, para antes de uma instrucao que possa
+    // continuar no proximo pedaco e devolve quantos bytes consumiu, para
+    // desmontar arquivos grandes em pedacos.
+    size_t desmontar(const uint8_t *dados, size_t n, uint16_t endereco, bool fim = true);
+    // Listagem da ROM inteira ja' rastreada: instrucoes onde o rastreador
+    // achou codigo, DB no resto, e cada banco de MegaROM no endereco dele.
+    void listar(const Rastreador &rastreador);
+    void limpar();
+    const char *getTexto() const;
+    size_t getTamanho() const;
+
+    static const size_t tamanhoTexto = 32;
+
+  private:
+    bool r800;
+    std::vector<char> saida;
+    size_t usado;
+
+    char *reservar();
+    size_t linha(const uint8_t *p, size_t n, uint16_t endereco);
+    void linhaDados(const uint8_t *p, unsigned n, uint16_t endereco);
+};
+
+// O que o rastreador sabe de cada byte da ROM; cabe em 2 bits.
+enum RegiaoRom {
+  regiaoDesconhecida,
+  regiaoDado,
+  regiaoCodigo,
+  // Primeiro byte de uma instrucao.
+  regiaoInicio
+};
+
+// Pedaco contiguo da ROM e o endereco do Z80 em que ele roda.
+struct TrechoRom {
+  size_t inicio;
+  size_t tamanho;
+  uint16_t endereco;
+};
+
+// Separa codigo de dados numa ROM de cartucho seguindo o fluxo a partir do
+// cabecalho "AB": INIT, STATEMENT e DEVICE sao rastreados como codigo, e o
+// programa BASIC de TEXT e' marcado como dado. Saltos condicionais e
+// chamadas abrem novos caminhos; JP (HL), RET e saltos incondicionais
+// terminam o caminho. Depois de RST #08 (SYNCHR) e RST #30 (CALLF) os bytes
+// em linha sao dados.
+//
+// Cada chamada vira uma tarefa de um PoolTarefas, e o mapa (2 bits por
+// byte) e' marcado com operacoes atomicas, entao caminhos que se encontram
+// param no primeiro inicio de instrucao ja' visto.
+//
+// Numa MegaROM, os primeiros 16 KB sao rastreados em #4000. Os destinos
+// que caem na janela #8000-#BFFF sao tentados em cada um dos outros
+// bancos, um banco por tarefa. Como ninguem garante que o banco certo
+// esteja na janela, um caminho que passa por opcode invalido, sai do banco
+// no meio de uma instrucao ou chega num RST #38 (o #FF de preenchimento)
+// e' descartado inteiro.
+class Rastreador {
+  public:
+    // bancoKB: tamanho dos bancos de MegaROM, 8 (Konami, ASCII8) ou 16
+    // (ASCII16); qualquer outro valor vale 8.
+    explicit Rastreador(unsigned bancoKB = 8, bool r800 = false);
+    ~Rastreador();
+
+    // rom tem que continuar valida enquanto o rastreador for usado. Com
+    // cabecalho em #0000 e um mapeador que nao seja o linear, a ROM e'
+    // rastreada como MegaROM.
+    bool analisar(const uint8_t *rom, size_t tamanho, MapeadorRom mapeador, unsigned threads = 0);
+
+    RegiaoRom regiao(size_t pos) const;
+    const std::vector<TrechoRom> &getTrechos() const;
+    const uint8_t *getRom() const;
+    size_t getTamanho() const;
+    size_t getBytesBanco() const;
+    bool getMegaRom() const;
+    size_t getBytesCodigo() const;
+
+  private:
+    Desmontador desmontador;
+    size_t bytesBanco;
+    const uint8_t *rom;
+    size_t tamanho;
+    bool megaRom;
+    std::vector<TrechoRom> trechos;
+    std::unique_ptr<std::atomic<uint64_t>[]> mapa;
+    // Destinos na janela dos bancos achados no codigo fixo.
+    std::mutex travaJanela;
+    std::vector<uint16_t> janela;
+
+    // Sobe a marca de pos ate' regiao e devolve a anterior.
+    RegiaoRom elevar(size_t pos, RegiaoRom regiao);
+    // Falso se pos ja' era inicio de instrucao.
+    bool marcarInstrucao(size_t pos, unsigned n);
+    void marcarTexto(uint16_t endereco);
+    // Guarda um destino fora do codigo fixo que cai na janela dos bancos.
+    void anotarJanela(uint16_t endereco);
+    void rastrearFixo(PoolTarefas &pool, uint16_t endereco);
+    void rastrearBanco(size_t banco);
+    bool tentar(const TrechoRom &trecho, uint16_t entrada, std::vector<uint8_t> &regioes) const;
+};
+
+#endif //MSX_TOOLS_Z80_H
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstring>
+
+#include "basic.h"
+#include "tokensbasic.h"
+
+// Um byte de entrada nunca vira mais que isso na saida: o pior caso sao os
+// reais de precisao simples, 5 bytes que viram ate' ".0123456!".
+static constexpr size_t expansaoMaxima = 8;
+static_assert(maiorToken() <= expansaoMaxima, "token maior que a expansao prevista");
+
+// O byte 0xFF do arquivo fica no lugar do #8000: a primeira linha esta' em
+// #8001, como o BASIC carrega.
+static constexpr uint16_t enderecoArquivo = 0x8000;
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+static char *escrever(char *p, std::string_view texto) {
+  std::memcpy(p, texto.data(), texto.size());
+  return p + texto.size();
+}
+
+static char *escreverInteiro(char *p, uint32_t valor) {
+  char digitos[10];
+  int n = 0;
+
+  do {
+    digitos[n++] = char('0' + valor % 10);
+    valor /= 10;
+  } while(valor);
+  while(n)
+    *p++ = digitos[--n];
+  return p;
+}
+
+static char *escreverBase(char *p, uint32_t valor, unsigned bits) {
+  char digitos[16];
+  int n = 0;
+
+  do {
+    digitos[n++] = "0123456789ABCDEF"[valor & ((1u << bits) - 1)];
+    valor >>= bits;
+  } while(valor);
+  while(n)
+    *p++ = digitos[--n];
+  return p;
+}
+
+// Reais em BCD: sinal e expoente (excesso 0x40) no primeiro byte, depois 6
+// ou 14 digitos. Escreve como o LIST: ponto fixo quando cabe, senao com
+// expoente, e com o sufixo que faz a constante voltar ao mesmo tipo.
+static char *escreverReal(char *p, const uint8_t *bcd, int bytes, bool dupla) {
+  char digitos[14];
+  int n = 0;
+
+  for(int i = 1; i < bytes; i++) {
+    digitos[n++] = char('0' + (bcd[i] >> 4));
+    digitos[n++] = char('0' + (bcd[i] & 0x0F));
+  }
+  while(n && digitos[n - 1] == '0')
+    n--;
+  if(!n || !(bcd[0] & 0x7F)) {
+    *p++ = '0';
+    *p++ = dupla ? '#' : '!';
+    return p;
+  }
+
+  if(bcd[0] & 0x80)
+    *p++ = '-';
+  int ponto = int(bcd[0] & 0x7F) - 0x40;
+  if(ponto < -1 || ponto > (dupla ? 14 : 6)) {
+    *p++ = digitos[0];
+    if(n > 1) {
+      *p++ = '.';
+      p = escrever(p, std::string_view(digitos + 1, n - 1));
+    }
+    int expoente = ponto - 1;
+    *p++ = dupla ? 'D' : 'E';
+    *p++ = expoente < 0 ? '-' : '+';
+    expoente = expoente < 0 ? -expoente : expoente;
+    *p++ = char('0' + expoente / 10);
+    *p++ = char('0' + expoente % 10);
+    return p;
+  }
+
+  if(ponto <= 0) {
+    *p++ = '.';
+    for(int i = 0; i < -ponto; i++)
+      *p++ = '0';
+    p = escrever(p, std::string_view(digitos, n));
+  } else if(ponto >= n) {
+    p = escrever(p, std::string_view(digitos, n));
+    for(int i = n; i < ponto; i++)
+      *p++ = '0';
+  } else {
+    p = escrever(p, std::string_view(digitos, ponto));
+    *p++ = '.';
+    p = escrever(p, std::string_view(digitos + ponto, n - ponto));
+  }
+
+  // Um inteiro pequeno sem sufixo voltaria como inteiro.
+  if(!dupla)
+    *p++ = '!';
+  else if(ponto >= n && ponto <= 5) {
+    uint32_t valor = 0;
+    for(int i = 0; i < ponto; i++)
+      valor = valor * 10 + (i < n ? digitos[i] - '0' : 0);
+    if(valor <= 32767)
+      *p++ = '#';
+  }
+  return p;
+}
+
+Detokenizador::Detokenizador() : usado(0) {
+}
+
+const char *Detokenizador::getTexto() const {
+  return saida.data();
+}
+
+size_t Detokenizador::getTamanho() const {
+  return usado;
+}
+
+// O RUN troca o numero por um ponteiro para o byte antes da linha, o 0x00
+// que fecha a anterior; aceita tambem um que aponte para a propria linha.
+bool Detokenizador::linhaDoPonteiro(uint16_t ponteiro, uint16_t &linha) const {
+  for(uint16_t endereco : {uint16_t(ponteiro + 1), ponteiro}) {
+    auto l = std::lower_bound(linhas.begin(), linhas.end(), std::make_pair(endereco, uint16_t(0)));
+    if(l != linhas.end() && l->first == endereco) {
+      linha = l->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Detokenizador::converter(const uint8_t *programa, size_t tamanho) {
+  // O buffer so' cresce; nenhuma escrita abaixo precisa conferir espaco.
+  if(saida.size() < tamanho * expansaoMaxima + 16)
+    saida.resize(tamanho * expansaoMaxima + 16);
+  char *p = saida.data();
+  const uint8_t *q = programa + 1;
+  const uint8_t *fim = programa + tamanho;
+  bool ok = false;
+
+  // Os ponteiros podem apontar para linhas mais adiante: a cadeia de
+  // enderecos e' percorrida antes, enquanto crescer e couber no arquivo.
+  linhas.clear();
+  for(size_t pos = 1; pos + 4 <= tamanho && pos < 0x8000;) {
+    uint16_t seguinte = le16(programa + pos);
+    if(!seguinte)
+      break;
+    linhas.emplace_back(uint16_t(enderecoArquivo + pos), le16(programa + pos + 2));
+    if(seguinte <= enderecoArquivo + pos || size_t(seguinte - enderecoArquivo) >= tamanho)
+      break;
+    pos = seguinte - enderecoArquivo;
+  }
+
+  usado = 0;
+  if(!tamanho || programa[0] != 0xFF)
+    return false;
+
+  // Cada linha: ponteiro para a proxima (0 no fim do programa), numero da
+  // linha e o texto tokenizado terminado em 0x00. Os ponteiros sao
+  // enderecos da memoria do MSX, entao as linhas sao lidas em sequencia.
+  while(q + 2 <= fim && (q[0] | q[1])) {
+    if(q + 4 > fim)
+      break;
+    p = escreverInteiro(p, le16(q + 2));
+    *p++ = ' ';
+    q += 4;
+
+    bool aspas = false, dados = false, literal = false, terminou = false;
+    while(q < fim) {
+      uint8_t b = *q++;
+      if(b == 0x00) {
+        terminou = true;
+        break;
+      }
+      if(literal || aspas) {
+        *p++ = char(b);
+        aspas = aspas && b != '"';
+        continue;
+      }
+      if(b == '"') {
+        *p++ = char(b);
+        aspas = true;
+        continue;
+      }
+      if(dados) {
+        *p++ = char(b);
+        dados = b != ':';
+        continue;
+      }
+
+      if(b == ':') {
+        // ELSE e o apostrofo sao gravados com um ':' escondido antes.
+        if(q < fim && *q == tokenElse) {
+          p = escrever(p, tokensComandos[tokenElse - 0x80]);
+          q++;
+        } else if(q + 1 < fim && q[0] == tokenRem && q[1] == tokenApostrofo) {
+          *p++ = '\'';
+          q += 2;
+          literal = true;
+        } else
+          *p++ = ':';
+        continue;
+      }
+
+      if(b == prefixoFuncao) {
+        if(q < fim && *q >= 0x80 && !tokensFuncoes[*q - 0x80].empty())
+          p = escrever(p, tokensFuncoes[*q++ - 0x80]);
+        else
+          *p++ = char(b);
+        continue;
+      }
+      if(b >= 0x80) {
+        if(tokensComandos[b - 0x80].empty()) {
+          *p++ = char(b);
+          continue;
+        }
+        p = escrever(p, tokensComandos[b - 0x80]);
+        literal = b == tokenRem || b == tokenApostrofo;
+        dados = b == tokenData;
+        continue;
+      }
+
+      // Constantes numericas; uma que passe do fim do arquivo o invalida.
+      size_t resta = size_t(fim - q);
+      switch(b) {
+        case numeroOctal:
+        case numeroHex:
+          if(resta < 2)
+            break;
+          *p++ = '&';
+          *p++ = b == numeroOctal ? 'O' : 'H';
+          p = escreverBase(p, le16(q), b == numeroOctal ? 3 : 4);
+          q += 2;
+          continue;
+        case numeroPonteiro:
+        case numeroLinha: {
+          if(resta < 2)
+            break;
+          uint16_t linha = le16(q);
+          if(b == numeroPonteiro)
+            linhaDoPonteiro(le16(q), linha);
+          p = escreverInteiro(p, linha);
+          q += 2;
+          continue;
+        }
+        case numeroByte:
+          if(resta < 1)
+            break;
+          p = escreverInteiro(p, *q++);
+          continue;
+        case numeroInteiro:
+          if(resta < 2)
+            break;
+          if(le16(q) & 0x8000) {
+            *p++ = '-';
+            p = escreverInteiro(p, 0x10000u - le16(q));
+          } else
+            p = escreverInteiro(p, le16(q));
+          q += 2;
+          continue;
+        case numeroSimples:
+        case numeroDupla: {
+          int bytes = b == numeroSimples ? 4 : 8;
+          if(resta < size_t(bytes))
+            break;
+          p = escreverReal(p, q, bytes, b == numeroDupla);
+          q += bytes;
+          continue;
+        }
+        default:
+          if(b >= numeroZero && b < numeroZero + 10)
+            *p++ = char('0' + b - numeroZero);
+          else
+            *p++ = char(b);
+          continue;
+      }
+      q = fim;
+    }
+    if(!terminou)
+      break;
+    *p++ = '\r';
+    *p++ = '\n';
+  }
+  // Alguns arquivos acabam sem o ponteiro zero da ultima linha.
+  ok = q == fim || (q + 2 <= fim && !(q[0] | q[1]));
+  usado = size_t(p - saida.data());
+  return ok;
+}
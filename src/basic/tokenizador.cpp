@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <cstring>
+
+#include "basic.h"
+#include "tokensbasic.h"
+
+// Trie das palavras reservadas, montada pelo compilador. Cada no' guarda a
+// letra, o primeiro filho e o proximo irmao; o primeiro nivel e' indexado
+// direto pelo caractere. token != 0 marca o fim de uma palavra.
+struct NoTrie {
+  char letra = 0;
+  uint8_t token = 0;
+  bool funcao = false;
+  int16_t filho = -1;
+  int16_t irmao = -1;
+};
+
+constexpr size_t letrasTokens() {
+  size_t n = 0;
+  for(size_t i = 0; i < 0x80; i++)
+    n += tokensComandos[i].size() + tokensFuncoes[i].size();
+  return n;
+}
+
+struct Trie {
+  int16_t raiz[128];
+  NoTrie nos[letrasTokens()];
+  size_t quantidade;
+
+  constexpr Trie() : raiz(), nos(), quantidade(0) {
+    for(int16_t &r : raiz)
+      r = -1;
+    for(size_t i = 1; i < 0x80; i++) {
+      inserir(tokensComandos[i], uint8_t(0x80 + i), false);
+      inserir(tokensFuncoes[i], uint8_t(0x80 + i), true);
+    }
+  }
+
+  constexpr int16_t novo(char letra) {
+    nos[quantidade] = NoTrie{letra, 0, false, -1, -1};
+    return int16_t(quantidade++);
+  }
+
+  constexpr void inserir(std::string_view palavra, uint8_t token, bool funcao) {
+    if(palavra.empty())
+      return;
+    int16_t atual = raiz[uint8_t(palavra[0])];
+    if(atual < 0)
+      atual = raiz[uint8_t(palavra[0])] = novo(palavra[0]);
+    for(size_t i = 1; i < palavra.size(); i++) {
+      int16_t filho = nos[atual].filho, anterior = -1;
+      while(filho >= 0 && nos[filho].letra != palavra[i]) {
+        anterior = filho;
+        filho = nos[filho].irmao;
+      }
+      if(filho < 0) {
+        filho = novo(palavra[i]);
+        if(anterior < 0)
+          nos[atual].filho = filho;
+        else
+          nos[anterior].irmao = filho;
+      }
+      atual = filho;
+    }
+    nos[atual].token = token;
+    nos[atual].funcao = funcao;
+  }
+};
+
+static constexpr Trie trie;
+
+static char maiuscula(char c) {
+  return c >= 'a' && c <= 'z' ? char(c - 'a' + 'A') : c;
+}
+
+static bool digito(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static bool letra(char c) {
+  c = maiuscula(c);
+  return c >= 'A' && c <= 'Z';
+}
+
+// Maior palavra reservada que comeca em p; devolve quantos caracteres ela tem.
+static size_t casarPalavra(const char *p, const char *fim, uint8_t &token, bool &funcao) {
+  uint8_t c = uint8_t(maiuscula(*p));
+  size_t melhor = 0;
+
+  if(c >= 128)
+    return 0;
+  int16_t no = trie.raiz[c];
+  for(size_t i = 1; no >= 0; i++) {
+    if(trie.nos[no].token) {
+      melhor = i;
+      token = trie.nos[no].token;
+      funcao = trie.nos[no].funcao;
+    }
+    if(p + i >= fim)
+      break;
+    char proxima = maiuscula(p[i]);
+    no = trie.nos[no].filho;
+    while(no >= 0 && trie.nos[no].letra != proxima)
+      no = trie.nos[no].irmao;
+  }
+  return melhor;
+}
+
+// Tokens depois dos quais os numeros sao numeros de linha.
+static bool antesDeLinha(uint8_t token) {
+  switch(token) {
+    case 0x89: // GOTO
+    case 0x8A: // RUN
+    case 0x8C: // RESTORE
+    case 0x8D: // GOSUB
+    case 0x93: // LIST
+    case 0x9E: // LLIST
+    case 0xA1: // ELSE
+    case 0xA7: // RESUME
+    case 0xA8: // DELETE
+    case 0xA9: // AUTO
+    case 0xAA: // RENUM
+    case 0xDA: // THEN
+      return true;
+  }
+  return false;
+}
+
+static void poe16(std::vector<uint8_t> &v, uint32_t valor) {
+  v.push_back(uint8_t(valor));
+  v.push_back(uint8_t(valor >> 8));
+}
+
+// Le uma constante decimal e grava no formato do MSX: inteiros ate' 32767
+// nos formatos curtos, o resto em BCD. Sem sufixo, com ponto ou grande
+// demais para inteiro, vira precisao dupla como no MSX; '!' ou 'E' fazem
+// precisao simples, '#' ou 'D' dupla. Devolve o fim da constante, ou
+// nullptr se ela nao couber.
+static const char *codificarNumero(const char *p, const char *fim, std::vector<uint8_t> &saida) {
+  char digitos[16];
+  int n = 0, ponto = 0;
+  bool real = false, dupla = true, inteiro = false;
+
+  for(; p < fim && digito(*p); p++)
+    if(n || *p != '0') {
+      if(n < 16)
+        digitos[n++] = *p;
+      ponto++;
+    }
+  if(p < fim && *p == '.') {
+    real = true;
+    for(p++; p < fim && digito(*p); p++)
+      if(n || *p != '0') {
+        if(n < 16)
+          digitos[n++] = *p;
+      } else
+        ponto--;
+  }
+
+  // Expoente so' se vier um digito depois: "1ELSE" nao e' "1E".
+  if(p < fim && (maiuscula(*p) == 'E' || maiuscula(*p) == 'D')) {
+    const char *q = p + 1;
+    bool negativo = false;
+    if(q < fim && (*q == '+' || *q == '-'))
+      negativo = *q++ == '-';
+    if(q < fim && digito(*q)) {
+      real = true;
+      dupla = maiuscula(*p) == 'D';
+      int expoente = 0;
+      for(; q < fim && digito(*q); q++)
+        expoente = std::min(expoente * 10 + (*q - '0'), 999);
+      ponto += negativo ? -expoente : expoente;
+      p = q;
+    }
+  }
+  if(p < fim && (*p == '!' || *p == '#')) {
+    real = true;
+    dupla = *p++ == '#';
+  } else if(p < fim && *p == '%')
+    inteiro = *p++ == '%';
+
+  if(!real) {
+    uint32_t valor = 0;
+    for(int i = 0; i < ponto && valor <= 32767; i++)
+      valor = valor * 10 + (i < n ? uint32_t(digitos[i] - '0') : 0);
+    if(valor <= 9)
+      saida.push_back(uint8_t(numeroZero + valor));
+    else if(valor <= 255) {
+      saida.push_back(numeroByte);
+      saida.push_back(uint8_t(valor));
+    } else if(valor <= 32767) {
+      saida.push_back(numeroInteiro);
+      poe16(saida, valor);
+    } else if(inteiro)
+      return nullptr;
+    else
+      real = true;
+    if(!real)
+      return p;
+  }
+
+  // Arredonda para 6 ou 14 digitos; o vai-um pode criar um digito novo.
+  int maximo = dupla ? 14 : 6;
+  if(n > maximo) {
+    bool sobe = digitos[maximo] >= '5';
+    n = maximo;
+    for(int i = n - 1; sobe && i >= 0; i--) {
+      sobe = digitos[i] == '9';
+      digitos[i] = sobe ? '0' : char(digitos[i] + 1);
+    }
+    if(sobe) {
+      digitos[0] = '1';
+      n = 1;
+      ponto++;
+    }
+  }
+  while(n && digitos[n - 1] == '0')
+    n--;
+  if(ponto > 63)
+    return nullptr;
+
+  saida.push_back(dupla ? numeroDupla : numeroSimples);
+  saida.push_back(n && ponto >= -63 ? uint8_t(0x40 + ponto) : 0);
+  for(int i = 0; i < maximo; i += 2) {
+    uint8_t alto = n && ponto >= -63 && i < n ? uint8_t(digitos[i] - '0') : 0;
+    uint8_t baixo = n && ponto >= -63 && i + 1 < n ? uint8_t(digitos[i + 1] - '0') : 0;
+    saida.push_back(uint8_t((alto << 4) | baixo));
+  }
+  return p;
+}
+
+Tokenizador::Tokenizador() : usado(0), linhaErro(0) {
+}
+
+const uint8_t *Tokenizador::getPrograma() const {
+  return saida.data();
+}
+
+size_t Tokenizador::getTamanho() const {
+  return usado;
+}
+
+size_t Tokenizador::getLinhaErro() const {
+  return linhaErro;
+}
+
+bool Tokenizador::tokenizarLinha(const char *p, const char *fim) {
+  bool numerosLinha = false;
+  bool nome = false;
+  bool extensao = false;
+
+  while(p < fim) {
+    char c = *p;
+
+    // O nome depois de CALL ou '_' e' da extensao, nao tem palavras reservadas.
+    if(extensao) {
+      if(c == ' ' || letra(c) || digito(c)) {
+        rascunho.push_back(uint8_t(maiuscula(c)));
+        p++;
+        continue;
+      }
+      extensao = false;
+    }
+
+    if(c == '"') {
+      const char *fecha = static_cast<const char *>(std::memchr(p + 1, '"', size_t(fim - p - 1)));
+      const char *ate = fecha ? fecha + 1 : fim;
+      rascunho.insert(rascunho.end(), p, ate);
+      p = ate;
+      nome = numerosLinha = false;
+      continue;
+    }
+    if(c == ' ') {
+      rascunho.push_back(' ');
+      p++;
+      nome = false;
+      continue;
+    }
+    if(c == '?') {
+      rascunho.push_back(0x91);
+      p++;
+      nome = numerosLinha = false;
+      continue;
+    }
+
+    if(c == '&' && p + 1 < fim && (maiuscula(p[1]) == 'H' || maiuscula(p[1]) == 'O')) {
+      bool hex = maiuscula(p[1]) == 'H';
+      uint32_t valor = 0;
+      for(p += 2; p < fim; p++) {
+        char d = maiuscula(*p);
+        uint32_t v = digito(d) ? uint32_t(d - '0') : hex && d >= 'A' && d <= 'F' ? uint32_t(d - 'A' + 10) : 16;
+        if(v >= (hex ? 16u : 8u))
+          break;
+        valor = valor * (hex ? 16 : 8) + v;
+        if(valor > 0xFFFF)
+          return false;
+      }
+      rascunho.push_back(hex ? numeroHex : numeroOctal);
+      poe16(rascunho, valor);
+      nome = numerosLinha = false;
+      continue;
+    }
+
+    if(digito(c) || (c == '.' && p + 1 < fim && digito(p[1]))) {
+      // Digitos no meio de um nome de variavel ficam como texto.
+      if(nome) {
+        rascunho.push_back(uint8_t(c));
+        p++;
+        continue;
+      }
+      if(numerosLinha && digito(c)) {
+        uint32_t linha = 0;
+        for(; p < fim && digito(*p); p++)
+          if((linha = linha * 10 + uint32_t(*p - '0')) > 65529)
+            return false;
+        rascunho.push_back(numeroLinha);
+        poe16(rascunho, linha);
+        continue;
+      }
+      if(!(p = codificarNumero(p, fim, rascunho)))
+        return false;
+      continue;
+    }
+
+    uint8_t token = 0;
+    bool funcao = false;
+    if(size_t n = casarPalavra(p, fim, token, funcao)) {
+      p += n;
+      nome = false;
+      if(funcao) {
+        rascunho.push_back(prefixoFuncao);
+        rascunho.push_back(token);
+        numerosLinha = false;
+        continue;
+      }
+
+      // ELSE e o apostrofo levam um ':' escondido; depois de REM e do
+      // apostrofo o resto da linha e' texto, depois de DATA ate' o ':'.
+      if(token == tokenApostrofo || token == tokenRem) {
+        if(token == tokenApostrofo)
+          rascunho.push_back(':');
+        rascunho.push_back(tokenRem);
+        if(token == tokenApostrofo)
+          rascunho.push_back(tokenApostrofo);
+        rascunho.insert(rascunho.end(), p, fim);
+        return true;
+      }
+      if(token == tokenElse)
+        rascunho.push_back(':');
+      rascunho.push_back(token);
+      if(token == tokenData) {
+        bool aspas = false;
+        for(; p < fim && (aspas || *p != ':'); p++) {
+          aspas = aspas != (*p == '"');
+          rascunho.push_back(uint8_t(*p));
+        }
+      }
+      // "LIST 10-20" e "ON X GOTO 10,20" continuam com numeros de linha.
+      numerosLinha = antesDeLinha(token) || (numerosLinha && token == 0xF2);
+      extensao = token == 0xCA;
+      continue;
+    }
+
+    rascunho.push_back(uint8_t(maiuscula(c)));
+    p++;
+    nome = letra(c);
+    extensao = c == '_';
+    numerosLinha = numerosLinha && c == ',';
+  }
+  return true;
+}
+
+bool Tokenizador::converter(const char *texto, size_t tamanho, uint16_t endereco) {
+  const char *p = texto;
+  const char *fim = texto + tamanho;
+
+  rascunho.clear();
+  linhas.clear();
+  usado = 0;
+  linhaErro = 0;
+  for(size_t numeroTexto = 1; p < fim; numeroTexto++) {
+    const char *eol = static_cast<const char *>(std::memchr(p, '\n', size_t(fim - p)));
+    const char *f = eol ? eol : fim;
+    while(f > p && (f[-1] == '\r' || f[-1] == 0x1A))
+      f--;
+    while(p < f && (*p == ' ' || *p == '\t'))
+      p++;
+
+    if(p < f) {
+      uint32_t numero = 0;
+      if(!digito(*p)) {
+        linhaErro = numeroTexto;
+        return false;
+      }
+      for(; p < f && digito(*p); p++)
+        if((numero = numero * 10 + uint32_t(*p - '0')) > 65529) {
+          linhaErro = numeroTexto;
+          return false;
+        }
+      while(p < f && *p == ' ')
+        p++;
+      size_t inicio = rascunho.size();
+      if(!tokenizarLinha(p, f)) {
+        linhaErro = numeroTexto;
+        return false;
+      }
+      linhas.push_back(Linha{uint16_t(numero), inicio, rascunho.size() - inicio});
+    }
+    p = eol ? eol + 1 : fim;
+  }
+
+  // Como no MSX: a ultima versao de cada linha vale, e uma vazia apaga.
+  std::stable_sort(linhas.begin(), linhas.end(),
+                   [](const Linha &a, const Linha &b) { return a.numero < b.numero; });
+  size_t bytes = 3;
+  size_t n = 0;
+  for(size_t i = 0; i < linhas.size(); i++) {
+    if(i + 1 < linhas.size() && linhas[i + 1].numero == linhas[i].numero)
+      continue;
+    if(!linhas[i].tamanho)
+      continue;
+    linhas[n++] = linhas[i];
+    bytes += 5 + linhas[i].tamanho;
+  }
+  linhas.resize(n);
+  if(bytes > 0x10000u - endereco) {
+    linhaErro = 0;
+    return false;
+  }
+
+  if(saida.size() < bytes)
+    saida.resize(bytes);
+  uint8_t *q = saida.data();
+  uint32_t atual = endereco;
+  *q++ = 0xFF;
+  for(const Linha &l : linhas) {
+    uint32_t proxima = atual + 5 + uint32_t(l.tamanho);
+    *q++ = uint8_t(proxima);
+    *q++ = uint8_t(proxima >> 8);
+    *q++ = uint8_t(l.numero);
+    *q++ = uint8_t(l.numero >> 8);
+    std::memcpy(q, &rascunho[l.inicio], l.tamanho);
+    q += l.tamanho;
+    *q++ = 0x00;
+    atual = proxima;
+  }
+  *q++ = 0x00;
+  *q++ = 0x00;
+  usado = size_t(q - saida.data());
+  return true;
+}
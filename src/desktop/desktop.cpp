@@ -1,16 +1,263 @@
 //
 // Created by barney on 20-May-21.
 //
+#include <cstdio>
 #include <final/final.h>
+#include <string>
+#include <vector>
+
+using std::string;
 
 using namespace finalcut;
 
 #include "desktop.h"
 #include "msx.h"
 
+// Lista o diretorio atual da imagem aberta no MSX. Enter entra num
+// diretorio e Backspace volta; Insert copia um arquivo do PC para ca',
+// Del apaga e F2 renomeia. Cada alteracao vai direto para a imagem.
+class VisaoDisco : public FWidget {
+  public:
+    VisaoDisco(MSX &msx, FWidget *parent = nullptr);
+  private:
+    enum Pedido { nenhum, copiar, renomear, apagar };
+
+    void draw() override;
+    void onKeyPress(FKeyEvent *ev) override;
+    uint64_t linhasVisiveis();
+    void carregar();
+    void mover(int64_t delta);
+    void teclaPedido(FKeyEvent *ev);
+    void executar();
+    string caminhoDe(const string &nome);
+
+    MSX &msx;
+    string caminho;
+    std::vector<EntradaDisco> entradas;
+    uint64_t topo;
+    uint64_t cursor;
+    Pedido pedido;
+    string texto;
+    string aviso;
+};
+
+VisaoDisco::VisaoDisco(MSX &msx, FWidget *parent)
+  : FWidget(parent), msx(msx), topo(0), cursor(0), pedido(nenhum) {
+  setFocusable(true);
+  carregar();
+}
+
+uint64_t VisaoDisco::linhasVisiveis() {
+  // A ultima linha do widget e' a linha de estado.
+  return getHeight() > 1 ? getHeight() - 1 : 1;
+}
+
+void VisaoDisco::carregar() {
+  if(!msx.getDisco()->listar(caminho, entradas))
+    aviso = "Erro ao ler o diretorio!";
+  if(cursor >= entradas.size())
+    cursor = entradas.empty() ? 0 : entradas.size() - 1;
+  mover(0);
+}
+
+string VisaoDisco::caminhoDe(const string &nome) {
+  return caminho.empty() ? nome : caminho + "/" + nome;
+}
+
+void VisaoDisco::draw() {
+  uint64_t linhas = linhasVisiveis();
+  char texto[64];
+
+  for(uint64_t y = 0; y < linhas; y++) {
+    string linha;
+    if(topo + y < entradas.size()) {
+      const EntradaDisco &e = entradas[topo + y];
+      if(e.diretorio())
+        std::snprintf(texto, sizeof(texto), " %-12s %10s", e.nome.c_str(), "<DIR>");
+      else
+        std::snprintf(texto, sizeof(texto), " %-12s %10u", e.nome.c_str(), e.tamanho);
+      linha = texto;
+      std::snprintf(texto, sizeof(texto), "  %02u/%02u/%04u %02u:%02u", e.data & 31, (e.data >> 5) & 15,
+                    1980 + (e.data >> 9), e.hora >> 11, (e.hora >> 5) & 63);
+      linha += texto;
+    }
+    if(linha.size() < getWidth())
+      linha.resize(getWidth(), ' ');
+    print() << FPoint{1, int(y) + 1};
+    if(topo + y == cursor && !entradas.empty())
+      setReverse(true);
+    print() << linha;
+    if(topo + y == cursor && !entradas.empty())
+      setReverse(false);
+  }
+
+  Disco *disco = msx.getDisco();
+  string estado = " /" + caminho;
+  std::snprintf(texto, sizeof(texto), "  Livre: %llu KB",
+                (unsigned long long) disco->getClustersLivres() * disco->getBytesCluster() / 1024);
+  estado += texto;
+  if(!disco->getEscrita())
+    estado += "  (so' leitura)";
+  if(pedido == copiar)
+    estado = " Copiar do PC: " + this->texto + "_";
+  else if(pedido == renomear)
+    estado = " Novo nome: " + this->texto + "_";
+  else if(pedido == apagar)
+    estado = " Apagar " + entradas[cursor].nome + "? (s/n)";
+  if(!aviso.empty())
+    estado += "  " + aviso;
+  if(estado.size() < getWidth())
+    estado.resize(getWidth(), ' ');
+  print() << FPoint{1, int(linhas) + 1};
+  setReverse(true);
+  print() << estado;
+  setReverse(false);
+}
+
+void VisaoDisco::mover(int64_t delta) {
+  uint64_t linhas = linhasVisiveis();
+
+  if(delta < 0 && uint64_t(-delta) > cursor)
+    cursor = 0;
+  else if(delta > 0 && cursor + uint64_t(delta) >= entradas.size())
+    cursor = entradas.empty() ? 0 : entradas.size() - 1;
+  else
+    cursor += delta;
+  if(cursor < topo)
+    topo = cursor;
+  else if(cursor >= topo + linhas)
+    topo = cursor - linhas + 1;
+}
+
+void VisaoDisco::executar() {
+  bool ok = false;
+
+  switch(pedido) {
+    case copiar: {
+      // O nome no disco e' o do arquivo no PC, sem a pasta.
+      size_t barra = texto.find_last_of('/');
+      string nome = barra == string::npos ? texto : texto.substr(barra + 1);
+      ok = msx.copiarParaDisco(texto, caminhoDe(nome));
+      break;
+    }
+    case renomear:
+      ok = msx.renomearNoDisco(caminhoDe(entradas[cursor].nome), texto);
+      break;
+    case apagar:
+      ok = msx.apagarDoDisco(caminhoDe(entradas[cursor].nome));
+      break;
+    case nenhum:
+      return;
+  }
+  pedido = nenhum;
+  carregar();
+  aviso = ok ? "Feito." : "Erro ao alterar o disco!";
+}
+
+void VisaoDisco::teclaPedido(FKeyEvent *ev) {
+  uint32_t tecla = uint32_t(ev->key());
+
+  if(pedido == apagar) {
+    if(tecla == 's' || tecla == 'S')
+      executar();
+    else
+      pedido = nenhum;
+    ev->accept();
+    redraw();
+    return;
+  }
+  switch(ev->key()) {
+    case FKey::Escape:
+      pedido = nenhum;
+      break;
+    case FKey::Enter:
+      executar();
+      break;
+    case FKey::Backspace:
+      if(!texto.empty())
+        texto.pop_back();
+      break;
+    default:
+      if(tecla >= 0x20 && tecla < 0x7F)
+        texto += char(tecla);
+  }
+  ev->accept();
+  redraw();
+}
+
+void VisaoDisco::onKeyPress(FKeyEvent *ev) {
+  int64_t pagina = int64_t(linhasVisiveis());
+
+  aviso.clear();
+  if(pedido != nenhum) {
+    teclaPedido(ev);
+    return;
+  }
+  switch(ev->key()) {
+    case FKey::Up:        mover(-1); break;
+    case FKey::Down:      mover(1); break;
+    case FKey::Page_up:   mover(-pagina); break;
+    case FKey::Page_down: mover(pagina); break;
+    case FKey::Home:      mover(-int64_t(cursor)); break;
+    case FKey::End:       mover(int64_t(entradas.size())); break;
+    case FKey::Enter:
+      if(!entradas.empty() && entradas[cursor].diretorio()) {
+        caminho = caminhoDe(entradas[cursor].nome);
+        topo = cursor = 0;
+        carregar();
+      }
+      break;
+    case FKey::Backspace:
+      if(!caminho.empty()) {
+        size_t barra = caminho.find_last_of('/');
+        caminho = barra == string::npos ? "" : caminho.substr(0, barra);
+        topo = cursor = 0;
+        carregar();
+      }
+      break;
+    case FKey::Insert:
+      pedido = copiar;
+      texto.clear();
+      break;
+    case FKey::F2:
+      if(!entradas.empty()) {
+        pedido = renomear;
+        texto = entradas[cursor].nome;
+      }
+      break;
+    case FKey::Del_char:
+      if(!entradas.empty())
+        pedido = apagar;
+      break;
+    case FKey::Escape:
+      getParentWidget()->close();
+      ev->accept();
+      return;
+    default:
+      FWidget::onKeyPress(ev);
+      return;
+  }
+  ev->accept();
+  redraw();
+}
+
 int desktop(int ac, char *av[], MSX msxbasico) {
   FApplication app(ac, av);
 
+  if(msxbasico.getDisco()) {
+    // The object dialog is managed by app
+    FDialog* dialog = new FDialog(&app);
+    dialog->setText("MSX Tools: Disco");
+    dialog->setGeometry(FPoint{1, 1}, FSize{app.getDesktopWidth(), app.getDesktopHeight()});
+
+    // The object visao is managed by dialog
+    VisaoDisco* visao = new VisaoDisco(msxbasico, dialog);
+    visao->setGeometry(FPoint{1, 1}, FSize{dialog->getClientWidth(), dialog->getClientHeight()});
+    FWidget::setMainWidget(dialog);
+    dialog->show();
+    return app.exec();
+  }
+
   // The object dialog is managed by app
   FDialog* dialog = new FDialog(&app);
   dialog->setText ("MSX Tools: Versao " + msxbasico.getModelo() + " " + msxbasico.getVersao());
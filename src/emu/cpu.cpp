@@ -0,0 +1,1020 @@
+#include "cpu.h"
+
+// Bits do F.
+static const uint8_t fC = 0x01, fN = 0x02, fP = 0x04, f3 = 0x08, fH = 0x10, f5 = 0x20, fZ = 0x40, fS = 0x80;
+
+struct TabelasFlags {
+  // S, Z e os bits 3 e 5 de um resultado de 8 bits.
+  uint8_t sz53[256] = {};
+  // O mesmo com a paridade.
+  uint8_t sz53p[256] = {};
+};
+
+static constexpr TabelasFlags gerarTabelasFlags() {
+  TabelasFlags tab;
+  for(unsigned i = 0; i < 256; i++) {
+    unsigned bits = 0;
+    for(unsigned k = 0; k < 8; k++)
+      bits += (i >> k) & 1;
+    tab.sz53[i] = uint8_t((i & (fS | f5 | f3)) | (i ? 0 : fZ));
+    tab.sz53p[i] = uint8_t(tab.sz53[i] | (bits & 1 ? 0 : fP));
+  }
+  return tab;
+}
+
+static constexpr TabelasFlags tabelas = gerarTabelasFlags();
+static_assert(tabelas.sz53p[0] == (fZ | fP) && tabelas.sz53p[0x80] == fS, "tabelas de flags");
+
+// Indice: bit 3 (ou 11) do primeiro operando, do segundo e do resultado.
+static const uint8_t meioCarrySoma[8] = {0, fH, fH, fH, 0, 0, 0, fH};
+static const uint8_t meioCarrySubtracao[8] = {0, 0, fH, 0, fH, 0, fH, fH};
+// O mesmo com o bit 7 (ou 15).
+static const uint8_t overflowSoma[8] = {0, 0, 0, fP, fP, 0, 0, 0};
+static const uint8_t overflowSubtracao[8] = {0, fP, 0, 0, 0, 0, fP, 0};
+
+Barramento::Barramento() : leitura(), escrita() {
+}
+
+Barramento::~Barramento() {
+}
+
+uint8_t Barramento::ler(uint16_t) {
+  return 0xFF;
+}
+
+void Barramento::escrever(uint16_t, uint8_t) {
+}
+
+uint8_t Barramento::entrada(uint16_t) {
+  return 0xFF;
+}
+
+void Barramento::saida(uint16_t, uint8_t) {
+}
+
+CpuZ80::CpuZ80(Barramento &barramento, bool esperaM1)
+    : barramento(barramento), esperaM1(esperaM1 ? 1 : 0), regs(), ciclos(0), linhaInt(false), nmiPendente(false),
+      parado(false), depoisEI(false) {
+  reiniciar();
+}
+
+void CpuZ80::reiniciar() {
+  regs = RegistradoresZ80();
+  regs.af = regs.sp = 0xFFFF;
+  parado = depoisEI = nmiPendente = false;
+}
+
+void CpuZ80::setInt(bool ativa) {
+  linhaInt = ativa;
+}
+
+void CpuZ80::nmi() {
+  nmiPendente = true;
+}
+
+RegistradoresZ80 &CpuZ80::getRegistradores() {
+  return regs;
+}
+
+uint64_t CpuZ80::getCiclos() const {
+  return ciclos;
+}
+
+bool CpuZ80::getParado() const {
+  return parado;
+}
+
+// Pares de registradores de 8 bits.
+#define BC uint16_t((b << 8) | c)
+#define DE uint16_t((d << 8) | e)
+#define HL uint16_t((h << 8) | l)
+#define DEF_PAR(x, y, valor) { uint16_t p_ = uint16_t(valor); x = uint8_t(p_ >> 8); y = uint8_t(p_); }
+// Metades do IX ou IY da instrucao.
+#define XH uint8_t(xy >> 8)
+#define XL uint8_t(xy)
+#define DEF_XH(valor) xy = uint16_t((xy & 0x00FF) | ((valor) << 8))
+#define DEF_XL(valor) xy = uint16_t((xy & 0xFF00) | (valor))
+
+// Busca de opcode (ciclo M1): incrementa o R e paga a espera do MSX.
+#define BUSCAR() (r++, tempo += m1, ler(pc++))
+// Fim de instrucao: soma os ciclos e salta direto para a proxima, a nao ser
+// que tenha chegado a hora de ver interrupcoes ou de parar.
+#define PROXIMA(t) do { tempo += (t); if(tempo >= alvo) goto verificar; op = BUSCAR(); goto *principal[op]; } while(0)
+// Fim das instrucoes DD/FD que mudam o IX ou o IY.
+#define PROXIMA_XY(t) do { tempo += (t); goto *volta; } while(0)
+
+#define IMEDIATO16(destino) { uint8_t lo_ = ler(pc++); destino = uint16_t(lo_ | (ler(pc++) << 8)); }
+#define ENDERECO_XY() { endereco = uint16_t(xy + int8_t(ler(pc++))); wz = endereco; }
+#define EMPILHAR(valor) { uint16_t s_ = (valor); sp--; escrever(sp, uint8_t(s_ >> 8)); sp--; escrever(sp, uint8_t(s_)); }
+#define DESEMPILHAR(x, y) { y = ler(sp++); x = ler(sp++); }
+#define DESEMPILHAR16(destino) { uint8_t lo_ = ler(sp++); destino = uint16_t(lo_ | (ler(sp++) << 8)); }
+// Depois de E/S a linha INT pode ter mudado.
+#define ENTRADA(porta) (alvo = 0, bus.entrada(porta))
+#define SAIDA(porta, valor) { bus.saida(porta, valor); alvo = 0; }
+
+#define ADD_A(valor) { uint8_t o_ = (valor); unsigned t_ = unsigned(a) + o_; \
+  uint8_t k_ = uint8_t(((a & 0x88) >> 3) | ((o_ & 0x88) >> 2) | ((t_ & 0x88) >> 1)); a = uint8_t(t_); \
+  f = uint8_t((t_ & 0x100 ? fC : 0) | meioCarrySoma[k_ & 7] | overflowSoma[k_ >> 4] | tabelas.sz53[a]); }
+#define ADC_A(valor) { uint8_t o_ = (valor); unsigned t_ = unsigned(a) + o_ + (f & fC); \
+  uint8_t k_ = uint8_t(((a & 0x88) >> 3) | ((o_ & 0x88) >> 2) | ((t_ & 0x88) >> 1)); a = uint8_t(t_); \
+  f = uint8_t((t_ & 0x100 ? fC : 0) | meioCarrySoma[k_ & 7] | overflowSoma[k_ >> 4] | tabelas.sz53[a]); }
+#define SUB_A(valor) { uint8_t o_ = (valor); unsigned t_ = unsigned(a) - o_; \
+  uint8_t k_ = uint8_t(((a & 0x88) >> 3) | ((o_ & 0x88) >> 2) | ((t_ & 0x88) >> 1)); a = uint8_t(t_); \
+  f = uint8_t((t_ & 0x100 ? fC : 0) | fN | meioCarrySubtracao[k_ & 7] | overflowSubtracao[k_ >> 4] | \
+              tabelas.sz53[a]); }
+#define SBC_A(valor) { uint8_t o_ = (valor); unsigned t_ = unsigned(a) - o_ - (f & fC); \
+  uint8_t k_ = uint8_t(((a & 0x88) >> 3) | ((o_ & 0x88) >> 2) | ((t_ & 0x88) >> 1)); a = uint8_t(t_); \
+  f = uint8_t((t_ & 0x100 ? fC : 0) | fN | meioCarrySubtracao[k_ & 7] | overflowSubtracao[k_ >> 4] | \
+              tabelas.sz53[a]); }
+#define AND_A(valor) { a &= (valor); f = uint8_t(fH | tabelas.sz53p[a]); }
+#define XOR_A(valor) { a ^= (valor); f = tabelas.sz53p[a]; }
+#define OR_A(valor) { a |= (valor); f = tabelas.sz53p[a]; }
+// Os bits 3 e 5 vem do operando, nao do resultado.
+#define CP_A(valor) { uint8_t o_ = (valor); unsigned t_ = unsigned(a) - o_; \
+  uint8_t k_ = uint8_t(((a & 0x88) >> 3) | ((o_ & 0x88) >> 2) | ((t_ & 0x88) >> 1)); \
+  f = uint8_t((t_ & 0x100 ? fC : (t_ ? 0 : fZ)) | fN | meioCarrySubtracao[k_ & 7] | overflowSubtracao[k_ >> 4] | \
+              (o_ & (f3 | f5)) | (t_ & fS)); }
+#define INC(v) { v = uint8_t(v + 1); \
+  f = uint8_t((f & fC) | (v == 0x80 ? fP : 0) | ((v & 0x0F) ? 0 : fH) | tabelas.sz53[v]); }
+#define DEC(v) { f = uint8_t((f & fC) | ((v & 0x0F) ? 0 : fH) | fN); v = uint8_t(v - 1); \
+  f = uint8_t(f | (v == 0x7F ? fP : 0) | tabelas.sz53[v]); }
+#define ADD16(destino, valor) { uint16_t o_ = (valor); unsigned t_ = unsigned(destino) + o_; \
+  uint8_t k_ = uint8_t(((destino & 0x0800) >> 11) | ((o_ & 0x0800) >> 10) | ((t_ & 0x0800) >> 9)); \
+  wz = uint16_t(destino + 1); destino = uint16_t(t_); \
+  f = uint8_t((f & (fP | fZ | fS)) | (t_ & 0x10000 ? fC : 0) | ((t_ >> 8) & (f3 | f5)) | meioCarrySoma[k_]); }
+#define ADC_HL(valor) { uint16_t o_ = (valor), hl_ = HL; unsigned t_ = unsigned(hl_) + o_ + (f & fC); \
+  uint8_t k_ = uint8_t(((hl_ & 0x8800) >> 11) | ((o_ & 0x8800) >> 10) | ((t_ & 0x8800) >> 9)); \
+  wz = uint16_t(hl_ + 1); DEF_PAR(h, l, t_); \
+  f = uint8_t((t_ & 0x10000 ? fC : 0) | overflowSoma[k_ >> 4] | (h & (f3 | f5 | fS)) | meioCarrySoma[k_ & 7] | \
+              (uint16_t(t_) ? 0 : fZ)); }
+#define SBC_HL(valor) { uint16_t o_ = (valor), hl_ = HL; unsigned t_ = unsigned(hl_) - o_ - (f & fC); \
+  uint8_t k_ = uint8_t(((hl_ & 0x8800) >> 11) | ((o_ & 0x8800) >> 10) | ((t_ & 0x8800) >> 9)); \
+  wz = uint16_t(hl_ + 1); DEF_PAR(h, l, t_); \
+  f = uint8_t((t_ & 0x10000 ? fC : 0) | fN | overflowSubtracao[k_ >> 4] | (h & (f3 | f5 | fS)) | \
+              meioCarrySubtracao[k_ & 7] | (uint16_t(t_) ? 0 : fZ)); }
+
+// Rotacoes, deslocamentos e bits do prefixo CB, sobre um lvalue; n so'
+// serve para RES e SET.
+#define RLC(v, n) { v = uint8_t((v << 1) | (v >> 7)); f = uint8_t((v & fC) | tabelas.sz53p[v]); }
+#define RRC(v, n) { f = uint8_t(v & fC); v = uint8_t((v >> 1) | (v << 7)); f |= tabelas.sz53p[v]; }
+#define RL(v, n) { uint8_t t_ = v; v = uint8_t((v << 1) | (f & fC)); f = uint8_t((t_ >> 7) | tabelas.sz53p[v]); }
+#define RR(v, n) { uint8_t t_ = v; v = uint8_t((v >> 1) | (f << 7)); f = uint8_t((t_ & fC) | tabelas.sz53p[v]); }
+#define SLA(v, n) { f = uint8_t(v >> 7); v = uint8_t(v << 1); f |= tabelas.sz53p[v]; }
+#define SRA(v, n) { f = uint8_t(v & fC); v = uint8_t((v & 0x80) | (v >> 1)); f |= tabelas.sz53p[v]; }
+#define SLL(v, n) { f = uint8_t(v >> 7); v = uint8_t((v << 1) | 1); f |= tabelas.sz53p[v]; }
+#define SRL(v, n) { f = uint8_t(v & fC); v = uint8_t(v >> 1); f |= tabelas.sz53p[v]; }
+#define RES(v, n) { v = uint8_t(v & ~(1 << (n))); }
+#define SET(v, n) { v = uint8_t(v | (1 << (n))); }
+// Os bits 3 e 5 vem do registrador em BIT n,r e do MEMPTR nos outros.
+#define BIT(v, n, bits35) { f = uint8_t((f & fC) | fH | ((bits35) & (f3 | f5)) | ((v & (1 << (n))) ? 0 : (fP | fZ)) | \
+                                         (((n) == 7 && (v & 0x80)) ? fS : 0)); }
+
+// Uma linha de 8 da tabela CB: a mesma operacao em B, C, D, E, H, L, (HL)
+// e A.
+#define CB_LINHA(n0, n1, n2, n3, n4, n5, n6, n7, OPERACAO, n) \
+  cb##n0: OPERACAO(b, n); PROXIMA(8); \
+  cb##n1: OPERACAO(c, n); PROXIMA(8); \
+  cb##n2: OPERACAO(d, n); PROXIMA(8); \
+  cb##n3: OPERACAO(e, n); PROXIMA(8); \
+  cb##n4: OPERACAO(h, n); PROXIMA(8); \
+  cb##n5: OPERACAO(l, n); PROXIMA(8); \
+  cb##n6: { uint8_t v_ = ler(HL); OPERACAO(v_, n); escrever(HL, v_); } PROXIMA(15); \
+  cb##n7: OPERACAO(a, n); PROXIMA(8);
+#define CB_BIT(n0, n1, n2, n3, n4, n5, n6, n7, n) \
+  cb##n0: BIT(b, n, b); PROXIMA(8); \
+  cb##n1: BIT(c, n, c); PROXIMA(8); \
+  cb##n2: BIT(d, n, d); PROXIMA(8); \
+  cb##n3: BIT(e, n, e); PROXIMA(8); \
+  cb##n4: BIT(h, n, h); PROXIMA(8); \
+  cb##n5: BIT(l, n, l); PROXIMA(8); \
+  cb##n6: { uint8_t v_ = ler(HL); BIT(v_, n, wz >> 8); } PROXIMA(12); \
+  cb##n7: BIT(a, n, a); PROXIMA(8);
+// DDCB/FDCB: a operacao em (XY+d) e, fora das documentadas, uma copia do
+// resultado no registrador dos 3 bits de baixo.
+#define COPIAR(v) \
+  switch(op & 7) { \
+    case 0: b = v; break; \
+    case 1: c = v; break; \
+    case 2: d = v; break; \
+    case 3: e = v; break; \
+    case 4: h = v; break; \
+    case 5: l = v; break; \
+    case 7: a = v; break; \
+  }
+#define XYCB(rotulo, OPERACAO) \
+  rotulo: { uint8_t v_ = ler(endereco); OPERACAO(v_, (op >> 3) & 7); escrever(endereco, v_); COPIAR(v_); } \
+  PROXIMA(23);
+
+#define JR_SE(condicao) { int8_t d_ = int8_t(ler(pc++)); if(condicao) { pc = uint16_t(pc + d_); wz = pc; PROXIMA(12); } } \
+  PROXIMA(7);
+#define JP_SE(condicao) { IMEDIATO16(wz); if(condicao) pc = wz; } PROXIMA(10);
+#define CALL_SE(condicao) { IMEDIATO16(wz); if(condicao) { EMPILHAR(pc); pc = wz; PROXIMA(17); } } PROXIMA(10);
+#define RET_SE(condicao) { if(condicao) { DESEMPILHAR16(pc); wz = pc; PROXIMA(11); } } PROXIMA(5);
+#define RST(destino) { EMPILHAR(pc); pc = destino; wz = pc; } PROXIMA(11);
+
+#define LDI_LDD(passo) { uint8_t v_ = ler(HL); escrever(DE, v_); DEF_PAR(h, l, HL + (passo)); \
+  DEF_PAR(d, e, DE + (passo)); DEF_PAR(b, c, BC - 1); v_ = uint8_t(v_ + a); \
+  f = uint8_t((f & (fC | fZ | fS)) | ((b | c) ? fP : 0) | (v_ & f3) | ((v_ & 0x02) ? f5 : 0)); }
+#define CPI_CPD(passo) { uint8_t v_ = ler(HL), t_ = uint8_t(a - v_); \
+  uint8_t k_ = uint8_t(((a & 0x08) >> 3) | ((v_ & 0x08) >> 2) | ((t_ & 0x08) >> 1)); \
+  DEF_PAR(h, l, HL + (passo)); DEF_PAR(b, c, BC - 1); wz = uint16_t(wz + (passo)); \
+  f = uint8_t((f & fC) | ((b | c) ? (fP | fN) : fN) | meioCarrySubtracao[k_] | (t_ ? 0 : fZ) | (t_ & fS)); \
+  if(f & fH) \
+    t_--; \
+  f = uint8_t(f | (t_ & f3) | ((t_ & 0x02) ? f5 : 0)); }
+#define INI_IND(passo) { wz = uint16_t(BC + (passo)); uint8_t v_ = ENTRADA(BC); escrever(HL, v_); b--; \
+  DEF_PAR(h, l, HL + (passo)); uint8_t t_ = uint8_t(v_ + c + (passo)); \
+  f = uint8_t((v_ & 0x80 ? fN : 0) | (t_ < v_ ? (fH | fC) : 0) | (tabelas.sz53p[(t_ & 0x07) ^ b] & fP) | \
+              tabelas.sz53[b]); }
+#define OUTI_OUTD(passo) { uint8_t v_ = ler(HL); b--; wz = uint16_t(BC + (passo)); SAIDA(BC, v_); \
+  DEF_PAR(h, l, HL + (passo)); uint8_t t_ = uint8_t(v_ + l); \
+  f = uint8_t((v_ & 0x80 ? fN : 0) | (t_ < v_ ? (fH | fC) : 0) | (tabelas.sz53p[(t_ & 0x07) ^ b] & fP) | \
+              tabelas.sz53[b]); }
+
+uint64_t CpuZ80::executar(uint64_t pedidos) {
+  // Rotulo de cada opcode sem prefixo; a tabela dos prefixos CB, ED e DD/FD
+  // indexa o segundo byte e a do DDCB o quarto, dividido por 8.
+  static void *const principal[256] = {
+    &&o00, &&o01, &&o02, &&o03, &&o04, &&o05, &&o06, &&o07,
+    &&o08, &&o09, &&o0A, &&o0B, &&o0C, &&o0D, &&o0E, &&o0F,
+    &&o10, &&o11, &&o12, &&o13, &&o14, &&o15, &&o16, &&o17,
+    &&o18, &&o19, &&o1A, &&o1B, &&o1C, &&o1D, &&o1E, &&o1F,
+    &&o20, &&o21, &&o22, &&o23, &&o24, &&o25, &&o26, &&o27,
+    &&o28, &&o29, &&o2A, &&o2B, &&o2C, &&o2D, &&o2E, &&o2F,
+    &&o30, &&o31, &&o32, &&o33, &&o34, &&o35, &&o36, &&o37,
+    &&o38, &&o39, &&o3A, &&o3B, &&o3C, &&o3D, &&o3E, &&o3F,
+    &&o40, &&o41, &&o42, &&o43, &&o44, &&o45, &&o46, &&o47,
+    &&o48, &&o49, &&o4A, &&o4B, &&o4C, &&o4D, &&o4E, &&o4F,
+    &&o50, &&o51, &&o52, &&o53, &&o54, &&o55, &&o56, &&o57,
+    &&o58, &&o59, &&o5A, &&o5B, &&o5C, &&o5D, &&o5E, &&o5F,
+    &&o60, &&o61, &&o62, &&o63, &&o64, &&o65, &&o66, &&o67,
+    &&o68, &&o69, &&o6A, &&o6B, &&o6C, &&o6D, &&o6E, &&o6F,
+    &&o70, &&o71, &&o72, &&o73, &&o74, &&o75, &&o76, &&o77,
+    &&o78, &&o79, &&o7A, &&o7B, &&o7C, &&o7D, &&o7E, &&o7F,
+    &&o80, &&o81, &&o82, &&o83, &&o84, &&o85, &&o86, &&o87,
+    &&o88, &&o89, &&o8A, &&o8B, &&o8C, &&o8D, &&o8E, &&o8F,
+    &&o90, &&o91, &&o92, &&o93, &&o94, &&o95, &&o96, &&o97,
+    &&o98, &&o99, &&o9A, &&o9B, &&o9C, &&o9D, &&o9E, &&o9F,
+    &&oA0, &&oA1, &&oA2, &&oA3, &&oA4, &&oA5, &&oA6, &&oA7,
+    &&oA8, &&oA9, &&oAA, &&oAB, &&oAC, &&oAD, &&oAE, &&oAF,
+    &&oB0, &&oB1, &&oB2, &&oB3, &&oB4, &&oB5, &&oB6, &&oB7,
+    &&oB8, &&oB9, &&oBA, &&oBB, &&oBC, &&oBD, &&oBE, &&oBF,
+    &&oC0, &&oC1, &&oC2, &&oC3, &&oC4, &&oC5, &&oC6, &&oC7,
+    &&oC8, &&oC9, &&oCA, &&oCB, &&oCC, &&oCD, &&oCE, &&oCF,
+    &&oD0, &&oD1, &&oD2, &&oD3, &&oD4, &&oD5, &&oD6, &&oD7,
+    &&oD8, &&oD9, &&oDA, &&oDB, &&oDC, &&oDD, &&oDE, &&oDF,
+    &&oE0, &&oE1, &&oE2, &&oE3, &&oE4, &&oE5, &&oE6, &&oE7,
+    &&oE8, &&oE9, &&oEA, &&oEB, &&oEC, &&oED, &&oEE, &&oEF,
+    &&oF0, &&oF1, &&oF2, &&oF3, &&oF4, &&oF5, &&oF6, &&oF7,
+    &&oF8, &&oF9, &&oFA, &&oFB, &&oFC, &&oFD, &&oFE, &&oFF,
+  };
+  static void *const prefixoCB[256] = {
+    &&cb00, &&cb01, &&cb02, &&cb03, &&cb04, &&cb05, &&cb06, &&cb07,
+    &&cb08, &&cb09, &&cb0A, &&cb0B, &&cb0C, &&cb0D, &&cb0E, &&cb0F,
+    &&cb10, &&cb11, &&cb12, &&cb13, &&cb14, &&cb15, &&cb16, &&cb17,
+    &&cb18, &&cb19, &&cb1A, &&cb1B, &&cb1C, &&cb1D, &&cb1E, &&cb1F,
+    &&cb20, &&cb21, &&cb22, &&cb23, &&cb24, &&cb25, &&cb26, &&cb27,
+    &&cb28, &&cb29, &&cb2A, &&cb2B, &&cb2C, &&cb2D, &&cb2E, &&cb2F,
+    &&cb30, &&cb31, &&cb32, &&cb33, &&cb34, &&cb35, &&cb36, &&cb37,
+    &&cb38, &&cb39, &&cb3A, &&cb3B, &&cb3C, &&cb3D, &&cb3E, &&cb3F,
+    &&cb40, &&cb41, &&cb42, &&cb43, &&cb44, &&cb45, &&cb46, &&cb47,
+    &&cb48, &&cb49, &&cb4A, &&cb4B, &&cb4C, &&cb4D, &&cb4E, &&cb4F,
+    &&cb50, &&cb51, &&cb52, &&cb53, &&cb54, &&cb55, &&cb56, &&cb57,
+    &&cb58, &&cb59, &&cb5A, &&cb5B, &&cb5C, &&cb5D, &&cb5E, &&cb5F,
+    &&cb60, &&cb61, &&cb62, &&cb63, &&cb64, &&cb65, &&cb66, &&cb67,
+    &&cb68, &&cb69, &&cb6A, &&cb6B, &&cb6C, &&cb6D, &&cb6E, &&cb6F,
+    &&cb70, &&cb71, &&cb72, &&cb73, &&cb74, &&cb75, &&cb76, &&cb77,
+    &&cb78, &&cb79, &&cb7A, &&cb7B, &&cb7C, &&cb7D, &&cb7E, &&cb7F,
+    &&cb80, &&cb81, &&cb82, &&cb83, &&cb84, &&cb85, &&cb86, &&cb87,
+    &&cb88, &&cb89, &&cb8A, &&cb8B, &&cb8C, &&cb8D, &&cb8E, &&cb8F,
+    &&cb90, &&cb91, &&cb92, &&cb93, &&cb94, &&cb95, &&cb96, &&cb97,
+    &&cb98, &&cb99, &&cb9A, &&cb9B, &&cb9C, &&cb9D, &&cb9E, &&cb9F,
+    &&cbA0, &&cbA1, &&cbA2, &&cbA3, &&cbA4, &&cbA5, &&cbA6, &&cbA7,
+    &&cbA8, &&cbA9, &&cbAA, &&cbAB, &&cbAC, &&cbAD, &&cbAE, &&cbAF,
+    &&cbB0, &&cbB1, &&cbB2, &&cbB3, &&cbB4, &&cbB5, &&cbB6, &&cbB7,
+    &&cbB8, &&cbB9, &&cbBA, &&cbBB, &&cbBC, &&cbBD, &&cbBE, &&cbBF,
+    &&cbC0, &&cbC1, &&cbC2, &&cbC3, &&cbC4, &&cbC5, &&cbC6, &&cbC7,
+    &&cbC8, &&cbC9, &&cbCA, &&cbCB, &&cbCC, &&cbCD, &&cbCE, &&cbCF,
+    &&cbD0, &&cbD1, &&cbD2, &&cbD3, &&cbD4, &&cbD5, &&cbD6, &&cbD7,
+    &&cbD8, &&cbD9, &&cbDA, &&cbDB, &&cbDC, &&cbDD, &&cbDE, &&cbDF,
+    &&cbE0, &&cbE1, &&cbE2, &&cbE3, &&cbE4, &&cbE5, &&cbE6, &&cbE7,
+    &&cbE8, &&cbE9, &&cbEA, &&cbEB, &&cbEC, &&cbED, &&cbEE, &&cbEF,
+    &&cbF0, &&cbF1, &&cbF2, &&cbF3, &&cbF4, &&cbF5, &&cbF6, &&cbF7,
+    &&cbF8, &&cbF9, &&cbFA, &&cbFB, &&cbFC, &&cbFD, &&cbFE, &&cbFF,
+  };
+  static void *const prefixoED[256] = {
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&e40, &&e41, &&e42, &&e43, &&e44, &&e45, &&e46, &&e47,
+    &&e48, &&e49, &&e4A, &&e4B, &&e44, &&e45, &&e46, &&e4F,
+    &&e50, &&e51, &&e52, &&e53, &&e44, &&e45, &&e56, &&e57,
+    &&e58, &&e59, &&e5A, &&e5B, &&e44, &&e45, &&e5E, &&e5F,
+    &&e60, &&e61, &&e62, &&e63, &&e44, &&e45, &&e46, &&e67,
+    &&e68, &&e69, &&e6A, &&e6B, &&e44, &&e45, &&e46, &&e6F,
+    &&e70, &&e71, &&e72, &&e73, &&e44, &&e45, &&e56, &&eNop,
+    &&e78, &&e79, &&e7A, &&e7B, &&e44, &&e45, &&e5E, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eA0, &&eA1, &&eA2, &&eA3, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eA8, &&eA9, &&eAA, &&eAB, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eB0, &&eB1, &&eB2, &&eB3, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eB8, &&eB9, &&eBA, &&eBB, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+    &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop, &&eNop,
+  };
+  // O que nao usa HL, H nem L e' a instrucao sem prefixo, 4 ciclos a mais.
+  static void *const prefixoXY[256] = {
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&x09, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&x19, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&x21, &&x22, &&x23, &&x24, &&x25, &&x26, &&xyNormal,
+    &&xyNormal, &&x29, &&x2A, &&x2B, &&x2C, &&x2D, &&x2E, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x34, &&x35, &&x36, &&xyNormal,
+    &&xyNormal, &&x39, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x44, &&x45, &&x46, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x4C, &&x4D, &&x4E, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x54, &&x55, &&x56, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x5C, &&x5D, &&x5E, &&xyNormal,
+    &&x60, &&x61, &&x62, &&x63, &&x64, &&x65, &&x66, &&x67,
+    &&x68, &&x69, &&x6A, &&x6B, &&x6C, &&x6D, &&x6E, &&x6F,
+    &&x70, &&x71, &&x72, &&x73, &&x74, &&x75, &&xyNormal, &&x77,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x7C, &&x7D, &&x7E, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x84, &&x85, &&x86, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x8C, &&x8D, &&x8E, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x94, &&x95, &&x96, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&x9C, &&x9D, &&x9E, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xA4, &&xA5, &&xA6, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xAC, &&xAD, &&xAE, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xB4, &&xB5, &&xB6, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xBC, &&xBD, &&xBE, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xCB, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xE1, &&xyNormal, &&xE3, &&xyNormal, &&xE5, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xE9, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+    &&xyNormal, &&xF9, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal, &&xyNormal,
+  };
+  static void *const prefixoXYCB[32] = {
+    &&xcRlc, &&xcRrc, &&xcRl, &&xcRr, &&xcSla, &&xcSra, &&xcSll, &&xcSrl,
+    &&xcBit, &&xcBit, &&xcBit, &&xcBit, &&xcBit, &&xcBit, &&xcBit, &&xcBit,
+    &&xcRes, &&xcRes, &&xcRes, &&xcRes, &&xcRes, &&xcRes, &&xcRes, &&xcRes,
+    &&xcSet, &&xcSet, &&xcSet, &&xcSet, &&xcSet, &&xcSet, &&xcSet, &&xcSet,
+  };
+
+  Barramento &bus = barramento;
+  const uint8_t *const *leitura = bus.leitura;
+  uint8_t *const *escrita = bus.escrita;
+  auto ler = [leitura, &bus](uint16_t endereco) -> uint8_t {
+    const uint8_t *p = leitura[endereco >> 13];
+    return p ? p[endereco & 0x1FFF] : bus.ler(endereco);
+  };
+  auto escrever = [escrita, &bus](uint16_t endereco, uint8_t valor) {
+    uint8_t *p = escrita[endereco >> 13];
+    if(p)
+      p[endereco & 0x1FFF] = valor;
+    else
+      bus.escrever(endereco, valor);
+  };
+
+  const uint64_t m1 = esperaM1;
+  uint8_t a = uint8_t(regs.af >> 8), f = uint8_t(regs.af);
+  uint8_t b = uint8_t(regs.bc >> 8), c = uint8_t(regs.bc);
+  uint8_t d = uint8_t(regs.de >> 8), e = uint8_t(regs.de);
+  uint8_t h = uint8_t(regs.hl >> 8), l = uint8_t(regs.hl);
+  uint16_t pc = regs.pc, sp = regs.sp, ix = regs.ix, iy = regs.iy, wz = regs.wz;
+  // xy: o IX ou IY da instrucao com prefixo, que volta pelo rotulo 'volta'.
+  uint16_t xy = 0, endereco = 0;
+  void *volta = nullptr;
+  // O bit 7 do R nao muda com as buscas.
+  uint8_t r = regs.r, r7 = uint8_t(regs.r & 0x80), op = 0;
+  uint64_t tempo = ciclos;
+  const uint64_t limite = ciclos + pedidos;
+  // Ciclo em que o laco para de saltar direto e passa por 'verificar'.
+  uint64_t alvo = 0;
+
+verificar:
+  if(tempo >= limite)
+    goto fim;
+  if(depoisEI) {
+    depoisEI = false;
+    alvo = 0;
+    op = BUSCAR();
+    goto *principal[op];
+  }
+  if(nmiPendente || (linhaInt && regs.iff1)) {
+    if(parado) {
+      parado = false;
+      pc++;
+    }
+    r++;
+    if(nmiPendente) {
+      nmiPendente = false;
+      regs.iff1 = false;
+      EMPILHAR(pc);
+      pc = 0x0066;
+      tempo += 11 + m1;
+    } else {
+      regs.iff1 = regs.iff2 = false;
+      EMPILHAR(pc);
+      // O barramento de dados do MSX fica em 0xFF: IM 0 vira RST 38h.
+      if(regs.im == 2) {
+        endereco = uint16_t((regs.i << 8) | 0xFF);
+        pc = uint16_t(ler(endereco) | (ler(uint16_t(endereco + 1)) << 8));
+        tempo += 19 + m1;
+      } else {
+        pc = 0x0038;
+        tempo += 13 + m1;
+      }
+    }
+    wz = pc;
+    goto verificar;
+  }
+  if(parado) {
+    // HALT repete NOPs ate' a interrupcao: pula direto para o limite.
+    uint64_t n = (limite - tempo + 3 + m1) / (4 + m1);
+    tempo += n * (4 + m1);
+    r = uint8_t(r + n);
+    goto fim;
+  }
+  alvo = limite;
+  op = BUSCAR();
+  goto *principal[op];
+
+o00: PROXIMA(4);
+o01: IMEDIATO16(endereco); DEF_PAR(b, c, endereco); PROXIMA(10);
+o02: escrever(BC, a); wz = uint16_t(((BC + 1) & 0xFF) | (a << 8)); PROXIMA(7);
+o03: DEF_PAR(b, c, BC + 1); PROXIMA(6);
+o04: INC(b); PROXIMA(4);
+o05: DEC(b); PROXIMA(4);
+o06: b = ler(pc++); PROXIMA(7);
+o07: a = uint8_t((a << 1) | (a >> 7)); f = uint8_t((f & (fP | fZ | fS)) | (a & (fC | f3 | f5))); PROXIMA(4);
+o08: { uint16_t t_ = regs.af2; regs.af2 = uint16_t((a << 8) | f); a = uint8_t(t_ >> 8); f = uint8_t(t_); } PROXIMA(4);
+o09: { uint16_t hl_ = HL; ADD16(hl_, BC); DEF_PAR(h, l, hl_); } PROXIMA(11);
+o0A: a = ler(BC); wz = uint16_t(BC + 1); PROXIMA(7);
+o0B: DEF_PAR(b, c, BC - 1); PROXIMA(6);
+o0C: INC(c); PROXIMA(4);
+o0D: DEC(c); PROXIMA(4);
+o0E: c = ler(pc++); PROXIMA(7);
+o0F: f = uint8_t((f & (fP | fZ | fS)) | (a & fC)); a = uint8_t((a >> 1) | (a << 7)); f = uint8_t(f | (a & (f3 | f5)));
+  PROXIMA(4);
+
+o10: { int8_t d_ = int8_t(ler(pc++)); if(--b) { pc = uint16_t(pc + d_); wz = pc; PROXIMA(13); } } PROXIMA(8);
+o11: IMEDIATO16(endereco); DEF_PAR(d, e, endereco); PROXIMA(10);
+o12: escrever(DE, a); wz = uint16_t(((DE + 1) & 0xFF) | (a << 8)); PROXIMA(7);
+o13: DEF_PAR(d, e, DE + 1); PROXIMA(6);
+o14: INC(d); PROXIMA(4);
+o15: DEC(d); PROXIMA(4);
+o16: d = ler(pc++); PROXIMA(7);
+o17: { uint8_t t_ = a; a = uint8_t((a << 1) | (f & fC)); f = uint8_t((f & (fP | fZ | fS)) | (a & (f3 | f5)) | (t_ >> 7)); }
+  PROXIMA(4);
+o18: { int8_t d_ = int8_t(ler(pc++)); pc = uint16_t(pc + d_); wz = pc; } PROXIMA(12);
+o19: { uint16_t hl_ = HL; ADD16(hl_, DE); DEF_PAR(h, l, hl_); } PROXIMA(11);
+o1A: a = ler(DE); wz = uint16_t(DE + 1); PROXIMA(7);
+o1B: DEF_PAR(d, e, DE - 1); PROXIMA(6);
+o1C: INC(e); PROXIMA(4);
+o1D: DEC(e); PROXIMA(4);
+o1E: e = ler(pc++); PROXIMA(7);
+o1F: { uint8_t t_ = a; a = uint8_t((a >> 1) | (f << 7)); f = uint8_t((f & (fP | fZ | fS)) | (a & (f3 | f5)) | (t_ & fC)); }
+  PROXIMA(4);
+
+o20: JR_SE(!(f & fZ));
+o21: IMEDIATO16(endereco); DEF_PAR(h, l, endereco); PROXIMA(10);
+o22: IMEDIATO16(endereco); escrever(endereco, l); escrever(uint16_t(endereco + 1), h); wz = uint16_t(endereco + 1);
+  PROXIMA(16);
+o23: DEF_PAR(h, l, HL + 1); PROXIMA(6);
+o24: INC(h); PROXIMA(4);
+o25: DEC(h); PROXIMA(4);
+o26: h = ler(pc++); PROXIMA(7);
+o27: {
+    uint8_t soma_ = 0, carry_ = f & fC;
+    if((f & fH) || (a & 0x0F) > 9)
+      soma_ = 6;
+    if(carry_ || a > 0x99)
+      soma_ |= 0x60;
+    if(a > 0x99)
+      carry_ = fC;
+    if(f & fN) {
+      SUB_A(soma_);
+    } else {
+      ADD_A(soma_);
+    }
+    f = uint8_t((f & ~(fC | fP)) | carry_ | (tabelas.sz53p[a] & fP));
+  }
+  PROXIMA(4);
+o28: JR_SE(f & fZ);
+o29: { uint16_t hl_ = HL; ADD16(hl_, hl_); DEF_PAR(h, l, hl_); } PROXIMA(11);
+o2A: IMEDIATO16(endereco); l = ler(endereco); h = ler(uint16_t(endereco + 1)); wz = uint16_t(endereco + 1); PROXIMA(16);
+o2B: DEF_PAR(h, l, HL - 1); PROXIMA(6);
+o2C: INC(l); PROXIMA(4);
+o2D: DEC(l); PROXIMA(4);
+o2E: l = ler(pc++); PROXIMA(7);
+o2F: a ^= 0xFF; f = uint8_t((f & (fC | fP | fZ | fS)) | (a & (f3 | f5)) | fN | fH); PROXIMA(4);
+
+o30: JR_SE(!(f & fC));
+o31: IMEDIATO16(sp); PROXIMA(10);
+o32: IMEDIATO16(endereco); escrever(endereco, a); wz = uint16_t(((endereco + 1) & 0xFF) | (a << 8)); PROXIMA(13);
+o33: sp++; PROXIMA(6);
+o34: { uint8_t v_ = ler(HL); INC(v_); escrever(HL, v_); } PROXIMA(11);
+o35: { uint8_t v_ = ler(HL); DEC(v_); escrever(HL, v_); } PROXIMA(11);
+o36: escrever(HL, ler(pc++)); PROXIMA(10);
+o37: f = uint8_t((f & (fP | fZ | fS)) | (a & (f3 | f5)) | fC); PROXIMA(4);
+o38: JR_SE(f & fC);
+o39: { uint16_t hl_ = HL; ADD16(hl_, sp); DEF_PAR(h, l, hl_); } PROXIMA(11);
+o3A: IMEDIATO16(endereco); a = ler(endereco); wz = uint16_t(endereco + 1); PROXIMA(13);
+o3B: sp--; PROXIMA(6);
+o3C: INC(a); PROXIMA(4);
+o3D: DEC(a); PROXIMA(4);
+o3E: a = ler(pc++); PROXIMA(7);
+o3F: f = uint8_t((f & (fP | fZ | fS)) | ((f & fC) ? fH : fC) | (a & (f3 | f5))); PROXIMA(4);
+
+o40: PROXIMA(4);
+o41: b = c; PROXIMA(4);
+o42: b = d; PROXIMA(4);
+o43: b = e; PROXIMA(4);
+o44: b = h; PROXIMA(4);
+o45: b = l; PROXIMA(4);
+o46: b = ler(HL); PROXIMA(7);
+o47: b = a; PROXIMA(4);
+o48: c = b; PROXIMA(4);
+o49: PROXIMA(4);
+o4A: c = d; PROXIMA(4);
+o4B: c = e; PROXIMA(4);
+o4C: c = h; PROXIMA(4);
+o4D: c = l; PROXIMA(4);
+o4E: c = ler(HL); PROXIMA(7);
+o4F: c = a; PROXIMA(4);
+
+o50: d = b; PROXIMA(4);
+o51: d = c; PROXIMA(4);
+o52: PROXIMA(4);
+o53: d = e; PROXIMA(4);
+o54: d = h; PROXIMA(4);
+o55: d = l; PROXIMA(4);
+o56: d = ler(HL); PROXIMA(7);
+o57: d = a; PROXIMA(4);
+o58: e = b; PROXIMA(4);
+o59: e = c; PROXIMA(4);
+o5A: e = d; PROXIMA(4);
+o5B: PROXIMA(4);
+o5C: e = h; PROXIMA(4);
+o5D: e = l; PROXIMA(4);
+o5E: e = ler(HL); PROXIMA(7);
+o5F: e = a; PROXIMA(4);
+
+o60: h = b; PROXIMA(4);
+o61: h = c; PROXIMA(4);
+o62: h = d; PROXIMA(4);
+o63: h = e; PROXIMA(4);
+o64: PROXIMA(4);
+o65: h = l; PROXIMA(4);
+o66: h = ler(HL); PROXIMA(7);
+o67: h = a; PROXIMA(4);
+o68: l = b; PROXIMA(4);
+o69: l = c; PROXIMA(4);
+o6A: l = d; PROXIMA(4);
+o6B: l = e; PROXIMA(4);
+o6C: l = h; PROXIMA(4);
+o6D: PROXIMA(4);
+o6E: l = ler(HL); PROXIMA(7);
+o6F: l = a; PROXIMA(4);
+
+o70: escrever(HL, b); PROXIMA(7);
+o71: escrever(HL, c); PROXIMA(7);
+o72: escrever(HL, d); PROXIMA(7);
+o73: escrever(HL, e); PROXIMA(7);
+o74: escrever(HL, h); PROXIMA(7);
+o75: escrever(HL, l); PROXIMA(7);
+o76: parado = true; pc--; tempo += 4; goto verificar;
+o77: escrever(HL, a); PROXIMA(7);
+o78: a = b; PROXIMA(4);
+o79: a = c; PROXIMA(4);
+o7A: a = d; PROXIMA(4);
+o7B: a = e; PROXIMA(4);
+o7C: a = h; PROXIMA(4);
+o7D: a = l; PROXIMA(4);
+o7E: a = ler(HL); PROXIMA(7);
+o7F: PROXIMA(4);
+
+o80: ADD_A(b); PROXIMA(4);
+o81: ADD_A(c); PROXIMA(4);
+o82: ADD_A(d); PROXIMA(4);
+o83: ADD_A(e); PROXIMA(4);
+o84: ADD_A(h); PROXIMA(4);
+o85: ADD_A(l); PROXIMA(4);
+o86: ADD_A(ler(HL)); PROXIMA(7);
+o87: ADD_A(a); PROXIMA(4);
+o88: ADC_A(b); PROXIMA(4);
+o89: ADC_A(c); PROXIMA(4);
+o8A: ADC_A(d); PROXIMA(4);
+o8B: ADC_A(e); PROXIMA(4);
+o8C: ADC_A(h); PROXIMA(4);
+o8D: ADC_A(l); PROXIMA(4);
+o8E: ADC_A(ler(HL)); PROXIMA(7);
+o8F: ADC_A(a); PROXIMA(4);
+
+o90: SUB_A(b); PROXIMA(4);
+o91: SUB_A(c); PROXIMA(4);
+o92: SUB_A(d); PROXIMA(4);
+o93: SUB_A(e); PROXIMA(4);
+o94: SUB_A(h); PROXIMA(4);
+o95: SUB_A(l); PROXIMA(4);
+o96: SUB_A(ler(HL)); PROXIMA(7);
+o97: SUB_A(a); PROXIMA(4);
+o98: SBC_A(b); PROXIMA(4);
+o99: SBC_A(c); PROXIMA(4);
+o9A: SBC_A(d); PROXIMA(4);
+o9B: SBC_A(e); PROXIMA(4);
+o9C: SBC_A(h); PROXIMA(4);
+o9D: SBC_A(l); PROXIMA(4);
+o9E: SBC_A(ler(HL)); PROXIMA(7);
+o9F: SBC_A(a); PROXIMA(4);
+
+oA0: AND_A(b); PROXIMA(4);
+oA1: AND_A(c); PROXIMA(4);
+oA2: AND_A(d); PROXIMA(4);
+oA3: AND_A(e); PROXIMA(4);
+oA4: AND_A(h); PROXIMA(4);
+oA5: AND_A(l); PROXIMA(4);
+oA6: AND_A(ler(HL)); PROXIMA(7);
+oA7: AND_A(a); PROXIMA(4);
+oA8: XOR_A(b); PROXIMA(4);
+oA9: XOR_A(c); PROXIMA(4);
+oAA: XOR_A(d); PROXIMA(4);
+oAB: XOR_A(e); PROXIMA(4);
+oAC: XOR_A(h); PROXIMA(4);
+oAD: XOR_A(l); PROXIMA(4);
+oAE: XOR_A(ler(HL)); PROXIMA(7);
+oAF: XOR_A(a); PROXIMA(4);
+
+oB0: OR_A(b); PROXIMA(4);
+oB1: OR_A(c); PROXIMA(4);
+oB2: OR_A(d); PROXIMA(4);
+oB3: OR_A(e); PROXIMA(4);
+oB4: OR_A(h); PROXIMA(4);
+oB5: OR_A(l); PROXIMA(4);
+oB6: OR_A(ler(HL)); PROXIMA(7);
+oB7: OR_A(a); PROXIMA(4);
+oB8: CP_A(b); PROXIMA(4);
+oB9: CP_A(c); PROXIMA(4);
+oBA: CP_A(d); PROXIMA(4);
+oBB: CP_A(e); PROXIMA(4);
+oBC: CP_A(h); PROXIMA(4);
+oBD: CP_A(l); PROXIMA(4);
+oBE: CP_A(ler(HL)); PROXIMA(7);
+oBF: CP_A(a); PROXIMA(4);
+
+oC0: RET_SE(!(f & fZ));
+oC1: DESEMPILHAR(b, c); PROXIMA(10);
+oC2: JP_SE(!(f & fZ));
+oC3: IMEDIATO16(wz); pc = wz; PROXIMA(10);
+oC4: CALL_SE(!(f & fZ));
+oC5: EMPILHAR(BC); PROXIMA(11);
+oC6: ADD_A(ler(pc++)); PROXIMA(7);
+oC7: RST(0x00);
+oC8: RET_SE(f & fZ);
+oC9: DESEMPILHAR16(pc); wz = pc; PROXIMA(10);
+oCA: JP_SE(f & fZ);
+oCB: op = BUSCAR(); goto *prefixoCB[op];
+oCC: CALL_SE(f & fZ);
+oCD: IMEDIATO16(wz); EMPILHAR(pc); pc = wz; PROXIMA(17);
+oCE: ADC_A(ler(pc++)); PROXIMA(7);
+oCF: RST(0x08);
+
+oD0: RET_SE(!(f & fC));
+oD1: DESEMPILHAR(d, e); PROXIMA(10);
+oD2: JP_SE(!(f & fC));
+oD3: { uint8_t n_ = ler(pc++); wz = uint16_t(((n_ + 1) & 0xFF) | (a << 8)); SAIDA(uint16_t(n_ | (a << 8)), a); }
+  PROXIMA(11);
+oD4: CALL_SE(!(f & fC));
+oD5: EMPILHAR(DE); PROXIMA(11);
+oD6: SUB_A(ler(pc++)); PROXIMA(7);
+oD7: RST(0x10);
+oD8: RET_SE(f & fC);
+oD9: {
+    uint16_t t_ = regs.bc2;
+    regs.bc2 = BC;
+    DEF_PAR(b, c, t_);
+    t_ = regs.de2;
+    regs.de2 = DE;
+    DEF_PAR(d, e, t_);
+    t_ = regs.hl2;
+    regs.hl2 = HL;
+    DEF_PAR(h, l, t_);
+  }
+  PROXIMA(4);
+oDA: JP_SE(f & fC);
+oDB: { uint16_t porta_ = uint16_t(ler(pc++) | (a << 8)); wz = uint16_t(porta_ + 1); a = ENTRADA(porta_); } PROXIMA(11);
+oDC: CALL_SE(f & fC);
+oDD: xy = ix; volta = &&voltaIX; op = BUSCAR(); goto *prefixoXY[op];
+oDE: SBC_A(ler(pc++)); PROXIMA(7);
+oDF: RST(0x18);
+
+oE0: RET_SE(!(f & fP));
+oE1: DESEMPILHAR(h, l); PROXIMA(10);
+oE2: JP_SE(!(f & fP));
+oE3: {
+    uint8_t lo_ = ler(sp), hi_ = ler(uint16_t(sp + 1));
+    escrever(uint16_t(sp + 1), h);
+    escrever(sp, l);
+    h = hi_;
+    l = lo_;
+    wz = HL;
+  }
+  PROXIMA(19);
+oE4: CALL_SE(!(f & fP));
+oE5: EMPILHAR(HL); PROXIMA(11);
+oE6: AND_A(ler(pc++)); PROXIMA(7);
+oE7: RST(0x20);
+oE8: RET_SE(f & fP);
+oE9: pc = HL; PROXIMA(4);
+oEA: JP_SE(f & fP);
+oEB: { uint8_t t_ = d; d = h; h = t_; t_ = e; e = l; l = t_; } PROXIMA(4);
+oEC: CALL_SE(f & fP);
+oED: op = BUSCAR(); goto *prefixoED[op];
+oEE: XOR_A(ler(pc++)); PROXIMA(7);
+oEF: RST(0x28);
+
+oF0: RET_SE(!(f & fS));
+oF1: DESEMPILHAR(a, f); PROXIMA(10);
+oF2: JP_SE(!(f & fS));
+oF3: regs.iff1 = regs.iff2 = false; PROXIMA(4);
+oF4: CALL_SE(!(f & fS));
+oF5: EMPILHAR(uint16_t((a << 8) | f)); PROXIMA(11);
+oF6: OR_A(ler(pc++)); PROXIMA(7);
+oF7: RST(0x30);
+oF8: RET_SE(f & fS);
+oF9: sp = HL; PROXIMA(6);
+oFA: JP_SE(f & fS);
+oFB: regs.iff1 = regs.iff2 = true; depoisEI = true; tempo += 4; goto verificar;
+oFC: CALL_SE(f & fS);
+oFD: xy = iy; volta = &&voltaIY; op = BUSCAR(); goto *prefixoXY[op];
+oFE: CP_A(ler(pc++)); PROXIMA(7);
+oFF: RST(0x38);
+
+  CB_LINHA(00, 01, 02, 03, 04, 05, 06, 07, RLC, 0)
+  CB_LINHA(08, 09, 0A, 0B, 0C, 0D, 0E, 0F, RRC, 0)
+  CB_LINHA(10, 11, 12, 13, 14, 15, 16, 17, RL, 0)
+  CB_LINHA(18, 19, 1A, 1B, 1C, 1D, 1E, 1F, RR, 0)
+  CB_LINHA(20, 21, 22, 23, 24, 25, 26, 27, SLA, 0)
+  CB_LINHA(28, 29, 2A, 2B, 2C, 2D, 2E, 2F, SRA, 0)
+  CB_LINHA(30, 31, 32, 33, 34, 35, 36, 37, SLL, 0)
+  CB_LINHA(38, 39, 3A, 3B, 3C, 3D, 3E, 3F, SRL, 0)
+  CB_BIT(40, 41, 42, 43, 44, 45, 46, 47, 0)
+  CB_BIT(48, 49, 4A, 4B, 4C, 4D, 4E, 4F, 1)
+  CB_BIT(50, 51, 52, 53, 54, 55, 56, 57, 2)
+  CB_BIT(58, 59, 5A, 5B, 5C, 5D, 5E, 5F, 3)
+  CB_BIT(60, 61, 62, 63, 64, 65, 66, 67, 4)
+  CB_BIT(68, 69, 6A, 6B, 6C, 6D, 6E, 6F, 5)
+  CB_BIT(70, 71, 72, 73, 74, 75, 76, 77, 6)
+  CB_BIT(78, 79, 7A, 7B, 7C, 7D, 7E, 7F, 7)
+  CB_LINHA(80, 81, 82, 83, 84, 85, 86, 87, RES, 0)
+  CB_LINHA(88, 89, 8A, 8B, 8C, 8D, 8E, 8F, RES, 1)
+  CB_LINHA(90, 91, 92, 93, 94, 95, 96, 97, RES, 2)
+  CB_LINHA(98, 99, 9A, 9B, 9C, 9D, 9E, 9F, RES, 3)
+  CB_LINHA(A0, A1, A2, A3, A4, A5, A6, A7, RES, 4)
+  CB_LINHA(A8, A9, AA, AB, AC, AD, AE, AF, RES, 5)
+  CB_LINHA(B0, B1, B2, B3, B4, B5, B6, B7, RES, 6)
+  CB_LINHA(B8, B9, BA, BB, BC, BD, BE, BF, RES, 7)
+  CB_LINHA(C0, C1, C2, C3, C4, C5, C6, C7, SET, 0)
+  CB_LINHA(C8, C9, CA, CB, CC, CD, CE, CF, SET, 1)
+  CB_LINHA(D0, D1, D2, D3, D4, D5, D6, D7, SET, 2)
+  CB_LINHA(D8, D9, DA, DB, DC, DD, DE, DF, SET, 3)
+  CB_LINHA(E0, E1, E2, E3, E4, E5, E6, E7, SET, 4)
+  CB_LINHA(E8, E9, EA, EB, EC, ED, EE, EF, SET, 5)
+  CB_LINHA(F0, F1, F2, F3, F4, F5, F6, F7, SET, 6)
+  CB_LINHA(F8, F9, FA, FB, FC, FD, FE, FF, SET, 7)
+
+e40: wz = uint16_t(BC + 1); b = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[b]); PROXIMA(12);
+e41: wz = uint16_t(BC + 1); SAIDA(BC, b); PROXIMA(12);
+e42: SBC_HL(BC); PROXIMA(15);
+e43: IMEDIATO16(endereco); escrever(endereco, c); escrever(uint16_t(endereco + 1), b); wz = uint16_t(endereco + 1);
+  PROXIMA(20);
+e44: { uint8_t n_ = a; a = 0; SUB_A(n_); } PROXIMA(8);
+e45: regs.iff1 = regs.iff2; DESEMPILHAR16(pc); wz = pc; alvo = 0; PROXIMA(14);
+e46: regs.im = 0; PROXIMA(8);
+e47: regs.i = a; PROXIMA(9);
+e48: wz = uint16_t(BC + 1); c = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[c]); PROXIMA(12);
+e49: wz = uint16_t(BC + 1); SAIDA(BC, c); PROXIMA(12);
+e4A: ADC_HL(BC); PROXIMA(15);
+e4B: IMEDIATO16(endereco); c = ler(endereco); b = ler(uint16_t(endereco + 1)); wz = uint16_t(endereco + 1); PROXIMA(20);
+e4F: r = a; r7 = uint8_t(a & 0x80); PROXIMA(9);
+
+e50: wz = uint16_t(BC + 1); d = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[d]); PROXIMA(12);
+e51: wz = uint16_t(BC + 1); SAIDA(BC, d); PROXIMA(12);
+e52: SBC_HL(DE); PROXIMA(15);
+e53: IMEDIATO16(endereco); escrever(endereco, e); escrever(uint16_t(endereco + 1), d); wz = uint16_t(endereco + 1);
+  PROXIMA(20);
+e56: regs.im = 1; PROXIMA(8);
+e57: a = regs.i; f = uint8_t((f & fC) | tabelas.sz53[a] | (regs.iff2 ? fP : 0)); PROXIMA(9);
+e58: wz = uint16_t(BC + 1); e = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[e]); PROXIMA(12);
+e59: wz = uint16_t(BC + 1); SAIDA(BC, e); PROXIMA(12);
+e5A: ADC_HL(DE); PROXIMA(15);
+e5B: IMEDIATO16(endereco); e = ler(endereco); d = ler(uint16_t(endereco + 1)); wz = uint16_t(endereco + 1); PROXIMA(20);
+e5E: regs.im = 2; PROXIMA(8);
+e5F: a = uint8_t((r & 0x7F) | r7); f = uint8_t((f & fC) | tabelas.sz53[a] | (regs.iff2 ? fP : 0)); PROXIMA(9);
+
+e60: wz = uint16_t(BC + 1); h = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[h]); PROXIMA(12);
+e61: wz = uint16_t(BC + 1); SAIDA(BC, h); PROXIMA(12);
+e62: SBC_HL(HL); PROXIMA(15);
+e63: IMEDIATO16(endereco); escrever(endereco, l); escrever(uint16_t(endereco + 1), h); wz = uint16_t(endereco + 1);
+  PROXIMA(20);
+e67: {
+    uint8_t v_ = ler(HL);
+    escrever(HL, uint8_t((a << 4) | (v_ >> 4)));
+    a = uint8_t((a & 0xF0) | (v_ & 0x0F));
+    f = uint8_t((f & fC) | tabelas.sz53p[a]);
+    wz = uint16_t(HL + 1);
+  }
+  PROXIMA(18);
+e68: wz = uint16_t(BC + 1); l = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[l]); PROXIMA(12);
+e69: wz = uint16_t(BC + 1); SAIDA(BC, l); PROXIMA(12);
+e6A: ADC_HL(HL); PROXIMA(15);
+e6B: IMEDIATO16(endereco); l = ler(endereco); h = ler(uint16_t(endereco + 1)); wz = uint16_t(endereco + 1); PROXIMA(20);
+e6F: {
+    uint8_t v_ = ler(HL);
+    escrever(HL, uint8_t((v_ << 4) | (a & 0x0F)));
+    a = uint8_t((a & 0xF0) | (v_ >> 4));
+    f = uint8_t((f & fC) | tabelas.sz53p[a]);
+    wz = uint16_t(HL + 1);
+  }
+  PROXIMA(18);
+
+// IN F,(C) e OUT (C),0: so' as flags e um zero.
+e70: { wz = uint16_t(BC + 1); uint8_t v_ = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[v_]); } PROXIMA(12);
+e71: wz = uint16_t(BC + 1); SAIDA(BC, 0); PROXIMA(12);
+e72: SBC_HL(sp); PROXIMA(15);
+e73: IMEDIATO16(endereco); escrever(endereco, uint8_t(sp)); escrever(uint16_t(endereco + 1), uint8_t(sp >> 8));
+  wz = uint16_t(endereco + 1); PROXIMA(20);
+e78: wz = uint16_t(BC + 1); a = ENTRADA(BC); f = uint8_t((f & fC) | tabelas.sz53p[a]); PROXIMA(12);
+e79: wz = uint16_t(BC + 1); SAIDA(BC, a); PROXIMA(12);
+e7A: ADC_HL(sp); PROXIMA(15);
+e7B: IMEDIATO16(endereco); { uint8_t lo_ = ler(endereco); sp = uint16_t(lo_ | (ler(uint16_t(endereco + 1)) << 8)); }
+  wz = uint16_t(endereco + 1); PROXIMA(20);
+
+eA0: LDI_LDD(1); PROXIMA(16);
+eA1: CPI_CPD(1); PROXIMA(16);
+eA2: INI_IND(1); PROXIMA(16);
+eA3: OUTI_OUTD(1); PROXIMA(16);
+eA8: LDI_LDD(-1); PROXIMA(16);
+eA9: CPI_CPD(-1); PROXIMA(16);
+eAA: INI_IND(-1); PROXIMA(16);
+eAB: OUTI_OUTD(-1); PROXIMA(16);
+eB0: LDI_LDD(1); if(b | c) { pc = uint16_t(pc - 2); wz = uint16_t(pc + 1); PROXIMA(21); } PROXIMA(16);
+eB1: CPI_CPD(1); if((f & (fP | fZ)) == fP) { pc = uint16_t(pc - 2); wz = uint16_t(pc + 1); PROXIMA(21); } PROXIMA(16);
+eB2: INI_IND(1); if(b) { pc = uint16_t(pc - 2); PROXIMA(21); } PROXIMA(16);
+eB3: OUTI_OUTD(1); if(b) { pc = uint16_t(pc - 2); PROXIMA(21); } PROXIMA(16);
+eB8: LDI_LDD(-1); if(b | c) { pc = uint16_t(pc - 2); wz = uint16_t(pc + 1); PROXIMA(21); } PROXIMA(16);
+eB9: CPI_CPD(-1); if((f & (fP | fZ)) == fP) { pc = uint16_t(pc - 2); wz = uint16_t(pc + 1); PROXIMA(21); } PROXIMA(16);
+eBA: INI_IND(-1); if(b) { pc = uint16_t(pc - 2); PROXIMA(21); } PROXIMA(16);
+eBB: OUTI_OUTD(-1); if(b) { pc = uint16_t(pc - 2); PROXIMA(21); } PROXIMA(16);
+// Os opcodes ED sem instrucao sao NOPs de 8 ciclos.
+eNop: PROXIMA(8);
+
+voltaIX: ix = xy; PROXIMA(0);
+voltaIY: iy = xy; PROXIMA(0);
+xyNormal: tempo += 4; goto *principal[op];
+
+x09: ADD16(xy, BC); PROXIMA_XY(15);
+x19: ADD16(xy, DE); PROXIMA_XY(15);
+x21: IMEDIATO16(xy); PROXIMA_XY(14);
+x22: IMEDIATO16(endereco); escrever(endereco, XL); escrever(uint16_t(endereco + 1), XH); wz = uint16_t(endereco + 1);
+  PROXIMA(20);
+x23: xy++; PROXIMA_XY(10);
+x24: { uint8_t v_ = XH; INC(v_); DEF_XH(v_); } PROXIMA_XY(8);
+x25: { uint8_t v_ = XH; DEC(v_); DEF_XH(v_); } PROXIMA_XY(8);
+x26: DEF_XH(ler(pc++)); PROXIMA_XY(11);
+x29: ADD16(xy, xy); PROXIMA_XY(15);
+x2A: IMEDIATO16(endereco); { uint8_t lo_ = ler(endereco); xy = uint16_t(lo_ | (ler(uint16_t(endereco + 1)) << 8)); }
+  wz = uint16_t(endereco + 1); PROXIMA_XY(20);
+x2B: xy--; PROXIMA_XY(10);
+x2C: { uint8_t v_ = XL; INC(v_); DEF_XL(v_); } PROXIMA_XY(8);
+x2D: { uint8_t v_ = XL; DEC(v_); DEF_XL(v_); } PROXIMA_XY(8);
+x2E: DEF_XL(ler(pc++)); PROXIMA_XY(11);
+x34: ENDERECO_XY(); { uint8_t v_ = ler(endereco); INC(v_); escrever(endereco, v_); } PROXIMA(23);
+x35: ENDERECO_XY(); { uint8_t v_ = ler(endereco); DEC(v_); escrever(endereco, v_); } PROXIMA(23);
+x36: ENDERECO_XY(); escrever(endereco, ler(pc++)); PROXIMA(19);
+x39: ADD16(xy, sp); PROXIMA_XY(15);
+
+x44: b = XH; PROXIMA(8);
+x45: b = XL; PROXIMA(8);
+x46: ENDERECO_XY(); b = ler(endereco); PROXIMA(19);
+x4C: c = XH; PROXIMA(8);
+x4D: c = XL; PROXIMA(8);
+x4E: ENDERECO_XY(); c = ler(endereco); PROXIMA(19);
+x54: d = XH; PROXIMA(8);
+x55: d = XL; PROXIMA(8);
+x56: ENDERECO_XY(); d = ler(endereco); PROXIMA(19);
+x5C: e = XH; PROXIMA(8);
+x5D: e = XL; PROXIMA(8);
+x5E: ENDERECO_XY(); e = ler(endereco); PROXIMA(19);
+x60: DEF_XH(b); PROXIMA_XY(8);
+x61: DEF_XH(c); PROXIMA_XY(8);
+x62: DEF_XH(d); PROXIMA_XY(8);
+x63: DEF_XH(e); PROXIMA_XY(8);
+x64: PROXIMA(8);
+x65: DEF_XH(XL); PROXIMA_XY(8);
+x66: ENDERECO_XY(); h = ler(endereco); PROXIMA(19);
+x67: DEF_XH(a); PROXIMA_XY(8);
+x68: DEF_XL(b); PROXIMA_XY(8);
+x69: DEF_XL(c); PROXIMA_XY(8);
+x6A: DEF_XL(d); PROXIMA_XY(8);
+x6B: DEF_XL(e); PROXIMA_XY(8);
+x6C: DEF_XL(XH); PROXIMA_XY(8);
+x6D: PROXIMA(8);
+x6E: ENDERECO_XY(); l = ler(endereco); PROXIMA(19);
+x6F: DEF_XL(a); PROXIMA_XY(8);
+x70: ENDERECO_XY(); escrever(endereco, b); PROXIMA(19);
+x71: ENDERECO_XY(); escrever(endereco, c); PROXIMA(19);
+x72: ENDERECO_XY(); escrever(endereco, d); PROXIMA(19);
+x73: ENDERECO_XY(); escrever(endereco, e); PROXIMA(19);
+x74: ENDERECO_XY(); escrever(endereco, h); PROXIMA(19);
+x75: ENDERECO_XY(); escrever(endereco, l); PROXIMA(19);
+x77: ENDERECO_XY(); escrever(endereco, a); PROXIMA(19);
+x7C: a = XH; PROXIMA(8);
+x7D: a = XL; PROXIMA(8);
+x7E: ENDERECO_XY(); a = ler(endereco); PROXIMA(19);
+
+x84: ADD_A(XH); PROXIMA(8);
+x85: ADD_A(XL); PROXIMA(8);
+x86: ENDERECO_XY(); ADD_A(ler(endereco)); PROXIMA(19);
+x8C: ADC_A(XH); PROXIMA(8);
+x8D: ADC_A(XL); PROXIMA(8);
+x8E: ENDERECO_XY(); ADC_A(ler(endereco)); PROXIMA(19);
+x94: SUB_A(XH); PROXIMA(8);
+x95: SUB_A(XL); PROXIMA(8);
+x96: ENDERECO_XY(); SUB_A(ler(endereco)); PROXIMA(19);
+x9C: SBC_A(XH); PROXIMA(8);
+x9D: SBC_A(XL); PROXIMA(8);
+x9E: ENDERECO_XY(); SBC_A(ler(endereco)); PROXIMA(19);
+xA4: AND_A(XH); PROXIMA(8);
+xA5: AND_A(XL); PROXIMA(8);
+xA6: ENDERECO_XY(); AND_A(ler(endereco)); PROXIMA(19);
+xAC: XOR_A(XH); PROXIMA(8);
+xAD: XOR_A(XL); PROXIMA(8);
+xAE: ENDERECO_XY(); XOR_A(ler(endereco)); PROXIMA(19);
+xB4: OR_A(XH); PROXIMA(8);
+xB5: OR_A(XL); PROXIMA(8);
+xB6: ENDERECO_XY(); OR_A(ler(endereco)); PROXIMA(19);
+xBC: CP_A(XH); PROXIMA(8);
+xBD: CP_A(XL); PROXIMA(8);
+xBE: ENDERECO_XY(); CP_A(ler(endereco)); PROXIMA(19);
+
+// DD CB d op: o deslocamento vem antes do opcode, que nao e' busca M1.
+xCB: ENDERECO_XY(); op = ler(pc++); goto *prefixoXYCB[op >> 3];
+xE1: DESEMPILHAR16(xy); PROXIMA_XY(14);
+xE3: {
+    uint8_t lo_ = ler(sp), hi_ = ler(uint16_t(sp + 1));
+    escrever(uint16_t(sp + 1), XH);
+    escrever(sp, XL);
+    xy = uint16_t(lo_ | (hi_ << 8));
+    wz = xy;
+  }
+  PROXIMA_XY(23);
+xE5: EMPILHAR(xy); PROXIMA(15);
+xE9: pc = xy; PROXIMA(8);
+xF9: sp = xy; PROXIMA(10);
+
+  XYCB(xcRlc, RLC)
+  XYCB(xcRrc, RRC)
+  XYCB(xcRl, RL)
+  XYCB(xcRr, RR)
+  XYCB(xcSla, SLA)
+  XYCB(xcSra, SRA)
+  XYCB(xcSll, SLL)
+  XYCB(xcSrl, SRL)
+  XYCB(xcRes, RES)
+  XYCB(xcSet, SET)
+xcBit: { uint8_t v_ = ler(endereco); BIT(v_, (op >> 3) & 7, endereco >> 8); } PROXIMA(20);
+
+fim:
+  regs.af = uint16_t((a << 8) | f);
+  regs.bc = BC;
+  regs.de = DE;
+  regs.hl = HL;
+  regs.ix = ix;
+  regs.iy = iy;
+  regs.sp = sp;
+  regs.pc = pc;
+  regs.wz = wz;
+  regs.r = uint8_t((r & 0x7F) | r7);
+  uint64_t feitos = tempo - ciclos;
+  ciclos = tempo;
+  return feitos;
+}
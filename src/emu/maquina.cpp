@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <glob.h>
+#include <initializer_list>
+#include <memory>
+
+#include "mapeamento.h"
+#include "maquina.h"
+#include "tarefas.h"
+
+// 228 ciclos por linha, 262 linhas, a 3,58 MHz.
+static const uint64_t ciclosQuadro = 228 * 262;
+// Para onde o INIT volta, se voltar: EI, HALT, JR de volta.
+static const uint16_t voltaInit = 0x1200;
+
+// BIOS de mentira, ja' montada. As entradas que precisam de mais de 3 bytes
+// saltam para rotinas a partir de #1000.
+static void montarBios(uint8_t *bios) {
+  auto poe = [bios](uint16_t endereco, std::initializer_list<uint8_t> codigo) {
+    std::copy(codigo.begin(), codigo.end(), bios + endereco);
+  };
+
+  std::fill_n(bios, 0x8000, 0xC9);
+  // CHKRAM: reset trava. CGTABL, portas do VDP e identificacao (MSX1, 60 Hz).
+  poe(0x0000, {0xF3, 0x76});
+  poe(0x0004, {0xBF, 0x1B, 0x98, 0x98});
+  poe(0x002B, {0x00, 0x00, 0x00});
+  // RDSLT e WRSLT no slot atual, CALSLT como JP (IX), DCOMPR, ENASLT.
+  poe(0x000C, {0x7E, 0xC9});
+  poe(0x0014, {0x73, 0xC9});
+  poe(0x001C, {0xDD, 0xE9});
+  poe(0x0020, {0xC3, 0x40, 0x11});
+  poe(0x0024, {0xC3, 0x40, 0x10});
+  // KEYINT.
+  poe(0x0038, {0xC3, 0x00, 0x10});
+  // WRTVDP, RDVRM, WRTVRM, SETRD, SETWRT, FILVRM, LDIRMV, LDIRVM.
+  poe(0x0047, {0xC3, 0x10, 0x11});
+  poe(0x004A, {0xC3, 0xF0, 0x10});
+  poe(0x004D, {0xC3, 0x00, 0x11});
+  poe(0x0050, {0xC3, 0xE0, 0x10});
+  poe(0x0053, {0xC3, 0xD0, 0x10});
+  poe(0x0056, {0xC3, 0x70, 0x10});
+  poe(0x0059, {0xC3, 0x90, 0x10});
+  poe(0x005C, {0xC3, 0xB0, 0x10});
+  // NMI: RETN.
+  poe(0x0066, {0xED, 0x45});
+  // WRTPSG, RDPSG.
+  poe(0x0093, {0xC3, 0x20, 0x11});
+  poe(0x0096, {0xC3, 0x30, 0x11});
+  // CHSNS sem tecla, CHGET devolve ENTER; GTSTCK, GTTRIG, GTPAD e GTPDL
+  // zerados.
+  poe(0x009C, {0xAF, 0xC9});
+  poe(0x009F, {0x3E, 0x0D, 0xC9});
+  poe(0x00D5, {0xAF, 0xC9});
+  poe(0x00D8, {0xAF, 0xC9});
+  poe(0x00DB, {0xAF, 0xC9});
+  poe(0x00DE, {0xAF, 0xC9});
+  // RSLREG, WSLREG, RDVDP, SNSMAT.
+  poe(0x0138, {0xDB, 0xA8, 0xC9});
+  poe(0x013B, {0xD3, 0xA8, 0xC9});
+  poe(0x013E, {0xDB, 0x99, 0xC9});
+  poe(0x0141, {0x3E, 0xFF, 0xC9});
+
+  // KEYINT: salva tudo, H.KEYI, le o status do VDP (o que desliga a
+  // interrupcao) e, se for o fim do quadro, STATFL, H.TIMI e JIFFY.
+  poe(0x1000, {0xE5, 0xD5, 0xC5, 0xF5, 0xD9, 0x08, 0xE5, 0xD5, 0xC5, 0xF5, // PUSH HL...AF; EXX; EX AF,AF'; PUSH
+               0xFD, 0xE5, 0xDD, 0xE5,                                     // PUSH IY; PUSH IX
+               0xCD, 0x9A, 0xFD,                                           // CALL H.KEYI
+               0xDB, 0x99, 0xA7, 0xF2, 0x24, 0x10,                         // IN A,(99h); AND A; JP P,fim
+               0x32, 0xE7, 0xF3,                                           // LD (STATFL),A
+               0xCD, 0x9F, 0xFD,                                           // CALL H.TIMI
+               0x2A, 0x9E, 0xFC, 0x23, 0x22, 0x9E, 0xFC,                   // JIFFY++
+               0xDD, 0xE1, 0xFD, 0xE1,                                     // fim: POP IX; POP IY
+               0xF1, 0xC1, 0xD1, 0xE1, 0x08, 0xD9,                         // POP AF...HL; EX AF,AF'; EXX
+               0xF1, 0xC1, 0xD1, 0xE1, 0xFB, 0xC9});                       // POP AF...HL; EI; RET
+  // ENASLT para slots nao expandidos: troca na porta A8 os 2 bits da
+  // pagina de H pelo slot de A.
+  poe(0x1040, {0xC5, 0xD5, 0xE6, 0x03, 0x5F,       // PUSH BC; PUSH DE; AND 3; LD E,A
+               0x7C, 0x07, 0x07, 0xE6, 0x03, 0x47, // LD A,H; RLCA; RLCA; AND 3; LD B,A
+               0x16, 0x03, 0xB7, 0x28, 0x0A,       // LD D,3; OR A; JR Z,pronto
+               0xCB, 0x23, 0xCB, 0x23,             // laco: SLA E; SLA E
+               0xCB, 0x22, 0xCB, 0x22, 0x10, 0xF6, // SLA D; SLA D; DJNZ laco
+               0xDB, 0xA8, 0x4F, 0x7A, 0x2F,       // pronto: IN A,(A8h); LD C,A; LD A,D; CPL
+               0xA1, 0xB3, 0xD3, 0xA8,             // AND C; OR E; OUT (A8h),A
+               0xD1, 0xC1, 0xC9});                 // POP DE; POP BC; RET
+  // FILVRM: A em BC bytes da VRAM a partir de HL.
+  poe(0x1070, {0xD5, 0x5F, 0xCD, 0xD0, 0x10, 0x7B, // PUSH DE; LD E,A; CALL SETWRT; LD A,E
+               0xD3, 0x98, 0x0B, 0x78, 0xB1,       // laco: OUT (98h),A; DEC BC; LD A,B; OR C
+               0x7B, 0x20, 0xF8, 0xD1, 0xC9});     // LD A,E; JR NZ,laco; POP DE; RET
+  // LDIRMV: BC bytes da VRAM em HL para a RAM em DE.
+  poe(0x1090, {0xCD, 0xE0, 0x10,                   // CALL SETRD
+               0xDB, 0x98, 0x12, 0x13, 0x0B,       // laco: IN A,(98h); LD (DE),A; INC DE; DEC BC
+               0x78, 0xB1, 0x20, 0xF7, 0xC9});     // LD A,B; OR C; JR NZ,laco; RET
+  // LDIRVM: BC bytes da RAM em HL para a VRAM em DE.
+  poe(0x10B0, {0xEB, 0xCD, 0xD0, 0x10, 0xEB,       // EX DE,HL; CALL SETWRT; EX DE,HL
+               0x7E, 0xD3, 0x98, 0x23, 0x0B,       // laco: LD A,(HL); OUT (98h),A; INC HL; DEC BC
+               0x78, 0xB1, 0x20, 0xF7, 0xC9});     // LD A,B; OR C; JR NZ,laco; RET
+  // SETWRT e SETRD: endereco HL no VDP.
+  poe(0x10D0, {0x7D, 0xD3, 0x99, 0x7C, 0xE6, 0x3F, 0xF6, 0x40, 0xD3, 0x99, 0xC9});
+  poe(0x10E0, {0x7D, 0xD3, 0x99, 0x7C, 0xE6, 0x3F, 0xD3, 0x99, 0xC9});
+  // RDVRM, WRTVRM, WRTVDP (C no registrador B).
+  poe(0x10F0, {0xCD, 0xE0, 0x10, 0xDB, 0x98, 0xC9});
+  poe(0x1100, {0xF5, 0xCD, 0xD0, 0x10, 0xF1, 0xD3, 0x98, 0xC9});
+  poe(0x1110, {0x78, 0xD3, 0x99, 0x79, 0xF6, 0x80, 0xD3, 0x99, 0xC9});
+  // WRTPSG (E no registrador A), RDPSG, DCOMPR.
+  poe(0x1120, {0xD3, 0xA0, 0xF5, 0x7B, 0xD3, 0xA1, 0xF1, 0xC9});
+  poe(0x1130, {0xD3, 0xA0, 0xDB, 0xA2, 0xC9});
+  poe(0x1140, {0x7C, 0x92, 0xC0, 0x7D, 0x93, 0xC9});
+  poe(voltaInit, {0xFB, 0x76, 0x18, 0xFC});
+}
+
+MaquinaTeste::MaquinaTeste()
+    : cpu(*this), mapeador(mapeadorLinear), bios(), ram(), vazia(), descarte(), leituraSlot(), escritaSlot(),
+      slots(0), vram(), registradoresVdp(), statusVdp(0), latchVdp(0), segundoByte(false), enderecoVram(0),
+      leituraVram(0), escritasVram(0), registradoresPsg(), registradorPsg(0), linhaTeclado(0) {
+  montarBios(bios);
+  std::fill_n(vazia, sizeof(vazia), 0xFF);
+  for(unsigned s = 0; s < 4; s++)
+    for(unsigned p = 0; p < 8; p++) {
+      leituraSlot[s][p] = vazia;
+      escritaSlot[s][p] = descarte;
+    }
+  for(unsigned p = 0; p < 4; p++)
+    leituraSlot[0][p] = bios + p * 0x2000;
+  for(unsigned p = 0; p < 8; p++)
+    leituraSlot[3][p] = escritaSlot[3][p] = ram + p * 0x2000;
+}
+
+bool MaquinaTeste::carregar(const uint8_t *dados, size_t tamanho, MapeadorRom mapeador) {
+  if(tamanho < 0x10 || mapeador > mapeadorASCII16)
+    return false;
+  this->mapeador = mapeador;
+  // Em bancos de 8 KB inteiros.
+  rom.assign(dados, dados + tamanho);
+  rom.resize((tamanho + 0x1FFF) & ~size_t(0x1FFF), 0xFF);
+  size_t bancos = rom.size() / 0x2000;
+
+  // Lineares comecam em #4000, ou em #0000 se o cabecalho estiver no
+  // segundo bloco de 16 KB; as de ate' 16 KB se repetem em #8000.
+  const uint8_t *cabecalho = rom.data();
+  if(mapeador == mapeadorLinear) {
+    unsigned primeira = 2;
+    if((rom[0] != 'A' || rom[1] != 'B') && rom.size() > 0x4000 && rom[0x4000] == 'A' && rom[0x4001] == 'B') {
+      primeira = 0;
+      cabecalho += 0x4000;
+    }
+    for(unsigned p = primeira, b = 0; p < 8 && b < bancos; p++, b++)
+      leituraSlot[1][p] = rom.data() + b * 0x2000;
+    if(rom.size() <= 0x4000 && primeira == 2)
+      for(unsigned p = 4; p < 6; p++)
+        leituraSlot[1][p] = leituraSlot[1][p - 2];
+  } else {
+    for(unsigned p = 2; p < 6; p++) {
+      escritaSlot[1][p] = nullptr;
+      trocarBanco(p, mapeador == mapeadorASCII16 ? p & 1 : p - 2);
+    }
+  }
+  uint16_t init = uint16_t(cabecalho[2] | (cabecalho[3] << 8));
+  if(cabecalho[0] != 'A' || cabecalho[1] != 'B' || init < 0x4000)
+    return false;
+
+  // Como a BIOS chama o INIT: cartucho na pagina 1, RAM nas 2 e 3.
+  std::fill(ram + 0xFD9A, ram + 0xFFCA, 0xC9);
+  slots = 0xF4;
+  mapear();
+  cpu.reiniciar();
+  RegistradoresZ80 &regs = cpu.getRegistradores();
+  regs.sp = 0xF37E;
+  ram[0xF37E] = uint8_t(voltaInit);
+  ram[0xF37F] = uint8_t(voltaInit >> 8);
+  regs.pc = init;
+  regs.im = 1;
+  regs.iff1 = regs.iff2 = true;
+  return true;
+}
+
+void MaquinaTeste::rodar(unsigned quadros) {
+  for(unsigned q = 0; q < quadros; q++) {
+    uint64_t fim = (cpu.getCiclos() / ciclosQuadro + 1) * ciclosQuadro;
+    cpu.executar(fim - cpu.getCiclos());
+    statusVdp |= 0x80;
+    atualizarInt();
+    if(getTravada() || getPerdida())
+      break;
+  }
+}
+
+bool MaquinaTeste::getTravada() {
+  return cpu.getParado() && !cpu.getRegistradores().iff1;
+}
+
+bool MaquinaTeste::getPerdida() {
+  return leitura[cpu.getRegistradores().pc >> 13] == vazia;
+}
+
+bool MaquinaTeste::getVoltou() {
+  uint16_t pc = cpu.getRegistradores().pc;
+  return pc >= voltaInit && pc < voltaInit + 4 && leitura[0] == bios;
+}
+
+uint64_t MaquinaTeste::getCiclos() const {
+  return cpu.getCiclos();
+}
+
+uint64_t MaquinaTeste::getEscritasVram() const {
+  return escritasVram;
+}
+
+void MaquinaTeste::mapear() {
+  for(unsigned p = 0; p < 8; p++) {
+    unsigned slot = (slots >> (p / 2 * 2)) & 3;
+    leitura[p] = leituraSlot[slot][p];
+    escrita[p] = escritaSlot[slot][p];
+  }
+}
+
+void MaquinaTeste::trocarBanco(unsigned pagina, unsigned banco) {
+  leituraSlot[1][pagina] = rom.data() + (banco % (rom.size() / 0x2000)) * 0x2000;
+  if(((slots >> (pagina / 2 * 2)) & 3) == 1)
+    leitura[pagina] = leituraSlot[1][pagina];
+}
+
+// So' chegam aqui as escritas nas paginas #4000-#BFFF de um cartucho com
+// mapeador.
+void MaquinaTeste::escrever(uint16_t endereco, uint8_t valor) {
+  switch(mapeador) {
+    case mapeadorGenerico8:
+      trocarBanco(endereco >> 13, valor);
+      break;
+    case mapeadorKonami:
+      if(endereco >= 0x6000)
+        trocarBanco(endereco >> 13, valor);
+      break;
+    case mapeadorKonamiSCC:
+      if((endereco & 0x1800) == 0x1000)
+        trocarBanco(endereco >> 13, valor);
+      break;
+    case mapeadorASCII8:
+      if(endereco >= 0x6000 && endereco < 0x8000)
+        trocarBanco(2 + ((endereco >> 11) & 3), valor);
+      break;
+    case mapeadorASCII16:
+      if(endereco >= 0x6000 && endereco < 0x7800 && !(endereco & 0x0800)) {
+        unsigned pagina = endereco < 0x7000 ? 2 : 4;
+        trocarBanco(pagina, valor * 2u);
+        trocarBanco(pagina + 1, valor * 2u + 1);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+uint8_t MaquinaTeste::entrada(uint16_t porta) {
+  switch(porta & 0xFF) {
+    case 0x98: {
+      uint8_t valor = leituraVram;
+      leituraVram = vram[enderecoVram];
+      enderecoVram = (enderecoVram + 1) & 0x3FFF;
+      segundoByte = false;
+      return valor;
+    }
+    case 0x99: {
+      uint8_t valor = statusVdp;
+      statusVdp &= 0x1F;
+      segundoByte = false;
+      atualizarInt();
+      return valor;
+    }
+    case 0xA2:
+      // Joystick sem nada apertado.
+      return registradorPsg == 14 ? 0x3F : registradoresPsg[registradorPsg & 15];
+    case 0xA8:
+      return slots;
+    case 0xA9:
+      return 0xFF;
+    case 0xAA:
+      return linhaTeclado;
+  }
+  return 0xFF;
+}
+
+void MaquinaTeste::saida(uint16_t porta, uint8_t valor) {
+  switch(porta & 0xFF) {
+    case 0x98:
+      vram[enderecoVram] = valor;
+      leituraVram = valor;
+      enderecoVram = (enderecoVram + 1) & 0x3FFF;
+      segundoByte = false;
+      escritasVram++;
+      break;
+    case 0x99:
+      if(!segundoByte) {
+        latchVdp = valor;
+        segundoByte = true;
+        break;
+      }
+      segundoByte = false;
+      if(valor & 0x80) {
+        registradoresVdp[valor & 7] = latchVdp;
+        atualizarInt();
+      } else {
+        enderecoVram = uint16_t((latchVdp | (valor << 8)) & 0x3FFF);
+        if(!(valor & 0x40)) {
+          leituraVram = vram[enderecoVram];
+          enderecoVram = (enderecoVram + 1) & 0x3FFF;
+        }
+      }
+      break;
+    case 0xA0:
+      registradorPsg = valor;
+      break;
+    case 0xA1:
+      registradoresPsg[registradorPsg & 15] = valor;
+      break;
+    case 0xA8:
+      slots = valor;
+      mapear();
+      break;
+    case 0xAA:
+      linhaTeclado = valor;
+      break;
+  }
+}
+
+// A linha INT do VDP: fim de quadro com o IE0 (bit 5 do R#1) ligado.
+void MaquinaTeste::atualizarInt() {
+  cpu.setInt((statusVdp & 0x80) && (registradoresVdp[1] & 0x20));
+}
+
+const char *nomeEstado(EstadoTeste estado) {
+  static const char *const nomes[] = {"rodando", "travado", "perdido", "voltou", "invalido"};
+  return nomes[estado];
+}
+
+bool testarRom(const MSX &msx, std::string arquivo, unsigned quadros, ResultadoTeste &resultado) {
+  ArquivoMapeado mapa;
+
+  resultado.arquivo = arquivo;
+  resultado.lido = mapa.abrir(arquivo);
+  resultado.estado = testeInvalido;
+  resultado.ciclos = resultado.escritasVram = 0;
+  resultado.segundos = 0;
+  if(!resultado.lido)
+    return false;
+  mapa.setSequencial(true);
+  const uint8_t *dados = mapa.getDados();
+  size_t tamanho = size_t(mapa.getTamanho());
+  resultado.mapeador = msx.detectarMapeador(dados, tamanho);
+
+  auto inicio = std::chrono::steady_clock::now();
+  std::unique_ptr<MaquinaTeste> maquina(new MaquinaTeste());
+  if(maquina->carregar(dados, tamanho, resultado.mapeador)) {
+    mapa.fechar();
+    maquina->rodar(quadros);
+    resultado.estado = maquina->getTravada() ? testeTravado
+                       : maquina->getPerdida() ? testePerdido
+                       : maquina->getVoltou() ? testeVoltou
+                       : testeRodando;
+    resultado.ciclos = maquina->getCiclos();
+    resultado.escritasVram = maquina->getEscritasVram();
+  }
+  resultado.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  return true;
+}
+
+bool testarLote(const MSX &msx, std::string padrao, unsigned quadros, unsigned threads,
+                std::vector<ResultadoTeste> &resultado) {
+  glob_t g;
+
+  resultado.clear();
+  if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0)
+    return false;
+  resultado.resize(g.gl_pathc);
+  for(size_t i = 0; i < g.gl_pathc; i++)
+    resultado[i].arquivo = g.gl_pathv[i];
+  globfree(&g);
+
+  // Cada tarefa so' escreve na sua posicao do resultado.
+  std::atomic<uint64_t> falhas(0);
+  {
+    PoolTarefas pool(threads);
+    for(ResultadoTeste &r : resultado)
+      pool.adicionar([&msx, &r, quadros, &falhas] {
+        if(!testarRom(msx, r.arquivo, quadros, r))
+          falhas++;
+      });
+    pool.esperar();
+  }
+  return falhas == 0;
+}
@@ -0,0 +1,312 @@
+#include <algorithm>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "busca.h"
+
+// Cada thread pega blocos deste tamanho ate' o documento acabar.
+static const uint64_t tamanhoBloco = 8 << 20;
+
+// Caracteres 0x80-0xAF do conjunto internacional do MSX, em Unicode.
+static const uint16_t caracteresMSX[48] = {
+  0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+  0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+  0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+  0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+  0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+  0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB
+};
+
+static int valorNibble(char c) {
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return c == '?' ? 16 : -1;
+}
+
+bool padraoHex(const std::string &texto, Padrao &padrao) {
+  int nibbles[2];
+  int n = 0;
+
+  padrao.valor.clear();
+  padrao.mascara.clear();
+  for(char c : texto) {
+    if(c == ' ' || c == '\t') {
+      if(n == 1)
+        return false;
+      continue;
+    }
+    if((nibbles[n++] = valorNibble(c)) < 0)
+      return false;
+    if(n == 2) {
+      uint8_t valor = 0, mascara = 0;
+      for(int i = 0; i < 2; i++) {
+        valor <<= 4;
+        mascara <<= 4;
+        if(nibbles[i] != 16) {
+          valor |= nibbles[i];
+          mascara |= 0x0F;
+        }
+      }
+      padrao.valor.push_back(valor);
+      padrao.mascara.push_back(mascara);
+      n = 0;
+    }
+  }
+  return n == 0 && !padrao.valor.empty();
+}
+
+bool padraoTexto(const std::string &texto, Padrao &padrao) {
+  padrao.valor.clear();
+  padrao.mascara.clear();
+  for(size_t i = 0; i < texto.size(); ) {
+    uint8_t c = uint8_t(texto[i]);
+    uint32_t codigo;
+    int extra;
+
+    if(c < 0x80) {
+      codigo = c;
+      extra = 0;
+    } else if((c & 0xE0) == 0xC0) {
+      codigo = c & 0x1F;
+      extra = 1;
+    } else if((c & 0xF0) == 0xE0) {
+      codigo = c & 0x0F;
+      extra = 2;
+    } else {
+      return false;
+    }
+    if(extra && i + extra >= texto.size())
+      return false;
+    for(int j = 1; j <= extra; j++)
+      codigo = (codigo << 6) | (uint8_t(texto[i + j]) & 0x3F);
+    i += extra + 1;
+
+    if(codigo >= 0x80) {
+      const uint16_t *p = std::find(caracteresMSX, caracteresMSX + 48, codigo);
+      if(p == caracteresMSX + 48)
+        return false;
+      codigo = 0x80 + uint32_t(p - caracteresMSX);
+    }
+    padrao.valor.push_back(uint8_t(codigo));
+    padrao.mascara.push_back(0xFF);
+  }
+  return !padrao.valor.empty();
+}
+
+// Dois bytes do padrao usados para filtrar candidatos antes da comparacao
+// completa: o primeiro e o ultimo com mascara cheia, se houver.
+struct Ancora {
+  uint64_t k1, k2;
+  uint8_t v1, m1, v2, m2;
+};
+
+static Ancora escolherAncora(const Padrao &padrao) {
+  Ancora a{0, 0, 0, 0, 0, 0};
+  uint64_t m = padrao.valor.size();
+  bool achou = false;
+
+  for(uint64_t j = 0; j < m && !achou; j++)
+    if(padrao.mascara[j] == 0xFF) {
+      a.k1 = j;
+      achou = true;
+    }
+  for(uint64_t j = 0; j < m && !achou; j++)
+    if(padrao.mascara[j]) {
+      a.k1 = j;
+      achou = true;
+    }
+  a.k2 = a.k1;
+  for(uint64_t j = m; j-- > a.k1 + 1 && a.k2 == a.k1; )
+    if(padrao.mascara[j] == 0xFF)
+      a.k2 = j;
+  for(uint64_t j = m; j-- > a.k1 + 1 && a.k2 == a.k1; )
+    if(padrao.mascara[j])
+      a.k2 = j;
+  a.v1 = padrao.valor[a.k1];
+  a.m1 = padrao.mascara[a.k1];
+  a.v2 = padrao.valor[a.k2];
+  a.m2 = padrao.mascara[a.k2];
+  return a;
+}
+
+// As varreduras chamam f(i) para cada i em [de, ate) cujos dois bytes
+// ancora batem, e devolvem ate' onde foram. d[i + k2] precisa ser valido.
+template<class F> static uint64_t varrerEscalar(const uint8_t *d, uint64_t de, uint64_t ate,
+                                                const Ancora &a, F &f) {
+  for(uint64_t i = de; i < ate; i++)
+    if((d[i + a.k1] & a.m1) == a.v1 && (d[i + a.k2] & a.m2) == a.v2)
+      f(i);
+  return ate;
+}
+
+#ifdef __SSE2__
+template<class F> static uint64_t varrerSSE2(const uint8_t *d, uint64_t de, uint64_t ate,
+                                             const Ancora &a, F &f) {
+  const __m128i v1 = _mm_set1_epi8(char(a.v1)), m1 = _mm_set1_epi8(char(a.m1));
+  const __m128i v2 = _mm_set1_epi8(char(a.v2)), m2 = _mm_set1_epi8(char(a.m2));
+  uint64_t i = de;
+
+  for(; i + 16 <= ate; i += 16) {
+    __m128i x = _mm_and_si128(_mm_loadu_si128((const __m128i *) (d + i + a.k1)), m1);
+    __m128i y = _mm_and_si128(_mm_loadu_si128((const __m128i *) (d + i + a.k2)), m2);
+    unsigned bits = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, v1), _mm_cmpeq_epi8(y, v2)));
+    while(bits) {
+      f(i + __builtin_ctz(bits));
+      bits &= bits - 1;
+    }
+  }
+  return i;
+}
+
+template<class F> __attribute__((target("avx2")))
+static uint64_t varrerAVX2(const uint8_t *d, uint64_t de, uint64_t ate, const Ancora &a, F &f) {
+  const __m256i v1 = _mm256_set1_epi8(char(a.v1)), m1 = _mm256_set1_epi8(char(a.m1));
+  const __m256i v2 = _mm256_set1_epi8(char(a.v2)), m2 = _mm256_set1_epi8(char(a.m2));
+  uint64_t i = de;
+
+  for(; i + 32 <= ate; i += 32) {
+    __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (d + i + a.k1)), m1);
+    __m256i y = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (d + i + a.k2)), m2);
+    uint32_t bits = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, v1),
+                                                                      _mm256_cmpeq_epi8(y, v2)));
+    while(bits) {
+      f(i + __builtin_ctz(bits));
+      bits &= bits - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+template<class F> static void varrer(const uint8_t *d, uint64_t n, const Ancora &a, F f) {
+  uint64_t i = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = varrerAVX2(d, i, n, a, f);
+  i = varrerSSE2(d, i, n, a, f);
+#endif
+  varrerEscalar(d, i, n, a, f);
+}
+
+Busca::Busca() : pecas(nullptr), proximoBloco(0), varridos(0), ativas(0), parar(false), total(0) {
+}
+
+Busca::~Busca() {
+  cancelar();
+}
+
+void Busca::cancelar() {
+  parar = true;
+  for(std::thread &t : threads)
+    t.join();
+  threads.clear();
+}
+
+void Busca::iniciar(const TabelaPecas &pecas, const Padrao &padrao, unsigned nThreads) {
+  cancelar();
+
+  this->pecas = &pecas;
+  this->padrao = padrao;
+  total = pecas.getTamanho();
+  proximoBloco = 0;
+  varridos = 0;
+  parar = false;
+  lista.clear();
+  if(padrao.valor.empty())
+    return;
+
+  if(!nThreads)
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  nThreads = (unsigned) std::min<uint64_t>(nThreads, total / tamanhoBloco + 1);
+  ativas = nThreads;
+  for(unsigned i = 0; i < nThreads; i++)
+    threads.emplace_back(&Busca::trabalhar, this);
+}
+
+bool Busca::rodando() const {
+  return ativas > 0;
+}
+
+uint64_t Busca::getProgresso() const {
+  return varridos;
+}
+
+uint64_t Busca::getTotal() const {
+  return total;
+}
+
+size_t Busca::getQuantidade() const {
+  std::lock_guard<std::mutex> l(trava);
+  return lista.size();
+}
+
+size_t Busca::resultados(std::vector<uint64_t> &destino, size_t de) const {
+  std::lock_guard<std::mutex> l(trava);
+  if(de < lista.size())
+    destino.insert(destino.end(), lista.begin() + de, lista.end());
+  return lista.size();
+}
+
+void Busca::trabalhar() {
+  std::vector<uint64_t> achados;
+
+  while(!parar) {
+    uint64_t inicio = proximoBloco++ * tamanhoBloco;
+    if(inicio >= total)
+      break;
+    uint64_t fim = std::min(total, inicio + tamanhoBloco);
+
+    achados.clear();
+    buscarBloco(inicio, fim, achados);
+    if(!achados.empty()) {
+      std::lock_guard<std::mutex> l(trava);
+      lista.insert(lista.end(), achados.begin(), achados.end());
+    }
+    varridos += fim - inicio;
+  }
+  ativas--;
+}
+
+void Busca::buscarBloco(uint64_t inicio, uint64_t fim, std::vector<uint64_t> &achados) {
+  const uint64_t m = padrao.valor.size();
+  const uint8_t *valor = padrao.valor.data();
+  const uint8_t *mascara = padrao.mascara.data();
+  const Ancora ancora = escolherAncora(padrao);
+  std::vector<uint8_t> janela(m);
+
+  if(m > total)
+    return;
+  fim = std::min(fim, total - m + 1);
+  if(inicio >= fim)
+    return;
+
+  // Inicios que cabem inteiros num trecho contiguo sao varridos direto na
+  // memoria; os que atravessam o fim do trecho sao lidos pela tabela.
+  pecas->paraCadaTrecho(inicio, fim - inicio + m - 1, [&](uint64_t pos, const uint8_t *d, uint64_t n) {
+    uint64_t limite = std::min(pos + n, fim);
+    uint64_t dentro = n >= m ? std::min(pos + n - m + 1, limite) : pos;
+
+    if(dentro > pos)
+      varrer(d, dentro - pos, ancora, [&](uint64_t i) {
+        for(uint64_t j = 0; j < m; j++)
+          if((d[i + j] & mascara[j]) != valor[j])
+            return;
+        achados.push_back(pos + i);
+      });
+    for(uint64_t s = std::max(pos, dentro); s < limite; s++) {
+      pecas->ler(s, janela.data(), m);
+      uint64_t j = 0;
+      while(j < m && (janela[j] & mascara[j]) == valor[j])
+        j++;
+      if(j == m)
+        achados.push_back(s);
+    }
+  });
+}
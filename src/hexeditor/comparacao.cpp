@@ -0,0 +1,195 @@
+#include <algorithm>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "comparacao.h"
+
+static const uint64_t tamanhoBloco = 16 << 20;
+
+// Primeira posicao em [i, fim) onde os bytes diferem (igual = false) ou
+// coincidem (igual = true); fim se nao houver.
+static uint64_t procurarEscalar(const uint8_t *a, const uint8_t *b, uint64_t i, uint64_t fim, bool igual) {
+  while(i < fim && (a[i] == b[i]) != igual)
+    i++;
+  return i;
+}
+
+#ifdef __SSE2__
+static uint64_t procurarSSE2(const uint8_t *a, const uint8_t *b, uint64_t i, uint64_t fim, bool igual) {
+  const unsigned alvo = igual ? 0 : 0xFFFF;
+
+  for(; i + 16 <= fim; i += 16) {
+    unsigned m = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                                             _mm_loadu_si128((const __m128i *) (b + i))));
+    if(m != alvo)
+      return i + __builtin_ctz(igual ? m : ~m);
+  }
+  return procurarEscalar(a, b, i, fim, igual);
+}
+
+__attribute__((target("avx2")))
+static uint64_t procurarAVX2(const uint8_t *a, const uint8_t *b, uint64_t i, uint64_t fim, bool igual) {
+  const uint32_t alvo = igual ? 0 : 0xFFFFFFFFu;
+
+  for(; i + 32 <= fim; i += 32) {
+    uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                                                   _mm256_loadu_si256((const __m256i *) (b + i))));
+    if(m != alvo)
+      return i + __builtin_ctz(igual ? m : ~m);
+  }
+  return procurarSSE2(a, b, i, fim, igual);
+}
+#endif
+
+static uint64_t procurar(const uint8_t *a, const uint8_t *b, uint64_t i, uint64_t fim, bool igual) {
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  return temAVX2 ? procurarAVX2(a, b, i, fim, igual) : procurarSSE2(a, b, i, fim, igual);
+#else
+  return procurarEscalar(a, b, i, fim, igual);
+#endif
+}
+
+Comparacao::Comparacao()
+  : a(nullptr), b(nullptr), comum(0), total(0), proximoBloco(0), comparados(0), ativas(0),
+    parar(false), terminada(false) {
+}
+
+Comparacao::~Comparacao() {
+  cancelar();
+}
+
+void Comparacao::cancelar() {
+  parar = true;
+  for(std::thread &t : threads)
+    t.join();
+  threads.clear();
+}
+
+void Comparacao::iniciar(const uint8_t *a, uint64_t tamanhoA, const uint8_t *b, uint64_t tamanhoB,
+                         unsigned nThreads) {
+  cancelar();
+
+  this->a = a;
+  this->b = b;
+  comum = std::min(tamanhoA, tamanhoB);
+  total = std::max(tamanhoA, tamanhoB);
+  faixas.clear();
+  blocos.assign((comum + tamanhoBloco - 1) / tamanhoBloco, std::vector<Faixa>());
+  proximoBloco = 0;
+  comparados = 0;
+  parar = false;
+  terminada = false;
+
+  if(blocos.empty()) {
+    juntar();
+    return;
+  }
+  if(!nThreads)
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  nThreads = (unsigned) std::min<uint64_t>(nThreads, blocos.size());
+  ativas = nThreads;
+  for(unsigned i = 0; i < nThreads; i++)
+    threads.emplace_back(&Comparacao::trabalhar, this);
+}
+
+void Comparacao::trabalhar() {
+  uint64_t n;
+
+  while(!parar && (n = proximoBloco++) < blocos.size()) {
+    uint64_t i = n * tamanhoBloco;
+    uint64_t fim = std::min(comum, i + tamanhoBloco);
+    std::vector<Faixa> &lista = blocos[n];
+
+    while(i < fim) {
+      if((i = procurar(a, b, i, fim, false)) == fim)
+        break;
+      uint64_t j = procurar(a, b, i, fim, true);
+      lista.push_back(Faixa{i, j});
+      i = j;
+    }
+    comparados += std::min(comum, n * tamanhoBloco + tamanhoBloco) - n * tamanhoBloco;
+  }
+
+  // A ultima thread a sair monta o indice.
+  if(--ativas == 0 && !parar)
+    juntar();
+}
+
+void Comparacao::juntar() {
+  size_t n = 0;
+
+  for(const std::vector<Faixa> &lista : blocos)
+    n += lista.size();
+  faixas.reserve(n + 1);
+
+  // Faixas que atravessam a fronteira de um bloco chegam partidas em duas.
+  for(std::vector<Faixa> &lista : blocos) {
+    for(const Faixa &f : lista)
+      if(!faixas.empty() && faixas.back().fim == f.inicio)
+        faixas.back().fim = f.fim;
+      else
+        faixas.push_back(f);
+    std::vector<Faixa>().swap(lista);
+  }
+  if(total > comum) {
+    if(!faixas.empty() && faixas.back().fim == comum)
+      faixas.back().fim = total;
+    else
+      faixas.push_back(Faixa{comum, total});
+  }
+  comparados = comum;
+  terminada = true;
+}
+
+bool Comparacao::pronta() const {
+  return terminada;
+}
+
+uint64_t Comparacao::getProgresso() const {
+  return comparados;
+}
+
+uint64_t Comparacao::getTotal() const {
+  return comum;
+}
+
+const std::vector<Comparacao::Faixa> &Comparacao::getFaixas() const {
+  return faixas;
+}
+
+uint64_t Comparacao::getBytesDiferentes() const {
+  uint64_t n = 0;
+
+  for(const Faixa &f : faixas)
+    n += f.fim - f.inicio;
+  return n;
+}
+
+static bool antesDe(uint64_t pos, const Comparacao::Faixa &f) {
+  return pos < f.inicio;
+}
+
+bool Comparacao::diferente(uint64_t pos) const {
+  std::vector<Faixa>::const_iterator i = std::upper_bound(faixas.begin(), faixas.end(), pos, antesDe);
+  return i != faixas.begin() && pos < (i - 1)->fim;
+}
+
+bool Comparacao::proxima(uint64_t pos, uint64_t &destino) const {
+  std::vector<Faixa>::const_iterator i = std::upper_bound(faixas.begin(), faixas.end(), pos, antesDe);
+  if(i == faixas.end())
+    return false;
+  destino = i->inicio;
+  return true;
+}
+
+bool Comparacao::anterior(uint64_t pos, uint64_t &destino) const {
+  std::vector<Faixa>::const_iterator i = std::upper_bound(faixas.begin(), faixas.end(), pos, antesDe);
+  if(i != faixas.begin() && (i - 1)->inicio == pos)
+    --i;
+  if(i == faixas.begin())
+    return false;
+  destino = (i - 1)->inicio;
+  return true;
+}
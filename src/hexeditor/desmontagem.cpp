@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "desmontagem.h"
+
+// Quantos blocos um ponto novo pode continuar de um anterior antes de
+// preferir recuar e ressincronizar.
+static const uint64_t cadeiaMaxima = 16;
+// Bytes antes do bloco usados para ressincronizar.
+static const uint64_t recuo = 16;
+
+Desmontagem::Desmontagem(uint16_t org, uint64_t passo) : org(org), passo(passo) {
+}
+
+uint16_t Desmontagem::getOrg() const {
+  return org;
+}
+
+void Desmontagem::invalidar(uint64_t pos) {
+  // Uma instrucao que comeca ate' 3 bytes antes tambem muda.
+  uint64_t bloco = (pos >= 3 ? pos - 3 : 0) / passo;
+
+  if(bloco < pontos.size())
+    std::fill(pontos.begin() + long(bloco), pontos.end(), semPonto);
+}
+
+uint8_t Desmontagem::tamanhoEm(const uint8_t *p, size_t n, uint64_t pos) const {
+  return desmontador.decodificar(p, n, uint16_t(org + pos)).tamanho;
+}
+
+uint64_t Desmontagem::ponto(const TabelaPecas &pecas, uint64_t bloco) {
+  uint64_t tamanho = pecas.getTamanho();
+
+  if(pontos.size() != tamanho / passo + 1)
+    pontos.resize(tamanho / passo + 1, semPonto);
+  if(bloco == 0)
+    return 0;
+  if(pontos[bloco] != semPonto)
+    return bloco * passo + pontos[bloco];
+
+  uint64_t k = bloco - 1;
+  while(k > 0 && pontos[k] == semPonto && bloco - k < cadeiaMaxima)
+    k--;
+  uint64_t atual;
+  if(k == 0)
+    atual = 0;
+  else if(pontos[k] != semPonto)
+    atual = k * passo + pontos[k];
+  else
+    atual = bloco * passo - std::min(recuo, passo);
+
+  uint64_t alvo = bloco * passo;
+  uint64_t inicio = atual;
+  uint64_t ultimoBloco = atual / passo;
+  buffer.resize(size_t(std::min(tamanho, alvo + 4) - inicio));
+  size_t n = size_t(pecas.ler(inicio, buffer.data(), buffer.size()));
+
+  // Marca a primeira fronteira de cada bloco que a decodificacao atravessa.
+  while(atual < alvo && atual - inicio < n) {
+    size_t i = size_t(atual - inicio);
+    atual += tamanhoEm(buffer.data() + i, n - i, atual);
+    if(atual / passo > ultimoBloco) {
+      ultimoBloco = atual / passo;
+      if(ultimoBloco < pontos.size())
+        pontos[ultimoBloco] = uint16_t(atual - ultimoBloco * passo);
+    }
+  }
+  return atual;
+}
+
+uint64_t Desmontagem::inicio(const TabelaPecas &pecas, uint64_t pos) {
+  if(pos >= pecas.getTamanho())
+    return pecas.getTamanho();
+
+  uint64_t bloco = pos / passo;
+  uint64_t atual = ponto(pecas, bloco);
+  if(atual > pos)
+    atual = ponto(pecas, bloco - 1);
+
+  uint64_t de = atual;
+  buffer.resize(size_t(pos + 4 - de));
+  size_t n = size_t(pecas.ler(de, buffer.data(), buffer.size()));
+  for(;;) {
+    size_t i = size_t(atual - de);
+    uint64_t seguinte = atual + tamanhoEm(buffer.data() + i, n - i, atual);
+    if(seguinte > pos)
+      return atual;
+    atual = seguinte;
+  }
+}
+
+uint64_t Desmontagem::anterior(const TabelaPecas &pecas, uint64_t pos) {
+  return pos ? inicio(pecas, pos - 1) : 0;
+}
+
+void Desmontagem::linhas(const TabelaPecas &pecas, uint64_t pos, unsigned n, std::vector<LinhaDesmontagem> &saida) {
+  saida.clear();
+  buffer.resize(size_t(n) * 4);
+  size_t lidos = size_t(pecas.ler(pos, buffer.data(), buffer.size()));
+
+  for(size_t i = 0; i < lidos && saida.size() < n;) {
+    LinhaDesmontagem linha;
+    InstrucaoZ80 instrucao;
+    linha.posicao = pos + i;
+    linha.comprimento = uint8_t(desmontador.formatar(buffer.data() + i, lidos - i, uint16_t(org + pos + i),
+                                                     linha.texto, &instrucao));
+    linha.tamanho = instrucao.tamanho;
+    std::copy(buffer.begin() + long(i), buffer.begin() + long(i + instrucao.tamanho), linha.bytes);
+    saida.push_back(linha);
+    i += instrucao.tamanho;
+  }
+}
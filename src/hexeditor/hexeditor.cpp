@@ -1,17 +1,759 @@
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <final/final.h>
 #include <string>
+#include <vector>
 
 using std::string;
 using std::endl;
 using std::cout;
 using std::cin;
 
+using namespace finalcut;
+
+#include "busca.h"
+#include "comparacao.h"
+#include "desmontagem.h"
 #include "hexeditor.h"
+#include "historico.h"
+#include "mapeamento.h"
+#include "tabelapecas.h"
+
+// Mostra o arquivo em linhas de 16 bytes. So' as linhas visiveis sao lidas,
+// entao so' as paginas mostradas na tela sao carregadas pelo kernel. As
+// edicoes ficam na tabela de pecas ate' o arquivo ser salvo, e cada uma
+// passa pelo historico para poder ser desfeita. Ctrl-F busca bytes ("CD ?? C9")
+// ou texto entre aspas, em segundo plano; F3 e Ctrl-P andam pelos resultados.
+// F4 troca para a desmontagem Z80 a partir da mesma posicao, decodificando
+// so' as instrucoes da tela.
+class VisaoHex : public FWidget {
+  public:
+    VisaoHex(ArquivoMapeado &&arquivo, string nome, uint64_t orcamentoHistorico,
+             FWidget *parent = nullptr);
+  private:
+    static const uint64_t bytesLinha = 16;
+
+    void draw() override;
+    void desenharHex(uint64_t linhas);
+    void desenharDesmontagem(uint64_t linhas);
+    void onKeyPress(FKeyEvent *ev) override;
+    void onTimer(FTimerEvent *ev) override;
+    uint64_t linhasVisiveis();
+    void mover(int64_t delta);
+    bool teclaDesmontagem(FKeyEvent *ev);
+    void digitar(uint8_t nibble);
+    void trocar(uint64_t pos, uint64_t nRemover, const uint8_t *bytes, uint64_t n);
+    void editar(uint64_t pos, uint64_t nRemover, const uint8_t *bytes, uint64_t n);
+    void desfazer();
+    void refazer();
+    bool salvar();
+    void teclaBusca(FKeyEvent *ev);
+    void iniciarBusca();
+    void irParaResultado(bool proximo);
+
+    ArquivoMapeado mapa;
+    TabelaPecas pecas;
+    Historico historico;
+    string nome;
+    uint64_t topo;
+    uint64_t cursor;
+    bool meioByte;
+    bool insercao;
+    int digitos;
+    string aviso;
+
+    Busca busca;
+    std::vector<uint64_t> achados;
+    bool achadosOrdenados;
+    bool pedindoBusca;
+    string textoBusca;
+    int timerBusca;
+
+    Desmontagem desmontagem;
+    std::vector<LinhaDesmontagem> instrucoes;
+    bool desmontando;
+    uint64_t topoDesmontagem;
+};
+
+
+VisaoHex::VisaoHex(ArquivoMapeado &&arquivo, string nome, uint64_t orcamentoHistorico,
+                   FWidget *parent)
+  : FWidget(parent), mapa(std::move(arquivo)), pecas(mapa.getDados(), mapa.getTamanho()),
+    historico(orcamentoHistorico), nome(nome), topo(0), cursor(0), meioByte(false), insercao(false),
+    achadosOrdenados(true), pedindoBusca(false), timerBusca(0), desmontando(false), topoDesmontagem(0) {
+  digitos = mapa.getTamanho() > 0xFFFFFFFFULL ? 10 : 8;
+  setFocusable(true);
+}
+
+uint64_t VisaoHex::linhasVisiveis() {
+  // A ultima linha do widget e' a linha de estado.
+  return getHeight() > 1 ? getHeight() - 1 : 1;
+}
+
+void VisaoHex::desenharHex(uint64_t linhas) {
+  uint64_t tamanho = pecas.getTamanho();
+  std::vector<uint8_t> dados(linhas * bytesLinha);
+  char texto[32];
+
+  mapa.preparar(topo, dados.size());
+  pecas.ler(topo, dados.data(), dados.size());
+  for(uint64_t y = 0; y < linhas; y++) {
+    uint64_t endereco = topo + y * bytesLinha;
+
+    print() << FPoint{1, int(y) + 1};
+    if(endereco > tamanho || (endereco == tamanho && cursor != tamanho)) {
+      print() << string(getWidth(), ' ');
+      continue;
+    }
+
+    std::snprintf(texto, sizeof(texto), "%0*llX  ", digitos, (unsigned long long) endereco);
+    print() << texto;
+    for(uint64_t i = 0; i < bytesLinha; i++) {
+      if(endereco + i < tamanho)
+        std::snprintf(texto, sizeof(texto), "%02X", dados[y * bytesLinha + i]);
+      else
+        std::snprintf(texto, sizeof(texto), "  ");
+      if(endereco + i == cursor)
+        setReverse(true);
+      print() << texto;
+      if(endereco + i == cursor)
+        setReverse(false);
+      print() << (i == 7 ? "  " : " ");
+    }
+    print() << " ";
+    for(uint64_t i = 0; i < bytesLinha; i++) {
+      uint8_t b = dados[y * bytesLinha + i];
+      char c = ' ';
+      if(endereco + i < tamanho)
+        c = (b >= 0x20 && b < 0x7F) ? char(b) : '.';
+      if(endereco + i == cursor)
+        setReverse(true);
+      print() << c;
+      if(endereco + i == cursor)
+        setReverse(false);
+    }
+  }
+}
+
+void VisaoHex::desenharDesmontagem(uint64_t linhas) {
+  uint64_t atual = desmontagem.inicio(pecas, cursor);
+  char texto[32];
+
+  // A tela acompanha o cursor: acima do topo, ele vira o topo; abaixo da
+  // ultima linha, o topo recua instrucao por instrucao a partir dele.
+  if(atual < topoDesmontagem)
+    topoDesmontagem = atual;
+  desmontagem.linhas(pecas, topoDesmontagem, unsigned(linhas), instrucoes);
+  if(!instrucoes.empty() && atual > instrucoes.back().posicao) {
+    topoDesmontagem = atual;
+    for(uint64_t i = 1; i < linhas && topoDesmontagem; i++)
+      topoDesmontagem = desmontagem.anterior(pecas, topoDesmontagem);
+    desmontagem.linhas(pecas, topoDesmontagem, unsigned(linhas), instrucoes);
+  }
+
+  for(uint64_t y = 0; y < linhas; y++) {
+    print() << FPoint{1, int(y) + 1};
+    if(y >= instrucoes.size()) {
+      print() << string(getWidth(), ' ');
+      continue;
+    }
+
+    const LinhaDesmontagem &l = instrucoes[y];
+    std::snprintf(texto, sizeof(texto), "%0*llX  %04X  ", digitos, (unsigned long long) l.posicao,
+                  unsigned(uint16_t(desmontagem.getOrg() + l.posicao)));
+    string linha = texto;
+    for(unsigned i = 0; i < 4; i++) {
+      if(i < l.tamanho)
+        std::snprintf(texto, sizeof(texto), "%02X ", l.bytes[i]);
+      else
+        std::snprintf(texto, sizeof(texto), "   ");
+      linha += texto;
+    }
+    linha += " " + string(l.texto, l.comprimento);
+    if(linha.size() < getWidth())
+      linha.resize(getWidth(), ' ');
+
+    bool sobCursor = cursor >= l.posicao && cursor < l.posicao + l.tamanho;
+    if(sobCursor)
+      setReverse(true);
+    print() << linha;
+    if(sobCursor)
+      setReverse(false);
+  }
+}
+
+void VisaoHex::draw() {
+  uint64_t tamanho = pecas.getTamanho();
+  uint64_t linhas = linhasVisiveis();
+  char texto[32];
+
+  if(desmontando)
+    desenharDesmontagem(linhas);
+  else
+    desenharHex(linhas);
+
+  std::snprintf(texto, sizeof(texto), "%0*llX", digitos, (unsigned long long) cursor);
+  string estado = string(" Posicao: ") + texto;
+  std::snprintf(texto, sizeof(texto), "%llu", (unsigned long long) tamanho);
+  estado += string("  Tamanho: ") + texto + " bytes";
+  estado += insercao ? "  INS" : "  SOB";
+  if(desmontando)
+    estado += "  Z80";
+  if(pecas.getModificado())
+    estado += "  *";
+  if(busca.rodando()) {
+    std::snprintf(texto, sizeof(texto), "  Buscando %d%%",
+                  int(busca.getTotal() ? busca.getProgresso() * 100 / busca.getTotal() : 100));
+    estado += texto;
+  }
+  if(!achados.empty())
+    estado += "  Achados: " + std::to_string(achados.size());
+  if(pedindoBusca)
+    estado = " Buscar (hex ou \"texto\"): " + textoBusca + "_";
+  if(!aviso.empty())
+    estado += "  " + aviso;
+  if(estado.size() < getWidth())
+    estado.resize(getWidth(), ' ');
+  print() << FPoint{1, int(linhas) + 1};
+  setReverse(true);
+  print() << estado;
+  setReverse(false);
+}
 
-int hexeditor(string);
+void VisaoHex::mover(int64_t delta) {
+  // O cursor pode ficar uma posicao depois do fim, para acrescentar bytes.
+  uint64_t ultimo = pecas.getTamanho();
 
-int hexeditor(string arquivo) {
-  return 0;
+  if(delta < 0 && uint64_t(-delta) > cursor)
+    cursor = 0;
+  else if(delta > 0 && uint64_t(delta) > ultimo - cursor)
+    cursor = ultimo;
+  else
+    cursor += delta;
+  meioByte = false;
+  if(delta)
+    historico.fecharGrupo();
+
+  uint64_t janela = linhasVisiveis() * bytesLinha;
+  if(cursor < topo)
+    topo = cursor - cursor % bytesLinha;
+  else if(cursor >= topo + janela)
+    topo = cursor - cursor % bytesLinha - janela + bytesLinha;
+}
+
+void VisaoHex::digitar(uint8_t nibble) {
+  uint8_t b;
+
+  if(!meioByte) {
+    b = uint8_t(nibble << 4);
+    if(insercao || cursor == pecas.getTamanho()) {
+      editar(cursor, 0, &b, 1);
+    } else {
+      b |= pecas.byte(cursor) & 0x0F;
+      editar(cursor, 1, &b, 1);
+    }
+    meioByte = true;
+  } else {
+    b = uint8_t((pecas.byte(cursor) & 0xF0) | nibble);
+    editar(cursor, 1, &b, 1);
+    // Avancar o cursor ao digitar nao fecha o grupo do historico.
+    cursor++;
+    meioByte = false;
+    mover(0);
+  }
+}
+
+void VisaoHex::trocar(uint64_t pos, uint64_t nRemover, const uint8_t *bytes, uint64_t n) {
+  // A busca le a tabela em outras threads; ela nao pode mudar por baixo.
+  if(busca.rodando()) {
+    busca.cancelar();
+    aviso = "Busca interrompida.";
+  }
+
+  desmontagem.invalidar(pos);
+  if(nRemover == n) {
+    pecas.sobrescrever(pos, bytes, n);
+  } else {
+    pecas.apagar(pos, nRemover);
+    pecas.inserir(pos, bytes, n);
+  }
+}
+
+void VisaoHex::editar(uint64_t pos, uint64_t nRemover, const uint8_t *bytes, uint64_t n) {
+  uint64_t tamanho = pecas.getTamanho();
+
+  if(pos > tamanho)
+    pos = tamanho;
+  if(nRemover > tamanho - pos)
+    nRemover = tamanho - pos;
+
+  std::vector<uint8_t> antigos(nRemover);
+  pecas.ler(pos, antigos.data(), nRemover);
+  historico.registrar(pos, antigos.data(), nRemover, bytes, n);
+  trocar(pos, nRemover, bytes, n);
+}
+
+void VisaoHex::desfazer() {
+  Historico::Edicao e;
+
+  if(!historico.desfazer(e)) {
+    aviso = "Nada para desfazer.";
+    return;
+  }
+  trocar(e.posicao, e.novos.size(), e.antigos.data(), e.antigos.size());
+  mover(int64_t(e.posicao) - int64_t(cursor));
+}
+
+void VisaoHex::refazer() {
+  Historico::Edicao e;
+
+  if(!historico.refazer(e)) {
+    aviso = "Nada para refazer.";
+    return;
+  }
+  trocar(e.posicao, e.antigos.size(), e.novos.data(), e.novos.size());
+  mover(int64_t(e.posicao + e.novos.size()) - int64_t(cursor));
 }
 
+void VisaoHex::iniciarBusca() {
+  Padrao padrao;
+  bool ok;
+
+  if(textoBusca.size() >= 2 && textoBusca.front() == '"' && textoBusca.back() == '"')
+    ok = padraoTexto(textoBusca.substr(1, textoBusca.size() - 2), padrao);
+  else
+    ok = padraoHex(textoBusca, padrao);
+  if(!ok) {
+    aviso = "Padrao invalido.";
+    return;
+  }
+
+  achados.clear();
+  achadosOrdenados = true;
+  busca.iniciar(pecas, padrao);
+  if(!timerBusca)
+    timerBusca = addTimer(100);
+}
+
+void VisaoHex::onTimer(FTimerEvent *) {
+  bool terminou = !busca.rodando();
+  size_t antes = achados.size();
+
+  busca.resultados(achados, antes);
+  if(achados.size() != antes)
+    achadosOrdenados = false;
+  if(terminou) {
+    delTimer(timerBusca);
+    timerBusca = 0;
+    if(achados.empty())
+      aviso = "Nada encontrado.";
+  }
+  redraw();
+}
+
+void VisaoHex::irParaResultado(bool proximo) {
+  // Cada thread entrega seus blocos fora de ordem; ordena so' quando precisa.
+  if(!achadosOrdenados) {
+    std::sort(achados.begin(), achados.end());
+    achadosOrdenados = true;
+  }
+
+  std::vector<uint64_t>::iterator i;
+  if(proximo) {
+    i = std::upper_bound(achados.begin(), achados.end(), cursor);
+    if(i == achados.end()) {
+      aviso = "Fim dos resultados.";
+      return;
+    }
+  } else {
+    i = std::lower_bound(achados.begin(), achados.end(), cursor);
+    if(i == achados.begin()) {
+      aviso = "Inicio dos resultados.";
+      return;
+    }
+    --i;
+  }
+  mover(int64_t(*i) - int64_t(cursor));
+}
+
+void VisaoHex::teclaBusca(FKeyEvent *ev) {
+  uint32_t tecla = uint32_t(ev->key());
+
+  switch(ev->key()) {
+    case FKey::Escape:
+      pedindoBusca = false;
+      break;
+    case FKey::Enter:
+      pedindoBusca = false;
+      iniciarBusca();
+      break;
+    case FKey::Backspace:
+      if(!textoBusca.empty())
+        textoBusca.pop_back();
+      break;
+    default:
+      if(tecla >= 0x20 && tecla < 0x7F)
+        textoBusca += char(tecla);
+  }
+  ev->accept();
+  redraw();
+}
+
+bool VisaoHex::teclaDesmontagem(FKeyEvent *ev) {
+  uint64_t atual = desmontagem.inicio(pecas, cursor);
+  uint64_t destino = atual;
+  uint32_t tecla = uint32_t(ev->key());
+
+  switch(ev->key()) {
+    case FKey::Up:
+      destino = desmontagem.anterior(pecas, atual);
+      break;
+    case FKey::Down:
+      desmontagem.linhas(pecas, atual, 2, instrucoes);
+      destino = instrucoes.size() > 1 ? instrucoes[1].posicao : pecas.getTamanho();
+      break;
+    case FKey::Page_up:
+      for(uint64_t i = 0; i < linhasVisiveis() && destino; i++)
+        destino = desmontagem.anterior(pecas, destino);
+      topoDesmontagem = destino;
+      break;
+    case FKey::Page_down:
+      desmontagem.linhas(pecas, atual, unsigned(linhasVisiveis()) + 1, instrucoes);
+      destino = instrucoes.size() > linhasVisiveis() ? instrucoes.back().posicao : pecas.getTamanho();
+      topoDesmontagem = destino;
+      break;
+    case FKey::End:
+      destino = desmontagem.inicio(pecas, pecas.getTamanho() ? pecas.getTamanho() - 1 : 0);
+      break;
+    case FKey::Insert:
+    case FKey::Del_char:
+    case FKey::Backspace:
+      // Na desmontagem, nenhuma tecla de edicao mexe nos bytes; desfazer e
+      // refazer continuam valendo.
+      return true;
+    default:
+      return tecla >= 0x20 && tecla < 0x7F;
+  }
+  mover(int64_t(destino) - int64_t(cursor));
+  return true;
+}
+
+bool VisaoHex::salvar() {
+  busca.cancelar();
+  if(!pecas.salvar(nome, true))
+    return false;
+
+  // O arquivo mudou em disco: o mapeamento e a tabela recomecam dele.
+  ArquivoMapeado novo;
+  if(!novo.abrir(nome))
+    return false;
+  mapa = std::move(novo);
+  pecas.reiniciar(mapa.getDados(), mapa.getTamanho());
+  desmontagem.invalidar(0);
+  digitos = mapa.getTamanho() > 0xFFFFFFFFULL ? 10 : 8;
+  return true;
+}
+
+void VisaoHex::onKeyPress(FKeyEvent *ev) {
+  int64_t pagina = int64_t(linhasVisiveis() * bytesLinha);
+
+  aviso.clear();
+  if(pedindoBusca) {
+    teclaBusca(ev);
+    return;
+  }
+  if(desmontando && teclaDesmontagem(ev)) {
+    ev->accept();
+    redraw();
+    return;
+  }
+  switch(ev->key()) {
+    case FKey::Left:      mover(-1); break;
+    case FKey::Right:     mover(1); break;
+    case FKey::Up:        mover(-int64_t(bytesLinha)); break;
+    case FKey::Down:      mover(int64_t(bytesLinha)); break;
+    case FKey::Page_up:   mover(-pagina); break;
+    case FKey::Page_down: mover(pagina); break;
+    case FKey::Home:      mover(-int64_t(cursor)); break;
+    case FKey::End:       mover(int64_t(pecas.getTamanho())); break;
+    case FKey::Insert:    insercao = !insercao; meioByte = false; break;
+    case FKey::Del_char:
+      editar(cursor, 1, nullptr, 0);
+      mover(0);
+      break;
+    case FKey::Backspace:
+      if(cursor > 0) {
+        cursor--;
+        meioByte = false;
+        editar(cursor, 1, nullptr, 0);
+        mover(0);
+      }
+      break;
+    case FKey::Ctrl_f:    pedindoBusca = true; break;
+    case FKey::F3:        irParaResultado(true); break;
+    case FKey::F4:
+      desmontando = !desmontando;
+      topoDesmontagem = desmontagem.inicio(pecas, topo);
+      break;
+    case FKey::Ctrl_p:    irParaResultado(false); break;
+    case FKey::Ctrl_z:    desfazer(); break;
+    case FKey::Ctrl_y:    refazer(); break;
+    case FKey::Ctrl_s:
+      aviso = salvar() ? "Salvo." : "Erro ao salvar!";
+      break;
+    case FKey::Escape:
+      getParentWidget()->close();
+      ev->accept();
+      return;
+    default: {
+      uint32_t tecla = uint32_t(ev->key());
+      if(tecla >= '0' && tecla <= '9')
+        digitar(uint8_t(tecla - '0'));
+      else if(tecla >= 'a' && tecla <= 'f')
+        digitar(uint8_t(tecla - 'a' + 10));
+      else if(tecla >= 'A' && tecla <= 'F')
+        digitar(uint8_t(tecla - 'A' + 10));
+      else {
+        FWidget::onKeyPress(ev);
+        return;
+      }
+    }
+  }
+  ev->accept();
+  redraw();
+}
+
+// Duas imagens lado a lado, com os bytes diferentes em destaque. A
+// comparacao roda em segundo plano; N/F3 e P/Ctrl-P andam pelas diferencas.
+class VisaoDiff : public FWidget {
+  public:
+    VisaoDiff(ArquivoMapeado &&a, ArquivoMapeado &&b, FWidget *parent = nullptr);
+  private:
+    void draw() override;
+    void onKeyPress(FKeyEvent *ev) override;
+    void onTimer(FTimerEvent *ev) override;
+    uint64_t linhasVisiveis();
+    uint64_t bytesLinha();
+    void desenharLado(const ArquivoMapeado &arquivo, uint64_t endereco, uint64_t n);
+    void irPara(uint64_t pos);
+
+    ArquivoMapeado mapaA;
+    ArquivoMapeado mapaB;
+    Comparacao comparacao;
+    uint64_t topo;
+    int digitos;
+    int timer;
+    string aviso;
+};
+
+VisaoDiff::VisaoDiff(ArquivoMapeado &&a, ArquivoMapeado &&b, FWidget *parent)
+  : FWidget(parent), mapaA(std::move(a)), mapaB(std::move(b)), topo(0) {
+  digitos = std::max(mapaA.getTamanho(), mapaB.getTamanho()) > 0xFFFFFFFFULL ? 10 : 8;
+  setFocusable(true);
+  comparacao.iniciar(mapaA.getDados(), mapaA.getTamanho(), mapaB.getDados(), mapaB.getTamanho());
+  timer = addTimer(100);
+}
+
+uint64_t VisaoDiff::linhasVisiveis() {
+  return getHeight() > 1 ? getHeight() - 1 : 1;
+}
+
+uint64_t VisaoDiff::bytesLinha() {
+  // Endereco, e para cada lado 3 colunas por byte mais o ASCII.
+  return getWidth() >= uint64_t(digitos) + 2 + 2 * (16 * 4 + 3) ? 16 : 8;
+}
+
+void VisaoDiff::desenharLado(const ArquivoMapeado &arquivo, uint64_t endereco, uint64_t n) {
+  const uint8_t *dados = arquivo.getDados();
+  uint64_t tamanho = arquivo.getTamanho();
+  bool marcar = comparacao.pronta();
+  char texto[4];
+
+  for(uint64_t i = 0; i < n; i++) {
+    bool dif = marcar && comparacao.diferente(endereco + i);
+    if(endereco + i < tamanho)
+      std::snprintf(texto, sizeof(texto), "%02X", dados[endereco + i]);
+    else
+      std::snprintf(texto, sizeof(texto), "  ");
+    if(dif)
+      setReverse(true);
+    print() << texto;
+    if(dif)
+      setReverse(false);
+    print() << " ";
+  }
+  for(uint64_t i = 0; i < n; i++) {
+    char c = ' ';
+    if(endereco + i < tamanho)
+      c = (dados[endereco + i] >= 0x20 && dados[endereco + i] < 0x7F) ? char(dados[endereco + i]) : '.';
+    print() << c;
+  }
+}
+
+void VisaoDiff::draw() {
+  uint64_t linhas = linhasVisiveis();
+  uint64_t largura = bytesLinha();
+  uint64_t tamanho = std::max(mapaA.getTamanho(), mapaB.getTamanho());
+  char texto[64];
+
+  mapaA.preparar(topo, linhas * largura);
+  mapaB.preparar(topo, linhas * largura);
+  for(uint64_t y = 0; y < linhas; y++) {
+    uint64_t endereco = topo + y * largura;
+
+    print() << FPoint{1, int(y) + 1};
+    if(endereco >= tamanho) {
+      print() << string(getWidth(), ' ');
+      continue;
+    }
+    std::snprintf(texto, sizeof(texto), "%0*llX  ", digitos, (unsigned long long) endereco);
+    print() << texto;
+    desenharLado(mapaA, endereco, largura);
+    print() << " | ";
+    desenharLado(mapaB, endereco, largura);
+  }
+
+  string estado;
+  std::snprintf(texto, sizeof(texto), " %0*llX", digitos, (unsigned long long) topo);
+  estado = texto;
+  if(comparacao.pronta()) {
+    std::snprintf(texto, sizeof(texto), "  %zu faixas, %llu bytes diferentes",
+                  comparacao.getFaixas().size(), (unsigned long long) comparacao.getBytesDiferentes());
+  } else {
+    std::snprintf(texto, sizeof(texto), "  Comparando %d%%",
+                  int(comparacao.getTotal() ? comparacao.getProgresso() * 100 / comparacao.getTotal() : 100));
+  }
+  estado += texto;
+  if(!aviso.empty())
+    estado += "  " + aviso;
+  if(estado.size() < getWidth())
+    estado.resize(getWidth(), ' ');
+  print() << FPoint{1, int(linhas) + 1};
+  setReverse(true);
+  print() << estado;
+  setReverse(false);
+}
+
+void VisaoDiff::irPara(uint64_t pos) {
+  uint64_t largura = bytesLinha();
+  uint64_t tamanho = std::max(mapaA.getTamanho(), mapaB.getTamanho());
+
+  if(pos >= tamanho)
+    pos = tamanho ? tamanho - 1 : 0;
+  topo = pos - pos % largura;
+}
+
+void VisaoDiff::onTimer(FTimerEvent *) {
+  if(comparacao.pronta()) {
+    delTimer(timer);
+    timer = 0;
+  }
+  redraw();
+}
+
+void VisaoDiff::onKeyPress(FKeyEvent *ev) {
+  uint64_t largura = bytesLinha();
+  uint64_t pagina = linhasVisiveis() * largura;
+  uint32_t tecla = uint32_t(ev->key());
+  uint64_t destino;
+  int sentido = 0;
+
+  aviso.clear();
+  switch(ev->key()) {
+    case FKey::Up:        irPara(topo >= largura ? topo - largura : 0); break;
+    case FKey::Down:      irPara(topo + largura); break;
+    case FKey::Page_up:   irPara(topo >= pagina ? topo - pagina : 0); break;
+    case FKey::Page_down: irPara(topo + pagina); break;
+    case FKey::Home:      irPara(0); break;
+    case FKey::End:       irPara(~uint64_t(0)); break;
+    case FKey::F3:        sentido = 1; break;
+    case FKey::Ctrl_p:    sentido = -1; break;
+    case FKey::Escape:
+      getParentWidget()->close();
+      ev->accept();
+      return;
+    default:
+      if(tecla == 'n' || tecla == 'N')
+        sentido = 1;
+      else if(tecla == 'p' || tecla == 'P')
+        sentido = -1;
+      else {
+        FWidget::onKeyPress(ev);
+        return;
+      }
+  }
+
+  if(sentido && !comparacao.pronta()) {
+    aviso = "Aguarde o fim da comparacao.";
+  } else if(sentido > 0) {
+    if(comparacao.proxima(topo + largura - 1, destino))
+      irPara(destino);
+    else
+      aviso = "Nao ha' mais diferencas.";
+  } else if(sentido < 0) {
+    if(comparacao.anterior(topo, destino))
+      irPara(destino);
+    else
+      aviso = "Nao ha' diferencas antes.";
+  }
+  ev->accept();
+  redraw();
+}
+
+int hexeditor(int ac, char *av[], string arquivo, uint64_t orcamentoHistorico) {
+  ArquivoMapeado mapa;
+
+  if(!mapa.abrir(arquivo)) {
+    std::cerr << "hexeditor: nao foi possivel abrir " << arquivo << "." << endl;
+    return 1;
+  }
+
+  FApplication app(ac, av);
+
+  // The object dialog is managed by app
+  FDialog* dialog = new FDialog(&app);
+  dialog->setText("Editor Hexadecimal: " + arquivo);
+  dialog->setGeometry(FPoint{1, 1}, FSize{app.getDesktopWidth(), app.getDesktopHeight()});
+
+  // The object visao is managed by dialog
+  VisaoHex* visao = new VisaoHex(std::move(mapa), arquivo, orcamentoHistorico, dialog);
+  visao->setGeometry(FPoint{1, 1}, FSize{dialog->getClientWidth(), dialog->getClientHeight()});
+
+  FWidget::setMainWidget(dialog);
+  dialog->show();
+  visao->setFocus();
+  return app.exec();
+}
+
+int hexeditorDiff(int ac, char *av[], string arquivoA, string arquivoB) {
+  ArquivoMapeado a, b;
+
+  if(!a.abrir(arquivoA)) {
+    std::cerr << "hexeditor: nao foi possivel abrir " << arquivoA << "." << endl;
+    return 1;
+  }
+  if(!b.abrir(arquivoB)) {
+    std::cerr << "hexeditor: nao foi possivel abrir " << arquivoB << "." << endl;
+    return 1;
+  }
+  // A comparacao le os dois arquivos do inicio ao fim.
+  a.setSequencial(true);
+  b.setSequencial(true);
+
+  FApplication app(ac, av);
+
+  // The object dialog is managed by app
+  FDialog* dialog = new FDialog(&app);
+  dialog->setText("Comparar: " + arquivoA + " x " + arquivoB);
+  dialog->setGeometry(FPoint{1, 1}, FSize{app.getDesktopWidth(), app.getDesktopHeight()});
+
+  // The object visao is managed by dialog
+  VisaoDiff* visao = new VisaoDiff(std::move(a), std::move(b), dialog);
+  visao->setGeometry(FPoint{1, 1}, FSize{dialog->getClientWidth(), dialog->getClientHeight()});
+
+  FWidget::setMainWidget(dialog);
+  dialog->show();
+  visao->setFocus();
+  return app.exec();
+}
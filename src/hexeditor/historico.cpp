@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+
+#include "historico.h"
+
+// Edicoes juntadas param de crescer aqui, para que juntar custe pouco.
+static const uint64_t maximoGrupo = 4096;
+
+Historico::Historico(uint64_t orcamento)
+  : baseArena(0), primeiraNaArena(0), atual(0), grupoAberto(false),
+    orcamento(orcamento), despejo(nullptr), fimDespejo(0) {
+}
+
+Historico::~Historico() {
+  if(despejo)
+    std::fclose(despejo);
+}
+
+void Historico::setOrcamento(uint64_t bytes) {
+  orcamento = bytes;
+  if(arena.size() > orcamento)
+    despejar();
+}
+
+uint64_t Historico::getOrcamento() const {
+  return orcamento;
+}
+
+void Historico::limpar() {
+  entradas.clear();
+  arena.clear();
+  baseArena = 0;
+  primeiraNaArena = 0;
+  atual = 0;
+  grupoAberto = false;
+  fimDespejo = 0;
+}
+
+void Historico::fecharGrupo() {
+  grupoAberto = false;
+}
+
+bool Historico::podeDesfazer() const {
+  return atual > 0;
+}
+
+bool Historico::podeRefazer() const {
+  return atual < entradas.size();
+}
+
+void Historico::truncarRefazer() {
+  if(atual == entradas.size())
+    return;
+
+  if(atual < primeiraNaArena) {
+    fimDespejo = entradas[atual].inicio;
+    primeiraNaArena = atual;
+    arena.clear();
+  } else {
+    arena.resize(entradas[atual].inicio - baseArena);
+  }
+  entradas.resize(atual);
+}
+
+void Historico::registrar(uint64_t posicao, const uint8_t *antigos, uint64_t nAntigos,
+                          const uint8_t *novos, uint64_t nNovos) {
+  if(!nAntigos && !nNovos)
+    return;
+  truncarRefazer();
+
+  if(grupoAberto && atual > primeiraNaArena) {
+    Entrada &u = entradas[atual - 1];
+    uint64_t i = u.inicio - baseArena;
+
+    // O mesmo trecho escrito de novo (o segundo nibble de um byte, por exemplo).
+    if(nAntigos == nNovos && posicao >= u.posicao && posicao + nNovos <= u.posicao + u.nNovos) {
+      std::memcpy(&arena[i + u.nAntigos + (posicao - u.posicao)], novos, nNovos);
+      return;
+    }
+
+    if(u.nAntigos + u.nNovos + nAntigos + nNovos <= maximoGrupo) {
+      bool sobrescrita = nAntigos == nNovos && u.nAntigos == u.nNovos;
+      bool insercao = !nAntigos && !u.nAntigos;
+      bool remocao = !nNovos && !u.nNovos;
+
+      if((sobrescrita || insercao) && posicao == u.posicao + u.nNovos) {
+        arena.insert(arena.begin() + i + u.nAntigos, antigos, antigos + nAntigos);
+        arena.insert(arena.end(), novos, novos + nNovos);
+        u.nAntigos += nAntigos;
+        u.nNovos += nNovos;
+        return;
+      }
+      if(remocao && posicao == u.posicao) {
+        arena.insert(arena.end(), antigos, antigos + nAntigos);
+        u.nAntigos += nAntigos;
+        return;
+      }
+      if(remocao && posicao + nAntigos == u.posicao) {
+        arena.insert(arena.begin() + i, antigos, antigos + nAntigos);
+        u.nAntigos += nAntigos;
+        u.posicao = posicao;
+        return;
+      }
+    }
+  }
+
+  entradas.push_back(Entrada{posicao, baseArena + arena.size(), nAntigos, nNovos, false});
+  arena.insert(arena.end(), antigos, antigos + nAntigos);
+  arena.insert(arena.end(), novos, novos + nNovos);
+  atual = entradas.size();
+  grupoAberto = true;
+  if(arena.size() > orcamento)
+    despejar();
+}
+
+void Historico::despejar() {
+  // Despeja as edicoes mais velhas ate' a arena ficar na metade do orcamento,
+  // assim o custo de mover a arena e' dividido por muitas edicoes.
+  if(!despejo && !(despejo = std::tmpfile()))
+    return;
+
+  size_t e = primeiraNaArena;
+  uint64_t corte = 0;
+  while(e < entradas.size() && arena.size() - corte > orcamento / 2) {
+    Entrada &x = entradas[e];
+    uint64_t n = x.nAntigos + x.nNovos;
+    if(fseeko(despejo, (off_t) fimDespejo, SEEK_SET) != 0 ||
+       std::fwrite(&arena[x.inicio - baseArena], 1, n, despejo) != n)
+      break;
+    x.inicio = fimDespejo;
+    x.despejada = true;
+    fimDespejo += n;
+    corte += n;
+    e++;
+  }
+  std::fflush(despejo);
+
+  arena.erase(arena.begin(), arena.begin() + corte);
+  baseArena += corte;
+  primeiraNaArena = e;
+  if(primeiraNaArena == atual)
+    grupoAberto = false;
+}
+
+bool Historico::ler(const Entrada &e, Edicao &edicao) {
+  edicao.posicao = e.posicao;
+  edicao.antigos.resize(e.nAntigos);
+  edicao.novos.resize(e.nNovos);
+
+  if(!e.despejada) {
+    const uint8_t *p = arena.data() + (e.inicio - baseArena);
+    std::copy(p, p + e.nAntigos, edicao.antigos.begin());
+    std::copy(p + e.nAntigos, p + e.nAntigos + e.nNovos, edicao.novos.begin());
+    return true;
+  }
+  return fseeko(despejo, (off_t) e.inicio, SEEK_SET) == 0 &&
+         std::fread(edicao.antigos.data(), 1, e.nAntigos, despejo) == e.nAntigos &&
+         std::fread(edicao.novos.data(), 1, e.nNovos, despejo) == e.nNovos;
+}
+
+bool Historico::desfazer(Edicao &edicao) {
+  if(!atual)
+    return false;
+  grupoAberto = false;
+  if(!ler(entradas[atual - 1], edicao))
+    return false;
+  atual--;
+  return true;
+}
+
+bool Historico::refazer(Edicao &edicao) {
+  if(atual == entradas.size())
+    return false;
+  grupoAberto = false;
+  if(!ler(entradas[atual], edicao))
+    return false;
+  atual++;
+  return true;
+}
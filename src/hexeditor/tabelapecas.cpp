@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tabelapecas.h"
+
+static bool escreverTudo(int fd, const uint8_t *dados, uint64_t n, int64_t pos = -1) {
+  while(n) {
+    ssize_t r = pos < 0 ? write(fd, dados, n) : pwrite(fd, dados, n, pos);
+    if(r <= 0)
+      return false;
+    dados += r;
+    n -= r;
+    if(pos >= 0)
+      pos += r;
+  }
+  return true;
+}
+
+TabelaPecas::TabelaPecas(const uint8_t *original, uint64_t tamanho) {
+  reiniciar(original, tamanho);
+}
+
+void TabelaPecas::reiniciar(const uint8_t *original, uint64_t tamanho) {
+  this->original = original;
+  tamanhoOriginal = tamanho;
+  adicionados.clear();
+  nos.clear();
+  livres.clear();
+  semente = 2463534242u;
+  modificado = false;
+
+  // O no' 0 e' a folha nula.
+  nos.push_back(Peca{0, 0, 0, 0, 0, 0, ORIGINAL});
+  raiz = tamanho ? novaPeca(ORIGINAL, 0, tamanho) : 0;
+}
+
+uint64_t TabelaPecas::getTamanho() const {
+  return nos[raiz].total;
+}
+
+bool TabelaPecas::getModificado() const {
+  return modificado;
+}
+
+uint32_t TabelaPecas::novaPeca(Origem origem, uint64_t inicio, uint64_t tamanho) {
+  uint32_t t;
+
+  semente ^= semente << 13;
+  semente ^= semente >> 17;
+  semente ^= semente << 5;
+  if(!livres.empty()) {
+    t = livres.back();
+    livres.pop_back();
+  } else {
+    t = (uint32_t) nos.size();
+    nos.emplace_back();
+  }
+  nos[t] = Peca{inicio, tamanho, tamanho, 0, 0, semente, origem};
+  return t;
+}
+
+void TabelaPecas::liberar(uint32_t t) {
+  if(!t)
+    return;
+  liberar(nos[t].esq);
+  liberar(nos[t].dir);
+  livres.push_back(t);
+}
+
+void TabelaPecas::atualizar(uint32_t t) {
+  nos[t].total = nos[nos[t].esq].total + nos[t].tamanho + nos[nos[t].dir].total;
+}
+
+void TabelaPecas::dividir(uint32_t t, uint64_t pos, uint32_t &a, uint32_t &b) {
+  uint32_t x, y;
+
+  if(!t) {
+    a = b = 0;
+    return;
+  }
+
+  uint64_t esquerda = nos[nos[t].esq].total;
+  if(pos <= esquerda) {
+    dividir(nos[t].esq, pos, x, y);
+    nos[t].esq = y;
+    atualizar(t);
+    a = x;
+    b = t;
+  } else if(pos >= esquerda + nos[t].tamanho) {
+    dividir(nos[t].dir, pos - esquerda - nos[t].tamanho, x, y);
+    nos[t].dir = x;
+    atualizar(t);
+    a = t;
+    b = y;
+  } else {
+    // O corte cai no meio da peca: ela vira duas.
+    uint64_t corte = pos - esquerda;
+    uint32_t resto = novaPeca(nos[t].origem, nos[t].inicio + corte, nos[t].tamanho - corte);
+    uint32_t direita = nos[t].dir;
+    nos[t].tamanho = corte;
+    nos[t].dir = 0;
+    atualizar(t);
+    a = t;
+    b = juntar(resto, direita);
+  }
+}
+
+uint32_t TabelaPecas::juntar(uint32_t a, uint32_t b) {
+  if(!a)
+    return b;
+  if(!b)
+    return a;
+  if(nos[a].prioridade > nos[b].prioridade) {
+    uint32_t d = juntar(nos[a].dir, b);
+    nos[a].dir = d;
+    atualizar(a);
+    return a;
+  }
+  uint32_t e = juntar(a, nos[b].esq);
+  nos[b].esq = e;
+  atualizar(b);
+  return b;
+}
+
+bool TabelaPecas::estenderUltimo(uint32_t &t, uint64_t n) {
+  // Digitacao sequencial: se a ultima peca termina exatamente no fim do
+  // buffer de adicionados, ela cresce em vez de criar uma peca nova.
+  uint32_t u = t;
+
+  if(!u)
+    return false;
+  while(nos[u].dir)
+    u = nos[u].dir;
+  if(nos[u].origem != ADICIONADO || nos[u].inicio + nos[u].tamanho != adicionados.size() - n)
+    return false;
+
+  nos[u].tamanho += n;
+  for(u = t; u; u = nos[u].dir)
+    nos[u].total += n;
+  return true;
+}
+
+const uint8_t *TabelaPecas::dadosPeca(const Peca &p) const {
+  return p.origem == ORIGINAL ? original + p.inicio : adicionados.data() + p.inicio;
+}
+
+uint8_t TabelaPecas::byte(uint64_t pos) const {
+  uint32_t t = raiz;
+
+  while(t) {
+    uint64_t esquerda = nos[nos[t].esq].total;
+    if(pos < esquerda) {
+      t = nos[t].esq;
+    } else if(pos < esquerda + nos[t].tamanho) {
+      return dadosPeca(nos[t])[pos - esquerda];
+    } else {
+      pos -= esquerda + nos[t].tamanho;
+      t = nos[t].dir;
+    }
+  }
+  return 0;
+}
+
+uint64_t TabelaPecas::ler(uint64_t pos, uint8_t *destino, uint64_t n) const {
+  uint64_t lidos = 0;
+
+  paraCadaTrecho(pos, n, [&](uint64_t, const uint8_t *dados, uint64_t tamanho) {
+    std::copy(dados, dados + tamanho, destino + lidos);
+    lidos += tamanho;
+  });
+  return lidos;
+}
+
+void TabelaPecas::inserir(uint64_t pos, const uint8_t *bytes, uint64_t n) {
+  uint32_t a, b;
+
+  if(!n)
+    return;
+  if(pos > getTamanho())
+    pos = getTamanho();
+
+  uint64_t inicio = adicionados.size();
+  adicionados.insert(adicionados.end(), bytes, bytes + n);
+  dividir(raiz, pos, a, b);
+  if(!estenderUltimo(a, n))
+    a = juntar(a, novaPeca(ADICIONADO, inicio, n));
+  raiz = juntar(a, b);
+  modificado = true;
+}
+
+void TabelaPecas::apagar(uint64_t pos, uint64_t n) {
+  uint32_t a, b, c, d;
+
+  if(pos >= getTamanho() || !n)
+    return;
+  dividir(raiz, pos, a, b);
+  dividir(b, n, c, d);
+  liberar(c);
+  raiz = juntar(a, d);
+  modificado = true;
+}
+
+void TabelaPecas::sobrescrever(uint64_t pos, const uint8_t *bytes, uint64_t n) {
+  uint64_t tamanho = getTamanho();
+
+  if(pos > tamanho)
+    pos = tamanho;
+  if(n > tamanho - pos) {
+    uint64_t excesso = n - (tamanho - pos);
+    n -= excesso;
+    inserir(tamanho, bytes + n, excesso);
+  }
+  if(!n)
+    return;
+
+  // Caso comum de edicao repetida: o trecho ja' esta' inteiro numa peca de
+  // adicionados, que nao e' compartilhada, entao basta escrever por cima.
+  uint32_t t = raiz;
+  uint64_t p = pos;
+  while(t) {
+    uint64_t esquerda = nos[nos[t].esq].total;
+    if(p < esquerda) {
+      t = nos[t].esq;
+    } else if(p < esquerda + nos[t].tamanho) {
+      if(nos[t].origem == ADICIONADO && p - esquerda + n <= nos[t].tamanho) {
+        std::memcpy(adicionados.data() + nos[t].inicio + (p - esquerda), bytes, n);
+        modificado = true;
+        return;
+      }
+      break;
+    } else {
+      p -= esquerda + nos[t].tamanho;
+      t = nos[t].dir;
+    }
+  }
+
+  uint32_t a, b, c, d;
+  uint64_t inicio = adicionados.size();
+  adicionados.insert(adicionados.end(), bytes, bytes + n);
+  dividir(raiz, pos, a, b);
+  dividir(b, n, c, d);
+  liberar(c);
+  if(!estenderUltimo(a, n))
+    a = juntar(a, novaPeca(ADICIONADO, inicio, n));
+  raiz = juntar(a, d);
+  modificado = true;
+}
+
+bool TabelaPecas::salvar(std::string arquivo, bool noLugar) {
+  uint64_t tamanho = getTamanho();
+  bool ok = true;
+
+  if(noLugar && tamanho == tamanhoOriginal) {
+    struct Escrita {
+      uint64_t pos;
+      const uint8_t *dados;
+      uint64_t n;
+    };
+    std::vector<Escrita> escritas;
+    std::vector<std::vector<uint8_t>> copias;
+
+    // Pecas do original que mudaram de lugar sao copiadas antes de qualquer
+    // escrita, porque o mapeamento reflete o proprio arquivo sendo gravado.
+    paraCadaTrecho(0, tamanho, [&](uint64_t pos, const uint8_t *dados, uint64_t n) {
+      if(dados == original + pos)
+        return;
+      if(dados >= original && dados < original + tamanhoOriginal) {
+        copias.emplace_back(dados, dados + n);
+        dados = copias.back().data();
+      }
+      escritas.push_back(Escrita{pos, dados, n});
+    });
+
+    int fd = open(arquivo.c_str(), O_WRONLY | O_CLOEXEC);
+    if(fd < 0)
+      return false;
+    for(const Escrita &e : escritas)
+      if(!(ok = escreverTudo(fd, e.dados, e.n, (int64_t) e.pos)))
+        break;
+    ok = fsync(fd) == 0 && ok;
+    return close(fd) == 0 && ok;
+  }
+
+  struct stat st;
+  std::string temporario = arquivo + ".XXXXXX";
+  int fd = mkstemp(&temporario[0]);
+  if(fd < 0)
+    return false;
+  if(stat(arquivo.c_str(), &st) == 0)
+    fchmod(fd, st.st_mode & 07777);
+
+  // Pecas pequenas sao agrupadas; as grandes vao direto do mapeamento.
+  std::vector<uint8_t> buffer;
+  buffer.reserve(1 << 20);
+  paraCadaTrecho(0, tamanho, [&](uint64_t, const uint8_t *dados, uint64_t n) {
+    if(!ok)
+      return;
+    if(buffer.size() + n > buffer.capacity()) {
+      ok = escreverTudo(fd, buffer.data(), buffer.size());
+      buffer.clear();
+    }
+    if(n >= buffer.capacity())
+      ok = ok && escreverTudo(fd, dados, n);
+    else
+      buffer.insert(buffer.end(), dados, dados + n);
+  });
+  ok = ok && escreverTudo(fd, buffer.data(), buffer.size());
+  ok = fsync(fd) == 0 && ok;
+  ok = close(fd) == 0 && ok;
+  if(ok)
+    ok = std::rename(temporario.c_str(), arquivo.c_str()) == 0;
+  if(!ok)
+    unlink(temporario.c_str());
+  return ok;
+}
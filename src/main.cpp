@@ -1,5 +1,10 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <vector>
 #include <boost/program_options.hpp>
 
 using namespace std;
@@ -7,9 +12,24 @@ using std::string;
 namespace po = boost::program_options;
 
 #include "msx.h"
+#include "basic.h"
 #include "hexeditor.h"
+#include "lote.h"
+#include "maquina.h"
 #include "desktop.h"
+#include "fita.h"
 #include "msx.h"
+#include "z80.h"
+
+// Erros e comeco do resumo de um lote ("3 fitas (0 falhas) em 1.2 s: ");
+// devolve os segundos, nunca zero, para as taxas que vem depois.
+static double mostrarLote(const ResultadoLote &resultado, const char *itens) {
+  for(const string &erro : resultado.erros)
+    cout << erro << endl;
+  cout << resultado.imagens << " " << itens << " (" << resultado.falhas << " falhas) em " << resultado.segundos
+       << " s: ";
+  return resultado.segundos > 0 ? resultado.segundos : 1e-9;
+}
 
 int main(int argc, char* argv[])
 {
@@ -24,6 +44,41 @@ int main(int argc, char* argv[])
   desc.add_options()
     ("help", "Mensagem de ajuda.")
     ("hexeditor", po::value<string>(), "Executa o editor Hexadecimal para arquivos MSX.")
+    ("diff", po::value<vector<string>>()->multitoken(), "Compara duas imagens: --diff a.rom b.rom.")
+    ("historico", po::value<unsigned>()->default_value(16), "Memoria do historico de desfazer do editor, em MB.")
+    ("extract", po::value<string>(), "Extrai os arquivos das imagens DSK/DMK que casam com o padrao: --extract '*.dsk' --out pasta.")
+    ("out", po::value<string>(), "Destino do --extract, do --cas, do --cas2wav, do --screen, do --png2sc e do --vgm (pasta), do --tokenize (arquivo .BAS), do --romdb-build, do --hash, do --wav2cas ou do --tiles (indice).")
+    ("threads", po::value<unsigned>()->default_value(0), "Threads para o --extract, --trace, --mapper, --hash, --cas, --cas2wav, --screen, --png2sc, --tiles, --tiles-shared, --vgm e --run (0 = todos os nucleos).")
+    ("list", po::value<string>(), "Mostra a listagem ASCII de um programa MSX-BASIC tokenizado (.BAS).")
+    ("tokenize", po::value<string>(), "Converte uma listagem ASCII em programa MSX-BASIC tokenizado: --tokenize a.asc --out a.bas.")
+    ("disco", po::value<string>(), "Abre uma imagem DSK/Nextor para copiar, apagar e renomear arquivos.")
+    ("particao", po::value<unsigned>()->default_value(0), "Particao da imagem de disco rigido usada por --disco.")
+    ("mapper", po::value<string>(), "Mostra o mapeador das MegaROMs que casam com o padrao: --mapper '*.rom'.")
+    ("romdb", po::value<string>(), "Base de ROMs conhecidas (gerada por --romdb-build) para o --mapper, o --identify e o --trace.")
+    ("romdb-build", po::value<vector<string>>()->multitoken(), "Gera a base de ROMs da softwaredb.xml do openMSX ou de listas \"HASH MAPEADOR [titulo]\": --romdb-build softwaredb.xml --out roms.db.")
+    ("hash", po::value<vector<string>>()->multitoken(), "Lista DAT (ClrMamePro) com CRC32, SHA-1 e MD5 dos arquivos que casam com os padroes: --hash '*.rom' '*.dsk' [--out lista.dat].")
+    ("identify", po::value<string>(), "Identifica uma ROM pela base do --romdb: titulo, mapeador, SHA-1 e CRC-32.")
+    ("cas", po::value<string>(), "Lista os arquivos das fitas .CAS que casam com o padrao; com --out, extrai: --cas '*.cas' [--out pasta].")
+    ("wav2cas", po::value<string>(), "Decodifica a gravacao de uma fita (WAV 8/16 bits, 1200/2400 baud) em .CAS: --wav2cas fita.wav --out fita.cas.")
+    ("cas2wav", po::value<string>(), "Gera o audio (WAV) das fitas .CAS que casam com o padrao: --cas2wav '*.cas' --out pasta [--baud 2400] [--taxa 48000].")
+    ("baud", po::value<unsigned>()->default_value(1200), "Velocidade da fita gerada pelo --cas2wav (1200 ou 2400).")
+    ("taxa", po::value<unsigned>()->default_value(44100), "Taxa de amostragem do WAV gerado pelo --cas2wav e pelo --vgm, em Hz.")
+    ("screen", po::value<string>(), "Converte em PNG as telas (BSAVE .SC2 a .SCC ou copia da VRAM) que casam com o padrao: --screen '*.sc?' --out pasta [--modo 8] [--escala 2].")
+    ("modo", po::value<unsigned>()->default_value(0), "SCREEN das telas do --screen (2 a 8, 10 a 12; 0 tira da extensao) ou do --png2sc (2, 5, 8 ou 12).")
+    ("png2sc", po::value<string>(), "Converte as imagens PNG que casam com o padrao em telas BSAVE: --png2sc '*.png' --modo 5 --out pasta [--sem-difusao].")
+    ("sem-difusao", "Sem difusao de erro (Floyd-Steinberg) no --png2sc.")
+    ("tiles", po::value<vector<string>>()->multitoken(), "Acrescenta os padroes 8x8 e sprites 16x16 das ROMs e telas que casam com os padroes ao indice: --tiles '*.rom' '*.sc2' --out padroes.idx.")
+    ("tiles-shared", po::value<string>(), "Mostra, para cada arquivo do indice do --tiles, os anteriores com quem ele mais divide padroes.")
+    ("escala", po::value<unsigned>()->default_value(1), "Reducao das imagens do --screen (2 = metade da largura e da altura).")
+    ("vgm", po::value<string>(), "Toca as musicas VGM/VGZ (PSG, SCC e YM2413) que casam com o padrao e grava em WAV: --vgm '*.vgz' --out pasta [--taxa 48000] [--voltas 1].")
+    ("voltas", po::value<unsigned>()->default_value(0), "Vezes que o --vgm repete o trecho de loop de cada musica.")
+    ("run", po::value<string>(), "Roda as ROMs que casam com o padrao num MSX1 sem tela e mostra se travaram: --run '*.rom' [--quadros 600].")
+    ("quadros", po::value<unsigned>()->default_value(600), "Quadros de 1/60 s que o --run emula de cada ROM.")
+    ("disasm", po::value<string>(), "Desmonta um arquivo binario Z80 (ROM, BIN) para a saida padrao.")
+    ("org", po::value<string>()->default_value("4000"), "Endereco inicial do --disasm, em hexadecimal.")
+    ("r800", "Inclui as instrucoes do R800 (MULUB, MULUW) no --disasm.")
+    ("trace", "Com --disasm, separa codigo e dados seguindo as entradas do cabecalho AB da ROM.")
+    ("banco", po::value<unsigned>()->default_value(8), "Tamanho dos bancos da MegaROM no --trace, em KB (8 ou 16).")
   ;
 
   po::variables_map vm;
@@ -35,9 +90,342 @@ int main(int argc, char* argv[])
     return 1;
   }
 
+  if(vm.count("diff")) {
+    vector<string> arquivos = vm["diff"].as<vector<string>>();
+    if(arquivos.size() != 2) {
+      cout << "--diff precisa de dois arquivos." << endl;
+      return 1;
+    }
+    return hexeditorDiff(argc, argv, arquivos[0], arquivos[1]);
+  }
+
+  if(vm.count("list")) {
+    ifstream arquivo(vm["list"].as<string>(), ios::binary);
+    if(!arquivo) {
+      cout << "Nao foi possivel abrir " << vm["list"].as<string>() << "." << endl;
+      return 1;
+    }
+    vector<uint8_t> programa((istreambuf_iterator<char>(arquivo)), istreambuf_iterator<char>());
+    Detokenizador detokenizador;
+    bool ok = detokenizador.converter(programa.data(), programa.size());
+    cout.write(detokenizador.getTexto(), detokenizador.getTamanho());
+    if(!ok)
+      cout << "Programa BASIC invalido ou incompleto." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("tokenize")) {
+    ifstream arquivo(vm["tokenize"].as<string>(), ios::binary);
+    if(!arquivo || !vm.count("out")) {
+      cout << "--tokenize precisa de uma listagem existente e de --out <arquivo>." << endl;
+      return 1;
+    }
+    string texto((istreambuf_iterator<char>(arquivo)), istreambuf_iterator<char>());
+    Tokenizador tokenizador;
+    if(!tokenizador.converter(texto.data(), texto.size())) {
+      cout << "Erro na linha " << tokenizador.getLinhaErro() << " da listagem." << endl;
+      return 1;
+    }
+    ofstream saida(vm["out"].as<string>(), ios::binary);
+    saida.write(reinterpret_cast<const char *>(tokenizador.getPrograma()), tokenizador.getTamanho());
+    return saida.good() ? 0 : 1;
+  }
+
+  if(vm.count("romdb-build")) {
+    size_t registros = 0;
+    if(!vm.count("out")) {
+      cout << "--romdb-build precisa de --out <arquivo>." << endl;
+      return 1;
+    }
+    if(!BaseRoms::gerar(vm["romdb-build"].as<vector<string>>(), vm["out"].as<string>(), &registros)) {
+      cout << "Nao foi possivel gerar " << vm["out"].as<string>() << "." << endl;
+      return 1;
+    }
+    cout << registros << " ROMs em " << vm["out"].as<string>() << "." << endl;
+    return 0;
+  }
+
+  if(vm.count("hash")) {
+    vector<HashArquivo> resultado;
+    bool ok = resumirLote(vm["hash"].as<vector<string>>(), vm["threads"].as<unsigned>(), resultado);
+    for(const HashArquivo &h : resultado)
+      if(!h.lido)
+        cerr << "Nao foi possivel ler " << h.arquivo << "." << endl;
+    if(resultado.empty()) {
+      cout << "Nenhum arquivo casa com os padroes do --hash." << endl;
+      return 1;
+    }
+    if(vm.count("out")) {
+      ofstream saida(vm["out"].as<string>(), ios::binary);
+      escreverDat(saida, resultado);
+      ok = ok && saida.good();
+    } else
+      escreverDat(cout, resultado);
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("romdb") && !msxbasico.abrirBaseRoms(vm["romdb"].as<string>())) {
+    cout << "Base de ROMs invalida: " << vm["romdb"].as<string>() << "." << endl;
+    return 1;
+  }
+
+  if(vm.count("identify")) {
+    RomConhecida rom;
+    char crc[9];
+    if(!msxbasico.identificar(vm["identify"].as<string>(), rom)) {
+      cout << "Nao foi possivel abrir " << vm["identify"].as<string>() << "." << endl;
+      return 1;
+    }
+    snprintf(crc, sizeof(crc), "%08x", rom.crc);
+    cout << "Titulo:    " << (rom.conhecida ? rom.titulo : "(desconhecida)") << endl;
+    cout << "Mapeador:  " << nomeMapeador(rom.mapeador) << (rom.conhecida ? "" : " (palpite)") << endl;
+    cout << "SHA-1:     ";
+    for(uint8_t b : rom.sha1) {
+      char hex[3];
+      snprintf(hex, sizeof(hex), "%02x", b);
+      cout << hex;
+    }
+    cout << endl << "CRC-32:    " << crc << endl;
+    return 0;
+  }
+
+  if(vm.count("mapper")) {
+    vector<MapeadorArquivo> resultado;
+    bool ok = detectarLote(msxbasico, vm["mapper"].as<string>(), vm["threads"].as<unsigned>(), resultado);
+    for(const MapeadorArquivo &m : resultado)
+      cout << (m.lido ? nomeMapeador(m.mapeador) : "ERRO") << "\t" << m.arquivo << endl;
+    if(resultado.empty())
+      cout << "Nenhuma ROM casa com " << vm["mapper"].as<string>() << "." << endl;
+    return ok && !resultado.empty() ? 0 : 1;
+  }
+
+  if(vm.count("cas")) {
+    vector<IndiceCassete> resultado;
+    string destino = vm.count("out") ? vm["out"].as<string>() : string();
+    bool ok = indexarCassetes(vm["cas"].as<string>(), destino, vm["threads"].as<unsigned>(), resultado);
+    for(const IndiceCassete &c : resultado) {
+      cout << c.arquivo << (c.lido ? "" : "  (ERRO)") << endl;
+      for(const ArquivoCassete &a : c.arquivos) {
+        cout << "  " << nomeTipoCassete(a.tipo) << "\t" << a.nome << "\t" << a.tamanho;
+        if(a.tipo == casseteBinario) {
+          char enderecos[32];
+          snprintf(enderecos, sizeof(enderecos), "\t#%04X-#%04X,#%04X", a.inicio, a.fim, a.execucao);
+          cout << enderecos;
+        }
+        cout << endl;
+      }
+      for(const string &aviso : c.avisos)
+        cout << "  aviso: " << aviso << endl;
+    }
+    if(resultado.empty())
+      cout << "Nenhuma fita casa com " << vm["cas"].as<string>() << "." << endl;
+    return ok && !resultado.empty() ? 0 : 1;
+  }
+
+  if(vm.count("wav2cas")) {
+    ResultadoFita resultado;
+    if(!vm.count("out")) {
+      cout << "--wav2cas precisa de --out <arquivo .CAS>." << endl;
+      return 1;
+    }
+    bool ok = converterWavCas(vm["wav2cas"].as<string>(), vm["out"].as<string>(), resultado);
+    if(!resultado.formato.taxa) {
+      cout << vm["wav2cas"].as<string>() << " nao e' um WAV PCM de 8 ou 16 bits." << endl;
+      return 1;
+    }
+    cout << resultado.blocos << " blocos, " << resultado.bytes << " bytes de " << resultado.segundos << " s de fita ("
+         << resultado.formato.taxa << " Hz, " << resultado.formato.bits << " bits, ~" << resultado.baud << " baud)";
+    if(resultado.erros)
+      cout << ", " << resultado.erros << " bytes perdidos";
+    cout << "." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("cas2wav")) {
+    if(!vm.count("out")) {
+      cout << "--cas2wav precisa de --out <pasta>." << endl;
+      return 1;
+    }
+    unsigned baud = vm["baud"].as<unsigned>();
+    if(baud != 1200 && baud != 2400) {
+      cout << "--baud tem que ser 1200 ou 2400." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    bool ok = sintetizarLote(vm["cas2wav"].as<string>(), vm["out"].as<string>(), vm["taxa"].as<unsigned>(), baud,
+                             vm["threads"].as<unsigned>(), resultado);
+    double segundos = mostrarLote(resultado, "fitas");
+    cout << resultado.bytesGravados / 1048576.0 / segundos << " MB/s gravados." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("screen")) {
+    if(!vm.count("out")) {
+      cout << "--screen precisa de --out <pasta>." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    bool ok = telasLote(msxbasico, vm["screen"].as<string>(), vm["out"].as<string>(), vm["modo"].as<unsigned>(),
+                        vm["escala"].as<unsigned>(), vm["threads"].as<unsigned>(), resultado);
+    double segundos = mostrarLote(resultado, "telas");
+    cout << resultado.imagens / segundos << " telas/s." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("png2sc")) {
+    if(!vm.count("out")) {
+      cout << "--png2sc precisa de --out <pasta>." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    bool ok = converterPngLote(vm["png2sc"].as<string>(), vm["out"].as<string>(), vm["modo"].as<unsigned>(),
+                               vm.count("sem-difusao") == 0, vm["threads"].as<unsigned>(), resultado);
+    double segundos = mostrarLote(resultado, "imagens");
+    cout << resultado.imagens / segundos << " imagens/s." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("tiles")) {
+    if(!vm.count("out")) {
+      cout << "--tiles precisa de --out <indice>." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    bool ok = indexarPadroes(vm["tiles"].as<vector<string>>(), vm["out"].as<string>(), vm["threads"].as<unsigned>(),
+                             resultado);
+    double segundos = mostrarLote(resultado, "arquivos");
+    cout << resultado.bytesLidos / 1048576.0 / segundos << " MB/s lidos." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("tiles-shared")) {
+    IndicePadroes indice;
+    vector<Compartilhamento> compartilhados;
+    if(!indice.abrir(vm["tiles-shared"].as<string>(), false)) {
+      cout << "Nao foi possivel abrir " << vm["tiles-shared"].as<string>() << "." << endl;
+      return 1;
+    }
+    indice.compartilhamentos(vm["threads"].as<unsigned>(), compartilhados);
+    const vector<string> &arquivos = indice.getArquivos();
+    // Os tres anteriores com mais padroes em comum, para cada arquivo.
+    for(size_t i = 0, mostrados = 0; i < compartilhados.size(); i++) {
+      if(i && compartilhados[i].arquivo != compartilhados[i - 1].arquivo)
+        mostrados = 0;
+      if(mostrados++ < 3)
+        cout << arquivos[compartilhados[i].arquivo] << ": " << compartilhados[i].padroes << " padroes de "
+             << arquivos[compartilhados[i].outro] << endl;
+    }
+    cout << arquivos.size() << " arquivos, " << indice.getUsados() << " padroes distintos." << endl;
+    return 0;
+  }
+
+  if(vm.count("vgm")) {
+    if(!vm.count("out")) {
+      cout << "--vgm precisa de --out <pasta>." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    double audio;
+    bool ok = renderizarLote(vm["vgm"].as<string>(), vm["out"].as<string>(), vm["taxa"].as<unsigned>(),
+                             vm["voltas"].as<unsigned>(), vm["threads"].as<unsigned>(), resultado, audio);
+    double segundos = mostrarLote(resultado, "musicas");
+    cout << audio << " s de audio, " << audio / segundos << " vezes o tempo real." << endl;
+    return ok ? 0 : 1;
+  }
+
+  if(vm.count("run")) {
+    vector<ResultadoTeste> resultado;
+    auto inicio = chrono::steady_clock::now();
+    bool ok = testarLote(msxbasico, vm["run"].as<string>(), vm["quadros"].as<unsigned>(), vm["threads"].as<unsigned>(),
+                         resultado);
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+    unsigned falhas = 0;
+    uint64_t ciclos = 0;
+    double tempo = 0;
+    for(const ResultadoTeste &r : resultado) {
+      // Voltar para a BIOS e' o que um cartucho que so' instala hooks faz.
+      bool falhou = !r.lido || (r.estado != testeRodando && r.estado != testeVoltou);
+      falhas += falhou;
+      ciclos += r.ciclos;
+      tempo += r.segundos;
+      cout << (r.lido ? nomeEstado(r.estado) : "ERRO") << "\t" << (r.lido ? nomeMapeador(r.mapeador) : "-") << "\t"
+           << r.escritasVram << "\t" << r.arquivo << endl;
+    }
+    if(resultado.empty()) {
+      cout << "Nenhuma ROM casa com " << vm["run"].as<string>() << "." << endl;
+      return 1;
+    }
+    tempo = tempo > 0 ? tempo : 1e-9;
+    cout << resultado.size() << " ROMs (" << falhas << " falhas) em " << segundos << " s: " << ciclos / tempo / 1e6
+         << " MHz por nucleo, " << ciclos / 3579545.0 / tempo << " vezes o tempo real." << endl;
+    return ok && falhas == 0 ? 0 : 1;
+  }
+
+  if(vm.count("disasm")) {
+    ifstream arquivo(vm["disasm"].as<string>(), ios::binary);
+    if(!arquivo) {
+      cout << "Nao foi possivel abrir " << vm["disasm"].as<string>() << "." << endl;
+      return 1;
+    }
+    Desmontador desmontador(vm.count("r800") > 0);
+    if(vm.count("trace")) {
+      if(vm["banco"].as<unsigned>() != 8 && vm["banco"].as<unsigned>() != 16) {
+        cout << "--banco tem que ser 8 ou 16." << endl;
+        return 1;
+      }
+      vector<uint8_t> rom((istreambuf_iterator<char>(arquivo)), istreambuf_iterator<char>());
+      Rastreador rastreador(vm["banco"].as<unsigned>(), vm.count("r800") > 0);
+      MapeadorRom mapeador = msxbasico.detectarMapeador(rom.data(), rom.size());
+      if(!rastreador.analisar(rom.data(), rom.size(), mapeador, vm["threads"].as<unsigned>())) {
+        cout << "ROM sem cabecalho AB." << endl;
+        return 1;
+      }
+      desmontador.listar(rastreador);
+      cout.write(desmontador.getTexto(), streamsize(desmontador.getTamanho()));
+      return 0;
+    }
+    uint16_t endereco = uint16_t(stoul(vm["org"].as<string>(), nullptr, 16));
+    vector<uint8_t> bloco(1 << 16);
+    size_t sobra = 0;
+    // Em blocos: o que pode ser o comeco de uma instrucao cortada vai para o proximo.
+    for(;;) {
+      arquivo.read(reinterpret_cast<char *>(bloco.data() + sobra), streamsize(bloco.size() - sobra));
+      size_t n = sobra + size_t(arquivo.gcount());
+      bool fim = !arquivo;
+      size_t usados = desmontador.desmontar(bloco.data(), n, endereco, fim);
+      cout.write(desmontador.getTexto(), streamsize(desmontador.getTamanho()));
+      desmontador.limpar();
+      endereco = uint16_t(endereco + usados);
+      sobra = n - usados;
+      if(fim)
+        break;
+      copy(bloco.begin() + long(usados), bloco.begin() + long(n), bloco.begin());
+    }
+    return 0;
+  }
+
+  if(vm.count("extract")) {
+    if(!vm.count("out")) {
+      cout << "--extract precisa de --out <pasta>." << endl;
+      return 1;
+    }
+    ResultadoLote resultado;
+    bool ok = extrairLote(vm["extract"].as<string>(), vm["out"].as<string>(), vm["threads"].as<unsigned>(), resultado);
+    double segundos = mostrarLote(resultado, "imagens");
+    cout << resultado.imagens / segundos << " imagens/s, "
+         << resultado.bytesLidos / 1048576.0 / segundos << " MB/s lidos, "
+         << resultado.bytesGravados / 1048576.0 / segundos << " MB/s gravados." << endl;
+    return ok ? 0 : 1;
+  }
+
   if(vm.count("hexeditor")) {
     cout << "hexeditor " << vm["hexeditor"].as<string>() << "." << endl;
-    hexeditor(vm["hexeditor"].as<string>());
+    return hexeditor(argc, argv, vm["hexeditor"].as<string>(), uint64_t(vm["historico"].as<unsigned>()) << 20);
+  }
+
+  if(vm.count("disco") && !msxbasico.abrirDisco(vm["disco"].as<string>(), vm["particao"].as<unsigned>(), true)) {
+    cout << "Nao foi possivel abrir " << vm["disco"].as<string>() << " para escrita." << endl;
+    return 1;
   }
 
   desktop(argc, argv, msxbasico);
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+
+#include "baserom.h"
+
+static const char magica[8] = {'M', 'S', 'X', 'R', 'O', 'M', 'D', 'B'};
+static const uint32_t versaoBase = 1;
+
+struct CabecalhoBase {
+  char magica[8];
+  uint32_t versao;
+  uint32_t registros;
+  uint32_t comSha1;
+  uint32_t indicesCrc;
+  uint64_t tamanhoTextos;
+};
+
+struct BaseRoms::Registro {
+  uint8_t sha1[20];
+  uint32_t crc;
+  // Posicao do titulo nos textos.
+  uint32_t titulo;
+  uint8_t mapeador;
+  uint8_t reservado[3];
+};
+
+struct BaseRoms::IndiceCrc {
+  uint32_t crc;
+  uint32_t registro;
+};
+
+static_assert(sizeof(CabecalhoBase) == 32, "cabecalho da base");
+
+BaseRoms::BaseRoms()
+  : registros(nullptr), totalRegistros(0), comSha1(0), indiceCrc(nullptr), totalCrc(0), textos(nullptr),
+    tamanhoTextos(0) {
+  static_assert(sizeof(Registro) == 32, "registro da base");
+  static_assert(sizeof(IndiceCrc) == 8, "indice de CRC da base");
+}
+
+bool BaseRoms::abrir(std::string arquivo) {
+  CabecalhoBase c;
+
+  fechar();
+  if(!mapa.abrir(arquivo) || mapa.getTamanho() < sizeof(c)) {
+    fechar();
+    return false;
+  }
+  std::memcpy(&c, mapa.getDados(), sizeof(c));
+
+  // O tamanho tem que bater exatamente com as tres partes.
+  uint64_t esperado = sizeof(c) + uint64_t(c.registros) * sizeof(Registro) + uint64_t(c.indicesCrc) * sizeof(IndiceCrc)
+                      + c.tamanhoTextos;
+  if(std::memcmp(c.magica, magica, sizeof(magica)) || c.versao != versaoBase || c.comSha1 > c.registros ||
+     c.indicesCrc > c.registros || esperado != mapa.getTamanho() || !c.tamanhoTextos) {
+    fechar();
+    return false;
+  }
+
+  const uint8_t *p = mapa.getDados() + sizeof(c);
+  registros = reinterpret_cast<const Registro *>(p);
+  totalRegistros = c.registros;
+  comSha1 = c.comSha1;
+  indiceCrc = reinterpret_cast<const IndiceCrc *>(p + size_t(c.registros) * sizeof(Registro));
+  totalCrc = c.indicesCrc;
+  textos = reinterpret_cast<const char *>(indiceCrc + totalCrc);
+  tamanhoTextos = c.tamanhoTextos;
+  // Um titulo fora dos textos ou sem fim nunca e' lido alem do arquivo.
+  if(textos[tamanhoTextos - 1]) {
+    fechar();
+    return false;
+  }
+  return true;
+}
+
+void BaseRoms::fechar() {
+  mapa.fechar();
+  registros = nullptr;
+  totalRegistros = comSha1 = totalCrc = 0;
+  indiceCrc = nullptr;
+  textos = nullptr;
+  tamanhoTextos = 0;
+}
+
+bool BaseRoms::aberta() const {
+  return registros != nullptr;
+}
+
+size_t BaseRoms::getRegistros() const {
+  return totalRegistros;
+}
+
+void BaseRoms::preencher(const Registro &r, RomConhecida &rom) const {
+  rom.titulo = r.titulo < tamanhoTextos ? std::string(textos + r.titulo) : std::string();
+  rom.mapeador = r.mapeador < totalMapeadores ? MapeadorRom(r.mapeador) : mapeadorOutro;
+  std::memcpy(rom.sha1, r.sha1, sizeof(rom.sha1));
+  rom.crc = r.crc;
+  rom.conhecida = true;
+}
+
+static uint64_t chaveSha1(const uint8_t *sha1) {
+  uint64_t k = 0;
+  for(int i = 0; i < 8; i++)
+    k = (k << 8) | sha1[i];
+  return k;
+}
+
+bool BaseRoms::procurarSha1(const uint8_t sha1[20], RomConhecida &rom) const {
+  uint64_t chave = chaveSha1(sha1);
+  size_t de = 0, ate = comSha1;
+
+  // Interpolacao em [de, ate): o proximo palpite e' onde a chave cairia se
+  // os hashes entre os extremos fossem espalhados por igual.
+  while(de < ate) {
+    uint64_t a = chaveSha1(registros[de].sha1), b = chaveSha1(registros[ate - 1].sha1);
+    if(chave < a || chave > b)
+      return false;
+    size_t meio = de;
+    if(b > a)
+      meio += size_t((unsigned __int128) (chave - a) * (ate - 1 - de) / (b - a));
+
+    int c = std::memcmp(registros[meio].sha1, sha1, 20);
+    if(c == 0) {
+      preencher(registros[meio], rom);
+      return true;
+    }
+    if(c < 0)
+      de = meio + 1;
+    else
+      ate = meio;
+  }
+  return false;
+}
+
+bool BaseRoms::procurarCrc(uint32_t crc, RomConhecida &rom) const {
+  const IndiceCrc *i = std::lower_bound(indiceCrc, indiceCrc + totalCrc, crc,
+                                        [](const IndiceCrc &x, uint32_t v) { return x.crc < v; });
+  if(i == indiceCrc + totalCrc || i->crc != crc || i->registro >= totalRegistros)
+    return false;
+  preencher(registros[i->registro], rom);
+  return true;
+}
+
+// Geracao da base a partir das fontes.
+
+struct EntradaFonte {
+  uint8_t sha1[20];
+  bool temSha1;
+  uint32_t crc;
+  bool temCrc;
+  MapeadorRom mapeador;
+  std::string titulo;
+};
+
+// Nomes de tipo da softwaredb do openMSX que nao sao os de nomeMapeador.
+static MapeadorRom mapeadorDoTipo(const std::string &tipo) {
+  static const std::pair<const char *, MapeadorRom> prefixos[] = {
+    {"GameMaster2", mapeadorRC755}, {"Mirrored", mapeadorLinear}, {"Normal", mapeadorLinear},
+    {"Page", mapeadorLinear}, {"ASCII8SRAM", mapeadorASCII8}, {"ASCII16SRAM", mapeadorASCII16},
+    {"Zemina", mapeadorZemina}
+  };
+  MapeadorRom m;
+
+  if(tipo.empty())
+    return mapeadorLinear;
+  if(mapeadorPorNome(tipo, m))
+    return m;
+  for(const std::pair<const char *, MapeadorRom> &p : prefixos)
+    if(tipo.compare(0, std::strlen(p.first), p.first) == 0)
+      return p.second;
+  return mapeadorOutro;
+}
+
+static bool lerHex(const std::string &texto, uint8_t *destino, size_t bytes) {
+  if(texto.size() != bytes * 2)
+    return false;
+  for(size_t i = 0; i < texto.size(); i++) {
+    char c = texto[i];
+    int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    if(v < 0)
+      return false;
+    destino[i / 2] = uint8_t(i % 2 ? destino[i / 2] | v : v << 4);
+  }
+  return true;
+}
+
+static bool entradaHash(const std::string &hash, EntradaFonte &e) {
+  uint8_t crc[4];
+
+  e.temSha1 = lerHex(hash, e.sha1, 20);
+  e.temCrc = !e.temSha1 && lerHex(hash, crc, 4);
+  if(!e.temSha1)
+    std::memset(e.sha1, 0, sizeof(e.sha1));
+  e.crc = e.temCrc ? (uint32_t(crc[0]) << 24) | (uint32_t(crc[1]) << 16) | (uint32_t(crc[2]) << 8) | crc[3] : 0;
+  return e.temSha1 || e.temCrc;
+}
+
+static bool lerLista(const std::string &conteudo, std::vector<EntradaFonte> &entradas) {
+  std::istringstream linhas(conteudo);
+  std::string linha;
+
+  while(std::getline(linhas, linha)) {
+    std::istringstream campos(linha);
+    std::string hash, tipo;
+    EntradaFonte e;
+
+    if(!(campos >> hash) || hash[0] == ';')
+      continue;
+    if(!(campos >> tipo) || !entradaHash(hash, e))
+      return false;
+    e.mapeador = mapeadorDoTipo(tipo);
+    std::getline(campos >> std::ws, e.titulo);
+    entradas.push_back(e);
+  }
+  return true;
+}
+
+static std::string textoXml(const std::string &texto) {
+  static const std::pair<const char *, char> entidades[] = {
+    {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}
+  };
+  std::string saida;
+
+  for(size_t i = 0; i < texto.size(); i++) {
+    bool trocou = false;
+    if(texto[i] == '&')
+      for(const std::pair<const char *, char> &e : entidades)
+        if(texto.compare(i, std::strlen(e.first), e.first) == 0) {
+          saida += e.second;
+          i += std::strlen(e.first) - 1;
+          trocou = true;
+          break;
+        }
+    if(!trocou)
+      saida += texto[i];
+  }
+  return saida;
+}
+
+// Conteudo do primeiro <marca ...>...</marca> em [de, ate), ou npos.
+static size_t procurarMarca(const std::string &xml, const char *marca, size_t de, size_t ate, std::string &conteudo) {
+  std::string abre = std::string("<") + marca, fecha = std::string("</") + marca + ">";
+
+  for(size_t i = xml.find(abre, de); i < ate; i = xml.find(abre, i + 1)) {
+    char c = xml[i + abre.size()];
+    if(c != '>' && c != ' ')
+      continue;
+    size_t inicio = xml.find('>', i);
+    size_t fim = xml.find(fecha, inicio);
+    if(inicio == std::string::npos || fim == std::string::npos || fim > ate)
+      return std::string::npos;
+    conteudo = textoXml(xml.substr(inicio + 1, fim - inicio - 1));
+    return fim + fecha.size();
+  }
+  return std::string::npos;
+}
+
+// Le so' o que interessa da softwaredb.xml: em cada <software>, o titulo e,
+// para cada <rom> ou <megarom> dos <dump>, o tipo e o hash.
+static void lerSoftwareDb(const std::string &xml, std::vector<EntradaFonte> &entradas) {
+  std::string titulo, tipo, hash;
+
+  for(size_t s = xml.find("<software>"); s != std::string::npos; s = xml.find("<software>", s + 1)) {
+    size_t fim = xml.find("</software>", s);
+    if(fim == std::string::npos)
+      break;
+    if(procurarMarca(xml, "title", s, fim, titulo) == std::string::npos)
+      titulo.clear();
+
+    for(const char *elemento : {"rom", "megarom"}) {
+      std::string corpo;
+      for(size_t r = s; (r = procurarMarca(xml, elemento, r, fim, corpo)) != std::string::npos; ) {
+        EntradaFonte e;
+        if(procurarMarca(corpo, "hash", 0, corpo.size(), hash) == std::string::npos || !entradaHash(hash, e))
+          continue;
+        if(procurarMarca(corpo, "type", 0, corpo.size(), tipo) == std::string::npos)
+          tipo.clear();
+        e.mapeador = mapeadorDoTipo(tipo);
+        e.titulo = titulo;
+        entradas.push_back(e);
+      }
+    }
+    s = fim;
+  }
+}
+
+bool BaseRoms::gerar(const std::vector<std::string> &fontes, std::string destino, size_t *total) {
+  std::vector<EntradaFonte> entradas;
+
+  for(const std::string &fonte : fontes) {
+    std::ifstream arquivo(fonte, std::ios::binary);
+    if(!arquivo)
+      return false;
+    std::string conteudo((std::istreambuf_iterator<char>(arquivo)), std::istreambuf_iterator<char>());
+    size_t inicio = conteudo.find_first_not_of(" \t\r\n");
+    if(inicio != std::string::npos && conteudo[inicio] == '<')
+      lerSoftwareDb(conteudo, entradas);
+    else if(!lerLista(conteudo, entradas))
+      return false;
+  }
+
+  // Com SHA-1 primeiro, em ordem; repetidos ficam com a ultima fonte.
+  std::stable_sort(entradas.begin(), entradas.end(), [](const EntradaFonte &a, const EntradaFonte &b) {
+    if(a.temSha1 != b.temSha1)
+      return a.temSha1;
+    return a.temSha1 ? std::memcmp(a.sha1, b.sha1, 20) < 0 : a.crc < b.crc;
+  });
+  std::vector<EntradaFonte> unicas;
+  for(const EntradaFonte &e : entradas) {
+    bool igual = !unicas.empty() && unicas.back().temSha1 == e.temSha1 &&
+                 (e.temSha1 ? !std::memcmp(unicas.back().sha1, e.sha1, 20) : unicas.back().crc == e.crc);
+    if(igual)
+      unicas.back() = e;
+    else
+      unicas.push_back(e);
+  }
+
+  std::vector<Registro> regs;
+  std::vector<IndiceCrc> crcs;
+  std::string textosBase(1, '\0');
+  std::unordered_map<std::string, uint32_t> posicoes{{"", 0}};
+  size_t comSha1 = 0;
+  for(const EntradaFonte &e : unicas) {
+    Registro r;
+    std::memset(&r, 0, sizeof(r));
+    std::memcpy(r.sha1, e.sha1, 20);
+    r.crc = e.crc;
+    r.mapeador = uint8_t(e.mapeador);
+    std::pair<std::unordered_map<std::string, uint32_t>::iterator, bool> p =
+      posicoes.emplace(e.titulo, uint32_t(textosBase.size()));
+    if(p.second) {
+      textosBase += e.titulo;
+      textosBase += '\0';
+    }
+    r.titulo = p.first->second;
+    if(e.temCrc)
+      crcs.push_back(IndiceCrc{e.crc, uint32_t(regs.size())});
+    if(e.temSha1)
+      comSha1++;
+    regs.push_back(r);
+  }
+  std::sort(crcs.begin(), crcs.end(), [](const IndiceCrc &a, const IndiceCrc &b) { return a.crc < b.crc; });
+
+  CabecalhoBase c;
+  std::memcpy(c.magica, magica, sizeof(magica));
+  c.versao = versaoBase;
+  c.registros = uint32_t(regs.size());
+  c.comSha1 = uint32_t(comSha1);
+  c.indicesCrc = uint32_t(crcs.size());
+  c.tamanhoTextos = textosBase.size();
+
+  std::ofstream saida(destino, std::ios::binary | std::ios::trunc);
+  saida.write(reinterpret_cast<const char *>(&c), sizeof(c));
+  saida.write(reinterpret_cast<const char *>(regs.data()), std::streamsize(regs.size() * sizeof(Registro)));
+  saida.write(reinterpret_cast<const char *>(crcs.data()), std::streamsize(crcs.size() * sizeof(IndiceCrc)));
+  saida.write(textosBase.data(), std::streamsize(textosBase.size()));
+  if(total)
+    *total = regs.size();
+  return saida.good();
+}
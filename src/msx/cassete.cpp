@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "cassete.h"
+
+static const uint8_t marca[8] = {0x1F, 0xA6, 0xDE, 0xBA, 0xCC, 0x13, 0x7D, 0x74};
+
+// Bloco de nome: 10 bytes com o tipo e 6 com o nome.
+static const size_t tamanhoNome = 16;
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+const char *nomeTipoCassete(TipoCassete tipo) {
+  static const char *nomes[] = {"BASIC", "ASCII", "BINARIO", "DADOS"};
+  return nomes[tipo];
+}
+
+static void procurarEscalar(const uint8_t *d, uint64_t de, uint64_t n, std::vector<uint64_t> &posicoes) {
+  for(uint64_t i = de; i + 8 <= n; i += 8)
+    if(!std::memcmp(d + i, marca, 8))
+      posicoes.push_back(i);
+}
+
+#ifdef __SSE2__
+// Os cabecalhos estao em multiplos de 8, entao basta comparar palavras de
+// 64 bits inteiras. Sem comparacao de 64 bits no SSE2, uma palavra casa
+// quando as suas duas metades de 32 bits casam.
+static uint64_t procurarSSE2(const uint8_t *d, uint64_t de, uint64_t n, std::vector<uint64_t> &posicoes) {
+  uint64_t m;
+  std::memcpy(&m, marca, 8);
+  const __m128i v = _mm_set1_epi64x(int64_t(m));
+  uint64_t i = de;
+
+  for(; i + 16 <= n; i += 16) {
+    unsigned bits = unsigned(_mm_movemask_ps(_mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(d + i)), v))));
+    if(bits & (bits >> 1) & 1)
+      posicoes.push_back(i);
+    if(bits & (bits >> 1) & 4)
+      posicoes.push_back(i + 8);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static uint64_t procurarAVX2(const uint8_t *d, uint64_t de, uint64_t n, std::vector<uint64_t> &posicoes) {
+  uint64_t m;
+  std::memcpy(&m, marca, 8);
+  const __m256i v = _mm256_set1_epi64x(int64_t(m));
+  uint64_t i = de;
+
+  // Quatro vetores por vez: a fita e' quase toda dado, e um so' teste
+  // descarta 128 bytes.
+  for(; i + 128 <= n; i += 128) {
+    const __m256i *p = reinterpret_cast<const __m256i *>(d + i);
+    __m256i a = _mm256_cmpeq_epi64(_mm256_loadu_si256(p), v);
+    __m256i b = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 1), v);
+    __m256i c = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 2), v);
+    __m256i e = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 3), v);
+    if(_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, e)),
+                          _mm256_set1_epi8(-1)))
+      continue;
+    const __m256i todos[4] = {a, b, c, e};
+    for(int k = 0; k < 4; k++) {
+      unsigned bits = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(todos[k])));
+      for(; bits; bits &= bits - 1)
+        posicoes.push_back(i + uint64_t(k) * 32 + uint64_t(__builtin_ctz(bits)) * 8);
+    }
+  }
+  return i;
+}
+#endif
+
+void Cassete::procurarCabecalhos(const uint8_t *dados, size_t n, std::vector<uint64_t> &posicoes) {
+  uint64_t i = 0;
+
+  posicoes.clear();
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = procurarAVX2(dados, i, n, posicoes);
+  i = procurarSSE2(dados, i, n, posicoes);
+#endif
+  procurarEscalar(dados, i, n, posicoes);
+}
+
+bool Cassete::abrir(std::string arquivo) {
+  fechar();
+  if(!mapa.abrir(arquivo))
+    return false;
+  mapa.setSequencial(true);
+  indexar();
+  return true;
+}
+
+void Cassete::fechar() {
+  mapa.fechar();
+  arquivos.clear();
+}
+
+bool Cassete::aberto() const {
+  return mapa.aberto();
+}
+
+const std::vector<ArquivoCassete> &Cassete::getArquivos() const {
+  return arquivos;
+}
+
+static bool tipoBlocoNome(const uint8_t *p, uint64_t n, TipoCassete &tipo) {
+  if(n < tamanhoNome || std::count(p, p + 10, p[0]) != 10)
+    return false;
+  switch(p[0]) {
+    case 0xD3: tipo = casseteBasic; return true;
+    case 0xEA: tipo = casseteAscii; return true;
+    case 0xD0: tipo = casseteBinario; return true;
+  }
+  return false;
+}
+
+// Tamanho do programa BASIC seguindo os ponteiros de linha, que partem de
+// #8001; o bloco da fita ainda traz zeros depois do fim. Ponteiros que nao
+// avancam deixam o bloco inteiro.
+static uint64_t tamanhoBasic(const uint8_t *p, uint64_t n) {
+  uint64_t pos = 0;
+
+  while(pos + 2 <= n) {
+    uint16_t ligacao = le16(p + pos);
+    if(!ligacao)
+      return pos + 2;
+    if(ligacao < 0x8001 || uint64_t(ligacao - 0x8001) <= pos || uint64_t(ligacao - 0x8001) > n)
+      return n;
+    pos = ligacao - 0x8001;
+  }
+  return n;
+}
+
+void Cassete::indexar() {
+  const uint8_t *d = mapa.getDados();
+  uint64_t n = mapa.getTamanho();
+  std::vector<uint64_t> posicoes;
+  // Um arquivo de nome ainda espera o(s) seu(s) bloco(s) de dados.
+  bool esperando = false;
+
+  procurarCabecalhos(d, size_t(n), posicoes);
+  for(size_t k = 0; k < posicoes.size(); k++) {
+    BlocoCassete bloco{posicoes[k] + 8, (k + 1 < posicoes.size() ? posicoes[k + 1] : n) - posicoes[k] - 8};
+    const uint8_t *p = d + bloco.inicio;
+    TipoCassete tipo;
+
+    if(tipoBlocoNome(p, bloco.tamanho, tipo)) {
+      std::string nome(reinterpret_cast<const char *>(p + 10), 6);
+      nome.erase(nome.find_last_not_of(' ') + 1);
+      arquivos.push_back(ArquivoCassete{nome, tipo, {}, 0, 0, 0, 0});
+      esperando = true;
+      continue;
+    }
+    if(!esperando)
+      arquivos.push_back(ArquivoCassete{"", casseteDados, {}, 0, 0, 0, 0});
+    ArquivoCassete &a = arquivos.back();
+    a.blocos.push_back(bloco);
+
+    switch(a.tipo) {
+      case casseteBasic:
+        a.tamanho = 1 + tamanhoBasic(p, bloco.tamanho);
+        esperando = false;
+        break;
+      case casseteBinario:
+        if(bloco.tamanho >= 6) {
+          a.inicio = le16(p);
+          a.fim = le16(p + 2);
+          a.execucao = le16(p + 4);
+          a.tamanho = 7 + std::min<uint64_t>(a.fim >= a.inicio ? a.fim - a.inicio + 1u : ~0ull, bloco.tamanho - 6);
+        }
+        esperando = false;
+        break;
+      case casseteAscii: {
+        // Blocos de 256 bytes ate' o que tem o #1A.
+        const uint8_t *eof = static_cast<const uint8_t *>(std::memchr(p, 0x1A, bloco.tamanho));
+        a.tamanho += eof ? uint64_t(eof - p) : bloco.tamanho;
+        esperando = !eof;
+        break;
+      }
+      case casseteDados:
+        a.tamanho = bloco.tamanho;
+        break;
+    }
+  }
+}
+
+bool Cassete::extrair(const ArquivoCassete &arquivo, std::vector<uint8_t> &dados) const {
+  const uint8_t *d = mapa.getDados();
+
+  dados.clear();
+  if(!aberto() || arquivo.blocos.empty())
+    return false;
+  dados.reserve(arquivo.tamanho);
+  const BlocoCassete &primeiro = arquivo.blocos.front();
+  switch(arquivo.tipo) {
+    case casseteBasic:
+      dados.push_back(0xFF);
+      dados.insert(dados.end(), d + primeiro.inicio, d + primeiro.inicio + (arquivo.tamanho - 1));
+      break;
+    case casseteBinario: {
+      if(arquivo.tamanho < 7)
+        return false;
+      const uint8_t cabecalho[7] = {0xFE, uint8_t(arquivo.inicio), uint8_t(arquivo.inicio >> 8), uint8_t(arquivo.fim),
+                                    uint8_t(arquivo.fim >> 8), uint8_t(arquivo.execucao),
+                                    uint8_t(arquivo.execucao >> 8)};
+      dados.insert(dados.end(), cabecalho, cabecalho + 7);
+      dados.insert(dados.end(), d + primeiro.inicio + 6, d + primeiro.inicio + 6 + (arquivo.tamanho - 7));
+      break;
+    }
+    case casseteAscii:
+    case casseteDados:
+      for(const BlocoCassete &b : arquivo.blocos) {
+        uint64_t falta = std::min(b.tamanho, arquivo.tamanho - dados.size());
+        dados.insert(dados.end(), d + b.inicio, d + b.inicio + falta);
+      }
+      break;
+  }
+  return true;
+}
+
+bool Cassete::extrairTudo(std::string destino, uint64_t *bytes, Gravador *gravador,
+                          std::vector<std::string> *avisos) const {
+  static const char *extensoes[] = {".BAS", ".ASC", ".BIN", ".DAT"};
+  Gravador direto;
+  Gravador &g = gravador ? *gravador : direto;
+  std::map<std::string, int> usados;
+  bool ok = true;
+  int blocosSoltos = 0;
+
+  if(!aberto() || !g.criarDiretorio(destino))
+    return false;
+  for(const ArquivoCassete &a : arquivos) {
+    if(a.blocos.empty()) {
+      if(avisos)
+        avisos->push_back("cabecalho de " + a.nome + " sem bloco de dados");
+      continue;
+    }
+    std::string nome = a.nome;
+    if(a.tipo == casseteDados) {
+      char numero[24];
+      snprintf(numero, sizeof(numero), "BLOCO%02d", ++blocosSoltos);
+      nome = numero;
+    }
+    for(char &c : nome)
+      if(c == '/' || c == '\\' || uint8_t(c) < 0x20 || uint8_t(c) >= 0x7F)
+        c = '_';
+    if(nome.empty())
+      nome = "_";
+    int n = ++usados[nome + extensoes[a.tipo]];
+    if(n > 1)
+      nome += "_" + std::to_string(n);
+
+    std::vector<uint8_t> dados;
+    if(!extrair(a, dados)) {
+      ok = false;
+      continue;
+    }
+    if(bytes)
+      *bytes += dados.size();
+    if(!g.gravar(destino + "/" + nome + extensoes[a.tipo], std::move(dados)))
+      ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "conversor.h"
+
+// Pares de cores do SCREEN 2 que passam da primeira fase para a difusao.
+static const unsigned candidatosPar = 6;
+// Ciclos do k-means depois do median cut no SCREEN 5.
+static const unsigned ciclosKMeans = 6;
+
+// Nivel mais proximo de cada valor de 8 bits: 3 bits para a paleta e o
+// SCREEN 8, 2 bits para o azul do SCREEN 8 (que o VDP estende para 3).
+struct Proximos {
+  uint8_t n3[256] = {};
+  uint8_t azul[256] = {};
+
+  constexpr Proximos() {
+    for(int v = 0; v < 256; v++) {
+      n3[v] = uint8_t((v * 7 + 127) / 255);
+      int melhor = 0;
+      for(int b = 1; b < 4; b++) {
+        int nivel = niveisCor.n3[(b << 1) | (b >> 1)], atual = niveisCor.n3[(melhor << 1) | (melhor >> 1)];
+        if((v - nivel) * (v - nivel) < (v - atual) * (v - atual))
+          melhor = b;
+      }
+      azul[v] = uint8_t(melhor);
+    }
+  }
+};
+
+static constexpr Proximos proximos = Proximos();
+
+static int distancia(const int a[3], const int b[3]) {
+  return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+}
+
+static int limitar(int v, int minimo, int maximo) {
+  return v < minimo ? minimo : v > maximo ? maximo : v;
+}
+
+static void componentes(uint32_t p, int cor[3]) {
+  for(int c = 0; c < 3; c++)
+    cor[c] = int((p >> (c * 8)) & 0xFF);
+}
+
+static void redimensionar(const ImagemRGBA &origem, unsigned largura, unsigned altura, ImagemRGBA &destino) {
+  destino.largura = largura;
+  destino.altura = altura;
+  destino.pixels.resize(size_t(largura) * altura);
+  for(unsigned y = 0; y < altura; y++) {
+    const uint32_t *linha = origem.pixels.data() + size_t(y * origem.altura / altura) * origem.largura;
+    for(unsigned x = 0; x < largura; x++)
+      destino.pixels[size_t(y) * largura + x] = linha[x * origem.largura / largura];
+  }
+}
+
+// Melhor grupo YJK para 4 pixels. J e K saem da media pela conversao do
+// manual do V9958 (Y = B/2 + R/4 + G/8) e sao ajustados em volta; para
+// cada J, K o Y de cada pixel vem do minimo continuo, arredondado e
+// conferido com o vizinho de cada lado.
+static void resolverYJK(const int alvo[4][3], uint8_t bytes[4], int saida[4][3]) {
+  float t[4][3], media[3] = {0, 0, 0};
+
+  for(int i = 0; i < 4; i++)
+    for(int c = 0; c < 3; c++) {
+      t[i][c] = alvo[i][c] * 31.0f / 255.0f;
+      media[c] += t[i][c] / 4;
+    }
+  float y0 = media[2] / 2 + media[0] / 4 + media[1] / 8;
+  int j0 = int(std::lround(media[0] - y0)), k0 = int(std::lround(media[1] - y0));
+
+  int melhorCusto = -1;
+  for(int dj = -2; dj <= 2; dj++)
+    for(int dk = -2; dk <= 2; dk++) {
+      int j = limitar(j0 + dj, -32, 31), k = limitar(k0 + dk, -32, 31);
+      int custo = 0, ys[4], cores[4][3];
+      for(int i = 0; i < 4 && (melhorCusto < 0 || custo < melhorCusto); i++) {
+        float estimado = ((t[i][0] - j) + (t[i][1] - k) + 1.25f * (t[i][2] + 0.5f * j + 0.25f * k)) / 3.5625f;
+        int centro = int(std::lround(estimado)), menor = -1;
+        for(int y = std::max(0, centro - 1); y <= std::min(31, centro + 1); y++) {
+          int cor[3] = {niveisCor.n5[limitar(y + j, 0, 31)], niveisCor.n5[limitar(y + k, 0, 31)],
+                        niveisCor.n5[limitar((5 * y - 2 * j - k + 2) >> 2, 0, 31)]};
+          int d = distancia(cor, alvo[i]);
+          if(menor < 0 || d < menor) {
+            menor = d;
+            ys[i] = y;
+            std::copy(cor, cor + 3, cores[i]);
+          }
+        }
+        if(menor < 0) {
+          // Estimativa fora de 0..31: o extremo mais perto.
+          ys[i] = limitar(centro, 0, 31);
+          int cor[3] = {niveisCor.n5[limitar(ys[i] + j, 0, 31)], niveisCor.n5[limitar(ys[i] + k, 0, 31)],
+                        niveisCor.n5[limitar((5 * ys[i] - 2 * j - k + 2) >> 2, 0, 31)]};
+          menor = distancia(cor, alvo[i]);
+          std::copy(cor, cor + 3, cores[i]);
+        }
+        custo += menor;
+        if(i == 3 && (melhorCusto < 0 || custo < melhorCusto)) {
+          melhorCusto = custo;
+          bytes[0] = uint8_t((ys[0] << 3) | (k & 7));
+          bytes[1] = uint8_t((ys[1] << 3) | ((k >> 3) & 7));
+          bytes[2] = uint8_t((ys[2] << 3) | (j & 7));
+          bytes[3] = uint8_t((ys[3] << 3) | ((j >> 3) & 7));
+          for(int m = 0; m < 4; m++)
+            std::copy(cores[m], cores[m] + 3, saida[m]);
+        }
+      }
+    }
+}
+
+ConversorTela::ConversorTela(PoolTarefas &pool) : pool(pool), difusao(true), proximaLinha(0) {
+}
+
+void ConversorTela::paralelo(size_t n, const std::function<void(size_t, size_t)> &faixa) {
+  size_t partes = std::min<size_t>(n, pool.getThreads() * 4);
+
+  for(size_t p = 0; p < partes; p++)
+    pool.adicionar([&, p] { faixa(n * p / partes, n * (p + 1) / partes); });
+  pool.esperar();
+}
+
+void ConversorTela::frenteOnda(unsigned passo, unsigned direita,
+                               const std::function<void(unsigned, unsigned)> &trecho) {
+  unsigned largura = alvo.largura, altura = alvo.altura;
+
+  progresso.reset(new std::atomic<unsigned>[altura]);
+  for(unsigned y = 0; y < altura; y++)
+    progresso[y] = 0;
+  proximaLinha = 0;
+  // As linhas sao pegas na ordem por tarefas que ja' estao rodando, entao
+  // a linha de cima de qualquer uma esta' sempre andando: ninguem espera
+  // por uma tarefa ainda na fila.
+  for(unsigned t = 0; t < pool.getThreads(); t++)
+    pool.adicionar([&] {
+      for(;;) {
+        unsigned y = proximaLinha++;
+        if(y >= altura)
+          return;
+        for(unsigned x = 0; x < largura; x += passo) {
+          // O pixel em andamento na linha de cima ainda soma erro na
+          // coluna anterior a ele; essa coluna tem que estar alem de tudo
+          // o que este trecho le e escreve nesta linha.
+          if(difusao && y > 0) {
+            unsigned precisa = std::min(x + passo + direita + 1, largura);
+            while(progresso[y - 1].load(std::memory_order_acquire) < precisa)
+              std::this_thread::yield();
+          }
+          trecho(x, y);
+          progresso[y].store(std::min(x + passo, largura), std::memory_order_release);
+        }
+      }
+    });
+  pool.esperar();
+}
+
+void ConversorTela::ajustado(unsigned x, unsigned y, int cor[3]) const {
+  size_t i = size_t(y) * alvo.largura + x;
+
+  componentes(alvo.pixels[i], cor);
+  for(int c = 0; c < 3; c++)
+    cor[c] = limitar(cor[c] + ((erro[i * 3 + c] + 8) >> 4), 0, 255);
+}
+
+void ConversorTela::espalhar(unsigned x, unsigned y, const int e[3], unsigned direita) {
+  size_t largura = alvo.largura, i = size_t(y) * largura + x;
+
+  if(!difusao)
+    return;
+  for(int c = 0; c < 3; c++) {
+    if(x + direita < largura)
+      erro[(i + direita) * 3 + c] += 7 * e[c];
+    if(y + 1 < alvo.altura) {
+      if(x > 0)
+        erro[(i + largura - 1) * 3 + c] += 3 * e[c];
+      erro[(i + largura) * 3 + c] += 5 * e[c];
+      if(x + 1 < largura)
+        erro[(i + largura + 1) * 3 + c] += e[c];
+    }
+  }
+}
+
+// Tres bancos de 256 padroes, um por terco da tela, com a tabela de nomes
+// em sequencia: cada caractere da tela tem padrao e cores proprios.
+void ConversorTela::screen2(std::vector<uint8_t> &vram) {
+  uint32_t rgba[16];
+  int paleta[16][3];
+  const unsigned segmentos = 32 * 192;
+  std::vector<uint8_t> pares(segmentos * candidatosPar);
+
+  Tela().paleta(2, rgba);
+  for(int c = 0; c < 16; c++)
+    componentes(rgba[c], paleta[c]);
+
+  // Fase 1: os pares de cores (1 a 15; a 0 e' transparente) que melhor
+  // cobrem cada trecho sozinho.
+  paralelo(segmentos, [&](size_t de, size_t ate) {
+    for(size_t s = de; s < ate; s++) {
+      unsigned x = unsigned(s % 32) * 8, y = unsigned(s / 32);
+      int d[8][16];
+      for(int i = 0; i < 8; i++) {
+        int cor[3];
+        componentes(alvo.pixels[size_t(y) * 256 + x + i], cor);
+        for(int c = 1; c < 16; c++)
+          d[i][c] = distancia(cor, paleta[c]);
+      }
+      int custos[candidatosPar];
+      uint8_t *melhores = pares.data() + s * candidatosPar;
+      unsigned n = 0;
+      for(int a = 1; a < 16; a++)
+        for(int b = a + 1; b < 16; b++) {
+          int custo = 0;
+          for(int i = 0; i < 8; i++)
+            custo += std::min(d[i][a], d[i][b]);
+          if(n == candidatosPar && custo >= custos[n - 1])
+            continue;
+          unsigned k = n < candidatosPar ? n++ : n - 1;
+          for(; k > 0 && custos[k - 1] > custo; k--) {
+            custos[k] = custos[k - 1];
+            melhores[k] = melhores[k - 1];
+          }
+          custos[k] = custo;
+          melhores[k] = uint8_t((a << 4) | b);
+        }
+    }
+  });
+
+  // Fase 2: entre os candidatos, o que fica melhor com o erro que chega.
+  frenteOnda(8, 1, [&](unsigned x, unsigned y) {
+    const uint8_t *candidatos = pares.data() + (y * 32 + x / 8) * candidatosPar;
+    int base[8][3];
+    for(int i = 0; i < 8; i++) {
+      size_t p = size_t(y) * 256 + x + i;
+      componentes(alvo.pixels[p], base[i]);
+      for(int c = 0; c < 3; c++)
+        base[i][c] = base[i][c] * 16 + erro[p * 3 + c];
+    }
+
+    uint8_t par = candidatos[0];
+    int64_t melhor = -1;
+    for(unsigned k = 0; k < candidatosPar && difusao; k++) {
+      const int *a = paleta[candidatos[k] >> 4], *b = paleta[candidatos[k] & 15];
+      int vem[3] = {0, 0, 0};
+      int64_t custo = 0;
+      for(int i = 0; i < 8; i++) {
+        int cor[3];
+        for(int c = 0; c < 3; c++)
+          cor[c] = limitar((base[i][c] + vem[c] + 8) >> 4, 0, 255);
+        int da = distancia(cor, a), db = distancia(cor, b);
+        const int *escolhida = da <= db ? a : b;
+        custo += std::min(da, db);
+        for(int c = 0; c < 3; c++)
+          vem[c] = 7 * (cor[c] - escolhida[c]);
+      }
+      if(melhor < 0 || custo < melhor) {
+        melhor = custo;
+        par = candidatos[k];
+      }
+    }
+
+    int frente = par >> 4, fundo = par & 15;
+    uint8_t padrao = 0;
+    for(unsigned i = 0; i < 8; i++) {
+      int cor[3], e[3];
+      ajustado(x + i, y, cor);
+      bool acesa = distancia(cor, paleta[frente]) <= distancia(cor, paleta[fundo]);
+      const int *escolhida = paleta[acesa ? frente : fundo];
+      if(acesa)
+        padrao |= uint8_t(0x80 >> i);
+      for(int c = 0; c < 3; c++)
+        e[c] = cor[c] - escolhida[c];
+      espalhar(x + i, y, e);
+    }
+    size_t pos = size_t(y >> 6) * 0x800 + (((y >> 3) & 7) * 32 + x / 8) * 8 + (y & 7);
+    vram[pos] = padrao;
+    vram[0x2000 + pos] = par;
+  });
+
+  for(unsigned i = 0; i < 768; i++)
+    vram[0x1800 + i] = uint8_t(i);
+  // Sem sprites, e a paleta padrao para o MSX2 mostrar as mesmas cores.
+  vram[0x1B00] = 0xD0;
+  for(int c = 0; c < 16; c++) {
+    vram[0x1B80 + c * 2] = uint8_t((proximos.n3[paleta[c][0]] << 4) | proximos.n3[paleta[c][2]]);
+    vram[0x1B81 + c * 2] = proximos.n3[paleta[c][1]];
+  }
+}
+
+// Paleta por median cut no histograma de 15 bits, refinada por k-means e
+// arredondada para os 3 bits por componente do V9938.
+void ConversorTela::screen5(std::vector<uint8_t> &vram) {
+  struct Entrada {
+    int cor[3];
+    uint32_t peso;
+  };
+  std::vector<uint32_t> histograma(1 << 15, 0);
+  std::mutex trava;
+
+  paralelo(alvo.pixels.size(), [&](size_t de, size_t ate) {
+    std::vector<uint32_t> local(1 << 15, 0);
+    for(size_t i = de; i < ate; i++) {
+      uint32_t p = alvo.pixels[i];
+      local[((p >> 3) & 0x1F) << 10 | ((p >> 11) & 0x1F) << 5 | ((p >> 19) & 0x1F)]++;
+    }
+    std::lock_guard<std::mutex> l(trava);
+    for(size_t i = 0; i < local.size(); i++)
+      histograma[i] += local[i];
+  });
+
+  std::vector<Entrada> entradas;
+  for(uint32_t i = 0; i < histograma.size(); i++)
+    if(histograma[i])
+      entradas.push_back(Entrada{{niveisCor.n5[i >> 10], niveisCor.n5[(i >> 5) & 31], niveisCor.n5[i & 31]},
+                                 histograma[i]});
+
+  // Median cut: divide a caixa de maior extensao na mediana ponderada.
+  std::vector<std::pair<size_t, size_t>> caixas{{0, entradas.size()}};
+  while(caixas.size() < 16) {
+    size_t escolhida = 0;
+    int maior = 0, eixo = 0;
+    for(size_t k = 0; k < caixas.size(); k++)
+      for(int c = 0; c < 3; c++) {
+        int minimo = 255, maximo = 0;
+        for(size_t i = caixas[k].first; i < caixas[k].second; i++) {
+          minimo = std::min(minimo, entradas[i].cor[c]);
+          maximo = std::max(maximo, entradas[i].cor[c]);
+        }
+        if(maximo - minimo > maior) {
+          maior = maximo - minimo;
+          escolhida = k;
+          eixo = c;
+        }
+      }
+    if(!maior)
+      break;
+    std::pair<size_t, size_t> caixa = caixas[escolhida];
+    std::sort(entradas.begin() + caixa.first, entradas.begin() + caixa.second,
+              [eixo](const Entrada &a, const Entrada &b) { return a.cor[eixo] < b.cor[eixo]; });
+    uint64_t total = 0, soma = 0;
+    for(size_t i = caixa.first; i < caixa.second; i++)
+      total += entradas[i].peso;
+    size_t meio = caixa.first;
+    while(meio < caixa.second - 1 && (soma += entradas[meio].peso) * 2 < total)
+      meio++;
+    meio = limitar(int(meio + 1), int(caixa.first + 1), int(caixa.second - 1));
+    caixas[escolhida].second = meio;
+    caixas.emplace_back(meio, caixa.second);
+  }
+
+  std::vector<std::array<double, 3>> centros(caixas.size());
+  for(size_t k = 0; k < caixas.size(); k++) {
+    double soma[3] = {0, 0, 0}, peso = 0;
+    for(size_t i = caixas[k].first; i < caixas[k].second; i++) {
+      for(int c = 0; c < 3; c++)
+        soma[c] += double(entradas[i].cor[c]) * entradas[i].peso;
+      peso += entradas[i].peso;
+    }
+    for(int c = 0; c < 3; c++)
+      centros[k][c] = peso ? soma[c] / peso : 0;
+  }
+
+  for(unsigned ciclo = 0; ciclo < ciclosKMeans && !entradas.empty(); ciclo++) {
+    std::vector<std::array<double, 4>> somas(centros.size(), std::array<double, 4>{0, 0, 0, 0});
+    paralelo(entradas.size(), [&](size_t de, size_t ate) {
+      std::vector<std::array<double, 4>> local(centros.size(), std::array<double, 4>{0, 0, 0, 0});
+      for(size_t i = de; i < ate; i++) {
+        const Entrada &e = entradas[i];
+        size_t perto = 0;
+        double menor = -1;
+        for(size_t k = 0; k < centros.size(); k++) {
+          double d = 0;
+          for(int c = 0; c < 3; c++)
+            d += (e.cor[c] - centros[k][c]) * (e.cor[c] - centros[k][c]);
+          if(menor < 0 || d < menor) {
+            menor = d;
+            perto = k;
+          }
+        }
+        for(int c = 0; c < 3; c++)
+          local[perto][c] += double(e.cor[c]) * e.peso;
+        local[perto][3] += e.peso;
+      }
+      std::lock_guard<std::mutex> l(trava);
+      for(size_t k = 0; k < local.size(); k++)
+        for(int c = 0; c < 4; c++)
+          somas[k][c] += local[k][c];
+    });
+    for(size_t k = 0; k < centros.size(); k++)
+      if(somas[k][3] > 0)
+        for(int c = 0; c < 3; c++)
+          centros[k][c] = somas[k][c] / somas[k][3];
+  }
+
+  int paleta[16][3] = {};
+  for(size_t k = 0; k < centros.size(); k++)
+    for(int c = 0; c < 3; c++)
+      paleta[k][c] = niveisCor.n3[proximos.n3[limitar(int(std::lround(centros[k][c])), 0, 255)]];
+
+  std::vector<uint8_t> perto(1 << 15);
+  paralelo(perto.size(), [&](size_t de, size_t ate) {
+    for(size_t i = de; i < ate; i++) {
+      int cor[3] = {niveisCor.n5[i >> 10], niveisCor.n5[(i >> 5) & 31], niveisCor.n5[i & 31]}, menor = -1;
+      for(int k = 0; k < 16; k++) {
+        int d = distancia(cor, paleta[k]);
+        if(menor < 0 || d < menor) {
+          menor = d;
+          perto[i] = uint8_t(k);
+        }
+      }
+    }
+  });
+
+  frenteOnda(16, 1, [&](unsigned x, unsigned y) {
+    for(unsigned i = x; i < x + 16; i++) {
+      int cor[3], e[3];
+      ajustado(i, y, cor);
+      uint8_t k = perto[(cor[0] >> 3) << 10 | (cor[1] >> 3) << 5 | (cor[2] >> 3)];
+      for(int c = 0; c < 3; c++)
+        e[c] = cor[c] - paleta[k][c];
+      espalhar(i, y, e);
+      uint8_t &byte = vram[size_t(y) * 128 + i / 2];
+      byte = i & 1 ? uint8_t(byte | k) : uint8_t(k << 4);
+    }
+  });
+
+  // Sem sprites: a partir do SCREEN 4 o Y que encerra a tabela de atributos
+  // e' #D8, nao o #D0 do SCREEN 2. So' a pagina 0 e' gravada, entao nao ha'
+  // a tabela da pagina 1 (#FA00).
+  vram[0x7600] = 0xD8;
+  for(int k = 0; k < 16; k++) {
+    vram[0x7680 + k * 2] = uint8_t((proximos.n3[paleta[k][0]] << 4) | proximos.n3[paleta[k][2]]);
+    vram[0x7681 + k * 2] = proximos.n3[paleta[k][1]];
+  }
+}
+
+void ConversorTela::screen8(std::vector<uint8_t> &vram) {
+  frenteOnda(16, 1, [&](unsigned x, unsigned y) {
+    for(unsigned i = x; i < x + 16; i++) {
+      int cor[3], e[3];
+      ajustado(i, y, cor);
+      int r = proximos.n3[cor[0]], g = proximos.n3[cor[1]], b = proximos.azul[cor[2]];
+      e[0] = cor[0] - niveisCor.n3[r];
+      e[1] = cor[1] - niveisCor.n3[g];
+      e[2] = cor[2] - niveisCor.n3[(b << 1) | (b >> 1)];
+      espalhar(i, y, e);
+      vram[size_t(y) * 256 + i] = uint8_t((g << 5) | (r << 2) | b);
+    }
+  });
+}
+
+// O grupo e' resolvido de uma vez; o erro de cada pixel segue para o pixel
+// na mesma posicao do grupo seguinte, ja' que os do proprio grupo estao
+// decididos.
+void ConversorTela::screen12(std::vector<uint8_t> &vram) {
+  frenteOnda(4, 4, [&](unsigned x, unsigned y) {
+    int cores[4][3], saida[4][3];
+    for(unsigned i = 0; i < 4; i++)
+      ajustado(x + i, y, cores[i]);
+    resolverYJK(cores, &vram[size_t(y) * 256 + x], saida);
+    for(unsigned i = 0; i < 4; i++) {
+      int e[3];
+      for(int c = 0; c < 3; c++)
+        e[c] = cores[i][c] - saida[i][c];
+      espalhar(x + i, y, e, 4);
+    }
+  });
+}
+
+bool ConversorTela::converter(const ImagemRGBA &imagem, unsigned modo, bool difusao, std::vector<uint8_t> &vram) {
+  if((modo != 2 && modo != 5 && modo != 8 && modo != 12) || !imagem.largura || !imagem.altura)
+    return false;
+
+  unsigned altura = modo == 2 || imagem.altura <= 192 ? 192 : 212;
+  redimensionar(imagem, 256, altura, alvo);
+  this->difusao = difusao;
+  erro.assign(alvo.pixels.size() * 3, 0);
+
+  if(modo == 2) {
+    vram.assign(0x3800, 0);
+    screen2(vram);
+  } else if(modo == 5) {
+    vram.assign(0x76A0, 0);
+    screen5(vram);
+  } else {
+    vram.assign(size_t(256) * altura, 0);
+    if(modo == 8)
+      screen8(vram);
+    else
+      screen12(vram);
+  }
+  return true;
+}
+
+bool gravarBsave(std::string arquivo, const std::vector<uint8_t> &dados) {
+  std::ofstream saida(arquivo, std::ios::binary);
+
+  if(!saida || dados.empty() || dados.size() > 0x10000)
+    return false;
+  size_t fim = dados.size() - 1;
+  uint8_t cabecalho[7] = {0xFE, 0, 0, uint8_t(fim), uint8_t(fim >> 8), 0, 0};
+  saida.write((const char *) cabecalho, sizeof(cabecalho));
+  saida.write((const char *) dados.data(), std::streamsize(dados.size()));
+  return bool(saida);
+}
@@ -0,0 +1,1072 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <ctime>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "disco.h"
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return uint32_t(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24));
+}
+
+static std::string maiusculas(std::string texto) {
+  for(char &c : texto)
+    if(c >= 'a' && c <= 'z')
+      c = char(c - 'a' + 'A');
+  return texto;
+}
+
+bool EntradaDisco::diretorio() const {
+  return atributos & 0x10;
+}
+
+Gravador::~Gravador() {
+}
+
+bool Gravador::criarDiretorio(const std::string &caminho) {
+  return mkdir(caminho.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+bool Gravador::gravar(const std::string &caminho, std::vector<uint8_t> &&dados) {
+  FILE *f = std::fopen(caminho.c_str(), "wb");
+  bool ok = f && std::fwrite(dados.data(), 1, dados.size(), f) == dados.size();
+
+  if(f && std::fclose(f) != 0)
+    ok = false;
+  return ok;
+}
+
+// Linhas do cache de setores: 512 setores de FAT e diretorio cobrem a FAT
+// inteira de um disquete e boa parte da de uma particao FAT16 grande.
+static const size_t linhasCache = 512;
+
+static bool tipoFat(uint8_t tipo) {
+  return tipo == 0x01 || tipo == 0x04 || tipo == 0x06 || tipo == 0x0E;
+}
+
+static bool tipoEstendida(uint8_t tipo) {
+  return tipo == 0x05 || tipo == 0x0F;
+}
+
+// Um caminho do MSX-DOS 2 tem no maximo 63 caracteres, entao nenhum disco
+// valido passa de 32 niveis de subdiretorios.
+static const unsigned maximoNiveis = 64;
+
+// Diario: assinatura, numero de registros e bytes por setor; cada registro
+// e' a posicao absoluta na imagem seguida do setor; no fim, a soma de tudo
+// que veio antes e a marca de fim. Sem a marca, o diario nao vale.
+static const char assinaturaDiario[8] = { 'M', 'S', 'X', 'J', 'N', 'L', '1', 0 };
+static const char marcaDiario[4] = { 'F', 'I', 'M', 0 };
+
+static uint32_t somaDiario(const uint8_t *p, uint64_t n) {
+  uint32_t h = 2166136261u;
+
+  while(n--)
+    h = (h ^ *p++) * 16777619u;
+  return h;
+}
+
+static void poe16(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+}
+
+static void poe32(uint8_t *p, uint32_t v) {
+  poe16(p, v);
+  poe16(p + 2, v >> 16);
+}
+
+static bool lerTudo(int fd, std::vector<uint8_t> &dados) {
+  struct stat st;
+
+  if(fstat(fd, &st) < 0)
+    return false;
+  dados.resize(st.st_size);
+  uint64_t lidos = 0;
+  while(lidos < dados.size()) {
+    ssize_t r = pread(fd, &dados[lidos], dados.size() - lidos, off_t(lidos));
+    if(r <= 0)
+      return false;
+    lidos += r;
+  }
+  return true;
+}
+
+static bool gravarTudo(int fd, const uint8_t *dados, uint64_t n, uint64_t pos) {
+  while(n) {
+    ssize_t r = pwrite(fd, dados, n, off_t(pos));
+    if(r <= 0)
+      return false;
+    dados += r;
+    pos += r;
+    n -= r;
+  }
+  return true;
+}
+
+// Termina uma transacao interrompida: um diario completo e' aplicado de novo
+// (gravar o mesmo setor duas vezes nao faz mal) e um incompleto e' jogado
+// fora, ja' que a imagem so' e' tocada depois do diario completo no disco.
+// Sem 'aplicar' nada e' gravado nem apagado. Falso se sobrou um diario
+// completo que nao foi aplicado: a imagem esta' no meio de uma transacao.
+static bool recuperarDiario(const std::string &imagem, bool aplicar) {
+  std::string nome = imagem + ".jnl";
+  std::vector<uint8_t> diario;
+  int d = open(nome.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if(d < 0)
+    return true;
+  bool lido = lerTudo(d, diario);
+  close(d);
+  if(!lido)
+    return !aplicar;
+
+  bool valido = diario.size() >= 24 && std::memcmp(diario.data(), assinaturaDiario, 8) == 0 &&
+                std::memcmp(&diario[diario.size() - 4], marcaDiario, 4) == 0 &&
+                le32(&diario[diario.size() - 8]) == somaDiario(diario.data(), diario.size() - 8);
+  uint64_t registros = valido ? le32(&diario[8]) : 0;
+  uint64_t bytesSetor = valido ? le32(&diario[12]) : 0;
+  if(valido && 16 + registros * (8 + bytesSetor) + 8 != diario.size())
+    valido = false;
+  if(!aplicar)
+    return !valido;
+
+  if(valido) {
+    int f = open(imagem.c_str(), O_RDWR | O_CLOEXEC);
+    if(f < 0)
+      return false;
+    bool ok = true;
+    for(uint64_t i = 0; i < registros && ok; i++) {
+      const uint8_t *r = &diario[16 + i * (8 + bytesSetor)];
+      uint64_t pos = le32(r) | (uint64_t(le32(r + 4)) << 32);
+      ok = gravarTudo(f, r + 8, bytesSetor, pos);
+    }
+    ok = ok && fdatasync(f) == 0;
+    close(f);
+    if(!ok)
+      return false;
+  }
+  unlink(nome.c_str());
+  return true;
+}
+
+// Converte "nome.ext" para a forma de 11 bytes do diretorio; falso se nao couber no 8.3.
+static bool nome83(std::string nome, uint8_t *destino) {
+  static const char proibidos[] = "\"*+,./:;<=>?[\\]| ";
+  size_t ponto = nome.find_last_of('.');
+  std::string raiz = nome.substr(0, ponto);
+  std::string extensao = ponto == std::string::npos ? "" : nome.substr(ponto + 1);
+
+  if(raiz.empty() || raiz.size() > 8 || extensao.size() > 3)
+    return false;
+  std::memset(destino, ' ', 11);
+  for(size_t i = 0; i < raiz.size() + extensao.size(); i++) {
+    char c = i < raiz.size() ? raiz[i] : extensao[i - raiz.size()];
+    if(uint8_t(c) < 0x20 || std::strchr(proibidos, c))
+      return false;
+    destino[i < raiz.size() ? i : 8 + i - raiz.size()] = uint8_t(c);
+  }
+  if(destino[0] == 0xE5)
+    destino[0] = 0x05;
+  return true;
+}
+
+Disco::Disco() : fd(-1), escrita(false), base(0), bytesSetor(512), totalClusters(0), fat16(false), fimCadeia(0xFF8),
+                 livres(-1), ultima(nullptr), dicaLivre(2) {
+}
+
+Disco::~Disco() {
+  fechar();
+}
+
+void Disco::fechar() {
+  if(fd >= 0)
+    close(fd);
+  fd = -1;
+  arquivo.clear();
+  escrita = false;
+  std::vector<uint8_t>().swap(memoria);
+  particoes.clear();
+  alterados.clear();
+  dicaLivre = 2;
+  cache.clear();
+  indiceCache.clear();
+  ultima = nullptr;
+  base = 0;
+  totalClusters = 0;
+  livres = -1;
+}
+
+bool Disco::aberto() const {
+  return fd >= 0 || !memoria.empty();
+}
+
+bool Disco::getEscrita() const {
+  return escrita;
+}
+
+const std::vector<ParticaoDisco> &Disco::getParticoes() const {
+  return particoes;
+}
+
+bool Disco::getFat16() const {
+  return fat16;
+}
+
+uint32_t Disco::getBytesSetor() const {
+  return bytesSetor;
+}
+
+uint32_t Disco::getBytesCluster() const {
+  return bytesSetor * setoresCluster;
+}
+
+uint32_t Disco::getTotalClusters() const {
+  return totalClusters;
+}
+
+uint32_t Disco::getClustersLivres() {
+  if(livres < 0 && aberto()) {
+    uint32_t seguinte;
+    livres = 0;
+    for(uint32_t c = 2; c < totalClusters + 2; c++)
+      if(proximo(c, seguinte) && !seguinte)
+        livres++;
+  }
+  return livres < 0 ? 0 : uint32_t(livres);
+}
+
+bool Disco::lerBruto(uint64_t pos, uint64_t n, uint8_t *destino) {
+  if(fd < 0) {
+    if(pos + n > memoria.size())
+      return false;
+    std::memcpy(destino, memoria.data() + pos, n);
+    return true;
+  }
+  while(n) {
+    ssize_t r = pread(fd, destino, n, off_t(pos));
+    if(r <= 0)
+      return false;
+    destino += r;
+    pos += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool Disco::ler(uint64_t setor, uint64_t setores, uint8_t *destino) {
+  return lerBruto(base + setor * bytesSetor, setores * bytesSetor, destino);
+}
+
+const uint8_t *Disco::setorCache(uint64_t setor) {
+  if(ultima && ultima->setor == setor)
+    return ultima->dados.data();
+
+  if(!alterados.empty()) {
+    std::map<uint64_t, std::vector<uint8_t>>::iterator a = alterados.find(setor);
+    if(a != alterados.end())
+      return a->second.data();
+  }
+
+  std::unordered_map<uint64_t, std::list<LinhaCache>::iterator>::iterator i = indiceCache.find(setor);
+  if(i != indiceCache.end()) {
+    cache.splice(cache.begin(), cache, i->second);
+    ultima = &cache.front();
+    return ultima->dados.data();
+  }
+
+  // Cache cheio: a linha usada ha' mais tempo vai para a frente e e' reaproveitada.
+  ultima = nullptr;
+  if(cache.size() >= linhasCache) {
+    indiceCache.erase(cache.back().setor);
+    cache.splice(cache.begin(), cache, std::prev(cache.end()));
+  } else
+    cache.emplace_front();
+  LinhaCache &linha = cache.front();
+  linha.setor = setor;
+  linha.dados.resize(bytesSetor);
+  if(!ler(setor, 1, linha.dados.data())) {
+    cache.pop_front();
+    return nullptr;
+  }
+  indiceCache[setor] = cache.begin();
+  ultima = &linha;
+  return linha.dados.data();
+}
+
+bool Disco::gravarBruto(uint64_t pos, uint64_t n, const uint8_t *origem) {
+  return fd >= 0 && escrita && gravarTudo(fd, origem, n, pos);
+}
+
+void Disco::esquecer(uint64_t setor, uint64_t setores) {
+  for(std::list<LinhaCache>::iterator i = cache.begin(); i != cache.end();)
+    if(i->setor >= setor && i->setor < setor + setores) {
+      indiceCache.erase(i->setor);
+      i = cache.erase(i);
+    } else
+      ++i;
+  ultima = nullptr;
+}
+
+uint8_t *Disco::alterarSetor(uint64_t setor) {
+  std::map<uint64_t, std::vector<uint8_t>>::iterator a = alterados.find(setor);
+  if(a != alterados.end())
+    return a->second.data();
+
+  const uint8_t *atual = setorCache(setor);
+  if(!atual)
+    return nullptr;
+  std::vector<uint8_t> copia(atual, atual + bytesSetor);
+
+  // Daqui ate' o fim da transacao o setor e' lido de 'alterados'.
+  esquecer(setor, 1);
+  return alterados.emplace(setor, std::move(copia)).first->second.data();
+}
+
+void Disco::descartar() {
+  alterados.clear();
+  ultima = nullptr;
+  livres = -1;
+}
+
+bool Disco::confirmar() {
+  if(alterados.empty())
+    return true;
+
+  // Os dados gravados direto nos clusters novos chegam ao disco antes da FAT
+  // que aponta para eles.
+  if(fdatasync(fd) != 0) {
+    descartar();
+    return false;
+  }
+
+  std::vector<uint8_t> diario(16);
+  std::memcpy(diario.data(), assinaturaDiario, 8);
+  poe32(&diario[8], uint32_t(alterados.size()));
+  poe32(&diario[12], bytesSetor);
+  for(const std::pair<const uint64_t, std::vector<uint8_t>> &a : alterados) {
+    uint64_t pos = base + a.first * bytesSetor;
+    uint64_t n = diario.size();
+    diario.resize(n + 8);
+    poe32(&diario[n], uint32_t(pos));
+    poe32(&diario[n + 4], uint32_t(pos >> 32));
+    diario.insert(diario.end(), a.second.begin(), a.second.end());
+  }
+  uint64_t n = diario.size();
+  diario.resize(n + 8);
+  poe32(&diario[n], somaDiario(diario.data(), n));
+  std::memcpy(&diario[n + 4], marcaDiario, 4);
+
+  std::string nome = arquivo + ".jnl";
+  int d = open(nome.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  bool ok = d >= 0 && gravarTudo(d, diario.data(), diario.size(), 0) && fdatasync(d) == 0;
+  if(d >= 0 && close(d) != 0)
+    ok = false;
+  if(!ok) {
+    unlink(nome.c_str());
+    descartar();
+    return false;
+  }
+
+  // Com o diario seguro, os setores vao para o lugar. Se algo falhar aqui,
+  // o diario fica e a proxima abertura termina o servico. Ate' la' a imagem
+  // esta' pela metade: o disco deixa de aceitar alteracoes, senao a
+  // proxima transacao gravaria o diario dela por cima deste.
+  for(const std::pair<const uint64_t, std::vector<uint8_t>> &a : alterados)
+    if(!gravarBruto(base + a.first * bytesSetor, bytesSetor, a.second.data()))
+      ok = false;
+  if(ok && fdatasync(fd) == 0)
+    unlink(nome.c_str());
+  else {
+    ok = false;
+    escrita = false;
+  }
+  alterados.clear();
+  ultima = nullptr;
+  return ok;
+}
+
+bool Disco::lerBPB(const uint8_t *boot) {
+  bytesSetor = le16(boot + 0x0B);
+  setoresCluster = boot[0x0D];
+  reservados = le16(boot + 0x0E);
+  numFats = boot[0x10];
+  entradasRaiz = le16(boot + 0x11);
+  totalSetores = le16(boot + 0x13);
+  midia = boot[0x15];
+  setoresFat = le16(boot + 0x16);
+  if(!totalSetores)
+    totalSetores = le32(boot + 0x20);
+
+  // Discos antigos do MSX-DOS 1 nao tem BPB: o setor de boot e' so' codigo.
+  return bytesSetor >= 128 && bytesSetor <= 4096 && !(bytesSetor & (bytesSetor - 1)) &&
+         setoresCluster && !(setoresCluster & (setoresCluster - 1)) &&
+         reservados >= 1 && numFats >= 1 && numFats <= 2 && setoresFat && totalSetores &&
+         midia >= 0xF0;
+}
+
+bool Disco::geometriaPadrao(uint8_t midia) {
+  // Setores, setores por cluster, entradas na raiz e setores por FAT de
+  // cada formato padrao, indexados pelo byte de midia F8-FF.
+  static const uint16_t formatos[8][4] = {
+    { 720, 2, 112, 2 },  // F8: 360 KB, 1 face, 80 trilhas
+    { 1440, 2, 112, 3 }, // F9: 720 KB, 2 faces, 80 trilhas
+    { 640, 2, 112, 1 },  // FA: 320 KB, 1 face, 8 setores
+    { 1280, 2, 112, 2 }, // FB: 640 KB, 2 faces, 8 setores
+    { 360, 1, 64, 2 },   // FC: 180 KB, 1 face, 40 trilhas
+    { 720, 2, 112, 2 },  // FD: 360 KB, 2 faces, 40 trilhas
+    { 320, 1, 64, 1 },   // FE: 160 KB, 1 face, 8 setores
+    { 640, 2, 112, 1 }   // FF: 320 KB, 2 faces, 8 setores
+  };
+
+  if(midia < 0xF8)
+    return false;
+  const uint16_t *f = formatos[midia - 0xF8];
+  this->midia = midia;
+  bytesSetor = 512;
+  reservados = 1;
+  numFats = 2;
+  totalSetores = f[0];
+  setoresCluster = f[1];
+  entradasRaiz = f[2];
+  setoresFat = f[3];
+  return true;
+}
+
+bool Disco::converterDMK(const uint8_t *dmk, uint64_t tamanho, std::vector<uint8_t> &setores) {
+  if(tamanho < 16 || (dmk[0] != 0x00 && dmk[0] != 0xFF))
+    return false;
+  uint32_t trilhas = dmk[1];
+  uint32_t bytesTrilha = le16(dmk + 2);
+  uint32_t faces = (dmk[4] & 0x10) ? 1 : 2;
+  if(!trilhas || bytesTrilha <= 128 || bytesTrilha > 0x4000 ||
+     tamanho != 16 + uint64_t(trilhas) * faces * bytesTrilha)
+    return false;
+
+  // Primeira passada: acha o campo de dados de cada setor de 512 bytes.
+  // Cada trilha comeca com 64 ponteiros para as marcas de ID (FE C H R N).
+  static const uint32_t maximoSetores = 18;
+  std::vector<const uint8_t *> achados(uint64_t(trilhas) * faces * maximoSetores, nullptr);
+  uint32_t porTrilha = 0;
+  for(uint32_t t = 0; t < trilhas * faces; t++) {
+    const uint8_t *trilha = dmk + 16 + uint64_t(t) * bytesTrilha;
+    for(int k = 0; k < 64; k++) {
+      uint16_t ponteiro = le16(trilha + 2 * k);
+      uint32_t id = ponteiro & 0x3FFF;
+      if(!ponteiro)
+        break;
+      if(!(ponteiro & 0x8000) || id < 128 || id + 7 >= bytesTrilha || trilha[id] != 0xFE)
+        continue;
+      uint32_t r = trilha[id + 3];
+      if((trilha[id + 4] & 3) != 2 || r < 1 || r > maximoSetores)
+        continue;
+      // A marca de dados (A1 A1 A1 FB) vem logo depois do intervalo.
+      for(uint32_t j = id + 7; j < id + 7 + 64 && j + 1 + 512 <= bytesTrilha; j++)
+        if((trilha[j] == 0xFB || trilha[j] == 0xF8) && trilha[j - 1] == 0xA1) {
+          achados[uint64_t(t) * maximoSetores + r - 1] = trilha + j + 1;
+          porTrilha = std::max(porTrilha, r);
+          break;
+        }
+    }
+  }
+  if(!porTrilha)
+    return false;
+
+  setores.assign(uint64_t(trilhas) * faces * porTrilha * 512, 0xE5);
+  for(uint32_t t = 0; t < trilhas * faces; t++)
+    for(uint32_t r = 0; r < porTrilha; r++)
+      if(const uint8_t *p = achados[uint64_t(t) * maximoSetores + r])
+        std::memcpy(&setores[(uint64_t(t) * porTrilha + r) * 512], p, 512);
+  return true;
+}
+
+bool Disco::abrir(std::string arquivo, unsigned particao, bool escrita) {
+  struct stat st;
+  uint8_t cabecalho[16];
+
+  fechar();
+  if(!recuperarDiario(arquivo, escrita))
+    return false;
+  if((fd = open(arquivo.c_str(), (escrita ? O_RDWR : O_RDONLY) | O_CLOEXEC)) < 0)
+    return false;
+  this->arquivo = arquivo;
+  this->escrita = escrita;
+
+  // DMK: o tamanho tem que bater com o cabecalho antes de ler o resto.
+  if(fstat(fd, &st) == 0 && pread(fd, cabecalho, 16, 0) == 16 && cabecalho[1] &&
+     uint64_t(st.st_size) == 16 + uint64_t(cabecalho[1]) * ((cabecalho[4] & 0x10) ? 1 : 2) * le16(cabecalho + 2)) {
+    std::vector<uint8_t> dmk(st.st_size), setores;
+    if(pread(fd, dmk.data(), dmk.size(), 0) == st.st_size && converterDMK(dmk.data(), dmk.size(), setores)) {
+      close(fd);
+      fd = -1;
+      return abrirMemoria(std::move(setores), particao);
+    }
+  }
+  return montar(particao);
+}
+
+bool Disco::abrirMemoria(std::vector<uint8_t> &&imagem, unsigned particao) {
+  fechar();
+  memoria = std::move(imagem);
+  return !memoria.empty() && montar(particao);
+}
+
+bool Disco::lerParticoes(const uint8_t *mbr) {
+  uint64_t estendida = 0;
+
+  particoes.clear();
+  if(mbr[510] != 0x55 || mbr[511] != 0xAA)
+    return false;
+  for(int i = 0; i < 4; i++) {
+    const uint8_t *p = mbr + 0x1BE + 16 * i;
+    if(p[0] != 0x00 && p[0] != 0x80)
+      return false;
+    if(!p[4] || !le32(p + 12))
+      continue;
+    if(tipoEstendida(p[4])) {
+      if(!estendida)
+        estendida = le32(p + 8);
+    } else if(tipoFat(p[4]))
+      particoes.push_back(ParticaoDisco{p[4], le32(p + 8), le32(p + 12)});
+  }
+
+  // O Nextor poe as particoes alem da primeira numa estendida: cada EBR tem
+  // a logica (relativa a ele) e o link para o proximo (relativo 'a estendida).
+  uint64_t atual = estendida;
+  for(int passos = 0; atual && passos < 256; passos++) {
+    uint8_t ebr[512];
+    if(!lerBruto(atual * 512, 512, ebr) || ebr[510] != 0x55 || ebr[511] != 0xAA)
+      break;
+    const uint8_t *p = ebr + 0x1BE;
+    if(tipoFat(p[4]) && le32(p + 12))
+      particoes.push_back(ParticaoDisco{p[4], atual + le32(p + 8), le32(p + 12)});
+    p += 16;
+    atual = tipoEstendida(p[4]) && le32(p + 8) ? estendida + le32(p + 8) : 0;
+  }
+  return !particoes.empty();
+}
+
+bool Disco::montar(unsigned particao) {
+  uint8_t boot[512];
+
+  bytesSetor = 512;
+  if(!lerBruto(0, 512, boot)) {
+    fechar();
+    return false;
+  }
+  if(!lerBPB(boot)) {
+    if(lerParticoes(boot)) {
+      if(particao >= particoes.size()) {
+        fechar();
+        return false;
+      }
+      base = particoes[particao].inicio * 512;
+      if(!lerBruto(base, 512, boot) || !lerBPB(boot)) {
+        fechar();
+        return false;
+      }
+    } else {
+      uint8_t primeiro[512];
+      bytesSetor = 512;
+      if(!lerBruto(512, 512, primeiro) || !geometriaPadrao(primeiro[0])) {
+        fechar();
+        return false;
+      }
+    }
+  }
+
+  inicioRaiz = reservados + numFats * setoresFat;
+  inicioDados = inicioRaiz + (entradasRaiz * 32 + bytesSetor - 1) / bytesSetor;
+  if(inicioDados >= totalSetores) {
+    fechar();
+    return false;
+  }
+
+  // O tipo da FAT vem da contagem de clusters, nao do tipo da particao.
+  totalClusters = (totalSetores - inicioDados) / setoresCluster;
+  if(totalClusters > 65524) {
+    fechar();
+    return false;
+  }
+  fat16 = totalClusters >= 4085;
+  fimCadeia = fat16 ? 0xFFF8 : 0xFF8;
+  uint64_t bytesFat = uint64_t(setoresFat) * bytesSetor;
+  uint64_t cabem = fat16 ? bytesFat / 2 : bytesFat * 2 / 3;
+  if(cabem < 3) {
+    fechar();
+    return false;
+  }
+  if(totalClusters + 2 > cabem)
+    totalClusters = uint32_t(cabem - 2);
+  return true;
+}
+
+bool Disco::proximo(uint32_t cluster, uint32_t &seguinte) {
+  if(fat16) {
+    uint64_t pos = uint64_t(cluster) * 2;
+    const uint8_t *setor = setorCache(reservados + pos / bytesSetor);
+    if(!setor)
+      return false;
+    seguinte = le16(setor + pos % bytesSetor);
+    return true;
+  }
+
+  // Na FAT12 a entrada pode atravessar o limite do setor; o primeiro byte e'
+  // copiado antes de pedir o segundo setor, que pode reaproveitar a linha.
+  uint64_t pos = uint64_t(cluster) * 3 / 2;
+  const uint8_t *setor = setorCache(reservados + pos / bytesSetor);
+  if(!setor)
+    return false;
+  uint8_t baixo = setor[pos % bytesSetor];
+  if((pos + 1) % bytesSetor == 0 && !(setor = setorCache(reservados + (pos + 1) / bytesSetor)))
+    return false;
+  uint8_t alto = setor[(pos + 1) % bytesSetor];
+  seguinte = (cluster & 1) ? uint32_t((baixo >> 4) | (alto << 4)) : uint32_t(baixo | ((alto & 0x0F) << 8));
+  return true;
+}
+
+bool Disco::cadeia(uint32_t cluster, std::vector<Trecho> &trechos) {
+  trechos.clear();
+  for(uint32_t passos = 0; cluster >= 2 && cluster < fimCadeia; passos++) {
+    if(cluster >= totalClusters + 2 || passos > totalClusters)
+      return false;
+    uint64_t setor = inicioDados + uint64_t(cluster - 2) * setoresCluster;
+    if(!trechos.empty() && trechos.back().setor + trechos.back().setores == setor)
+      trechos.back().setores += setoresCluster;
+    else
+      trechos.push_back(Trecho{setor, setoresCluster});
+    if(!proximo(cluster, cluster))
+      return false;
+  }
+  return true;
+}
+
+// Falso para entradas que nao aparecem na listagem (apagadas, volume, "." e "..").
+static bool lerEntrada(const uint8_t *e, EntradaDisco &entrada) {
+  if(e[0] == 0xE5 || (e[11] & 0x08) || e[0] == '.')
+    return false;
+
+  // O nome vira caminho no PC na extracao: nada de '/' ou controles.
+  entrada.nome.clear();
+  for(int j = 0; j < 11; j++) {
+    if(j == 8 && e[8] != ' ')
+      entrada.nome += '.';
+    if(e[j] == ' ')
+      continue;
+    uint8_t c = (j == 0 && e[j] == 0x05) ? 0xE5 : e[j];
+    entrada.nome += (c < 0x20 || c == '/' || c == '\\') ? '_' : char(c);
+  }
+  if(entrada.nome.empty())
+    return false;
+  entrada.atributos = e[11];
+  entrada.hora = le16(e + 22);
+  entrada.data = le16(e + 24);
+  entrada.cluster = le16(e + 26);
+  entrada.tamanho = le32(e + 28);
+  return true;
+}
+
+bool Disco::definir(uint32_t cluster, uint32_t valor) {
+  // Todas as copias da FAT recebem o mesmo valor.
+  for(uint32_t k = 0; k < numFats; k++) {
+    uint64_t inicio = reservados + uint64_t(k) * setoresFat;
+    if(fat16) {
+      uint64_t pos = uint64_t(cluster) * 2;
+      uint8_t *setor = alterarSetor(inicio + pos / bytesSetor);
+      if(!setor)
+        return false;
+      poe16(setor + pos % bytesSetor, valor);
+      continue;
+    }
+
+    uint64_t pos = uint64_t(cluster) * 3 / 2;
+    uint8_t *baixo = alterarSetor(inicio + pos / bytesSetor);
+    uint8_t *alto = alterarSetor(inicio + (pos + 1) / bytesSetor);
+    if(!baixo || !alto)
+      return false;
+    baixo += pos % bytesSetor;
+    alto += (pos + 1) % bytesSetor;
+    if(cluster & 1) {
+      *baixo = uint8_t((*baixo & 0x0F) | ((valor & 0x0F) << 4));
+      *alto = uint8_t(valor >> 4);
+    } else {
+      *baixo = uint8_t(valor);
+      *alto = uint8_t((*alto & 0xF0) | ((valor >> 8) & 0x0F));
+    }
+  }
+  return true;
+}
+
+bool Disco::alocar(uint32_t n, std::vector<uint32_t> &clusters) {
+  uint32_t seguinte;
+
+  // Procura a partir do ultimo alocado, entao arquivos seguidos saem contiguos.
+  clusters.clear();
+  for(uint32_t i = 0; i < totalClusters && clusters.size() < n; i++) {
+    uint32_t c = 2 + (dicaLivre - 2 + i) % totalClusters;
+    if(!proximo(c, seguinte))
+      return false;
+    if(!seguinte)
+      clusters.push_back(c);
+  }
+  if(clusters.size() < n)
+    return false;
+
+  for(size_t i = 0; i < clusters.size(); i++)
+    if(!definir(clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : (fat16 ? 0xFFFF : 0xFFF)))
+      return false;
+  if(!clusters.empty())
+    dicaLivre = clusters.back() + 1 < totalClusters + 2 ? clusters.back() + 1 : 2;
+  if(livres >= 0)
+    livres -= n;
+  return true;
+}
+
+bool Disco::liberar(uint32_t cluster) {
+  uint32_t seguinte;
+
+  for(uint32_t passos = 0; cluster >= 2 && cluster < fimCadeia; passos++) {
+    if(cluster >= totalClusters + 2 || passos > totalClusters || !proximo(cluster, seguinte) ||
+       !definir(cluster, 0))
+      return false;
+    dicaLivre = std::min(dicaLivre, cluster);
+    if(livres >= 0)
+      livres++;
+    cluster = seguinte;
+  }
+  return true;
+}
+
+bool Disco::gravarClusters(const std::vector<uint32_t> &clusters, const uint8_t *dados, uint64_t n) {
+  uint64_t bytesCluster = getBytesCluster();
+  uint64_t feito = 0;
+
+  // Uma escrita por sequencia de clusters contiguos, como na leitura.
+  for(size_t i = 0; i < clusters.size() && feito < n;) {
+    size_t j = i + 1;
+    while(j < clusters.size() && clusters[j] == clusters[j - 1] + 1)
+      j++;
+    uint64_t setor = inicioDados + uint64_t(clusters[i] - 2) * setoresCluster;
+    uint64_t bytes = std::min<uint64_t>((j - i) * bytesCluster, n - feito);
+    if(!gravarBruto(base + setor * bytesSetor, bytes, dados + feito))
+      return false;
+    esquecer(setor, uint64_t(j - i) * setoresCluster);
+    feito += bytes;
+    i = j;
+  }
+  return true;
+}
+
+bool Disco::percorrer(uint32_t cluster, const Visita &visita) {
+  std::vector<Trecho> trechos;
+  uint64_t restantes = entradasRaiz;
+
+  if(cluster == 0)
+    trechos.push_back(Trecho{inicioRaiz, inicioDados - inicioRaiz});
+  else if(!cadeia(cluster, trechos))
+    return false;
+  else
+    restantes = UINT64_MAX;
+
+  // Setor a setor pelo cache; quem visita decide onde parar.
+  for(const Trecho &t : trechos)
+    for(uint32_t k = 0; k < t.setores; k++) {
+      const uint8_t *setor = setorCache(t.setor + k);
+      if(!setor)
+        return false;
+      for(uint32_t pos = 0; pos + 32 <= bytesSetor && restantes; pos += 32, restantes--)
+        if(!visita(t.setor + k, pos, setor + pos))
+          return true;
+    }
+  return true;
+}
+
+bool Disco::lerDiretorio(uint32_t cluster, std::vector<EntradaDisco> &entradas) {
+  EntradaDisco entrada;
+
+  // Para na primeira entrada nunca usada.
+  entradas.clear();
+  return percorrer(cluster, [&](uint64_t, uint32_t, const uint8_t *e) {
+    if(e[0] == 0x00)
+      return false;
+    if(lerEntrada(e, entrada))
+      entradas.push_back(entrada);
+    return true;
+  });
+}
+
+bool Disco::diretorioPai(std::string caminho, uint32_t &cluster, std::string &nome) {
+  EntradaDisco dir;
+
+  caminho = maiusculas(caminho);
+  while(!caminho.empty() && caminho.back() == '/')
+    caminho.pop_back();
+  size_t barra = caminho.find_last_of('/');
+  nome = barra == std::string::npos ? caminho : caminho.substr(barra + 1);
+  cluster = 0;
+  if(barra == std::string::npos || caminho.find_first_not_of('/') >= barra)
+    return !nome.empty();
+  if(!procurar(caminho.substr(0, barra), dir) || !dir.diretorio())
+    return false;
+  cluster = dir.cluster;
+  return !nome.empty();
+}
+
+bool Disco::localizar(uint32_t pai, const uint8_t *nome, uint64_t &setor, uint32_t &pos) {
+  bool achou = false;
+
+  if(!percorrer(pai, [&](uint64_t s, uint32_t p, const uint8_t *e) {
+       if(e[0] == 0x00)
+         return false;
+       if(e[0] == 0xE5 || (e[11] & 0x08) || std::memcmp(e, nome, 11) != 0)
+         return true;
+       setor = s;
+       pos = p;
+       achou = true;
+       return false;
+     }))
+    return false;
+  return achou;
+}
+
+bool Disco::procurar(std::string caminho, EntradaDisco &entrada) {
+  std::vector<EntradaDisco> entradas;
+  uint32_t cluster = 0;
+  size_t pos = 0;
+  bool achou = false;
+
+  caminho = maiusculas(caminho);
+  while(pos < caminho.size()) {
+    size_t fim = caminho.find('/', pos);
+    if(fim == std::string::npos)
+      fim = caminho.size();
+    std::string parte = caminho.substr(pos, fim - pos);
+    pos = fim + 1;
+    if(parte.empty())
+      continue;
+
+    if(achou && !entrada.diretorio())
+      return false;
+    if(!lerDiretorio(cluster, entradas))
+      return false;
+    achou = false;
+    for(const EntradaDisco &e : entradas)
+      if(maiusculas(e.nome) == parte) {
+        entrada = e;
+        achou = true;
+        break;
+      }
+    if(!achou)
+      return false;
+    cluster = entrada.cluster;
+  }
+  return achou;
+}
+
+bool Disco::listar(std::string caminho, std::vector<EntradaDisco> &entradas) {
+  EntradaDisco dir;
+
+  if(!aberto())
+    return false;
+  if(caminho.find_first_not_of('/') == std::string::npos)
+    return lerDiretorio(0, entradas);
+  if(!procurar(caminho, dir) || !dir.diretorio())
+    return false;
+  return lerDiretorio(dir.cluster, entradas);
+}
+
+bool Disco::extrair(const EntradaDisco &entrada, std::vector<uint8_t> &dados) {
+  std::vector<Trecho> trechos;
+  uint64_t lidos = 0;
+
+  dados.clear();
+  if(!entrada.tamanho)
+    return true;
+  if(!cadeia(entrada.cluster, trechos))
+    return false;
+
+  // Le clusters inteiros direto no destino e corta o excesso no fim.
+  uint64_t bytesCluster = getBytesCluster();
+  dados.resize((entrada.tamanho + bytesCluster - 1) / bytesCluster * bytesCluster);
+  for(const Trecho &t : trechos) {
+    uint64_t setores = t.setores;
+    if(lidos + setores * bytesSetor > dados.size())
+      setores = (dados.size() - lidos) / bytesSetor;
+    if(!setores)
+      break;
+    if(!ler(t.setor, setores, &dados[lidos]))
+      return false;
+    lidos += setores * bytesSetor;
+  }
+  if(lidos < entrada.tamanho)
+    return false;
+  dados.resize(entrada.tamanho);
+  return true;
+}
+
+bool Disco::extrairDiretorio(uint32_t cluster, std::string destino, uint64_t *bytes, Gravador &gravador,
+                             std::set<uint32_t> &visitados, unsigned nivel) {
+  std::vector<EntradaDisco> entradas;
+  std::vector<uint8_t> dados;
+  bool ok = true;
+
+  if(!gravador.criarDiretorio(destino))
+    return false;
+  if(!lerDiretorio(cluster, entradas))
+    return false;
+
+  for(const EntradaDisco &e : entradas) {
+    std::string caminho = destino + "/" + e.nome;
+    if(e.diretorio()) {
+      // Uma entrada corrompida pode apontar para fora dos dados, para o
+      // proprio diretorio ou para um acima dele: vira erro, sem descer.
+      if(e.cluster < 2 || e.cluster >= totalClusters + 2 || nivel >= maximoNiveis ||
+         !visitados.insert(e.cluster).second) {
+        ok = false;
+        continue;
+      }
+      ok = extrairDiretorio(e.cluster, caminho, bytes, gravador, visitados, nivel + 1) && ok;
+      continue;
+    }
+    if(!extrair(e, dados)) {
+      ok = false;
+      continue;
+    }
+    if(bytes)
+      *bytes += dados.size();
+    ok = gravador.gravar(caminho, std::move(dados)) && ok;
+  }
+  return ok;
+}
+
+bool Disco::extrairTudo(std::string destino, uint64_t *bytes, Gravador *gravador) {
+  Gravador direto;
+  std::set<uint32_t> visitados;
+
+  return aberto() && extrairDiretorio(0, destino, bytes, gravador ? *gravador : direto, visitados, 0);
+}
+
+bool Disco::adicionar(std::string caminho, const std::vector<uint8_t> &dados) {
+  std::string nome;
+  uint8_t nome11[11];
+  uint32_t pai;
+  uint64_t setor;
+  uint32_t pos;
+
+  if(!escrita || dados.size() > 0xFFFFFFFFULL || !diretorioPai(caminho, pai, nome) || !nome83(nome, nome11) ||
+     localizar(pai, nome11, setor, pos))
+    return false;
+
+  // Primeira vaga do diretorio: uma apagada ou a primeira nunca usada.
+  bool vaga = false;
+  if(!percorrer(pai, [&](uint64_t s, uint32_t p, const uint8_t *e) {
+       if(e[0] != 0x00 && e[0] != 0xE5)
+         return true;
+       setor = s;
+       pos = p;
+       vaga = true;
+       return false;
+     }))
+    return false;
+
+  std::vector<uint32_t> clusters;
+  uint32_t bytesCluster = getBytesCluster();
+  if(!alocar(uint32_t((dados.size() + bytesCluster - 1) / bytesCluster), clusters) ||
+     !gravarClusters(clusters, dados.data(), dados.size())) {
+    descartar();
+    return false;
+  }
+
+  // Diretorio cheio: a raiz tem tamanho fixo, um subdiretorio ganha um
+  // cluster zerado no fim da cadeia.
+  if(!vaga) {
+    std::vector<uint32_t> novo;
+    uint32_t ultimo = pai, seguinte;
+    for(uint32_t passos = 0; pai && passos <= totalClusters; passos++) {
+      if(!proximo(ultimo, seguinte) || seguinte < 2 || seguinte >= fimCadeia)
+        break;
+      ultimo = seguinte;
+    }
+    std::vector<uint8_t> zeros(bytesCluster, 0);
+    if(!pai || !alocar(1, novo) || !definir(ultimo, novo[0]) || !gravarClusters(novo, zeros.data(), zeros.size())) {
+      descartar();
+      return false;
+    }
+    setor = inicioDados + uint64_t(novo[0] - 2) * setoresCluster;
+    pos = 0;
+  }
+
+  // Hora e data no formato do MSX-DOS, as mesmas da FAT do PC.
+  time_t agora = time(nullptr);
+  struct tm t;
+  localtime_r(&agora, &t);
+  uint8_t *e = alterarSetor(setor);
+  if(!e) {
+    descartar();
+    return false;
+  }
+  e += pos;
+  std::memset(e, 0, 32);
+  std::memcpy(e, nome11, 11);
+  e[11] = 0x20;
+  poe16(e + 22, uint32_t((t.tm_hour << 11) | (t.tm_min << 5) | (t.tm_sec / 2)));
+  poe16(e + 24, uint32_t((std::max(t.tm_year - 80, 0) << 9) | ((t.tm_mon + 1) << 5) | t.tm_mday));
+  poe16(e + 26, clusters.empty() ? 0 : clusters[0]);
+  poe32(e + 28, uint32_t(dados.size()));
+  return confirmar();
+}
+
+bool Disco::apagar(std::string caminho) {
+  std::string nome;
+  uint8_t nome11[11];
+  uint32_t pai;
+  uint64_t setor;
+  uint32_t pos;
+  EntradaDisco entrada;
+  std::vector<EntradaDisco> conteudo;
+
+  if(!escrita || !diretorioPai(caminho, pai, nome) || !nome83(nome, nome11) || !localizar(pai, nome11, setor, pos))
+    return false;
+  const uint8_t *e = setorCache(setor);
+  if(!e || !lerEntrada(e + pos, entrada))
+    return false;
+  if(entrada.diretorio() && (!lerDiretorio(entrada.cluster, conteudo) || !conteudo.empty()))
+    return false;
+
+  uint8_t *alterada = alterarSetor(setor);
+  if(!alterada || !liberar(entrada.cluster)) {
+    descartar();
+    return false;
+  }
+  alterada[pos] = 0xE5;
+  return confirmar();
+}
+
+bool Disco::renomear(std::string caminho, std::string novoNome) {
+  std::string nome;
+  uint8_t nome11[11], novo11[11];
+  uint32_t pai;
+  uint64_t setor, outro;
+  uint32_t pos, posOutro;
+
+  if(!escrita || !diretorioPai(caminho, pai, nome) || !nome83(nome, nome11) ||
+     !nome83(maiusculas(novoNome), novo11) || !localizar(pai, nome11, setor, pos) ||
+     localizar(pai, novo11, outro, posOutro))
+    return false;
+
+  uint8_t *e = alterarSetor(setor);
+  if(!e) {
+    descartar();
+    return false;
+  }
+  std::memcpy(e + pos, novo11, 11);
+  return confirmar();
+}
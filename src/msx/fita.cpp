@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "cassete.h"
+#include "fita.h"
+#include "mapeamento.h"
+
+static const uint8_t marca[8] = {0x1F, 0xA6, 0xDE, 0xBA, 0xCC, 0x13, 0x7D, 0x74};
+
+// Meias ondas parecidas seguidas para aceitar um tom de sincronismo
+// (256 ciclos; o tom mais curto do MSX tem uns 4000).
+static const unsigned meiasTom = 512;
+// Bits 1 seguidos entre bytes que ja' sao o tom do proximo bloco.
+static const unsigned curtosTom = 64;
+
+// Amostras por vez na conversao do arquivo e no buffer da sintese.
+static const size_t amostrasPedaco = 64 << 10;
+static const size_t amostrasBuffer = 256 << 10;
+
+// Tons do BIOS a 1200 baud, em bits 1; a 2400 baud o tempo e' o mesmo.
+static const unsigned tomLongo = 8000;
+static const unsigned tomCurto = 2000;
+static const int16_t amplitude = 24000;
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return uint32_t(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24));
+}
+
+DecodificadorFita::DecodificadorFita(std::ostream &saida, unsigned taxa)
+  : saida(saida), taxa(taxa), escritos(0), blocos(0), erros(0), baud(0), centro(0), histerese(0), anterior(0),
+    negativo(false), amostra(0), ultimoCruzamento(0), estado(procurando), curto(0), meias{0, 0}, paridade(0),
+    ultimaMeia(0), seguidas(0), primeira(0), temPrimeira(false), bit(-1), segundoCurto(false), curtos(0), byte(0),
+    guardada(0), temGuardada(false), juntar(false) {
+}
+
+unsigned DecodificadorFita::getBlocos() const {
+  return blocos;
+}
+
+uint64_t DecodificadorFita::getBytes() const {
+  return escritos;
+}
+
+unsigned DecodificadorFita::getErros() const {
+  return erros;
+}
+
+unsigned DecodificadorFita::getBaud() const {
+  return baud;
+}
+
+void DecodificadorFita::escrever(uint8_t valor) {
+  saida.put(char(valor));
+  escritos++;
+}
+
+void DecodificadorFita::perder() {
+  if(estado == bits && bit >= 0 && bit < 9)
+    erros++;
+  estado = procurando;
+  seguidas = 0;
+  ultimaMeia = 0;
+  temPrimeira = false;
+  segundoCurto = false;
+  bit = -1;
+}
+
+void DecodificadorFita::ciclo(double duracao) {
+  int valor;
+
+  if(duracao > curto * 3) {
+    perder();
+    return;
+  }
+  bool longo = duracao > curto * 1.5;
+  if(segundoCurto) {
+    segundoCurto = false;
+    if(longo) {
+      perder();
+      return;
+    }
+    valor = 1;
+  } else if(!longo) {
+    segundoCurto = true;
+    return;
+  } else
+    valor = 0;
+
+  if(bit < 0) {
+    // Esperando a partida; muitos bits 1 seguidos ja' sao o proximo tom.
+    if(valor == 0) {
+      bit = 0;
+      byte = 0;
+    } else if(++curtos > curtosTom)
+      estado = tom;
+    return;
+  }
+  if(bit < 8) {
+    byte |= unsigned(valor) << bit;
+    bit++;
+    return;
+  }
+  // O byte vale ja' no primeiro bit de parada: o ultimo meio ciclo do
+  // bloco pode nao ter cruzamento nenhum antes do silencio.
+  if(valor == 0) {
+    perder();
+    return;
+  }
+  if(bit == 8) {
+    escrever(uint8_t(byte));
+    bit = 9;
+  } else {
+    bit = -1;
+    curtos = 0;
+  }
+}
+
+void DecodificadorFita::meiaOnda(double duracao) {
+  // As meias ondas positivas e negativas tem medias separadas: com o sinal
+  // fora do centro uma fica mais longa que a outra, mas o ciclo nao muda.
+  int p = paridade;
+  paridade ^= 1;
+
+  switch(estado) {
+    case procurando: {
+      double c = ultimaMeia + duracao;
+      if(seguidas && c >= curto * 0.75 && c <= curto * 1.25) {
+        curto += (c - curto) / 16;
+        meias[p] += (duracao - meias[p]) / 16;
+        if(++seguidas >= meiasTom)
+          estado = tom;
+      } else {
+        curto = c;
+        meias[p] = duracao;
+        meias[p ^ 1] = ultimaMeia;
+        seguidas = 1;
+      }
+      break;
+    }
+
+    case tom:
+      if(duracao < meias[p] * 1.5) {
+        meias[p] += (duracao - meias[p]) / 64;
+        curto = meias[0] + meias[1];
+        break;
+      }
+      if(duracao > curto * 2) {
+        perder();
+        break;
+      }
+      // Primeira meia onda do bit de partida: comeca um bloco, alinhado
+      // em 8 bytes como no .CAS.
+      while(escritos % 8)
+        escrever(0);
+      for(uint8_t b : marca)
+        escrever(b);
+      blocos++;
+      baud = taxa / (curto * 2) < 1800 ? 1200 : 2400;
+      estado = bits;
+      bit = -1;
+      curtos = 0;
+      segundoCurto = false;
+      primeira = duracao;
+      temPrimeira = true;
+      break;
+
+    case bits:
+      // Os bits comecam com a partida, entao as meias ondas se juntam aos
+      // pares em ciclos inteiros, qualquer que seja a polaridade do sinal.
+      if(temPrimeira) {
+        temPrimeira = false;
+        ciclo(primeira + duracao);
+      } else {
+        primeira = duracao;
+        temPrimeira = true;
+      }
+      break;
+  }
+  ultimaMeia = duracao;
+}
+
+void DecodificadorFita::cruzamento(double posicao) {
+  double duracao = posicao - ultimoCruzamento;
+
+  ultimoCruzamento = posicao;
+  // Ruido perto do zero cria cruzamentos a mais muito juntos; com o tom
+  // ja' estimado, a meia onda curtinha e a seguinte voltam a fazer parte
+  // da anterior.
+  if((estado != procurando || seguidas >= 16) && duracao < curto * 0.175 && temGuardada) {
+    guardada += duracao;
+    juntar = true;
+    return;
+  }
+  if(juntar) {
+    guardada += duracao;
+    juntar = false;
+    return;
+  }
+  if(temGuardada)
+    meiaOnda(guardada);
+  guardada = duracao;
+  temGuardada = true;
+}
+
+#ifdef __SSE2__
+// Bit k de 'acima' ligado se a amostra k passar do limite de cima; o de
+// 'abaixo', se ficar abaixo do de baixo.
+static void limitesSSE2(const int16_t *x, __m128i cima, __m128i baixo, uint32_t &acima, uint32_t &abaixo) {
+  const __m128i *p = reinterpret_cast<const __m128i *>(x);
+  __m128i v[4];
+
+  for(int k = 0; k < 4; k++)
+    v[k] = _mm_loadu_si128(p + k);
+  acima = uint32_t(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(v[0], cima), _mm_cmpgt_epi16(v[1], cima)))) |
+          (uint32_t(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(v[2], cima), _mm_cmpgt_epi16(v[3], cima)))) << 16);
+  abaixo = uint32_t(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(baixo, v[0]), _mm_cmpgt_epi16(baixo, v[1])))) |
+           (uint32_t(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(baixo, v[2]), _mm_cmpgt_epi16(baixo, v[3])))) << 16);
+}
+
+__attribute__((target("avx2")))
+static void limitesAVX2(const int16_t *x, int16_t cima, int16_t baixo, uint32_t &acima, uint32_t &abaixo) {
+  const __m256i *p = reinterpret_cast<const __m256i *>(x);
+  const __m256i c = _mm256_set1_epi16(cima), b = _mm256_set1_epi16(baixo);
+  __m256i v0 = _mm256_loadu_si256(p), v1 = _mm256_loadu_si256(p + 1);
+
+  // packs intercala as metades de 128 bits; a permutacao poe tudo em ordem.
+  acima = uint32_t(_mm256_movemask_epi8(_mm256_permute4x64_epi64(
+    _mm256_packs_epi16(_mm256_cmpgt_epi16(v0, c), _mm256_cmpgt_epi16(v1, c)), 0xD8)));
+  abaixo = uint32_t(_mm256_movemask_epi8(_mm256_permute4x64_epi64(
+    _mm256_packs_epi16(_mm256_cmpgt_epi16(b, v0), _mm256_cmpgt_epi16(b, v1)), 0xD8)));
+}
+#endif
+
+void DecodificadorFita::processar(const int16_t *entrada, size_t n) {
+  if(!n)
+    return;
+
+  // Media movel de uns 50 us: quase nao mexe no tom mais agudo (4800 Hz),
+  // mas tira boa parte do chiado das gravacoes com taxa alta. As ultimas
+  // amostras do pedaco anterior ficam no comeco do filtro.
+  size_t janela = std::max<size_t>(1, taxa / 19200);
+  const int16_t *x = entrada;
+  if(janela > 1) {
+    historico.resize(janela - 1 + n);
+    std::copy(entrada, entrada + n, historico.begin() + std::ptrdiff_t(janela - 1));
+    filtrado.resize(n);
+    const int16_t *h = historico.data();
+    for(size_t i = 0; i < n; i++) {
+      int32_t soma = 0;
+      for(size_t k = 0; k < janela; k++)
+        soma += h[i + k];
+      filtrado[i] = int16_t(soma / int32_t(janela));
+    }
+    std::copy(historico.end() - std::ptrdiff_t(janela - 1), historico.end(), historico.begin());
+    x = filtrado.data();
+  }
+
+  // Centro e amplitude acompanham devagar os de cada pedaco. O cruzamento
+  // so' conta quando o sinal passa de um limite a um quarto da amplitude
+  // media do outro lado do centro (um Schmitt trigger), entao o ruido perto
+  // do zero nao cria cruzamentos falsos. Os dois lados atrasam o mesmo
+  // tanto, e as meias ondas nao mudam.
+  int64_t soma = 0, desvio = 0;
+  for(size_t i = 0; i < n; i++)
+    soma += x[i];
+  int32_t media = int32_t(soma / int64_t(n));
+  for(size_t i = 0; i < n; i++)
+    desvio += std::abs(x[i] - media);
+  int32_t amplitude = int32_t(desvio / int64_t(n));
+  centro = amostra ? (centro * 3 + media) / 4 : media;
+  histerese = amostra ? (histerese * 3 + amplitude / 4) / 4 : amplitude / 4;
+  int16_t cima = int16_t(std::min(centro + histerese, 32767)), baixo = int16_t(std::max(centro - histerese, -32768));
+
+  size_t i = 0;
+  auto cruzar = [&](size_t j) {
+    double nivel = negativo ? cima : baixo;
+    double a = (j ? x[j - 1] : anterior) - nivel, b = x[j] - nivel;
+    cruzamento(double(amostra + j) - 1 + a / (a - b));
+    negativo = !negativo;
+  };
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  const __m128i c = _mm_set1_epi16(cima), b = _mm_set1_epi16(baixo);
+  for(; i + 32 <= n; i += 32) {
+    uint32_t acima, abaixo;
+    if(temAVX2)
+      limitesAVX2(x + i, cima, baixo, acima, abaixo);
+    else
+      limitesSSE2(x + i, c, b, acima, abaixo);
+    // So' as amostras alem do limite do outro lado importam; a proxima
+    // busca comeca depois da ultima troca.
+    uint64_t livres = 0xFFFFFFFF;
+    for(;;) {
+      uint64_t alvo = (negativo ? acima : abaixo) & livres;
+      if(!alvo)
+        break;
+      int j = __builtin_ctzll(alvo);
+      cruzar(i + size_t(j));
+      livres = (uint64_t(0xFFFFFFFF) << (j + 1)) & 0xFFFFFFFF;
+    }
+  }
+#endif
+  for(; i < n; i++)
+    if(negativo ? x[i] > cima : x[i] < baixo)
+      cruzar(i);
+  anterior = x[n - 1];
+  amostra += n;
+}
+
+void DecodificadorFita::terminar() {
+  if(temGuardada)
+    meiaOnda(guardada);
+  temGuardada = false;
+  perder();
+  saida.flush();
+}
+
+bool lerCabecalhoWav(std::istream &entrada, FormatoWav &formato) {
+  uint8_t h[12], pedaco[8], fmt[16];
+  bool temFormato = false;
+
+  if(!entrada.read(reinterpret_cast<char *>(h), 12) || std::memcmp(h, "RIFF", 4) || std::memcmp(h + 8, "WAVE", 4))
+    return false;
+  // Pedacos ate' o "data"; os que nao interessam sao pulados.
+  while(entrada.read(reinterpret_cast<char *>(pedaco), 8)) {
+    uint32_t tamanho = le32(pedaco + 4);
+    if(!std::memcmp(pedaco, "fmt ", 4) && tamanho >= 16) {
+      if(!entrada.read(reinterpret_cast<char *>(fmt), 16))
+        return false;
+      uint16_t tipo = le16(fmt);
+      formato.canais = le16(fmt + 2);
+      formato.taxa = le32(fmt + 4);
+      formato.bits = le16(fmt + 14);
+      // 1: PCM; #FFFE: WAVE_FORMAT_EXTENSIBLE, que para PCM tem as mesmas amostras.
+      if((tipo != 1 && tipo != 0xFFFE) || !formato.canais || !formato.taxa || (formato.bits != 8 && formato.bits != 16))
+        return false;
+      temFormato = true;
+      entrada.seekg(tamanho - 16 + (tamanho & 1), std::ios::cur);
+    } else if(!std::memcmp(pedaco, "data", 4)) {
+      formato.tamanho = tamanho == 0xFFFFFFFF ? 0 : tamanho;
+      return temFormato;
+    } else
+      entrada.seekg(tamanho + (tamanho & 1), std::ios::cur);
+  }
+  return false;
+}
+
+bool converterWavCas(std::string wav, std::string cas, ResultadoFita &resultado) {
+  std::ifstream entrada(wav, std::ios::binary);
+  FormatoWav &f = resultado.formato;
+
+  resultado = ResultadoFita{{0, 0, 0, 0}, 0.0, 0, 0, 0, 0};
+  if(!entrada || !lerCabecalhoWav(entrada, f))
+    return false;
+  std::ofstream saida(cas, std::ios::binary | std::ios::trunc);
+  if(!saida)
+    return false;
+
+  DecodificadorFita decodificador(saida, f.taxa);
+  size_t quadro = f.canais * (f.bits / 8);
+  std::vector<uint8_t> bruto(amostrasPedaco * quadro);
+  std::vector<int16_t> amostras(amostrasPedaco);
+  uint64_t falta = f.tamanho ? f.tamanho : ~uint64_t(0), total = 0;
+
+  // So' o primeiro canal: o sinal da fita e' mono.
+  while(falta >= quadro) {
+    entrada.read(reinterpret_cast<char *>(bruto.data()), std::streamsize(std::min<uint64_t>(bruto.size(), falta)));
+    size_t n = size_t(entrada.gcount()) / quadro;
+    if(!n)
+      break;
+    falta -= n * quadro;
+    const uint8_t *p = bruto.data();
+    if(f.bits == 16 && f.canais == 1)
+      std::memcpy(amostras.data(), p, n * 2);
+    else if(f.bits == 16)
+      for(size_t i = 0; i < n; i++)
+        amostras[i] = int16_t(le16(p + i * quadro));
+    else
+      for(size_t i = 0; i < n; i++)
+        amostras[i] = int16_t((p[i * quadro] - 128) << 8);
+    decodificador.processar(amostras.data(), n);
+    total += n;
+  }
+  decodificador.terminar();
+
+  resultado.segundos = double(total) / f.taxa;
+  resultado.blocos = decodificador.getBlocos();
+  resultado.bytes = decodificador.getBytes();
+  resultado.erros = decodificador.getErros();
+  resultado.baud = decodificador.getBaud();
+  return saida.good() && resultado.blocos > 0;
+}
+
+SintetizadorFita::SintetizadorFita(std::ostream &saida, unsigned taxa, unsigned baud)
+  : saida(saida), taxa(taxa), baud(baud), erro(0), buffer(amostrasBuffer), usado(0), amostras(0) {
+  // Onda quadrada, como a que sai do MSX: cada ciclo comeca na metade alta.
+  for(int valor = 0; valor < 2; valor++)
+    for(int maior = 0; maior < 2; maior++) {
+      unsigned n = taxa / baud + unsigned(maior), ciclos = unsigned(valor) + 1;
+      formas[valor][maior].resize(n);
+      for(unsigned k = 0; k < n; k++)
+        formas[valor][maior][k] = (k * ciclos * 2 / n) % 2 ? -amplitude : amplitude;
+    }
+}
+
+SintetizadorFita::~SintetizadorFita() {
+  esvaziar();
+}
+
+uint64_t SintetizadorFita::getAmostras() const {
+  return amostras;
+}
+
+void SintetizadorFita::esvaziar() {
+  saida.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(usado * sizeof(int16_t)));
+  usado = 0;
+}
+
+void SintetizadorFita::bit(int valor) {
+  // Bresenham: taxa % baud amostras a distribuir a cada baud bits.
+  erro += taxa % baud;
+  bool maior = erro >= baud;
+  if(maior)
+    erro -= baud;
+  const std::vector<int16_t> &forma = formas[valor][maior];
+  if(usado + forma.size() > buffer.size())
+    esvaziar();
+  std::copy(forma.begin(), forma.end(), buffer.begin() + std::ptrdiff_t(usado));
+  usado += forma.size();
+  amostras += forma.size();
+}
+
+void SintetizadorFita::silencio(double segundos) {
+  uint64_t n = uint64_t(segundos * taxa);
+
+  amostras += n;
+  while(n) {
+    if(usado == buffer.size())
+      esvaziar();
+    size_t m = size_t(std::min<uint64_t>(n, buffer.size() - usado));
+    std::fill_n(buffer.begin() + std::ptrdiff_t(usado), m, int16_t(0));
+    usado += m;
+    n -= m;
+  }
+}
+
+void SintetizadorFita::tom(unsigned bits) {
+  while(bits--)
+    bit(1);
+}
+
+void SintetizadorFita::bytes(const uint8_t *dados, size_t n) {
+  for(size_t i = 0; i < n; i++) {
+    bit(0);
+    for(int k = 0; k < 8; k++)
+      bit((dados[i] >> k) & 1);
+    bit(1);
+    bit(1);
+  }
+}
+
+static void gravar16(uint8_t *p, uint16_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+}
+
+static void gravar32(uint8_t *p, uint32_t v) {
+  gravar16(p, uint16_t(v));
+  gravar16(p + 2, uint16_t(v >> 16));
+}
+
+void cabecalhoWav(uint8_t h[44], unsigned taxa, uint64_t amostras) {
+  uint32_t dados = uint32_t(std::min<uint64_t>(amostras * 2, 0xFFFFFFFF - 36));
+
+  std::memcpy(h, "RIFF", 4);
+  gravar32(h + 4, 36 + dados);
+  std::memcpy(h + 8, "WAVEfmt ", 8);
+  gravar32(h + 16, 16);
+  gravar16(h + 20, 1);
+  gravar16(h + 22, 1);
+  gravar32(h + 24, taxa);
+  gravar32(h + 28, taxa * 2);
+  gravar16(h + 32, 2);
+  gravar16(h + 34, 16);
+  std::memcpy(h + 36, "data", 4);
+  gravar32(h + 40, dados);
+}
+
+bool converterCasWav(std::string cas, std::string wav, unsigned taxa, unsigned baud, double *segundos) {
+  ArquivoMapeado mapa;
+  std::vector<uint64_t> posicoes;
+  uint8_t h[44];
+
+  if(!baud || taxa < baud * 8 || !mapa.abrir(cas))
+    return false;
+  mapa.setSequencial(true);
+  const uint8_t *d = mapa.getDados();
+  uint64_t n = mapa.getTamanho();
+  Cassete::procurarCabecalhos(d, size_t(n), posicoes);
+  if(posicoes.empty())
+    return false;
+
+  std::ofstream saida(wav, std::ios::binary | std::ios::trunc);
+  if(!saida)
+    return false;
+  // O tamanho so' e' conhecido no fim; o cabecalho e' regravado depois.
+  cabecalhoWav(h, taxa, 0);
+  saida.write(reinterpret_cast<const char *>(h), sizeof(h));
+
+  uint64_t amostras;
+  {
+    SintetizadorFita sintetizador(saida, taxa, baud);
+    for(size_t k = 0; k < posicoes.size(); k++) {
+      uint64_t inicio = posicoes[k] + 8, fim = k + 1 < posicoes.size() ? posicoes[k + 1] : n;
+      const uint8_t *p = d + inicio;
+      // Mesmo teste do indice da Cassete: 10 bytes iguais de tipo.
+      bool nome = fim - inicio >= 16 && std::count(p, p + 10, p[0]) == 10 &&
+                  (p[0] == 0xD3 || p[0] == 0xEA || p[0] == 0xD0);
+      sintetizador.silencio(nome ? 2.0 : 1.0);
+      sintetizador.tom((nome ? tomLongo : tomCurto) * baud / 1200);
+      sintetizador.bytes(p, size_t(fim - inicio));
+    }
+    sintetizador.silencio(1.0);
+    amostras = sintetizador.getAmostras();
+  }
+
+  cabecalhoWav(h, taxa, amostras);
+  saida.seekp(0);
+  saida.write(reinterpret_cast<const char *>(h), sizeof(h));
+  if(segundos)
+    *segundos = double(amostras) / taxa;
+  return saida.good();
+}
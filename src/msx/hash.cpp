@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "hash.h"
+
+// Tabelas do CRC de 8 em 8 bytes: a linha k da o efeito de um byte seguido
+// de k bytes zero, entao 8 consultas independentes substituem 8 em cadeia.
+struct TabelasCRC {
+  uint32_t t[8][256] = {};
+};
+
+static constexpr TabelasCRC gerarTabelasCRC() {
+  TabelasCRC tab;
+  for(uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for(int k = 0; k < 8; k++)
+      c = (c >> 1) ^ (c & 1 ? 0xEDB88320u : 0);
+    tab.t[0][i] = c;
+  }
+  for(uint32_t i = 0; i < 256; i++)
+    for(int k = 1; k < 8; k++)
+      tab.t[k][i] = (tab.t[k - 1][i] >> 8) ^ tab.t[0][tab.t[k - 1][i] & 0xFF];
+  return tab;
+}
+
+static constexpr TabelasCRC tabelasCRC = gerarTabelasCRC();
+static_assert(tabelasCRC.t[0][1] == 0x77073096u, "tabela do CRC-32");
+
+static uint32_t crc32Tabela(const uint8_t *dados, size_t n, uint32_t crc) {
+  const uint32_t (*t)[256] = tabelasCRC.t;
+
+  for(; n >= 8; n -= 8, dados += 8) {
+    uint32_t a, b;
+    std::memcpy(&a, dados, 4);
+    std::memcpy(&b, dados + 4, 4);
+    a ^= crc;
+    crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24] ^
+          t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+  }
+  while(n--)
+    crc = (crc >> 8) ^ t[0][(crc ^ *dados++) & 0xFF];
+  return crc;
+}
+
+#ifdef __SSE2__
+// Dobra com multiplicacao sem vai-um (Gopal et al., "Fast CRC Computation
+// for Generic Polynomials Using PCLMULQDQ"): quatro acumuladores de 128 bits
+// andam 64 bytes por vez e no fim sao dobrados num so' e reduzidos a 32 bits
+// por Barrett. A instrucao crc32 do SSE4.2 nao serve: ela calcula o CRC-32C,
+// de outro polinomio. n: multiplo de 16, pelo menos 64; crc ja' invertido.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32Dobras(const uint8_t *dados, size_t n, uint32_t crc) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+  const __m128i k5 = _mm_set_epi64x(0, 0x0163CD6124);
+  const __m128i polinomio = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+  const __m128i baixos = _mm_setr_epi32(~0, 0, ~0, 0);
+  const __m128i *p = reinterpret_cast<const __m128i *>(dados);
+
+  __m128i x1 = _mm_xor_si128(_mm_loadu_si128(p), _mm_cvtsi32_si128(int(crc)));
+  __m128i x2 = _mm_loadu_si128(p + 1), x3 = _mm_loadu_si128(p + 2), x4 = _mm_loadu_si128(p + 3);
+  for(p += 4, n -= 64; n >= 64; p += 4, n -= 64) {
+    __m128i y1 = _mm_clmulepi64_si128(x1, k1k2, 0x00), y2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i y3 = _mm_clmulepi64_si128(x3, k1k2, 0x00), y4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), y1), _mm_loadu_si128(p));
+    x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), y2), _mm_loadu_si128(p + 1));
+    x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), y3), _mm_loadu_si128(p + 2));
+    x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), y4), _mm_loadu_si128(p + 3));
+  }
+
+  // Quatro acumuladores num so', e depois o resto de 16 em 16.
+  __m128i prox[3] = {x2, x3, x4};
+  for(const __m128i &x : prox)
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x);
+  for(; n >= 16; p++, n -= 16)
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)),
+                       _mm_loadu_si128(p));
+
+  // 128 bits para 64, e Barrett de 64 para 32.
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, k3k4, 0x10));
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, baixos), k5, 0x00), _mm_srli_si128(x1, 4));
+  __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, baixos), polinomio, 0x10);
+  t = _mm_clmulepi64_si128(_mm_and_si128(t, baixos), polinomio, 0x00);
+  return uint32_t(_mm_extract_epi32(_mm_xor_si128(x1, t), 1));
+}
+#endif
+
+uint32_t crc32(const uint8_t *dados, size_t n, uint32_t crc) {
+  crc = ~crc;
+#ifdef __SSE2__
+  static const bool temPCLMUL = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+  if(temPCLMUL && n >= 64) {
+    size_t m = n & ~size_t(15);
+    crc = crc32Dobras(dados, m, crc);
+    dados += m;
+    n -= m;
+  }
+#endif
+  return ~crc32Tabela(dados, n, crc);
+}
+
+static uint32_t girar(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t le32be(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static void blocoSha1(uint32_t h[5], const uint8_t *p) {
+  uint32_t w[80];
+
+  for(int i = 0; i < 16; i++)
+    w[i] = le32be(p + i * 4);
+  for(int i = 16; i < 80; i++)
+    w[i] = girar(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  // Uma funcao por laco de 20 rodadas, sem desvio dentro delas.
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], t;
+  for(int i = 0; i < 20; i++) {
+    t = girar(a, 5) + ((b & (c ^ d)) ^ d) + e + 0x5A827999 + w[i];
+    e = d;
+    d = c;
+    c = girar(b, 30);
+    b = a;
+    a = t;
+  }
+  for(int i = 20; i < 40; i++) {
+    t = girar(a, 5) + (b ^ c ^ d) + e + 0x6ED9EBA1 + w[i];
+    e = d;
+    d = c;
+    c = girar(b, 30);
+    b = a;
+    a = t;
+  }
+  for(int i = 40; i < 60; i++) {
+    t = girar(a, 5) + ((b & c) | (d & (b | c))) + e + 0x8F1BBCDC + w[i];
+    e = d;
+    d = c;
+    c = girar(b, 30);
+    b = a;
+    a = t;
+  }
+  for(int i = 60; i < 80; i++) {
+    t = girar(a, 5) + (b ^ c ^ d) + e + 0xCA62C1D6 + w[i];
+    e = d;
+    d = c;
+    c = girar(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+#ifdef __SSE2__
+// Extensoes SHA: cada sha1rnds4 faz 4 rodadas e sha1msg1/sha1msg2 montam as
+// palavras seguintes da mensagem. m[g % 4] tem as palavras do grupo g.
+__attribute__((target("sha,sse4.1")))
+static void blocosSha1NI(uint32_t h[5], const uint8_t *p, size_t blocos) {
+  const __m128i inverter = _mm_set_epi64x(0x0001020304050607, 0x08090A0B0C0D0E0F);
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(h)), 0x1B);
+  __m128i e0 = _mm_set_epi32(int(h[4]), 0, 0, 0);
+
+  for(; blocos; blocos--, p += 64) {
+    __m128i salvoAbcd = abcd, salvoE = e0, e1, m[4];
+
+#pragma GCC unroll 20
+    for(int g = 0; g < 20; g++) {
+      __m128i &w = m[g % 4];
+      if(g < 4)
+        w = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + g * 16)), inverter);
+      // Os E se alternam: o de agora recebe a mensagem, o outro guarda o ABCD.
+      __m128i &e = g % 2 ? e1 : e0;
+      e = g ? _mm_sha1nexte_epu32(e, w) : _mm_add_epi32(e, w);
+      (g % 2 ? e0 : e1) = abcd;
+      if(g >= 3 && g <= 18)
+        m[(g + 1) % 4] = _mm_sha1msg2_epu32(m[(g + 1) % 4], w);
+      switch(g / 5) {
+        case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break;
+        case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break;
+        case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break;
+        default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break;
+      }
+      if(g >= 1 && g <= 16)
+        m[(g + 3) % 4] = _mm_sha1msg1_epu32(m[(g + 3) % 4], w);
+      if(g >= 2 && g <= 17)
+        m[(g + 2) % 4] = _mm_xor_si128(m[(g + 2) % 4], w);
+    }
+    e0 = _mm_sha1nexte_epu32(e0, salvoE);
+    abcd = _mm_add_epi32(abcd, salvoAbcd);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(h), _mm_shuffle_epi32(abcd, 0x1B));
+  h[4] = uint32_t(_mm_extract_epi32(e0, 3));
+}
+#endif
+
+static void blocosSha1(uint32_t h[5], const uint8_t *p, size_t blocos) {
+#ifdef __SSE2__
+  static const bool temSHA = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+  if(temSHA) {
+    blocosSha1NI(h, p, blocos);
+    return;
+  }
+#endif
+  for(; blocos; blocos--, p += 64)
+    blocoSha1(h, p);
+}
+
+// O resto, o bit 1 e o tamanho em bits cabem em um ou dois blocos.
+// grande: o tamanho vai em big-endian (SHA-1) ou little-endian (MD5).
+static size_t completar(const uint8_t *dados, size_t n, uint8_t fim[128], bool grande) {
+  uint64_t bits = uint64_t(n) * 8;
+  size_t resto = n % 64;
+
+  std::memset(fim, 0, 128);
+  if(resto)
+    std::memcpy(fim, dados + (n - resto), resto);
+  fim[resto] = 0x80;
+  size_t blocos = resto < 56 ? 1 : 2;
+  for(int i = 0; i < 8; i++)
+    fim[grande ? blocos * 64 - 1 - i : blocos * 64 - 8 + i] = uint8_t(bits >> (i * 8));
+  return blocos;
+}
+
+static const uint32_t inicioSha1[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+static void terminarSha1(uint32_t h[5], const uint8_t *dados, size_t n, uint8_t resumo[20]) {
+  uint8_t fim[128];
+
+  blocosSha1(h, fim, completar(dados, n, fim, true));
+  for(int i = 0; i < 5; i++)
+    for(int j = 0; j < 4; j++)
+      resumo[i * 4 + j] = uint8_t(h[i] >> (24 - j * 8));
+}
+
+void sha1(const uint8_t *dados, size_t n, uint8_t resumo[20]) {
+  uint32_t h[5];
+
+  std::copy(inicioSha1, inicioSha1 + 5, h);
+  blocosSha1(h, dados, n / 64);
+  terminarSha1(h, dados, n, resumo);
+}
+
+// MD5 (RFC 1321). Nao ha' instrucao para ele; as 64 rodadas vao em quatro
+// lacos de 16, um por funcao, com as constantes e os giros em tabela.
+struct TabelasMD5 {
+  uint32_t k[64] = {
+    0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+    0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+    0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+    0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+    0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+    0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+    0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+    0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391
+  };
+  int giro[4][4] = {{7, 12, 17, 22}, {5, 9, 14, 20}, {4, 11, 16, 23}, {6, 10, 15, 21}};
+};
+
+static constexpr TabelasMD5 tabelasMD5 = TabelasMD5();
+
+static void blocosMd5(uint32_t h[4], const uint8_t *p, size_t blocos) {
+  const uint32_t *k = tabelasMD5.k;
+
+  for(; blocos; blocos--, p += 64) {
+    uint32_t w[16];
+    for(int i = 0; i < 16; i++)
+      w[i] = uint32_t(p[i * 4]) | (uint32_t(p[i * 4 + 1]) << 8) | (uint32_t(p[i * 4 + 2]) << 16) |
+             (uint32_t(p[i * 4 + 3]) << 24);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], t;
+    for(int i = 0; i < 16; i++) {
+      t = d;
+      d = c;
+      c = b;
+      b += girar(a + ((c & (d ^ t)) ^ t) + k[i] + w[i], tabelasMD5.giro[0][i % 4]);
+      a = t;
+    }
+    for(int i = 16; i < 32; i++) {
+      t = d;
+      d = c;
+      c = b;
+      b += girar(a + ((t & (c ^ d)) ^ d) + k[i] + w[(5 * i + 1) % 16], tabelasMD5.giro[1][i % 4]);
+      a = t;
+    }
+    for(int i = 32; i < 48; i++) {
+      t = d;
+      d = c;
+      c = b;
+      b += girar(a + (c ^ d ^ t) + k[i] + w[(3 * i + 5) % 16], tabelasMD5.giro[2][i % 4]);
+      a = t;
+    }
+    for(int i = 48; i < 64; i++) {
+      t = d;
+      d = c;
+      c = b;
+      b += girar(a + (d ^ (c | ~t)) + k[i] + w[(7 * i) % 16], tabelasMD5.giro[3][i % 4]);
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+  }
+}
+
+static const uint32_t inicioMd5[4] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476};
+
+static void terminarMd5(uint32_t h[4], const uint8_t *dados, size_t n, uint8_t resumo[16]) {
+  uint8_t fim[128];
+
+  blocosMd5(h, fim, completar(dados, n, fim, false));
+  for(int i = 0; i < 4; i++)
+    for(int j = 0; j < 4; j++)
+      resumo[i * 4 + j] = uint8_t(h[i] >> (j * 8));
+}
+
+void md5(const uint8_t *dados, size_t n, uint8_t resumo[16]) {
+  uint32_t h[4];
+
+  std::copy(inicioMd5, inicioMd5 + 4, h);
+  blocosMd5(h, dados, n / 64);
+  terminarMd5(h, dados, n, resumo);
+}
+
+void resumir(const uint8_t *dados, size_t n, Resumos &resumos) {
+  // Trechos de 64 KB: os tres calculos leem o trecho enquanto ele ainda
+  // esta' no cache, em vez de cada um varrer o arquivo inteiro.
+  const size_t trecho = 64 << 10;
+  uint32_t hSha1[5], hMd5[4], crc = 0;
+
+  std::copy(inicioSha1, inicioSha1 + 5, hSha1);
+  std::copy(inicioMd5, inicioMd5 + 4, hMd5);
+  for(size_t i = 0; i < n; i += trecho) {
+    size_t m = std::min(trecho, n - i);
+    crc = crc32(dados + i, m, crc);
+    blocosSha1(hSha1, dados + i, m / 64);
+    blocosMd5(hMd5, dados + i, m / 64);
+  }
+  resumos.crc = crc;
+  terminarSha1(hSha1, dados, n, resumos.sha1);
+  terminarMd5(hMd5, dados, n, resumos.md5);
+}
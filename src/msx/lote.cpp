@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <glob.h>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
+#include "disco.h"
+#include "fita.h"
+#include "lote.h"
+#include "mapeamento.h"
+#include "tarefas.h"
+#include "vgm.h"
+
+// Gravador com fila limitada em bytes: quem extrai so' espera quando a fila
+// esta' cheia, e as threads de gravacao esvaziam a fila em paralelo.
+class GravadorAssincrono : public Gravador {
+  public:
+    GravadorAssincrono(uint64_t limite, unsigned threads);
+    ~GravadorAssincrono();
+
+    bool gravar(const std::string &caminho, std::vector<uint8_t> &&dados) override;
+    void fechar();
+    uint64_t getFalhas() const;
+
+  private:
+    struct Pedido {
+      std::string caminho;
+      std::vector<uint8_t> dados;
+    };
+
+    std::deque<Pedido> fila;
+    std::mutex trava;
+    std::condition_variable temPedido;
+    std::condition_variable temEspaco;
+    std::vector<std::thread> threads;
+    uint64_t limite;
+    uint64_t emUso;
+    bool parar;
+    std::atomic<uint64_t> falhas;
+
+    void trabalhar();
+};
+
+GravadorAssincrono::GravadorAssincrono(uint64_t limite, unsigned n)
+  : limite(limite), emUso(0), parar(false), falhas(0) {
+  for(unsigned i = 0; i < n; i++)
+    threads.emplace_back(&GravadorAssincrono::trabalhar, this);
+}
+
+GravadorAssincrono::~GravadorAssincrono() {
+  fechar();
+}
+
+bool GravadorAssincrono::gravar(const std::string &caminho, std::vector<uint8_t> &&dados) {
+  std::unique_lock<std::mutex> l(trava);
+
+  // Um arquivo maior que o limite inteiro passa sozinho, com a fila vazia.
+  temEspaco.wait(l, [&] { return emUso == 0 || emUso + dados.size() <= limite; });
+  emUso += dados.size();
+  fila.push_back(Pedido{caminho, std::move(dados)});
+  temPedido.notify_one();
+  return true;
+}
+
+void GravadorAssincrono::trabalhar() {
+  for(;;) {
+    Pedido pedido;
+    {
+      std::unique_lock<std::mutex> l(trava);
+      temPedido.wait(l, [this] { return parar || !fila.empty(); });
+      if(fila.empty())
+        return;
+      pedido = std::move(fila.front());
+      fila.pop_front();
+    }
+
+    uint64_t n = pedido.dados.size();
+    if(!Gravador::gravar(pedido.caminho, std::move(pedido.dados)))
+      falhas++;
+    std::vector<uint8_t>().swap(pedido.dados);
+
+    std::lock_guard<std::mutex> l(trava);
+    emUso -= n;
+    temEspaco.notify_all();
+  }
+}
+
+void GravadorAssincrono::fechar() {
+  {
+    std::lock_guard<std::mutex> l(trava);
+    parar = true;
+  }
+  temPedido.notify_all();
+  for(std::thread &t : threads)
+    t.join();
+  threads.clear();
+}
+
+uint64_t GravadorAssincrono::getFalhas() const {
+  return falhas;
+}
+
+static std::string nomeBase(const std::string &caminho) {
+  size_t barra = caminho.find_last_of('/');
+  std::string nome = barra == std::string::npos ? caminho : caminho.substr(barra + 1);
+  size_t ponto = nome.find_last_of('.');
+  return ponto == std::string::npos || ponto == 0 ? nome : nome.substr(0, ponto);
+}
+
+static uint64_t tamanhoArquivo(const std::string &caminho) {
+  struct stat st;
+  return stat(caminho.c_str(), &st) == 0 ? uint64_t(st.st_size) : 0;
+}
+
+// Cada arquivo do lote e a saida dele.
+typedef std::vector<std::pair<std::string, std::string>> TrabalhosLote;
+
+// Arquivos que casam com o padrao, cada um com destino/<nome><extensao>;
+// arquivos com o mesmo nome em pastas diferentes ganham um sufixo. 'tipo'
+// so' entra na mensagem de erro ("nenhuma imagem casa com ...").
+static bool prepararLote(const std::string &padrao, const std::string &destino, const std::string &extensao,
+                         const std::string &tipo, TrabalhosLote &trabalhos, ResultadoLote &resultado) {
+  glob_t g;
+
+  if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0) {
+    resultado.erros.push_back("nenhuma " + tipo + " casa com " + padrao);
+    return false;
+  }
+  if(mkdir(destino.c_str(), 0777) < 0 && errno != EEXIST) {
+    globfree(&g);
+    resultado.erros.push_back("nao foi possivel criar " + destino);
+    return false;
+  }
+
+  std::map<std::string, int> usados;
+  for(size_t i = 0; i < g.gl_pathc; i++) {
+    std::string nome = nomeBase(g.gl_pathv[i]);
+    int n = ++usados[nome];
+    if(n > 1)
+      nome += "_" + std::to_string(n);
+    trabalhos.emplace_back(g.gl_pathv[i], destino + "/" + nome + extensao);
+  }
+  globfree(&g);
+  return true;
+}
+
+// Converte um arquivo do lote; devolve false na falha e soma em 'gravados'
+// os bytes que escreveu.
+typedef std::function<bool(const std::string &entrada, const std::string &saida, uint64_t &gravados)> ConversaoLote;
+
+// Lote com um arquivo por tarefa de um PoolTarefas: prepara os trabalhos,
+// roda 'converter' em cada um e preenche o resultado. 'acao' entra na
+// mensagem de cada falha ("falha ao extrair ...").
+static bool executarLote(const std::string &padrao, const std::string &destino, const std::string &extensao,
+                         const std::string &tipo, const std::string &acao, unsigned threads, ResultadoLote &resultado,
+                         const ConversaoLote &converter) {
+  std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+  TrabalhosLote trabalhos;
+
+  resultado = ResultadoLote{0, 0, 0, 0, 0.0, {}};
+  if(!prepararLote(padrao, destino, extensao, tipo, trabalhos, resultado))
+    return false;
+
+  std::atomic<uint64_t> arquivos(0), falhas(0), lidos(0), gravados(0);
+  std::mutex travaErros;
+  {
+    PoolTarefas pool(threads);
+    for(const std::pair<std::string, std::string> &t : trabalhos)
+      pool.adicionar([&, t] {
+        uint64_t bytes = 0;
+        lidos += tamanhoArquivo(t.first);
+        if(!converter(t.first, t.second, bytes)) {
+          falhas++;
+          std::lock_guard<std::mutex> l(travaErros);
+          resultado.erros.push_back("falha ao " + acao + " " + t.first);
+        }
+        gravados += bytes;
+        arquivos++;
+      });
+    pool.esperar();
+  }
+
+  resultado.imagens = arquivos;
+  resultado.falhas = falhas;
+  resultado.bytesLidos = lidos;
+  resultado.bytesGravados = gravados;
+  resultado.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  return resultado.falhas == 0;
+}
+
+bool extrairLote(std::string padrao, std::string destino, unsigned threads, ResultadoLote &resultado,
+                 uint64_t memoriaGravacao) {
+  GravadorAssincrono gravador(memoriaGravacao, 2);
+  bool ok = executarLote(padrao, destino, "", "imagem", "extrair", threads, resultado,
+                         [&gravador](const std::string &entrada, const std::string &saida, uint64_t &gravados) {
+                           Disco disco;
+                           return disco.abrir(entrada) && disco.extrairTudo(saida, &gravados, &gravador);
+                         });
+  if(!resultado.imagens)
+    return ok;
+
+  // O tempo inclui esvaziar a fila de gravacao.
+  std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+  gravador.fechar();
+  resultado.segundos += std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  if(gravador.getFalhas()) {
+    resultado.erros.push_back(std::to_string(gravador.getFalhas()) + " arquivos nao puderam ser gravados");
+    resultado.falhas += gravador.getFalhas();
+    ok = false;
+  }
+  return ok;
+}
+
+bool detectarLote(const MSX &msx, std::string padrao, unsigned threads, std::vector<MapeadorArquivo> &resultado) {
+  glob_t g;
+
+  resultado.clear();
+  if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0)
+    return false;
+  for(size_t i = 0; i < g.gl_pathc; i++)
+    resultado.push_back(MapeadorArquivo{g.gl_pathv[i], mapeadorLinear, false});
+  globfree(&g);
+
+  // Cada tarefa so' escreve na sua posicao do resultado.
+  std::atomic<uint64_t> falhas(0);
+  {
+    PoolTarefas pool(threads);
+    for(MapeadorArquivo &m : resultado)
+      pool.adicionar([&msx, &m, &falhas] {
+        m.lido = msx.detectarMapeador(m.arquivo, m.mapeador);
+        if(!m.lido)
+          falhas++;
+      });
+    pool.esperar();
+  }
+  return falhas == 0;
+}
+
+bool resumirLote(const std::vector<std::string> &padroes, unsigned threads, std::vector<HashArquivo> &resultado) {
+  resultado.clear();
+  for(const std::string &padrao : padroes) {
+    glob_t g;
+    if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0)
+      continue;
+    for(size_t i = 0; i < g.gl_pathc; i++)
+      resultado.push_back(HashArquivo{g.gl_pathv[i], 0, Resumos(), false});
+    globfree(&g);
+  }
+
+  // Maiores primeiro, para um arquivo grande nao ficar sozinho no fim.
+  std::vector<std::pair<uint64_t, HashArquivo *>> ordem;
+  for(HashArquivo &h : resultado) {
+    struct stat st;
+    ordem.emplace_back(stat(h.arquivo.c_str(), &st) == 0 ? uint64_t(st.st_size) : 0, &h);
+  }
+  std::stable_sort(ordem.begin(), ordem.end(),
+                   [](const std::pair<uint64_t, HashArquivo *> &a, const std::pair<uint64_t, HashArquivo *> &b) {
+                     return a.first > b.first;
+                   });
+
+  std::atomic<uint64_t> falhas(0);
+  {
+    PoolTarefas pool(threads);
+    for(const std::pair<uint64_t, HashArquivo *> &o : ordem)
+      pool.adicionar([h = o.second, &falhas] {
+        ArquivoMapeado mapa;
+        h->lido = mapa.abrir(h->arquivo);
+        if(!h->lido) {
+          falhas++;
+          return;
+        }
+        mapa.setSequencial(true);
+        h->tamanho = mapa.getTamanho();
+        resumir(mapa.getDados(), size_t(h->tamanho), h->resumos);
+      });
+    pool.esperar();
+  }
+  return falhas == 0 && !resultado.empty();
+}
+
+static std::string hexadecimal(const uint8_t *dados, size_t n) {
+  static const char digitos[] = "0123456789abcdef";
+  std::string texto;
+
+  for(size_t i = 0; i < n; i++) {
+    texto += digitos[dados[i] >> 4];
+    texto += digitos[dados[i] & 15];
+  }
+  return texto;
+}
+
+// Nomes do DAT vao entre aspas, que nao podem aparecer dentro deles.
+static std::string nomeDat(std::string nome) {
+  std::replace(nome.begin(), nome.end(), '"', '\'');
+  return "\"" + nome + "\"";
+}
+
+void escreverDat(std::ostream &saida, const std::vector<HashArquivo> &arquivos) {
+  saida << "clrmamepro (\n\tname \"msx-tools\"\n\tdescription \"msx-tools --hash\"\n)\n";
+  for(const HashArquivo &h : arquivos) {
+    if(!h.lido)
+      continue;
+    size_t barra = h.arquivo.find_last_of('/');
+    std::string nome = barra == std::string::npos ? h.arquivo : h.arquivo.substr(barra + 1);
+    char crc[9];
+    std::snprintf(crc, sizeof(crc), "%08x", h.resumos.crc);
+    saida << "\ngame (\n\tname " << nomeDat(nomeBase(h.arquivo)) << "\n\tdescription " << nomeDat(nomeBase(h.arquivo))
+          << "\n\trom ( name " << nomeDat(nome) << " size " << h.tamanho << " crc " << crc << " md5 "
+          << hexadecimal(h.resumos.md5, 16) << " sha1 " << hexadecimal(h.resumos.sha1, 20) << " )\n)\n";
+  }
+}
+
+bool indexarCassetes(std::string padrao, std::string destino, unsigned threads, std::vector<IndiceCassete> &resultado) {
+  glob_t g;
+
+  resultado.clear();
+  if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0)
+    return false;
+  std::map<std::string, int> usados;
+  std::vector<std::string> pastas;
+  for(size_t i = 0; i < g.gl_pathc; i++) {
+    std::string nome = nomeBase(g.gl_pathv[i]);
+    int n = ++usados[nome];
+    if(n > 1)
+      nome += "_" + std::to_string(n);
+    resultado.push_back(IndiceCassete{g.gl_pathv[i], {}, {}, false});
+    pastas.push_back(destino + "/" + nome);
+  }
+  globfree(&g);
+  if(!destino.empty() && mkdir(destino.c_str(), 0777) < 0 && errno != EEXIST)
+    return false;
+
+  std::atomic<uint64_t> falhas(0);
+  {
+    PoolTarefas pool(threads);
+    for(size_t i = 0; i < resultado.size(); i++)
+      pool.adicionar([&, i] {
+        IndiceCassete &c = resultado[i];
+        Cassete cassete;
+        c.lido = cassete.abrir(c.arquivo) && (destino.empty() || cassete.extrairTudo(pastas[i], nullptr, nullptr, &c.avisos));
+        if(!c.lido)
+          falhas++;
+        c.arquivos = cassete.getArquivos();
+      });
+    pool.esperar();
+  }
+  return falhas == 0;
+}
+
+bool sintetizarLote(std::string padrao, std::string destino, unsigned taxa, unsigned baud, unsigned threads,
+                    ResultadoLote &resultado) {
+  return executarLote(padrao, destino, ".wav", "fita", "converter", threads, resultado,
+                      [taxa, baud](const std::string &entrada, const std::string &saida, uint64_t &gravados) {
+                        if(!converterCasWav(entrada, saida, taxa, baud))
+                          return false;
+                        gravados = tamanhoArquivo(saida);
+                        return true;
+                      });
+}
+
+bool telasLote(const MSX &msx, std::string padrao, std::string destino, unsigned modo, unsigned fator,
+               unsigned threads, ResultadoLote &resultado) {
+  return executarLote(padrao, destino, ".png", "tela", "converter", threads, resultado,
+                      [&msx, modo, fator](const std::string &entrada, const std::string &saida, uint64_t &gravados) {
+                        ImagemRGBA imagem;
+                        if(!msx.decodificarTela(entrada, modo, imagem))
+                          return false;
+                        reduzir(imagem, fator, imagem);
+                        if(!gravarPng(saida, imagem))
+                          return false;
+                        gravados = tamanhoArquivo(saida);
+                        return true;
+                      });
+}
+
+bool converterPngLote(std::string padrao, std::string destino, unsigned modo, bool difusao, unsigned threads,
+                      ResultadoLote &resultado) {
+  std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+  const char *extensao = modo == 2 ? ".SC2" : modo == 5 ? ".SC5" : modo == 8 ? ".SC8" : ".SCC";
+  TrabalhosLote trabalhos;
+
+  resultado = ResultadoLote{0, 0, 0, 0, 0.0, {}};
+  if(modo != 2 && modo != 5 && modo != 8 && modo != 12) {
+    resultado.erros.push_back("modo " + std::to_string(modo) + " nao e' 2, 5, 8 nem 12");
+    return false;
+  }
+  if(!prepararLote(padrao, destino, extensao, "imagem", trabalhos, resultado))
+    return false;
+
+  // Duas imagens e duas VRAMs: uma na conversao, a outra sendo lida ou gravada.
+  PoolTarefas pool(threads);
+  ConversorTela conversor(pool);
+  ImagemRGBA imagens[2];
+  std::vector<uint8_t> vrams[2];
+  std::future<bool> leitura, gravacao;
+  size_t gravando = 0;
+  auto falhou = [&](size_t i) {
+    resultado.falhas++;
+    resultado.erros.push_back("falha ao converter " + trabalhos[i].first);
+  };
+
+  if(!trabalhos.empty())
+    leitura = std::async(std::launch::async, lerPng, trabalhos[0].first, std::ref(imagens[0]));
+  for(size_t i = 0; i < trabalhos.size(); i++) {
+    bool ok = leitura.get();
+    if(i + 1 < trabalhos.size())
+      leitura = std::async(std::launch::async, lerPng, trabalhos[i + 1].first, std::ref(imagens[(i + 1) % 2]));
+    resultado.bytesLidos += tamanhoArquivo(trabalhos[i].first);
+    ok = ok && conversor.converter(imagens[i % 2], modo, difusao, vrams[i % 2]);
+
+    if(gravacao.valid() && !gravacao.get())
+      falhou(gravando);
+    if(ok) {
+      gravando = i;
+      resultado.bytesGravados += vrams[i % 2].size() + 7;
+      gravacao = std::async(std::launch::async, gravarBsave, trabalhos[i].second, std::cref(vrams[i % 2]));
+    } else
+      falhou(i);
+    resultado.imagens++;
+  }
+  if(gravacao.valid() && !gravacao.get())
+    falhou(gravando);
+
+  resultado.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  return resultado.falhas == 0;
+}
+
+bool indexarPadroes(const std::vector<std::string> &padroes, std::string indice, unsigned threads,
+                    ResultadoLote &resultado) {
+  std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+  std::vector<std::string> arquivos;
+  IndicePadroes padroesIndice;
+
+  resultado = ResultadoLote{0, 0, 0, 0, 0.0, {}};
+  for(const std::string &padrao : padroes) {
+    glob_t g;
+    if(glob(padrao.c_str(), GLOB_TILDE | GLOB_BRACE, nullptr, &g) != 0) {
+      resultado.erros.push_back("nenhum arquivo casa com " + padrao);
+      continue;
+    }
+    for(size_t i = 0; i < g.gl_pathc; i++) {
+      arquivos.push_back(g.gl_pathv[i]);
+      resultado.bytesLidos += tamanhoArquivo(g.gl_pathv[i]);
+    }
+    globfree(&g);
+  }
+  if(!padroesIndice.abrir(indice)) {
+    resultado.erros.push_back("nao foi possivel abrir " + indice);
+    return false;
+  }
+
+  padroesIndice.adicionar(arquivos, threads, resultado.erros);
+  resultado.imagens = arquivos.size();
+  resultado.falhas = resultado.erros.size();
+  if(!padroesIndice.fechar()) {
+    resultado.erros.push_back("nao foi possivel gravar " + indice);
+    resultado.falhas++;
+  }
+  resultado.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+  return resultado.falhas == 0;
+}
+
+bool renderizarLote(std::string padrao, std::string destino, unsigned taxa, unsigned voltas, unsigned threads,
+                    ResultadoLote &resultado, double &audio) {
+  std::mutex travaAudio;
+
+  audio = 0;
+  return executarLote(padrao, destino, ".wav", "musica", "tocar", threads, resultado,
+                      [&, taxa, voltas](const std::string &entrada, const std::string &saida, uint64_t &gravados) {
+                        double segundos;
+                        if(!converterVgmWav(entrada, saida, taxa, voltas, &segundos))
+                          return false;
+                        gravados = tamanhoArquivo(saida);
+                        std::lock_guard<std::mutex> l(travaAudio);
+                        audio += segundos;
+                        return true;
+                      });
+}
@@ -0,0 +1,150 @@
+#include <cctype>
+#include <utility>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "mapeadores.h"
+
+static const char *const nomesMapeadores[totalMapeadores] = {
+  "Linear", "8KB", "Konami", "KonamiSCC", "ASCII8", "ASCII16",
+  "RC755", "RType", "CrossBlaim", "HarryFox", "Halnote", "Zemina", "Outro"
+};
+
+const char *nomeMapeador(MapeadorRom mapeador) {
+  return mapeador < totalMapeadores ? nomesMapeadores[mapeador] : "?";
+}
+
+bool mapeadorPorNome(const std::string &nome, MapeadorRom &mapeador) {
+  for(int m = 0; m < totalMapeadores; m++) {
+    const char *n = nomesMapeadores[m];
+    size_t i = 0;
+    while(n[i] && i < nome.size() && std::toupper((unsigned char) n[i]) == std::toupper((unsigned char) nome[i]))
+      i++;
+    if(!n[i] && i == nome.size()) {
+      mapeador = MapeadorRom(m);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Enderecos que os mapeadores usam para trocar de banco.
+struct Escritas {
+  uint32_t konami;
+  uint32_t konamiSCC;
+  uint32_t ascii8;
+  uint32_t ascii16;
+};
+
+static void contar(const uint8_t *d, Escritas &e) {
+  switch(d[1] | (d[2] << 8)) {
+    case 0x5000: case 0x9000: case 0xB000:
+      e.konamiSCC++;
+      break;
+    case 0x4000: case 0x8000: case 0xA000:
+      e.konami++;
+      break;
+    case 0x6800: case 0x7800:
+      e.ascii8++;
+      break;
+    case 0x6000:
+      e.konami++;
+      e.ascii8++;
+      e.ascii16++;
+      break;
+    case 0x7000:
+      e.konamiSCC++;
+      e.ascii8++;
+      e.ascii16++;
+      break;
+    case 0x77FF:
+      e.ascii16++;
+      break;
+  }
+}
+
+// Todos os enderecos acima terminam em #00 ou #FF: so' as posicoes com #32
+// seguido de um desses passam para o switch. As varreduras devolvem ate'
+// onde foram; d[i + 1] precisa ser valido.
+static size_t varrerEscalar(const uint8_t *d, size_t de, size_t ate, Escritas &e) {
+  for(size_t i = de; i < ate; i++)
+    if(d[i] == 0x32 && (d[i + 1] == 0x00 || d[i + 1] == 0xFF))
+      contar(d + i, e);
+  return ate;
+}
+
+#ifdef __SSE2__
+static size_t varrerSSE2(const uint8_t *d, size_t de, size_t ate, Escritas &e) {
+  const __m128i ld = _mm_set1_epi8(0x32), zero = _mm_setzero_si128(), ff = _mm_set1_epi8(-1);
+  size_t i = de;
+
+  for(; i + 16 <= ate; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *) (d + i));
+    __m128i y = _mm_loadu_si128((const __m128i *) (d + i + 1));
+    __m128i baixo = _mm_or_si128(_mm_cmpeq_epi8(y, zero), _mm_cmpeq_epi8(y, ff));
+    unsigned bits = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, ld), baixo));
+    while(bits) {
+      contar(d + i + __builtin_ctz(bits), e);
+      bits &= bits - 1;
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t varrerAVX2(const uint8_t *d, size_t de, size_t ate, Escritas &e) {
+  const __m256i ld = _mm256_set1_epi8(0x32), zero = _mm256_setzero_si256(), ff = _mm256_set1_epi8(-1);
+  size_t i = de;
+
+  for(; i + 32 <= ate; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *) (d + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *) (d + i + 1));
+    __m256i baixo = _mm256_or_si256(_mm256_cmpeq_epi8(y, zero), _mm256_cmpeq_epi8(y, ff));
+    uint32_t bits = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, ld), baixo));
+    while(bits) {
+      contar(d + i + __builtin_ctz(bits), e);
+      bits &= bits - 1;
+    }
+  }
+  return i;
+}
+#endif
+
+MapeadorRom adivinharMapeador(const uint8_t *rom, size_t tamanho) {
+  Escritas e{0, 0, 0, 0};
+
+  if(tamanho <= 0x10000)
+    return mapeadorLinear;
+
+  // O ultimo #32 que cabe tem o endereco inteiro dentro da ROM.
+  size_t fim = tamanho - 2, i = 0;
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = varrerAVX2(rom, i, fim, e);
+  i = varrerSSE2(rom, i, fim, e);
+#endif
+  varrerEscalar(rom, i, fim, e);
+
+  // #6000 e #7000 contam para os ASCII mesmo quando so' o primeiro banco e'
+  // trocado; uma escrita a menos evita que eles ganhem so' por isso.
+  if(e.ascii8)
+    e.ascii8--;
+  if(e.ascii16)
+    e.ascii16--;
+
+  // Empate fica com o ultimo da lista; sem nenhuma escrita, 8 KB generico.
+  MapeadorRom mapeador = mapeadorGenerico8;
+  uint32_t maior = 0;
+  const std::pair<MapeadorRom, uint32_t> candidatos[] = {
+    {mapeadorKonami, e.konami}, {mapeadorKonamiSCC, e.konamiSCC},
+    {mapeadorASCII8, e.ascii8}, {mapeadorASCII16, e.ascii16}
+  };
+  for(const std::pair<MapeadorRom, uint32_t> &c : candidatos)
+    if(c.second && c.second >= maior) {
+      mapeador = c.first;
+      maior = c.second;
+    }
+  return mapeador;
+}
@@ -0,0 +1,102 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapeamento.h"
+
+ArquivoMapeado::ArquivoMapeado() : fd(-1), base(nullptr), tamanho(0) {
+}
+
+ArquivoMapeado::~ArquivoMapeado() {
+  fechar();
+}
+
+ArquivoMapeado::ArquivoMapeado(ArquivoMapeado&& outro) noexcept
+  : fd(outro.fd), base(outro.base), tamanho(outro.tamanho) {
+  outro.fd = -1;
+  outro.base = nullptr;
+  outro.tamanho = 0;
+}
+
+ArquivoMapeado& ArquivoMapeado::operator=(ArquivoMapeado&& outro) noexcept {
+  if(this != &outro) {
+    fechar();
+    fd = outro.fd;
+    base = outro.base;
+    tamanho = outro.tamanho;
+    outro.fd = -1;
+    outro.base = nullptr;
+    outro.tamanho = 0;
+  }
+  return *this;
+}
+
+bool ArquivoMapeado::abrir(std::string arquivo) {
+  struct stat st;
+
+  fechar();
+  if((fd = open(arquivo.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+    return false;
+  if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    fechar();
+    return false;
+  }
+
+  tamanho = (uint64_t) st.st_size;
+  if(tamanho == 0)
+    return true;
+
+  void *p = mmap(nullptr, tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(p == MAP_FAILED) {
+    fechar();
+    return false;
+  }
+  base = (const uint8_t *) p;
+
+  // O editor salta pelo arquivo; read-ahead so' aumentaria a memoria residente.
+  madvise(p, tamanho, MADV_RANDOM);
+  return true;
+}
+
+void ArquivoMapeado::fechar() {
+  if(base)
+    munmap((void *) base, tamanho);
+  if(fd >= 0)
+    close(fd);
+  fd = -1;
+  base = nullptr;
+  tamanho = 0;
+}
+
+bool ArquivoMapeado::aberto() const {
+  return fd >= 0;
+}
+
+const uint8_t *ArquivoMapeado::getDados() const {
+  return base;
+}
+
+uint64_t ArquivoMapeado::getTamanho() const {
+  return tamanho;
+}
+
+int ArquivoMapeado::getDescritor() const {
+  return fd;
+}
+
+void ArquivoMapeado::preparar(uint64_t inicio, uint64_t n) const {
+  static const uint64_t pagina = (uint64_t) sysconf(_SC_PAGESIZE);
+
+  if(!base || inicio >= tamanho)
+    return;
+  if(n > tamanho - inicio)
+    n = tamanho - inicio;
+  uint64_t alinhado = inicio & ~(pagina - 1);
+  madvise((void *) (base + alinhado), n + (inicio - alinhado), MADV_WILLNEED);
+}
+
+void ArquivoMapeado::setSequencial(bool sequencial) const {
+  if(base)
+    madvise((void *) base, tamanho, sequencial ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
@@ -2,6 +2,13 @@
 // Created by barney on 20-May-21.
 //
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "hash.h"
+#include "mapeamento.h"
 #include "msx.h"
 
 std::string MSX::getModelo() {
@@ -14,3 +21,111 @@ std::string MSX::getVersao() {
 
 MSX::MSX(std::string descricao, std::string numver) : modelo(descricao), versao(numver) {
 }
+
+bool MSX::abrirDisco(std::string imagem, unsigned particao, bool escrita) {
+  std::shared_ptr<Disco> novo = std::make_shared<Disco>();
+
+  if(!novo->abrir(imagem, particao, escrita))
+    return false;
+  disco = novo;
+  return true;
+}
+
+Disco *MSX::getDisco() {
+  return disco.get();
+}
+
+bool MSX::abrirCassete(std::string imagem) {
+  std::shared_ptr<Cassete> nova = std::make_shared<Cassete>();
+
+  if(!nova->abrir(imagem))
+    return false;
+  cassete = nova;
+  return true;
+}
+
+Cassete *MSX::getCassete() {
+  return cassete.get();
+}
+
+bool MSX::copiarParaDisco(std::string origem, std::string destino) {
+  std::ifstream arquivo(origem, std::ios::binary);
+
+  if(!disco || !arquivo)
+    return false;
+  std::vector<uint8_t> dados((std::istreambuf_iterator<char>(arquivo)), std::istreambuf_iterator<char>());
+  if(arquivo.bad())
+    return false;
+  return disco->adicionar(destino, dados);
+}
+
+bool MSX::apagarDoDisco(std::string caminho) {
+  return disco && disco->apagar(caminho);
+}
+
+bool MSX::renomearNoDisco(std::string caminho, std::string novoNome) {
+  return disco && disco->renomear(caminho, novoNome);
+}
+
+bool MSX::abrirBaseRoms(std::string arquivo) {
+  std::shared_ptr<BaseRoms> nova = std::make_shared<BaseRoms>();
+
+  if(!nova->abrir(arquivo))
+    return false;
+  baseRoms = nova;
+  return true;
+}
+
+MapeadorRom MSX::detectarMapeador(const uint8_t *rom, size_t tamanho) const {
+  RomConhecida conhecida;
+  uint8_t resumo[20];
+
+  // Como no identificar: a base do softwaredb.xml so' tem SHA-1.
+  if(baseRoms) {
+    sha1(rom, tamanho, resumo);
+    if(baseRoms->procurarSha1(resumo, conhecida) || baseRoms->procurarCrc(crc32(rom, tamanho), conhecida))
+      return conhecida.mapeador;
+  }
+  return adivinharMapeador(rom, tamanho);
+}
+
+bool MSX::detectarMapeador(std::string arquivo, MapeadorRom &mapeador) const {
+  ArquivoMapeado mapa;
+
+  if(!mapa.abrir(arquivo))
+    return false;
+  mapa.setSequencial(true);
+  mapeador = detectarMapeador(mapa.getDados(), size_t(mapa.getTamanho()));
+  return true;
+}
+
+bool MSX::identificar(std::string arquivo, RomConhecida &rom) const {
+  ArquivoMapeado mapa;
+
+  if(!mapa.abrir(arquivo))
+    return false;
+  mapa.setSequencial(true);
+  const uint8_t *dados = mapa.getDados();
+  size_t tamanho = size_t(mapa.getTamanho());
+  uint8_t resumo[20];
+  uint32_t crc = crc32(dados, tamanho);
+  sha1(dados, tamanho, resumo);
+
+  if(!baseRoms || !(baseRoms->procurarSha1(resumo, rom) || baseRoms->procurarCrc(crc, rom))) {
+    rom.titulo.clear();
+    rom.mapeador = adivinharMapeador(dados, tamanho);
+    rom.conhecida = false;
+  }
+  // A base pode so' ter um dos hashes; os do arquivo valem sempre.
+  std::copy(resumo, resumo + sizeof(resumo), rom.sha1);
+  rom.crc = crc;
+  return true;
+}
+
+bool MSX::decodificarTela(std::string arquivo, unsigned modo, ImagemRGBA &imagem) const {
+  Tela tela;
+
+  if(!modo)
+    modo = modoPorExtensao(arquivo);
+  return modo && tela.abrir(arquivo) && tela.decodificar(modo, imagem);
+}
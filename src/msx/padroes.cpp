@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#include "mapeamento.h"
+#include "padroes.h"
+#include "tarefas.h"
+#include "tela.h"
+
+static const char magica[8] = {'M', 'S', 'X', 'T', 'I', 'L', 'E', 'S'};
+static const uint32_t versaoIndice = 1;
+static const uint64_t capacidadeInicial = 1 << 16;
+
+struct IndicePadroes::Cabecalho {
+  char magica[8];
+  uint32_t versao;
+  uint32_t arquivos;
+  uint64_t capacidade;
+  uint64_t usados;
+  // Os nomes vem depois das entradas, separados por '\0'.
+  uint64_t tamanhoNomes;
+  uint8_t reservado[24];
+};
+
+static_assert(sizeof(EntradaPadrao) == 24, "entrada do indice de padroes");
+
+// Finalizador do splitmix64: bijetivo, entao padroes de 8 bytes diferentes
+// nunca tem a mesma chave, e os bits baixos ja' servem de posicao.
+static uint64_t misturar(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+static EntradaPadrao *posicao(EntradaPadrao *entradas, uint64_t capacidade, uint64_t chave, uint32_t tamanho) {
+  for(uint64_t i = chave & (capacidade - 1);; i = (i + 1) & (capacidade - 1)) {
+    EntradaPadrao *e = entradas + i;
+    if(!e->arquivos || (e->chave == chave && e->tamanho == tamanho))
+      return e;
+  }
+}
+
+// Chave e quantas vezes aparece, de cada padrao distinto.
+static void agrupar(std::vector<uint64_t> &chaves, std::vector<std::pair<uint64_t, uint32_t>> &grupos) {
+  std::sort(chaves.begin(), chaves.end());
+  grupos.clear();
+  for(size_t i = 0; i < chaves.size(); i++)
+    if(grupos.empty() || grupos.back().first != chaves[i])
+      grupos.emplace_back(chaves[i], 1);
+    else
+      grupos.back().second++;
+}
+
+static void coletar(const uint8_t *dados, size_t inicio, size_t fim, size_t tamanho, std::vector<uint64_t> &chaves) {
+  for(size_t i = inicio; i + tamanho <= fim; i += tamanho) {
+    const uint8_t *p = dados + i;
+    if(std::count(p, p + tamanho, p[0]) != std::ptrdiff_t(tamanho))
+      chaves.push_back(IndicePadroes::chave(p, tamanho));
+  }
+}
+
+IndicePadroes::IndicePadroes()
+  : fd(-1), escrita(false), base(nullptr), tamanhoMapa(0), entradas(nullptr), capacidade(0), usados(0) {
+  static_assert(sizeof(Cabecalho) == 64, "cabecalho do indice de padroes");
+}
+
+IndicePadroes::~IndicePadroes() {
+  fechar();
+}
+
+uint64_t IndicePadroes::chave(const uint8_t *padrao, size_t tamanho) {
+  uint64_t h = 0;
+
+  if(tamanho == 8) {
+    std::memcpy(&h, padrao, 8);
+    return misturar(h);
+  }
+  h = misturar(tamanho);
+  for(size_t i = 0; i < tamanho; i += 8) {
+    uint64_t v = 0;
+    std::memcpy(&v, padrao + i, std::min<size_t>(8, tamanho - i));
+    h = misturar(h ^ v) + i;
+  }
+  return h;
+}
+
+bool IndicePadroes::varrer(std::string arquivo, std::vector<uint64_t> &padroes, std::vector<uint64_t> &sprites) {
+  unsigned modo = modoPorExtensao(arquivo);
+
+  padroes.clear();
+  sprites.clear();
+  if(modo) {
+    Tela tela;
+    if(!tela.abrir(arquivo))
+      return false;
+    const uint8_t *v = tela.getVram().data();
+    // Tabelas de padroes e de sprites nos enderecos do BASIC.
+    if(modo == 2 || modo == 4)
+      coletar(v, 0x0000, 0x1800, 8, padroes);
+    if(modo <= 4)
+      coletar(v, 0x3800, 0x4000, 32, sprites);
+    else if(modo <= 6)
+      coletar(v, 0x7800, 0x8000, 32, sprites);
+    else
+      coletar(v, 0xF000, 0xF800, 32, sprites);
+    return true;
+  }
+
+  ArquivoMapeado mapa;
+  if(!mapa.abrir(arquivo))
+    return false;
+  mapa.setSequencial(true);
+  coletar(mapa.getDados(), 0, mapa.getTamanho(), 8, padroes);
+  coletar(mapa.getDados(), 0, mapa.getTamanho(), 32, sprites);
+  return true;
+}
+
+bool IndicePadroes::mapear(uint64_t nova) {
+  size_t tamanho = sizeof(Cabecalho) + size_t(nova) * sizeof(EntradaPadrao);
+  void *p = mmap(nullptr, tamanho, escrita ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+  if(p == MAP_FAILED)
+    return false;
+  base = (uint8_t *) p;
+  tamanhoMapa = tamanho;
+  entradas = reinterpret_cast<EntradaPadrao *>(base + sizeof(Cabecalho));
+  capacidade = nova;
+  return true;
+}
+
+bool IndicePadroes::abrir(std::string arquivo, bool escrita) {
+  struct stat st;
+  Cabecalho c;
+
+  fechar();
+  this->escrita = escrita;
+  fd = open(arquivo.c_str(), escrita ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0666);
+  if(fd < 0 || fstat(fd, &st) < 0) {
+    fechar();
+    return false;
+  }
+  nome = arquivo;
+
+  if(st.st_size == 0 && escrita) {
+    if(posix_fallocate(fd, 0, off_t(sizeof(Cabecalho) + capacidadeInicial * sizeof(EntradaPadrao))) != 0 ||
+       !mapear(capacidadeInicial)) {
+      fechar();
+      return false;
+    }
+    usados = 0;
+    return true;
+  }
+
+  if(pread(fd, &c, sizeof(c), 0) != ssize_t(sizeof(c)) || std::memcmp(c.magica, magica, sizeof(magica)) ||
+     c.versao != versaoIndice || !c.capacidade || (c.capacidade & (c.capacidade - 1)) || c.usados > c.capacidade ||
+     uint64_t(st.st_size) != sizeof(c) + c.capacidade * sizeof(EntradaPadrao) + c.tamanhoNomes || !mapear(c.capacidade)) {
+    fechar();
+    return false;
+  }
+  // Um processo que morreu depois de um crescer() deixa o cabecalho com a
+  // contagem de entao; as entradas e' que valem.
+  usados = 0;
+  for(uint64_t i = 0; i < capacidade; i++)
+    usados += entradas[i].arquivos != 0;
+
+  std::string nomes(c.tamanhoNomes, '\0');
+  if(pread(fd, &nomes[0], nomes.size(), off_t(tamanhoMapa)) != ssize_t(nomes.size())) {
+    fechar();
+    return false;
+  }
+  for(size_t i = 0; i < nomes.size();) {
+    size_t fim = nomes.find('\0', i);
+    if(fim == std::string::npos)
+      fim = nomes.size();
+    arquivos.push_back(nomes.substr(i, fim - i));
+    i = fim + 1;
+  }
+  if(arquivos.size() != c.arquivos) {
+    fechar();
+    return false;
+  }
+  return true;
+}
+
+// Cabecalho no mapa e nomes depois das entradas: o arquivo aberto fica
+// valido para o abrir().
+bool IndicePadroes::gravarCabecalho() {
+  std::string nomes;
+  for(const std::string &a : arquivos)
+    nomes += a + '\0';
+  Cabecalho c;
+  std::memset(&c, 0, sizeof(c));
+  std::memcpy(c.magica, magica, sizeof(magica));
+  c.versao = versaoIndice;
+  c.arquivos = uint32_t(arquivos.size());
+  c.capacidade = capacidade;
+  c.usados = usados;
+  c.tamanhoNomes = nomes.size();
+  std::memcpy(base, &c, sizeof(c));
+  return ftruncate(fd, off_t(tamanhoMapa + nomes.size())) == 0 &&
+         pwrite(fd, nomes.data(), nomes.size(), off_t(tamanhoMapa)) == ssize_t(nomes.size());
+}
+
+bool IndicePadroes::fechar() {
+  bool ok = true;
+
+  if(base && escrita)
+    ok = gravarCabecalho();
+  if(base)
+    munmap(base, tamanhoMapa);
+  if(fd >= 0)
+    close(fd);
+  fd = -1;
+  base = nullptr;
+  entradas = nullptr;
+  tamanhoMapa = 0;
+  capacidade = 0;
+  usados = 0;
+  arquivos.clear();
+  return ok;
+}
+
+bool IndicePadroes::aberto() const {
+  return base != nullptr;
+}
+
+// Tabela com o dobro do tamanho num arquivo novo, que so' substitui o
+// antigo com todas as entradas ja' copiadas e o cabecalho e os nomes
+// gravados: se o processo morrer depois, o indice continua abrindo.
+bool IndicePadroes::crescer() {
+  std::string novo = nome + ".novo";
+  uint64_t nova = capacidade * 2;
+  int fdNovo = open(novo.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+  if(fdNovo < 0)
+    return false;
+  if(posix_fallocate(fdNovo, 0, off_t(sizeof(Cabecalho) + nova * sizeof(EntradaPadrao))) != 0) {
+    close(fdNovo);
+    unlink(novo.c_str());
+    return false;
+  }
+
+  int fdAntigo = fd;
+  uint8_t *baseAntiga = base;
+  size_t tamanhoAntigo = tamanhoMapa;
+  const EntradaPadrao *antigas = entradas;
+  uint64_t capacidadeAntiga = capacidade;
+  fd = fdNovo;
+  if(!mapear(nova)) {
+    fd = fdAntigo;
+    base = baseAntiga;
+    tamanhoMapa = tamanhoAntigo;
+    entradas = const_cast<EntradaPadrao *>(antigas);
+    capacidade = capacidadeAntiga;
+    close(fdNovo);
+    unlink(novo.c_str());
+    return false;
+  }
+  for(uint64_t i = 0; i < capacidadeAntiga; i++)
+    if(antigas[i].arquivos)
+      *posicao(entradas, capacidade, antigas[i].chave, antigas[i].tamanho) = antigas[i];
+  bool ok = gravarCabecalho();
+
+  munmap(baseAntiga, tamanhoAntigo);
+  close(fdAntigo);
+  return rename(novo.c_str(), nome.c_str()) == 0 && ok;
+}
+
+void IndicePadroes::inserir(uint64_t chave, uint32_t tamanho, uint32_t arquivo, uint32_t ocorrencias) {
+  EntradaPadrao *e = posicao(entradas, capacidade, chave, tamanho);
+
+  if(!e->arquivos) {
+    e->chave = chave;
+    e->tamanho = tamanho;
+    e->primeiro = arquivo;
+    e->ocorrencias = 0;
+    usados++;
+  } else
+    e->primeiro = std::min(e->primeiro, arquivo);
+  e->arquivos++;
+  e->ocorrencias += ocorrencias;
+}
+
+bool IndicePadroes::adicionar(const std::vector<std::string> &novos, unsigned threads,
+                              std::vector<std::string> &erros) {
+  if(!base || !escrita)
+    return false;
+
+  // Um arquivo que ja' esta' no indice contaria duas vezes em cada padrao.
+  std::unordered_set<std::string> vistos(arquivos.begin(), arquivos.end());
+  std::vector<std::string> lista;
+  for(const std::string &a : novos)
+    if(vistos.insert(a).second)
+      lista.push_back(a);
+
+  // Um arquivo so' ganha numero e nome no indice depois que os padroes
+  // dele entram na tabela, e na ordem do vetor: as varreduras que terminam
+  // antes da vez esperam em 'varreduras'. Um que nao foi lido fica de fora
+  // e pode ser adicionado de novo depois.
+  struct Varredura {
+    bool pronta = false;
+    bool lida = false;
+    std::vector<std::pair<uint64_t, uint32_t>> grupos[2];
+  };
+  std::vector<Varredura> varreduras(lista.size());
+  size_t proxima = 0;
+  bool ok = true;
+  std::mutex trava;
+  {
+    PoolTarefas pool(threads);
+    for(size_t i = 0; i < lista.size(); i++)
+      pool.adicionar([&, i] {
+        std::vector<uint64_t> padroes, sprites;
+        Varredura v;
+        v.pronta = true;
+        v.lida = varrer(lista[i], padroes, sprites);
+        if(v.lida) {
+          agrupar(padroes, v.grupos[0]);
+          agrupar(sprites, v.grupos[1]);
+        }
+
+        // So' a insercao e' serializada; a leitura e a ordenacao nao.
+        std::lock_guard<std::mutex> l(trava);
+        varreduras[i] = std::move(v);
+        for(; proxima < lista.size() && varreduras[proxima].pronta; proxima++) {
+          Varredura &atual = varreduras[proxima];
+          if(!atual.lida) {
+            ok = false;
+            erros.push_back("nao foi possivel ler " + lista[proxima]);
+          } else if(!inserirArquivo(lista[proxima], atual.grupos)) {
+            ok = false;
+            erros.push_back("nao foi possivel aumentar " + nome);
+          }
+          atual = Varredura{true, false, {}};
+        }
+      });
+    pool.esperar();
+  }
+  return ok;
+}
+
+bool IndicePadroes::inserirArquivo(const std::string &arquivo,
+                                   const std::vector<std::pair<uint64_t, uint32_t>> (&grupos)[2]) {
+  while((usados + grupos[0].size() + grupos[1].size()) * 10 > capacidade * 7)
+    if(!crescer())
+      return false;
+  uint32_t numero = uint32_t(arquivos.size());
+  for(const std::pair<uint64_t, uint32_t> &g : grupos[0])
+    inserir(g.first, 8, numero, g.second);
+  for(const std::pair<uint64_t, uint32_t> &g : grupos[1])
+    inserir(g.first, 32, numero, g.second);
+  arquivos.push_back(arquivo);
+  return true;
+}
+
+bool IndicePadroes::procurar(const uint8_t *padrao, size_t tamanho, EntradaPadrao &entrada) const {
+  if(!base)
+    return false;
+  const EntradaPadrao *e = posicao(entradas, capacidade, chave(padrao, tamanho), uint32_t(tamanho));
+  if(!e->arquivos)
+    return false;
+  entrada = *e;
+  return true;
+}
+
+uint64_t IndicePadroes::getUsados() const {
+  return usados;
+}
+
+uint64_t IndicePadroes::getCapacidade() const {
+  return capacidade;
+}
+
+const std::vector<std::string> &IndicePadroes::getArquivos() const {
+  return arquivos;
+}
+
+bool IndicePadroes::compartilhamentos(unsigned threads, std::vector<Compartilhamento> &resultado) const {
+  std::vector<std::vector<Compartilhamento>> porArquivo(arquivos.size());
+
+  resultado.clear();
+  if(!base)
+    return false;
+  {
+    PoolTarefas pool(threads);
+    for(size_t i = 0; i < arquivos.size(); i++)
+      pool.adicionar([&, i] {
+        std::vector<uint64_t> chaves[2];
+        std::vector<std::pair<uint64_t, uint32_t>> grupos;
+        std::map<uint32_t, uint64_t> comuns;
+        // Um arquivo que sumiu depois de indexado so' fica sem resultado.
+        if(!varrer(arquivos[i], chaves[0], chaves[1]))
+          return;
+        for(int t = 0; t < 2; t++) {
+          agrupar(chaves[t], grupos);
+          for(const std::pair<uint64_t, uint32_t> &g : grupos) {
+            const EntradaPadrao *e = posicao(entradas, capacidade, g.first, t ? 32 : 8);
+            if(e->arquivos > 1 && e->primeiro != i)
+              comuns[e->primeiro]++;
+          }
+        }
+        for(const std::pair<const uint32_t, uint64_t> &c : comuns)
+          porArquivo[i].push_back(Compartilhamento{uint32_t(i), c.first, c.second});
+        std::stable_sort(porArquivo[i].begin(), porArquivo[i].end(),
+                         [](const Compartilhamento &a, const Compartilhamento &b) { return a.padroes > b.padroes; });
+      });
+    pool.esperar();
+  }
+  for(const std::vector<Compartilhamento> &v : porArquivo)
+    resultado.insert(resultado.end(), v.begin(), v.end());
+  return true;
+}
@@ -0,0 +1,823 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "som.h"
+
+// Volume maximo de um canal de cada chip na soma.
+static const float volumePsg = 0.25f;
+static const float volumeScc = 0.2f;
+static const float volumeOpll = 0.3f;
+
+// Alcance do envelope do OPLL (128 degraus de 0,375 dB).
+static const double maximoDb = 48.0;
+static const double pi = 3.14159265358979323846;
+
+// Os 16 volumes do AY, 3 dB por degrau.
+struct NiveisPsg {
+  float v[16];
+
+  NiveisPsg() : v() {
+    for(int i = 1; i < 16; i++)
+      v[i] = volumePsg * float(std::pow(2.0, (i - 15) / 2.0));
+  }
+};
+
+static const NiveisPsg niveisPsg;
+
+// Instrumentos da ROM do YM2413 (1 a 15) e do modo ritmo (bumbo; chimbal e
+// caixa; tom-tom e prato), no formato dos registradores 0 a 7. O 0 e' o do
+// usuario, que fica nos proprios registradores.
+static const uint8_t instrumentos[19][8] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+  {0x71, 0x61, 0x1E, 0x17, 0xD0, 0x78, 0x00, 0x17},
+  {0x13, 0x41, 0x1A, 0x0D, 0xD8, 0xF7, 0x23, 0x13},
+  {0x13, 0x01, 0x99, 0x00, 0xF2, 0xC4, 0x21, 0x23},
+  {0x11, 0x61, 0x0E, 0x07, 0x8D, 0x64, 0x70, 0x27},
+  {0x32, 0x21, 0x1E, 0x06, 0xE1, 0x76, 0x01, 0x28},
+  {0x31, 0x22, 0x16, 0x05, 0xE0, 0x71, 0x00, 0x18},
+  {0x21, 0x61, 0x1D, 0x07, 0x82, 0x81, 0x11, 0x07},
+  {0x33, 0x21, 0x2D, 0x13, 0xB0, 0x70, 0x00, 0x07},
+  {0x61, 0x61, 0x1B, 0x06, 0x64, 0x65, 0x10, 0x17},
+  {0x41, 0x61, 0x0B, 0x18, 0x85, 0xF0, 0x81, 0x07},
+  {0x33, 0x01, 0x83, 0x11, 0xEA, 0xEF, 0x10, 0x04},
+  {0x17, 0xC1, 0x24, 0x07, 0xF8, 0xF8, 0x22, 0x12},
+  {0x61, 0x50, 0x0C, 0x05, 0xD2, 0xF5, 0x40, 0x42},
+  {0x01, 0x01, 0x55, 0x03, 0xE9, 0x90, 0x03, 0x02},
+  {0x41, 0x41, 0x89, 0x03, 0xF1, 0xE4, 0xC0, 0x13},
+  {0x01, 0x01, 0x18, 0x0F, 0xDF, 0xF8, 0x6A, 0x6D},
+  {0x01, 0x01, 0x00, 0x00, 0xC8, 0xD8, 0xA7, 0x68},
+  {0x05, 0x01, 0x00, 0x00, 0xF8, 0xAA, 0x59, 0x55}
+};
+
+static const double multiplos[16] = {0.5, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 12, 12, 15, 15};
+
+// Atenuacao pelo KSL a 6 dB/oitava no bloco 7, pelos 4 bits altos do F-Num.
+static const double tabelaKsl[16] = {
+  0, 9, 12, 13.875, 15, 16.125, 16.875, 17.625, 18, 18.75, 19.125, 19.5, 19.875, 20.25, 20.625, 21
+};
+
+// Integral da onda quadrada do PSG (+1 na primeira metade do ciclo, -1 na
+// segunda) desde o comeco do ciclo: um triangulo de 0 a 2^30.
+static inline int32_t integralQuadrada(uint32_t p) {
+  uint32_t m = uint32_t(int32_t(p) >> 31);
+  return int32_t(((p ^ m) - m) >> 1);
+}
+
+// seno(2 pi x) por duas parabolas, erro de cerca de 0,001.
+static inline float seno(float x) {
+  float r = x - std::floor(x + 0.5f);
+  float p = 8 * (r - 2 * r * std::fabs(r));
+  return p + 0.225f * (p * std::fabs(p) - p);
+}
+
+// Uma senoide de um bloco: saida[k] recebe (ou soma, com 'somar')
+// seno(fase + k * inc + indice * modulacao[k]) * ganho * razao^k, com a
+// metade negativa zerada se 'meia'.
+struct Oscilador {
+  float fase;
+  float inc;
+  float ganho;
+  float razao;
+  bool meia;
+  const float *modulacao;
+  float indice;
+  bool somar;
+};
+
+// Moduladores do OPLL com realimentacao, um canal por lane: cada amostra
+// depende das duas anteriores do mesmo canal, entao o bloco anda uma
+// amostra por vez, mas com todos os canais juntos. Os lanes que sobram no
+// ultimo grupo tocam com ganho 0 para 'descarte'.
+struct Realimentacao {
+  static const size_t lanes = 16;
+
+  float fase[lanes];
+  float inc[lanes];
+  // A fase anda (s1 + s2) * escala ciclos.
+  float escala[lanes];
+  float ganho[lanes];
+  float razao[lanes];
+  // 0 com a metade negativa zerada, -1 sem.
+  float piso[lanes];
+  float s1[lanes];
+  float s2[lanes];
+  float *saida[lanes];
+  size_t quantos;
+};
+
+// Tom do PSG: saida[k] += (1 + media) / 2 * fator[k], com a media da onda
+// quadrada entre fase + k * inc e a amostra seguinte.
+static size_t tomEscalar(float *saida, const float *fator, size_t k, size_t n, uint32_t fase, uint32_t inc) {
+  float escala = 1.0f / float(inc);
+
+  for(; k < n; k++) {
+    uint32_t p = fase + uint32_t(k) * inc;
+    float media = float(integralQuadrada(p + inc) - integralQuadrada(p)) * escala;
+    saida[k] += (0.5f + media) * fator[k];
+  }
+  return k;
+}
+
+static size_t ondaEscalar(float *saida, size_t k, size_t n, uint32_t fase, uint32_t inc, const float *tabela) {
+  for(; k < n; k++)
+    saida[k] += tabela[(fase + uint32_t(k) * inc) >> 27];
+  return k;
+}
+
+static size_t operadorEscalar(float *saida, size_t k, size_t n, const Oscilador &o) {
+  float g = o.ganho * std::pow(o.razao, float(k));
+
+  for(; k < n; k++, g *= o.razao) {
+    float x = o.fase + float(k) * o.inc;
+    if(o.modulacao)
+      x += o.indice * o.modulacao[k];
+    float v = seno(x);
+    if(o.meia && v < 0)
+      v = 0;
+    saida[k] = o.somar ? saida[k] + v * g : v * g;
+  }
+  return k;
+}
+
+static size_t realimentarEscalar(Realimentacao &r, size_t i, size_t n) {
+  for(; i < r.quantos; i++) {
+    float g = r.ganho[i], s1 = r.s1[i], s2 = r.s2[i];
+    for(size_t k = 0; k < n; k++, g *= r.razao[i]) {
+      float v = std::max(seno(r.fase[i] + float(k) * r.inc[i] + r.escala[i] * (s1 + s2)), r.piso[i]) * g;
+      r.saida[i][k] = v;
+      s2 = s1;
+      s1 = v;
+    }
+    r.s1[i] = s1;
+    r.s2[i] = s2;
+  }
+  return i;
+}
+
+#ifdef __SSE2__
+static size_t tomSSE2(float *saida, const float *fator, size_t k, size_t n, uint32_t fase, uint32_t inc) {
+  const __m128i lanes = _mm_setr_epi32(0, int32_t(inc), int32_t(inc * 2), int32_t(inc * 3));
+  const __m128i d = _mm_set1_epi32(int32_t(inc));
+  const __m128 escala = _mm_set1_ps(1.0f / float(inc));
+  const __m128 meio = _mm_set1_ps(0.5f);
+
+  for(; k + 4 <= n; k += 4) {
+    __m128i p = _mm_add_epi32(_mm_set1_epi32(int32_t(fase + uint32_t(k) * inc)), lanes);
+    __m128i q = _mm_add_epi32(p, d);
+    __m128i mp = _mm_srai_epi32(p, 31), mq = _mm_srai_epi32(q, 31);
+    __m128i ip = _mm_srli_epi32(_mm_sub_epi32(_mm_xor_si128(p, mp), mp), 1);
+    __m128i iq = _mm_srli_epi32(_mm_sub_epi32(_mm_xor_si128(q, mq), mq), 1);
+    __m128 media = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(iq, ip)), escala);
+    __m128 v = _mm_mul_ps(_mm_add_ps(meio, media), _mm_loadu_ps(fator + k));
+    _mm_storeu_ps(saida + k, _mm_add_ps(_mm_loadu_ps(saida + k), v));
+  }
+  return k;
+}
+
+__attribute__((target("avx2")))
+static size_t tomAVX2(float *saida, const float *fator, size_t k, size_t n, uint32_t fase, uint32_t inc) {
+  const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(inc)));
+  const __m256i d = _mm256_set1_epi32(int32_t(inc));
+  const __m256 escala = _mm256_set1_ps(1.0f / float(inc));
+  const __m256 meio = _mm256_set1_ps(0.5f);
+
+  for(; k + 8 <= n; k += 8) {
+    __m256i p = _mm256_add_epi32(_mm256_set1_epi32(int32_t(fase + uint32_t(k) * inc)), lanes);
+    __m256i q = _mm256_add_epi32(p, d);
+    __m256i ip = _mm256_srli_epi32(_mm256_abs_epi32(p), 1);
+    __m256i iq = _mm256_srli_epi32(_mm256_abs_epi32(q), 1);
+    __m256 media = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(iq, ip)), escala);
+    __m256 v = _mm256_mul_ps(_mm256_add_ps(meio, media), _mm256_loadu_ps(fator + k));
+    _mm256_storeu_ps(saida + k, _mm256_add_ps(_mm256_loadu_ps(saida + k), v));
+  }
+  return k;
+}
+
+// Sem gather, os indices passam pela memoria.
+static size_t ondaSSE2(float *saida, size_t k, size_t n, uint32_t fase, uint32_t inc, const float *tabela) {
+  const __m128i lanes = _mm_setr_epi32(0, int32_t(inc), int32_t(inc * 2), int32_t(inc * 3));
+  alignas(16) uint32_t indices[4];
+
+  for(; k + 4 <= n; k += 4) {
+    __m128i p = _mm_add_epi32(_mm_set1_epi32(int32_t(fase + uint32_t(k) * inc)), lanes);
+    _mm_store_si128((__m128i *) indices, _mm_srli_epi32(p, 27));
+    __m128 v = _mm_setr_ps(tabela[indices[0]], tabela[indices[1]], tabela[indices[2]], tabela[indices[3]]);
+    _mm_storeu_ps(saida + k, _mm_add_ps(_mm_loadu_ps(saida + k), v));
+  }
+  return k;
+}
+
+__attribute__((target("avx2")))
+static size_t ondaAVX2(float *saida, size_t k, size_t n, uint32_t fase, uint32_t inc, const float *tabela) {
+  const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(inc)));
+
+  for(; k + 8 <= n; k += 8) {
+    __m256i p = _mm256_add_epi32(_mm256_set1_epi32(int32_t(fase + uint32_t(k) * inc)), lanes);
+    __m256 v = _mm256_i32gather_ps(tabela, _mm256_srli_epi32(p, 27), 4);
+    _mm256_storeu_ps(saida + k, _mm256_add_ps(_mm256_loadu_ps(saida + k), v));
+  }
+  return k;
+}
+
+// A fase de cada amostra sai de k, nao de somas seguidas, para o erro do
+// float nao crescer ao longo do bloco; o ganho, que so' diminui ou cresce
+// devagar, e' multiplicado pela razao a cada passo.
+static size_t operadorSSE2(float *saida, size_t k, size_t n, const Oscilador &o) {
+  const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+  const __m128 inc = _mm_set1_ps(o.inc), fase = _mm_set1_ps(o.fase), indice = _mm_set1_ps(o.indice);
+  const __m128 sinal = _mm_set1_ps(-0.0f), oito = _mm_set1_ps(8), dois = _mm_set1_ps(2), ajuste = _mm_set1_ps(0.225f);
+  const __m128 zero = _mm_setzero_ps();
+  float r2 = o.razao * o.razao, g0 = o.ganho * std::pow(o.razao, float(k));
+  __m128 g = _mm_setr_ps(g0, g0 * o.razao, g0 * r2, g0 * r2 * o.razao);
+  const __m128 passo = _mm_set1_ps(r2 * r2);
+
+  for(; k + 4 <= n; k += 4) {
+    __m128 x = _mm_add_ps(fase, _mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(k)), lanes), inc));
+    if(o.modulacao)
+      x = _mm_add_ps(x, _mm_mul_ps(indice, _mm_loadu_ps(o.modulacao + k)));
+    __m128 r = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_cvtps_epi32(x)));
+    __m128 p = _mm_mul_ps(oito, _mm_sub_ps(r, _mm_mul_ps(dois, _mm_mul_ps(r, _mm_andnot_ps(sinal, r)))));
+    __m128 v = _mm_add_ps(p, _mm_mul_ps(ajuste, _mm_sub_ps(_mm_mul_ps(p, _mm_andnot_ps(sinal, p)), p)));
+    if(o.meia)
+      v = _mm_max_ps(v, zero);
+    v = _mm_mul_ps(v, g);
+    if(o.somar)
+      v = _mm_add_ps(v, _mm_loadu_ps(saida + k));
+    _mm_storeu_ps(saida + k, v);
+    g = _mm_mul_ps(g, passo);
+  }
+  return k;
+}
+
+__attribute__((target("avx2")))
+static size_t operadorAVX2(float *saida, size_t k, size_t n, const Oscilador &o) {
+  const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 inc = _mm256_set1_ps(o.inc), fase = _mm256_set1_ps(o.fase), indice = _mm256_set1_ps(o.indice);
+  const __m256 sinal = _mm256_set1_ps(-0.0f), oito = _mm256_set1_ps(8), dois = _mm256_set1_ps(2);
+  const __m256 ajuste = _mm256_set1_ps(0.225f), zero = _mm256_setzero_ps();
+  alignas(32) float ganhos[8];
+  ganhos[0] = o.ganho * std::pow(o.razao, float(k));
+  for(int i = 1; i < 8; i++)
+    ganhos[i] = ganhos[i - 1] * o.razao;
+  __m256 g = _mm256_load_ps(ganhos);
+  const __m256 passo = _mm256_set1_ps(std::pow(o.razao, 8.0f));
+
+  for(; k + 8 <= n; k += 8) {
+    __m256 x = _mm256_add_ps(fase, _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(float(k)), lanes), inc));
+    if(o.modulacao)
+      x = _mm256_add_ps(x, _mm256_mul_ps(indice, _mm256_loadu_ps(o.modulacao + k)));
+    __m256 r = _mm256_sub_ps(x, _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    __m256 p = _mm256_mul_ps(oito, _mm256_sub_ps(r, _mm256_mul_ps(dois, _mm256_mul_ps(r, _mm256_andnot_ps(sinal, r)))));
+    __m256 v = _mm256_add_ps(p, _mm256_mul_ps(ajuste, _mm256_sub_ps(_mm256_mul_ps(p, _mm256_andnot_ps(sinal, p)), p)));
+    if(o.meia)
+      v = _mm256_max_ps(v, zero);
+    v = _mm256_mul_ps(v, g);
+    if(o.somar)
+      v = _mm256_add_ps(v, _mm256_loadu_ps(saida + k));
+    _mm256_storeu_ps(saida + k, v);
+    g = _mm256_mul_ps(g, passo);
+  }
+  return k;
+}
+
+static size_t realimentarSSE2(Realimentacao &r, size_t i, size_t n) {
+  const __m128 sinal = _mm_set1_ps(-0.0f), oito = _mm_set1_ps(8), dois = _mm_set1_ps(2), ajuste = _mm_set1_ps(0.225f);
+  alignas(16) float v[4];
+
+  for(; i < r.quantos; i += 4) {
+    const __m128 fase = _mm_loadu_ps(r.fase + i), inc = _mm_loadu_ps(r.inc + i);
+    const __m128 escala = _mm_loadu_ps(r.escala + i), razao = _mm_loadu_ps(r.razao + i), piso = _mm_loadu_ps(r.piso + i);
+    __m128 g = _mm_loadu_ps(r.ganho + i), s1 = _mm_loadu_ps(r.s1 + i), s2 = _mm_loadu_ps(r.s2 + i);
+    for(size_t k = 0; k < n; k++) {
+      __m128 x = _mm_add_ps(_mm_add_ps(fase, _mm_mul_ps(_mm_set1_ps(float(k)), inc)), _mm_mul_ps(escala, _mm_add_ps(s1, s2)));
+      __m128 t = _mm_sub_ps(x, _mm_cvtepi32_ps(_mm_cvtps_epi32(x)));
+      __m128 p = _mm_mul_ps(oito, _mm_sub_ps(t, _mm_mul_ps(dois, _mm_mul_ps(t, _mm_andnot_ps(sinal, t)))));
+      __m128 y = _mm_add_ps(p, _mm_mul_ps(ajuste, _mm_sub_ps(_mm_mul_ps(p, _mm_andnot_ps(sinal, p)), p)));
+      y = _mm_mul_ps(_mm_max_ps(y, piso), g);
+      g = _mm_mul_ps(g, razao);
+      s2 = s1;
+      s1 = y;
+      _mm_store_ps(v, y);
+      for(size_t l = 0; l < 4; l++)
+        r.saida[i + l][k] = v[l];
+    }
+    _mm_storeu_ps(r.s1 + i, s1);
+    _mm_storeu_ps(r.s2 + i, s2);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t realimentarAVX2(Realimentacao &r, size_t i, size_t n) {
+  const __m256 sinal = _mm256_set1_ps(-0.0f), oito = _mm256_set1_ps(8), dois = _mm256_set1_ps(2);
+  const __m256 ajuste = _mm256_set1_ps(0.225f);
+  alignas(32) float v[8];
+
+  for(; i < r.quantos; i += 8) {
+    const __m256 fase = _mm256_loadu_ps(r.fase + i), inc = _mm256_loadu_ps(r.inc + i);
+    const __m256 escala = _mm256_loadu_ps(r.escala + i), razao = _mm256_loadu_ps(r.razao + i);
+    const __m256 piso = _mm256_loadu_ps(r.piso + i);
+    __m256 g = _mm256_loadu_ps(r.ganho + i), s1 = _mm256_loadu_ps(r.s1 + i), s2 = _mm256_loadu_ps(r.s2 + i);
+    for(size_t k = 0; k < n; k++) {
+      __m256 x = _mm256_add_ps(_mm256_add_ps(fase, _mm256_mul_ps(_mm256_set1_ps(float(k)), inc)),
+                               _mm256_mul_ps(escala, _mm256_add_ps(s1, s2)));
+      __m256 t = _mm256_sub_ps(x, _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+      __m256 p = _mm256_mul_ps(oito, _mm256_sub_ps(t, _mm256_mul_ps(dois, _mm256_mul_ps(t, _mm256_andnot_ps(sinal, t)))));
+      __m256 y = _mm256_add_ps(p, _mm256_mul_ps(ajuste, _mm256_sub_ps(_mm256_mul_ps(p, _mm256_andnot_ps(sinal, p)), p)));
+      y = _mm256_mul_ps(_mm256_max_ps(y, piso), g);
+      g = _mm256_mul_ps(g, razao);
+      s2 = s1;
+      s1 = y;
+      _mm256_store_ps(v, y);
+      for(size_t l = 0; l < 8; l++)
+        r.saida[i + l][k] = v[l];
+    }
+    _mm256_storeu_ps(r.s1 + i, s1);
+    _mm256_storeu_ps(r.s2 + i, s2);
+  }
+  return i;
+}
+
+static size_t pcmSSE2(const float *entrada, size_t i, size_t n, int16_t *saida) {
+  const __m128 maximo = _mm_set1_ps(1), minimo = _mm_set1_ps(-1), escala = _mm_set1_ps(32767);
+
+  for(; i + 8 <= n; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(entrada + i), minimo), maximo);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(entrada + i + 4), minimo), maximo);
+    __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, escala)), _mm_cvtps_epi32(_mm_mul_ps(b, escala)));
+    _mm_storeu_si128((__m128i *) (saida + i), v);
+  }
+  return i;
+}
+
+// packs trabalha em cada metade de 128 bits; permute4x64 poe os quatro
+// grupos de 4 amostras de volta em ordem.
+__attribute__((target("avx2")))
+static size_t pcmAVX2(const float *entrada, size_t i, size_t n, int16_t *saida) {
+  const __m256 maximo = _mm256_set1_ps(1), minimo = _mm256_set1_ps(-1), escala = _mm256_set1_ps(32767);
+
+  for(; i + 16 <= n; i += 16) {
+    __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(entrada + i), minimo), maximo);
+    __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(entrada + i + 8), minimo), maximo);
+    __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(a, escala)),
+                                   _mm256_cvtps_epi32(_mm256_mul_ps(b, escala)));
+    _mm256_storeu_si256((__m256i *) (saida + i), _mm256_permute4x64_epi64(v, 0xD8));
+  }
+  return i;
+}
+#endif
+
+static void tom(float *saida, const float *fator, size_t n, uint32_t fase, uint32_t inc) {
+  size_t k = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    k = tomAVX2(saida, fator, k, n, fase, inc);
+  k = tomSSE2(saida, fator, k, n, fase, inc);
+#endif
+  tomEscalar(saida, fator, k, n, fase, inc);
+}
+
+static void onda(float *saida, size_t n, uint32_t fase, uint32_t inc, const float *tabela) {
+  size_t k = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    k = ondaAVX2(saida, k, n, fase, inc, tabela);
+  k = ondaSSE2(saida, k, n, fase, inc, tabela);
+#endif
+  ondaEscalar(saida, k, n, fase, inc, tabela);
+}
+
+static void operador(float *saida, size_t n, const Oscilador &o) {
+  size_t k = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    k = operadorAVX2(saida, k, n, o);
+  k = operadorSSE2(saida, k, n, o);
+#endif
+  operadorEscalar(saida, k, n, o);
+}
+
+static void realimentar(Realimentacao &r, size_t n, float *descarte) {
+  size_t i = 0;
+
+  for(size_t l = r.quantos; l < Realimentacao::lanes; l++) {
+    r.fase[l] = r.inc[l] = r.escala[l] = r.ganho[l] = r.piso[l] = r.s1[l] = r.s2[l] = 0;
+    r.razao[l] = 1;
+    r.saida[l] = descarte;
+  }
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = realimentarAVX2(r, i, n);
+  i = realimentarSSE2(r, i, n);
+#endif
+  realimentarEscalar(r, i, n);
+}
+
+void converterPcm(const float *entrada, size_t n, int16_t *saida) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = pcmAVX2(entrada, i, n, saida);
+  i = pcmSSE2(entrada, i, n, saida);
+#endif
+  for(; i < n; i++)
+    saida[i] = int16_t(std::lrint(std::min(std::max(entrada[i], -1.0f), 1.0f) * 32767));
+}
+
+ChipPsg::ChipPsg(double relogio, unsigned taxa)
+  : relogio(relogio), taxa(taxa), registradores(), fases(), faseRuido(0), lfsr(1), faseEnvelope(0), passoEnvelope(0),
+    subindo(false), parado(true), nivelParado(0), ruido(), envelope() {
+}
+
+void ChipPsg::escrever(uint8_t registrador, uint8_t valor) {
+  if(registrador >= 16)
+    return;
+  registradores[registrador] = valor;
+  // Escrever a forma reinicia o envelope.
+  if(registrador == 13) {
+    passoEnvelope = 0;
+    faseEnvelope = 0;
+    subindo = valor & 4;
+    parado = false;
+  }
+}
+
+void ChipPsg::gerar(float *saida, size_t n) {
+  const uint8_t *r = registradores;
+  uint8_t mixer = r[7];
+  bool usaRuido = false, usaEnvelope = false;
+
+  for(unsigned c = 0; c < 3; c++) {
+    usaRuido |= !(mixer & (8 << c));
+    usaEnvelope |= (r[8 + c] & 0x10) != 0;
+  }
+
+  // Ruido e envelope sao os unicos que andam amostra por amostra, e so'
+  // quando algum canal os usa.
+  if(usaRuido) {
+    unsigned periodo = std::max(1, r[6] & 31);
+    double passo = relogio / (16.0 * periodo) / taxa;
+    for(size_t k = 0; k < n; k++) {
+      for(faseRuido += passo; faseRuido >= 1; faseRuido -= 1)
+        lfsr = (lfsr >> 1) | (((lfsr ^ (lfsr >> 3)) & 1) << 16);
+      ruido[k] = float(lfsr & 1);
+    }
+  }
+  if(usaEnvelope) {
+    unsigned periodo = std::max(1, r[11] | (r[12] << 8));
+    double passo = relogio / (16.0 * periodo) / taxa;
+    for(size_t k = 0; k < n; k++) {
+      for(faseEnvelope += passo; faseEnvelope >= 1 && !parado; faseEnvelope -= 1) {
+        if(++passoEnvelope < 16)
+          continue;
+        // Fim do ciclo: CONT (bit 3), ATT (2), ALT (1), HOLD (0).
+        uint8_t forma = r[13];
+        if(!(forma & 8)) {
+          parado = true;
+          nivelParado = 0;
+        } else if(forma & 1) {
+          parado = true;
+          nivelParado = subindo != bool(forma & 2) ? 15 : 0;
+        } else {
+          passoEnvelope = 0;
+          if(forma & 2)
+            subindo = !subindo;
+        }
+      }
+      if(parado)
+        faseEnvelope = 0;
+      envelope[k] = niveisPsg.v[parado ? nivelParado : subindo ? passoEnvelope : 15 - passoEnvelope];
+    }
+  }
+
+  float fator[amostrasBloco];
+  for(unsigned c = 0; c < 3; c++) {
+    unsigned periodo = std::max(1, r[2 * c] | ((r[2 * c + 1] & 15) << 8));
+    double frequencia = relogio / (16.0 * periodo);
+    uint32_t inc = frequencia * 2 < taxa ? uint32_t(frequencia / taxa * 4294967296.0) : 0;
+    uint32_t fase = fases[c];
+    fases[c] += uint32_t(n) * inc;
+
+    uint8_t volume = r[8 + c];
+    bool comTom = !(mixer & (1 << c)), comRuido = !(mixer & (8 << c));
+    if(!(volume & 0x1F))
+      continue;
+    for(size_t k = 0; k < n; k++)
+      fator[k] = (volume & 0x10 ? envelope[k] : niveisPsg.v[volume & 15]) * (comRuido ? ruido[k] : 1.0f);
+    // O canal fica no nivel alto com o tom desligado (e' assim que os
+    // jogos tocam PCM pelo volume); acima de taxa/2, na media.
+    if(comTom && inc)
+      tom(saida, fator, n, fase, inc);
+    else {
+      float nivel = comTom ? 0.5f : 1.0f;
+      for(size_t k = 0; k < n; k++)
+        saida[k] += nivel * fator[k];
+    }
+  }
+}
+
+ChipScc::ChipScc(double relogio, unsigned taxa, bool mais)
+  : relogio(relogio), taxa(taxa), mais(mais), ondas(), periodos(), volumes(), ligados(0), fases() {
+}
+
+void ChipScc::escrever(uint8_t porta, uint8_t registrador, uint8_t valor) {
+  switch(porta) {
+    case 0:
+      if(registrador < 0x80) {
+        unsigned c = registrador >> 5;
+        ondas[c][registrador & 31] = int8_t(valor);
+        if(c == 3 && !mais)
+          ondas[4][registrador & 31] = int8_t(valor);
+      }
+      break;
+    case 1:
+      if(registrador < 10) {
+        unsigned c = registrador >> 1;
+        if(registrador & 1)
+          periodos[c] = uint16_t((periodos[c] & 0xFF) | ((valor & 15) << 8));
+        else
+          periodos[c] = uint16_t((periodos[c] & 0xF00) | valor);
+      }
+      break;
+    case 2:
+      if(registrador < 5)
+        volumes[registrador] = valor & 15;
+      break;
+    case 3:
+      ligados = valor & 31;
+      break;
+    case 4:
+      ondas[4][registrador & 31] = int8_t(valor);
+      break;
+    default:
+      break;
+  }
+}
+
+void ChipScc::gerar(float *saida, size_t n) {
+  alignas(32) float tabela[32];
+
+  for(unsigned c = 0; c < 5; c++) {
+    double frequencia = relogio / (32.0 * (periodos[c] + 1));
+    uint32_t inc = uint32_t(std::min(frequencia * 32 / taxa, 8.0) * 134217728.0);
+    uint32_t fase = fases[c];
+    fases[c] += uint32_t(n) * inc;
+    // Com periodo abaixo de 9 o SCC nao toca; acima de taxa/2 nao se ouve.
+    if(!(ligados & (1 << c)) || !volumes[c] || periodos[c] < 9 || frequencia * 2 >= taxa)
+      continue;
+    float escala = volumeScc * volumes[c] / (15.0f * 128.0f);
+    for(unsigned i = 0; i < 32; i++)
+      tabela[i] = ondas[c][i] * escala;
+    onda(saida, n, fase, inc, tabela);
+  }
+}
+
+ChipOpll::ChipOpll(double relogio, unsigned taxa)
+  : relogio(relogio), taxa(taxa), registradores(), amostras(0), lfsr(1), modulacao(), ruido() {
+  for(Operador &op : operadores)
+    op = Operador{0, desligado, maximoDb, false, 0, 0};
+}
+
+bool ChipOpll::ritmo() const {
+  return registradores[0x0E] & 0x20;
+}
+
+const uint8_t *ChipOpll::instrumento(unsigned canal) const {
+  if(canal >= 6 && ritmo())
+    return instrumentos[16 + canal - 6];
+  unsigned i = registradores[0x30 + canal] >> 4;
+  return i ? instrumentos[i] : registradores;
+}
+
+void ChipOpll::escrever(uint8_t registrador, uint8_t valor) {
+  if(registrador >= 64)
+    return;
+  registradores[registrador] = valor;
+  if(registrador == 0x0E || (registrador >= 0x20 && registrador <= 0x28))
+    atualizarChaves();
+}
+
+void ChipOpll::atualizarChaves() {
+  // No modo ritmo, bumbo nos dois operadores do canal 6, chimbal e caixa
+  // no 7, tom-tom e prato no 8.
+  static const uint8_t bateria[6] = {0x10, 0x10, 0x01, 0x08, 0x04, 0x02};
+  uint8_t tocando = ritmo() ? registradores[0x0E] : 0;
+
+  for(unsigned i = 0; i < 18; i++) {
+    unsigned c = i / 2;
+    bool chave = (registradores[0x20 + c] & 0x10) || (c >= 6 && (tocando & bateria[i - 12]));
+    Operador &op = operadores[i];
+    if(chave && !op.chave) {
+      op.etapa = ataque;
+      op.fase = 0;
+      op.saida1 = op.saida2 = 0;
+    } else if(!chave && op.chave && op.etapa != desligado)
+      op.etapa = liberacao;
+    op.chave = chave;
+  }
+}
+
+// dB por segundo de um envelope com taxa r (0 a 15): o tempo de cada taxa
+// e' o do OPL, metade a cada degrau de 4 no indice.
+static double velocidade(unsigned r, unsigned rks, bool ataque) {
+  if(!r)
+    return 0;
+  unsigned i = std::min(63u, r * 4 + rks);
+  if(ataque && i >= 60)
+    return HUGE_VAL;
+  double ms = (ataque ? 2826.24 : 39280.64) * std::pow(2.0, (4.0 - i) / 4.0);
+  return maximoDb * 1000 / ms;
+}
+
+double ChipOpll::incremento(unsigned canal, unsigned o, double vibrato) const {
+  const uint8_t *p = instrumento(canal);
+  unsigned fnum = registradores[0x10 + canal] | ((registradores[0x20 + canal] & 1) << 8);
+  unsigned bloco = (registradores[0x20 + canal] >> 1) & 7;
+  double f = fnum * double(1 << bloco) * relogio / 72 / (1 << 19) * multiplos[p[o] & 15];
+  if(p[o] & 0x40)
+    f *= vibrato;
+  return f / taxa;
+}
+
+void ChipOpll::envelope(unsigned canal, unsigned o, size_t n, double am, double &inicio, double &fim) {
+  Operador &op = operadores[canal * 2 + o];
+  const uint8_t *p = instrumento(canal);
+  const uint8_t *r = registradores;
+  unsigned fnum = r[0x10 + canal] | ((r[0x20 + canal] & 1) << 8), bloco = (r[0x20 + canal] >> 1) & 7;
+  unsigned rks = ((bloco << 1) | (fnum >> 8)) >> (p[o] & 0x10 ? 0 : 2);
+  unsigned ar = p[4 + o] >> 4, dr = p[4 + o] & 15, sl = p[6 + o] >> 4, rr = p[6 + o] & 15;
+  double dt = double(n) / taxa, antes = op.db;
+
+  if(op.etapa == desligado) {
+    inicio = fim = HUGE_VAL;
+    return;
+  }
+  switch(op.etapa) {
+    case ataque:
+      op.db -= velocidade(ar, rks, true) * dt;
+      if(op.db <= 0) {
+        op.db = 0;
+        op.etapa = decaimento;
+      }
+      break;
+    case decaimento:
+      op.db += velocidade(dr, rks, false) * dt;
+      if(op.db >= sl * 3.0) {
+        op.db = sl * 3.0;
+        op.etapa = sustentacao;
+      }
+      break;
+    case sustentacao:
+      // Os instrumentos percussivos (bit 5 zerado) continuam caindo.
+      if(!(p[o] & 0x20))
+        op.db += velocidade(rr, rks, false) * dt;
+      break;
+    default:
+      op.db += velocidade(r[0x20 + canal] & 0x20 ? 5 : rr, rks, false) * dt;
+      break;
+  }
+  if(op.db >= maximoDb) {
+    op.db = maximoDb;
+    op.etapa = desligado;
+  }
+
+  // Volume: TL de 0,75 dB no modulador e 3 dB por degrau na portadora; no
+  // modo ritmo, chimbal e tom-tom (moduladores dos canais 7 e 8) usam os 4
+  // bits altos do registrador de volume.
+  double nivel;
+  if(o)
+    nivel = (r[0x30 + canal] & 15) * 3.0;
+  else if(canal >= 7 && ritmo())
+    nivel = (r[0x30 + canal] >> 4) * 3.0;
+  else
+    nivel = (p[2] & 63) * 0.75;
+  static const double escalaKsl[4] = {0, 0.25, 0.5, 1};
+  double ksl = std::max(0.0, tabelaKsl[fnum >> 5] - 6.0 * (7 - bloco)) * escalaKsl[(o ? p[3] : p[2]) >> 6];
+  double extra = nivel + ksl + (p[o] & 0x80 ? am : 0);
+  inicio = antes + extra;
+  fim = op.db + extra;
+}
+
+// Ganho no comeco do bloco e razao entre amostras seguidas.
+static void ganhos(double inicio, double fim, size_t n, float escala, float &ganho, float &razao) {
+  if(inicio == HUGE_VAL) {
+    ganho = 0;
+    razao = 1;
+    return;
+  }
+  ganho = escala * float(std::pow(10.0, -inicio / 20));
+  razao = float(std::pow(10.0, -(fim - inicio) / 20 / double(n)));
+}
+
+static void somarRuido(float *saida, const float *ruido, size_t n, float ganho, float razao) {
+  for(size_t k = 0; k < n; k++, ganho *= razao)
+    saida[k] += ruido[k] * ganho;
+}
+
+void ChipOpll::gerar(float *saida, size_t n) {
+  if(!n)
+    return;
+
+  // Tremolo de 4,8 dB a 3,7 Hz e vibrato de 14 cents a 6,4 Hz.
+  double t = double(amostras) / taxa;
+  double am = 2.4 * (1 - std::cos(2 * pi * 3.7 * t));
+  double vibrato = std::pow(2.0, 14.0 / 1200 * std::sin(2 * pi * 6.4 * t));
+  amostras += n;
+
+  bool bateria = ritmo();
+  if(bateria)
+    for(size_t k = 0; k < n; k++) {
+      if(lfsr & 1)
+        lfsr ^= 0x800302;
+      lfsr >>= 1;
+      ruido[k] = lfsr & 1 ? 1.0f : -1.0f;
+    }
+
+  // Primeiro os moduladores: sem realimentacao, cada um e' um bloco SIMD;
+  // com ela, vao todos juntos para realimentar(). Depois as portadoras.
+  Realimentacao fb;
+  Oscilador portadoras[9];
+  bool tocar[9] = {};
+  unsigned canais[9];
+  fb.quantos = 0;
+  for(unsigned c = 0; c < 9; c++) {
+    Operador &mod = operadores[c * 2], &car = operadores[c * 2 + 1];
+    if(mod.etapa == desligado && car.etapa == desligado)
+      continue;
+    const uint8_t *p = instrumento(c);
+    double m0, m1, c0, c1;
+    envelope(c, 0, n, am, m0, m1);
+    envelope(c, 1, n, am, c0, c1);
+    double incMod = incremento(c, 0, vibrato), incCar = incremento(c, 1, vibrato);
+    Oscilador om{float(mod.fase), float(incMod), 0, 1, (p[3] & 0x08) != 0, nullptr, 0, false};
+    Oscilador oc{float(car.fase), float(incCar), 0, 1, (p[3] & 0x10) != 0, nullptr, 0, true};
+    ganhos(m0, m1, n, 1.0f, om.ganho, om.razao);
+    ganhos(c0, c1, n, volumeOpll, oc.ganho, oc.razao);
+    mod.fase += n * incMod;
+    mod.fase -= std::floor(mod.fase);
+    car.fase += n * incCar;
+    car.fase -= std::floor(car.fase);
+
+    if(bateria && c == 7) {
+      // Chimbal: ruido; caixa: meio seno, meio ruido.
+      somarRuido(saida, ruido, n, om.ganho * volumeOpll, om.razao);
+      oc.ganho *= 0.5f;
+      operador(saida, n, oc);
+      somarRuido(saida, ruido, n, oc.ganho, oc.razao);
+    } else if(bateria && c == 8) {
+      // Tom-tom: seno; prato: ruido.
+      om.ganho *= volumeOpll;
+      om.somar = true;
+      operador(saida, n, om);
+      somarRuido(saida, ruido, n, oc.ganho, oc.razao);
+    } else {
+      unsigned f = p[3] & 7;
+      if(!f)
+        operador(modulacao[c], n, om);
+      else {
+        size_t l = fb.quantos++;
+        canais[l] = c;
+        fb.fase[l] = om.fase;
+        fb.inc[l] = om.inc;
+        fb.escala[l] = std::ldexp(1.0f, int(f) - 7);
+        fb.ganho[l] = om.ganho;
+        fb.razao[l] = om.razao;
+        fb.piso[l] = om.meia ? 0.0f : -1.0f;
+        fb.s1[l] = mod.saida1;
+        fb.s2[l] = mod.saida2;
+        fb.saida[l] = modulacao[c];
+      }
+      // O modulador no maximo desloca a portadora em 4 ciclos.
+      oc.modulacao = modulacao[c];
+      oc.indice = 4;
+      portadoras[c] = oc;
+      tocar[c] = true;
+    }
+  }
+
+  if(fb.quantos) {
+    float descarte[amostrasBloco];
+    realimentar(fb, n, descarte);
+    for(size_t l = 0; l < fb.quantos; l++) {
+      Operador &mod = operadores[canais[l] * 2];
+      mod.saida1 = fb.s1[l];
+      mod.saida2 = fb.s2[l];
+    }
+  }
+  for(unsigned c = 0; c < 9; c++)
+    if(tocar[c])
+      operador(saida, n, portadoras[c]);
+}
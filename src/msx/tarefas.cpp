@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "tarefas.h"
+
+static thread_local int indiceTrabalhador = -1;
+
+PoolTarefas::PoolTarefas(unsigned n) : pendentes(0), proximaFila(0), parar(false) {
+  if(!n)
+    n = std::max(1u, std::thread::hardware_concurrency());
+  for(unsigned i = 0; i < n; i++)
+    filas.emplace_back(new Fila());
+  for(unsigned i = 0; i < n; i++)
+    threads.emplace_back(&PoolTarefas::trabalhar, this, i);
+}
+
+PoolTarefas::~PoolTarefas() {
+  esperar();
+  {
+    std::lock_guard<std::mutex> l(trava);
+    parar = true;
+  }
+  temTarefa.notify_all();
+  for(std::thread &t : threads)
+    t.join();
+}
+
+unsigned PoolTarefas::getThreads() const {
+  return (unsigned) threads.size();
+}
+
+int PoolTarefas::trabalhadorAtual() {
+  return indiceTrabalhador;
+}
+
+void PoolTarefas::adicionar(std::function<void()> tarefa) {
+  // De dentro de uma tarefa, a nova vai para a fila do proprio trabalhador;
+  // de fora, as filas sao usadas em rodizio.
+  unsigned i = indiceTrabalhador >= 0 ? unsigned(indiceTrabalhador) : proximaFila++ % filas.size();
+
+  pendentes++;
+  {
+    std::lock_guard<std::mutex> l(filas[i]->trava);
+    filas[i]->tarefas.push_back(std::move(tarefa));
+  }
+  {
+    std::lock_guard<std::mutex> l(trava);
+  }
+  temTarefa.notify_one();
+}
+
+bool PoolTarefas::pegar(unsigned indice, std::function<void()> &tarefa) {
+  {
+    Fila &propria = *filas[indice];
+    std::lock_guard<std::mutex> l(propria.trava);
+    if(!propria.tarefas.empty()) {
+      tarefa = std::move(propria.tarefas.back());
+      propria.tarefas.pop_back();
+      return true;
+    }
+  }
+  for(size_t k = 1; k < filas.size(); k++) {
+    Fila &outra = *filas[(indice + k) % filas.size()];
+    std::lock_guard<std::mutex> l(outra.trava);
+    if(!outra.tarefas.empty()) {
+      tarefa = std::move(outra.tarefas.front());
+      outra.tarefas.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void PoolTarefas::trabalhar(unsigned indice) {
+  std::function<void()> tarefa;
+
+  indiceTrabalhador = int(indice);
+  for(;;) {
+    if(pegar(indice, tarefa)) {
+      tarefa();
+      tarefa = nullptr;
+      if(--pendentes == 0) {
+        std::lock_guard<std::mutex> l(trava);
+        terminou.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> l(trava);
+    if(parar)
+      return;
+    // Confere de novo com a trava: uma tarefa pode ter chegado agora.
+    bool vazio = true;
+    for(const std::unique_ptr<Fila> &f : filas) {
+      std::lock_guard<std::mutex> lf(f->trava);
+      if(!f->tarefas.empty()) {
+        vazio = false;
+        break;
+      }
+    }
+    if(vazio)
+      temTarefa.wait(l);
+  }
+}
+
+void PoolTarefas::esperar() {
+  std::unique_lock<std::mutex> l(trava);
+  terminou.wait(l, [this] { return pendentes == 0; });
+}
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+#include <png.h>
+
+#include "mapeamento.h"
+#include "tela.h"
+
+static constexpr uint32_t rgba(uint8_t r, uint8_t g, uint8_t b) {
+  return uint32_t(r) | (uint32_t(g) << 8) | (uint32_t(b) << 16) | 0xFF000000u;
+}
+
+// Paleta inicial do V9938, em R, G, B de 3 bits.
+static const uint8_t paletaPadrao[16][3] = {
+  {0, 0, 0}, {0, 0, 0}, {1, 6, 1}, {3, 7, 3}, {1, 1, 7}, {2, 3, 7}, {5, 1, 1}, {2, 6, 7},
+  {7, 1, 1}, {7, 3, 3}, {6, 6, 1}, {6, 6, 4}, {1, 4, 1}, {6, 2, 5}, {5, 5, 5}, {7, 7, 7}
+};
+
+// SCREEN 8: cada byte e' GGGRRRBB; o azul de 2 bits vira 3 repetindo o bit alto.
+struct CoresScreen8 {
+  uint32_t c[256] = {};
+};
+
+static constexpr CoresScreen8 gerarCoresScreen8() {
+  CoresScreen8 tab;
+  for(int i = 0; i < 256; i++)
+    tab.c[i] = rgba(niveisCor.n3[(i >> 2) & 7], niveisCor.n3[i >> 5], niveisCor.n3[((i & 3) << 1) | ((i >> 1) & 1)]);
+  return tab;
+}
+
+static constexpr CoresScreen8 coresScreen8 = gerarCoresScreen8();
+static_assert(coresScreen8.c[255] == 0xFFFFFFFFu, "cores do SCREEN 8");
+
+static uint8_t limitar5(int c) {
+  return uint8_t(c < 0 ? 0 : c > 31 ? 31 : c);
+}
+
+// Cada grupo de 4 bytes tem os 5 bits de Y de cada pixel no alto e, nos 3
+// bits baixos, K (bytes 0 e 1) e J (bytes 2 e 3), de 6 bits com sinal.
+static void yjkEscalar(const uint8_t *p, size_t n, uint32_t *saida, const uint32_t *paleta) {
+  for(size_t i = 0; i + 4 <= n; i += 4, p += 4, saida += 4) {
+    int k = (p[0] & 7) | ((p[1] & 7) << 3);
+    int j = (p[2] & 7) | ((p[3] & 7) << 3);
+    k -= (k & 32) << 1;
+    j -= (j & 32) << 1;
+    for(int m = 0; m < 4; m++) {
+      if(paleta && (p[m] & 8)) {
+        saida[m] = paleta[p[m] >> 4];
+        continue;
+      }
+      int y = p[m] >> 3;
+      saida[m] = rgba(niveisCor.n5[limitar5(y + j)], niveisCor.n5[limitar5(y + k)],
+                      niveisCor.n5[limitar5((5 * y - 2 * j - k + 2) >> 2)]);
+    }
+  }
+}
+
+#ifdef __SSE2__
+// Um pixel por lane de 16 bits. Os 3 bits baixos de cada par de bytes
+// viram o valor de 6 bits no lane de 32 bits, e pshuflw/pshufhw espalham
+// K e J pelos 4 pixels do grupo.
+static size_t yjkSSE2(const uint8_t *p, size_t n, uint32_t *saida, const uint32_t *paleta) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i sete = _mm_set1_epi16(7);
+  const __m128i maximo = _mm_set1_epi16(31);
+  const __m128i dois = _mm_set1_epi16(2);
+  const __m128i alfa = _mm_set1_epi16(int16_t(0xFF00));
+  size_t i = 0;
+
+  for(; i + 8 <= n; i += 8) {
+    __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (p + i)), zero);
+    __m128i baixo = _mm_and_si128(v, sete);
+    __m128i jk = _mm_or_si128(baixo, _mm_srli_epi32(baixo, 13));
+    jk = _mm_srai_epi16(_mm_slli_epi16(jk, 10), 10);
+    __m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(jk, 0x00), 0x00);
+    __m128i j = _mm_shufflehi_epi16(_mm_shufflelo_epi16(jk, 0xAA), 0xAA);
+    __m128i y = _mm_srli_epi16(v, 3);
+
+    __m128i r = _mm_add_epi16(y, j);
+    __m128i g = _mm_add_epi16(y, k);
+    __m128i b = _mm_sub_epi16(_mm_add_epi16(y, _mm_slli_epi16(y, 2)), _mm_add_epi16(_mm_add_epi16(j, j), k));
+    b = _mm_srai_epi16(_mm_add_epi16(b, dois), 2);
+    r = _mm_min_epi16(_mm_max_epi16(r, zero), maximo);
+    g = _mm_min_epi16(_mm_max_epi16(g, zero), maximo);
+    b = _mm_min_epi16(_mm_max_epi16(b, zero), maximo);
+    r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+    g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+    b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    __m128i ba = _mm_or_si128(b, alfa);
+    _mm_storeu_si128((__m128i *) (saida + i), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *) (saida + i + 4), _mm_unpackhi_epi16(rg, ba));
+
+    // Sem pshufb, os pixels de paleta sao trocados depois.
+    if(paleta && _mm_movemask_epi8(_mm_slli_epi16(v, 12)))
+      for(size_t m = i; m < i + 8; m++)
+        if(p[m] & 8)
+          saida[m] = paleta[p[m] >> 4];
+  }
+  return i;
+}
+
+// O mesmo com 16 pixels. As 16 cores da paleta vao em tres tabelas de
+// bytes (R, G, B) consultadas por pshufb, e o bit 3 escolhe entre elas e
+// o YJK.
+__attribute__((target("avx2")))
+static size_t yjkAVX2(const uint8_t *p, size_t n, uint32_t *saida, const uint32_t *paleta) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i sete = _mm256_set1_epi16(7);
+  const __m256i oito = _mm256_set1_epi16(8);
+  const __m256i maximo = _mm256_set1_epi16(31);
+  const __m256i dois = _mm256_set1_epi16(2);
+  const __m256i byteBaixo = _mm256_set1_epi16(0xFF);
+  const __m256i alfa = _mm256_set1_epi16(int16_t(0xFF00));
+  __m256i tabR = zero, tabG = zero, tabB = zero;
+  size_t i = 0;
+
+  if(paleta) {
+    alignas(16) uint8_t planos[3][16];
+    for(int c = 0; c < 16; c++)
+      for(int m = 0; m < 3; m++)
+        planos[m][c] = uint8_t(paleta[c] >> (m * 8));
+    tabR = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) planos[0]));
+    tabG = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) planos[1]));
+    tabB = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) planos[2]));
+  }
+
+  for(; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (p + i)));
+    __m256i baixo = _mm256_and_si256(v, sete);
+    __m256i jk = _mm256_or_si256(baixo, _mm256_srli_epi32(baixo, 13));
+    jk = _mm256_srai_epi16(_mm256_slli_epi16(jk, 10), 10);
+    __m256i k = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(jk, 0x00), 0x00);
+    __m256i j = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(jk, 0xAA), 0xAA);
+    __m256i y = _mm256_srli_epi16(v, 3);
+
+    __m256i r = _mm256_add_epi16(y, j);
+    __m256i g = _mm256_add_epi16(y, k);
+    __m256i b = _mm256_sub_epi16(_mm256_add_epi16(y, _mm256_slli_epi16(y, 2)),
+                                 _mm256_add_epi16(_mm256_add_epi16(j, j), k));
+    b = _mm256_srai_epi16(_mm256_add_epi16(b, dois), 2);
+    r = _mm256_min_epi16(_mm256_max_epi16(r, zero), maximo);
+    g = _mm256_min_epi16(_mm256_max_epi16(g, zero), maximo);
+    b = _mm256_min_epi16(_mm256_max_epi16(b, zero), maximo);
+    r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+    g = _mm256_or_si256(_mm256_slli_epi16(g, 3), _mm256_srli_epi16(g, 2));
+    b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+
+    if(paleta) {
+      __m256i indice = _mm256_srli_epi16(v, 4);
+      __m256i usar = _mm256_cmpeq_epi16(_mm256_and_si256(v, oito), oito);
+      r = _mm256_blendv_epi8(r, _mm256_and_si256(_mm256_shuffle_epi8(tabR, indice), byteBaixo), usar);
+      g = _mm256_blendv_epi8(g, _mm256_and_si256(_mm256_shuffle_epi8(tabG, indice), byteBaixo), usar);
+      b = _mm256_blendv_epi8(b, _mm256_and_si256(_mm256_shuffle_epi8(tabB, indice), byteBaixo), usar);
+    }
+
+    // unpack trabalha em cada metade de 128 bits: as duas metades de cada
+    // resultado sao os pixels 0-3/8-11 e 4-7/12-15.
+    __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+    __m256i ba = _mm256_or_si256(b, alfa);
+    __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+    __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+    _mm256_storeu_si256((__m256i *) (saida + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *) (saida + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  return i;
+}
+#endif
+
+void converterYJK(const uint8_t *dados, size_t n, uint32_t *saida, const uint32_t *paleta) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  static const bool temAVX2 = __builtin_cpu_supports("avx2");
+  if(temAVX2)
+    i = yjkAVX2(dados, n, saida, paleta);
+  i += yjkSSE2(dados + i, n - i, saida + i, paleta);
+#endif
+  yjkEscalar(dados + i, n - i, saida + i, paleta);
+}
+
+Tela::Tela() : vram(tamanhoVram), inicio(0), fim(0) {
+}
+
+bool Tela::carregar(const uint8_t *dados, size_t n) {
+  size_t destino, tamanho;
+
+  if(n == 16 << 10 || n == 64 << 10 || n == tamanhoVram) {
+    destino = 0;
+    tamanho = n;
+  } else if(n >= 7 && dados[0] == 0xFE) {
+    size_t primeiro = dados[1] | (dados[2] << 8);
+    size_t ultimo = dados[3] | (dados[4] << 8);
+    if(ultimo < primeiro)
+      return false;
+    destino = primeiro;
+    // Ha' arquivos cortados antes do fim declarado.
+    tamanho = std::min(ultimo - primeiro + 1, n - 7);
+    dados += 7;
+  } else
+    return false;
+
+  std::fill(vram.begin(), vram.end(), 0);
+  std::copy(dados, dados + tamanho, vram.begin() + destino);
+  inicio = destino;
+  fim = destino + tamanho;
+  return true;
+}
+
+bool Tela::abrir(std::string arquivo) {
+  ArquivoMapeado mapa;
+
+  if(!mapa.abrir(arquivo))
+    return false;
+  return carregar(mapa.getDados(), mapa.getTamanho());
+}
+
+const std::vector<uint8_t> &Tela::getVram() const {
+  return vram;
+}
+
+void Tela::paleta(unsigned modo, uint32_t cores[16]) const {
+  size_t endereco = modo == 3 ? 0x2020 : modo <= 4 ? 0x1B80 : modo <= 6 ? 0x7680 : 0xFA80;
+  // Fora do arquivo, zerada (MSX1) ou com bits que o V9938 nao tem, a
+  // copia nao e' de uma paleta.
+  bool valida = endereco >= inicio && endereco + 32 <= fim;
+  bool usada = false;
+
+  for(int c = 0; valida && c < 16; c++) {
+    uint8_t rb = vram[endereco + c * 2], g = vram[endereco + c * 2 + 1];
+    if((rb & 0x88) || (g & 0xF8))
+      valida = false;
+    if(rb || g)
+      usada = true;
+  }
+  for(int c = 0; c < 16; c++) {
+    if(valida && usada) {
+      uint8_t rb = vram[endereco + c * 2], g = vram[endereco + c * 2 + 1];
+      cores[c] = rgba(niveisCor.n3[rb >> 4], niveisCor.n3[g], niveisCor.n3[rb & 7]);
+    } else
+      cores[c] = rgba(niveisCor.n3[paletaPadrao[c][0]], niveisCor.n3[paletaPadrao[c][1]], niveisCor.n3[paletaPadrao[c][2]]);
+  }
+}
+
+// SCREEN 2 e 4: tres bancos de 256 padroes, um para cada terco da tela,
+// com a cor de frente e de fundo de cada linha de 8 pixels.
+void Tela::padroes(const uint32_t cores[16], ImagemRGBA &imagem) const {
+  const uint8_t *nomes = vram.data() + 0x1800;
+
+  for(unsigned y = 0; y < 192; y++) {
+    size_t banco = (y >> 6) << 11;
+    uint32_t *linha = imagem.pixels.data() + y * 256;
+    for(unsigned x = 0; x < 32; x++) {
+      size_t pos = banco + nomes[(y >> 3) * 32 + x] * 8 + (y & 7);
+      uint8_t padrao = vram[pos], cor = vram[0x2000 + pos];
+      uint32_t frente = cores[cor >> 4], fundo = cores[cor & 15];
+      for(int b = 0; b < 8; b++)
+        linha[x * 8 + b] = padrao & (0x80 >> b) ? frente : fundo;
+    }
+  }
+}
+
+// SCREEN 3: blocos de 4x4 pixels, dois por byte; cada padrao de 8 bytes
+// cobre 2x8 blocos e a linha de caracteres escolhe qual par de bytes usar.
+void Tela::multicor(const uint32_t cores[16], ImagemRGBA &imagem) const {
+  const uint8_t *nomes = vram.data() + 0x0800;
+
+  for(unsigned y = 0; y < 192; y++) {
+    uint32_t *linha = imagem.pixels.data() + y * 256;
+    for(unsigned x = 0; x < 32; x++) {
+      uint8_t cor = vram[nomes[(y >> 3) * 32 + x] * 8 + ((y >> 3) & 3) * 2 + ((y >> 2) & 1)];
+      std::fill(linha + x * 8, linha + x * 8 + 4, cores[cor >> 4]);
+      std::fill(linha + x * 8 + 4, linha + x * 8 + 8, cores[cor & 15]);
+    }
+  }
+}
+
+// SCREEN 5 a 8 e 10 a 12: uma linha de 128 ou 256 bytes depois da outra.
+void Tela::bitmap(unsigned modo, const uint32_t cores[16], ImagemRGBA &imagem) const {
+  size_t bytesLinha = modo <= 6 ? 128 : 256;
+
+  if(modo == 5 || modo == 7) {
+    uint64_t pares[256];
+    for(int i = 0; i < 256; i++)
+      pares[i] = cores[i >> 4] | (uint64_t(cores[i & 15]) << 32);
+    for(unsigned y = 0; y < imagem.altura; y++) {
+      const uint8_t *origem = vram.data() + y * bytesLinha;
+      uint32_t *linha = imagem.pixels.data() + y * imagem.largura;
+      for(size_t x = 0; x < bytesLinha; x++)
+        std::memcpy(linha + x * 2, &pares[origem[x]], 8);
+    }
+  } else if(modo == 6) {
+    uint32_t quatro[256][4];
+    for(int i = 0; i < 256; i++)
+      for(int m = 0; m < 4; m++)
+        quatro[i][m] = cores[(i >> (6 - m * 2)) & 3];
+    for(unsigned y = 0; y < imagem.altura; y++) {
+      const uint8_t *origem = vram.data() + y * bytesLinha;
+      uint32_t *linha = imagem.pixels.data() + y * imagem.largura;
+      for(size_t x = 0; x < bytesLinha; x++)
+        std::memcpy(linha + x * 4, quatro[origem[x]], 16);
+    }
+  } else if(modo == 8) {
+    const uint8_t *origem = vram.data();
+    for(size_t i = 0; i < imagem.pixels.size(); i++)
+      imagem.pixels[i] = coresScreen8.c[origem[i]];
+  } else
+    converterYJK(vram.data(), imagem.pixels.size(), imagem.pixels.data(), modo == 12 ? nullptr : cores);
+}
+
+bool Tela::decodificar(unsigned modo, ImagemRGBA &imagem) const {
+  uint32_t cores[16];
+
+  if(modo < 2 || modo > 12 || modo == 9)
+    return false;
+  paleta(modo, cores);
+  if(modo <= 4) {
+    imagem.largura = 256;
+    imagem.altura = 192;
+  } else {
+    size_t bytesLinha = modo <= 6 ? 128 : 256;
+    imagem.largura = modo == 6 || modo == 7 ? 512 : 256;
+    imagem.altura = fim >= bytesLinha * 212 ? 212 : 192;
+  }
+  imagem.pixels.resize(size_t(imagem.largura) * imagem.altura);
+
+  if(modo == 3)
+    multicor(cores, imagem);
+  else if(modo <= 4)
+    padroes(cores, imagem);
+  else
+    bitmap(modo, cores, imagem);
+  return true;
+}
+
+unsigned modoPorExtensao(std::string arquivo) {
+  size_t ponto = arquivo.rfind('.');
+
+  if(ponto == std::string::npos || arquivo.size() - ponto != 4)
+    return 0;
+  std::string ext = arquivo.substr(ponto + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::toupper);
+  if(ext.compare(0, 2, "SC") != 0)
+    return 0;
+  if(ext[2] >= '2' && ext[2] <= '8')
+    return unsigned(ext[2] - '0');
+  if(ext[2] >= 'A' && ext[2] <= 'C')
+    return unsigned(ext[2] - 'A' + 10);
+  return 0;
+}
+
+void reduzir(const ImagemRGBA &origem, unsigned fator, ImagemRGBA &destino) {
+  if(fator <= 1) {
+    destino = origem;
+    return;
+  }
+
+  ImagemRGBA nova;
+  nova.largura = std::max(1u, origem.largura / fator);
+  nova.altura = std::max(1u, origem.altura / fator);
+  nova.pixels.resize(size_t(nova.largura) * nova.altura);
+  for(unsigned y = 0; y < nova.altura; y++)
+    for(unsigned x = 0; x < nova.largura; x++) {
+      uint32_t soma[4] = {0, 0, 0, 0}, n = 0;
+      for(unsigned dy = 0; dy < fator && y * fator + dy < origem.altura; dy++)
+        for(unsigned dx = 0; dx < fator && x * fator + dx < origem.largura; dx++, n++) {
+          uint32_t p = origem.pixels[size_t(y * fator + dy) * origem.largura + x * fator + dx];
+          for(int c = 0; c < 4; c++)
+            soma[c] += (p >> (c * 8)) & 0xFF;
+        }
+      uint32_t p = 0;
+      for(int c = 0; c < 4; c++)
+        p |= ((soma[c] + n / 2) / n) << (c * 8);
+      nova.pixels[size_t(y) * nova.largura + x] = p;
+    }
+  destino = std::move(nova);
+}
+
+bool gravarPng(std::string arquivo, const ImagemRGBA &imagem) {
+  png_image png;
+
+  std::memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  png.width = imagem.largura;
+  png.height = imagem.altura;
+  png.format = PNG_FORMAT_RGBA;
+  bool ok = png_image_write_to_file(&png, arquivo.c_str(), 0, imagem.pixels.data(), 0, nullptr) != 0;
+  png_image_free(&png);
+  return ok;
+}
+
+bool lerPng(std::string arquivo, ImagemRGBA &imagem) {
+  png_image png;
+
+  std::memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  if(!png_image_begin_read_from_file(&png, arquivo.c_str()))
+    return false;
+  png.format = PNG_FORMAT_RGBA;
+  imagem.largura = png.width;
+  imagem.altura = png.height;
+  imagem.pixels.resize(size_t(png.width) * png.height);
+  bool ok = png_image_finish_read(&png, nullptr, imagem.pixels.data(), 0, nullptr) != 0;
+  png_image_free(&png);
+  return ok;
+}
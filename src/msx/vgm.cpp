@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <zlib.h>
+
+#include "fita.h"
+#include "som.h"
+#include "vgm.h"
+
+// Taxa das esperas do VGM.
+static const unsigned taxaVgm = 44100;
+// Amostras guardadas antes de gravar.
+static const size_t amostrasBuffer = 64 << 10;
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return uint32_t(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24));
+}
+
+// Bytes do comando que comeca em p (com o codigo), pelo formato do VGM 1.71;
+// 'resto' e' o que sobra do arquivo a partir de p.
+static size_t tamanhoComando(const uint8_t *p, size_t resto) {
+  uint8_t c = p[0];
+
+  if(c == 0x67)
+    return resto >= 7 ? 7 + size_t(le32(p + 3)) : resto + 1;
+  if(c >= 0x30 && c <= 0x3F)
+    return 2;
+  if(c == 0x4F || c == 0x50)
+    return 2;
+  if((c >= 0x40 && c <= 0x5F) || c == 0x61 || (c >= 0xA0 && c <= 0xBF))
+    return 3;
+  if(c == 0x68)
+    return 12;
+  if(c == 0x90 || c == 0x91 || c == 0x95)
+    return 5;
+  if(c == 0x92)
+    return 6;
+  if(c == 0x93)
+    return 11;
+  if(c == 0x94)
+    return 2;
+  if(c >= 0xC0 && c <= 0xDF)
+    return 4;
+  if(c >= 0xE0)
+    return 5;
+  return 1;
+}
+
+Vgm::Vgm() : info(), inicio(0), volta(0) {
+}
+
+const InfoVgm &Vgm::getInfo() const {
+  return info;
+}
+
+bool Vgm::abrir(std::string arquivo) {
+  // gzread tambem le arquivos sem compressao.
+  gzFile f = gzopen(arquivo.c_str(), "rb");
+  if(!f)
+    return false;
+  dados.clear();
+  info = InfoVgm();
+  uint8_t bloco[64 << 10];
+  int n;
+  while((n = gzread(f, bloco, sizeof(bloco))) > 0)
+    dados.insert(dados.end(), bloco, bloco + n);
+  gzclose(f);
+  if(n < 0 || dados.size() < 0x40 || std::memcmp(dados.data(), "Vgm ", 4) != 0)
+    return false;
+
+  const uint8_t *d = dados.data();
+  info.versao = le32(d + 0x08);
+  info.amostras = le32(d + 0x18);
+  info.amostrasVolta = le32(d + 0x20);
+  // Antes da 1.50 os dados comecam sempre em 0x40.
+  uint32_t deslocamento = info.versao >= 0x150 ? le32(d + 0x34) : 0;
+  inicio = deslocamento ? 0x34 + size_t(deslocamento) : 0x40;
+  if(inicio > dados.size())
+    return false;
+  volta = le32(d + 0x1C) ? 0x1C + size_t(le32(d + 0x1C)) : 0;
+  if(volta < inicio || volta >= dados.size())
+    volta = 0;
+
+  // Os campos que ficam depois do inicio dos dados nao existem no arquivo.
+  auto campo = [&](size_t posicao) {
+    return posicao + 4 <= inicio ? le32(d + posicao) : 0;
+  };
+  info.relogioOpll = campo(0x10) & 0x3FFFFFFF;
+  info.relogioPsg = campo(0x74) & 0x3FFFFFFF;
+  // YM2149 com o pino 26 em baixo divide o relogio por 2.
+  if(info.relogioPsg && inicio > 0x79 && (d[0x78] & 0x10) && (d[0x79] & 0x10))
+    info.relogioPsg /= 2;
+  uint32_t scc = campo(0x9C);
+  info.relogioScc = scc & 0x7FFFFFFF;
+  info.sccMais = (scc >> 31) != 0;
+  return true;
+}
+
+uint64_t Vgm::renderizar(std::ostream &saida, unsigned taxa, unsigned voltas) const {
+  std::unique_ptr<ChipPsg> psg;
+  std::unique_ptr<ChipScc> scc;
+  std::unique_ptr<ChipOpll> opll;
+  if(info.relogioPsg)
+    psg.reset(new ChipPsg(info.relogioPsg, taxa));
+  if(info.relogioScc)
+    scc.reset(new ChipScc(info.relogioScc, taxa, info.sccMais));
+  if(info.relogioOpll)
+    opll.reset(new ChipOpll(info.relogioOpll, taxa));
+
+  std::vector<int16_t> buffer(amostrasBuffer);
+  size_t usado = 0;
+  float mistura[amostrasBloco];
+  uint64_t tempo = 0, gravadas = 0;
+  // Passa-altas de um polo em ~10 Hz: o PSG so' tem tensao positiva.
+  float polo = 1.0f - 63.0f / float(taxa), x1 = 0, y1 = 0;
+
+  auto esperar = [&](uint64_t n) {
+    tempo += n;
+    uint64_t alvo = tempo * taxa / taxaVgm;
+    while(gravadas < alvo) {
+      size_t m = size_t(std::min<uint64_t>(alvo - gravadas, amostrasBloco));
+      std::fill_n(mistura, m, 0.0f);
+      if(psg)
+        psg->gerar(mistura, m);
+      if(scc)
+        scc->gerar(mistura, m);
+      if(opll)
+        opll->gerar(mistura, m);
+      for(size_t k = 0; k < m; k++) {
+        float y = mistura[k] - x1 + polo * y1;
+        x1 = mistura[k];
+        mistura[k] = y1 = y;
+      }
+      if(usado + m > buffer.size()) {
+        saida.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(usado * sizeof(int16_t)));
+        usado = 0;
+      }
+      converterPcm(mistura, m, buffer.data() + usado);
+      usado += m;
+      gravadas += m;
+    }
+  };
+
+  const uint8_t *d = dados.data();
+  size_t pos = inicio, fim = dados.size();
+  unsigned feitas = 0;
+  while(pos < fim) {
+    const uint8_t *p = d + pos;
+    uint8_t c = p[0];
+    size_t tamanho = tamanhoComando(p, fim - pos);
+    if(tamanho > fim - pos)
+      break;
+    if(c == 0x66) {
+      if(!volta || feitas >= voltas)
+        break;
+      feitas++;
+      pos = volta;
+      continue;
+    }
+    switch(c) {
+      case 0x51:
+        if(opll)
+          opll->escrever(p[1], p[2]);
+        break;
+      case 0xA0:
+        // Bit 7 do registrador: segundo PSG, que o MSX nao tem.
+        if(psg && !(p[1] & 0x80))
+          psg->escrever(p[1], p[2]);
+        break;
+      case 0xD2:
+        if(scc && !(p[1] & 0x80))
+          scc->escrever(p[1], p[2], p[3]);
+        break;
+      case 0x61:
+        esperar(le16(p + 1));
+        break;
+      case 0x62:
+        esperar(735);
+        break;
+      case 0x63:
+        esperar(882);
+        break;
+      default:
+        if(c >= 0x70 && c <= 0x7F)
+          esperar((c & 15) + 1);
+        else if(c >= 0x80 && c <= 0x8F)
+          esperar(c & 15);
+        break;
+    }
+    pos += tamanho;
+  }
+
+  saida.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(usado * sizeof(int16_t)));
+  return gravadas;
+}
+
+bool converterVgmWav(std::string vgm, std::string wav, unsigned taxa, unsigned voltas, double *segundos) {
+  Vgm musica;
+  uint8_t h[44];
+
+  if(!taxa || !musica.abrir(vgm))
+    return false;
+  const InfoVgm &info = musica.getInfo();
+  if(!info.relogioPsg && !info.relogioScc && !info.relogioOpll)
+    return false;
+
+  std::ofstream saida(wav, std::ios::binary | std::ios::trunc);
+  if(!saida)
+    return false;
+  cabecalhoWav(h, taxa, 0);
+  saida.write(reinterpret_cast<const char *>(h), sizeof(h));
+  uint64_t amostras = musica.renderizar(saida, taxa, voltas);
+  cabecalhoWav(h, taxa, amostras);
+  saida.seekp(0);
+  saida.write(reinterpret_cast<const char *>(h), sizeof(h));
+  if(segundos)
+    *segundos = double(amostras) / taxa;
+  return saida.good();
+}
@@ -0,0 +1,741 @@
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+#include "z80.h"
+
+// Formato de cada opcode. Letras minusculas sao trocadas na hora de formatar:
+//   n  byte imediato            w  palavra imediata
+//   r  destino de JR/DJNZ       o  o proprio opcode (para os DB)
+//   x  HL, IX ou IY             h  H, IXH ou IYH
+//   l  L, IXL ou IYL            m  (HL), (IX+d) ou (IY+d)
+// Com DD/FD, so' opcodes com x, h, l ou m mudam; nos outros o prefixo vira
+// um DB sozinho. Quando ha' m, h e l continuam sendo H e L, como no Z80.
+// Vazio marca os prefixos.
+static constexpr std::string_view formatosBase[256] = {
+  "NOP", "LD BC,w", "LD (BC),A", "INC BC",                              // 00
+  "INC B", "DEC B", "LD B,n", "RLCA",                                   // 04
+  "EX AF,AF'", "ADD x,BC", "LD A,(BC)", "DEC BC",                       // 08
+  "INC C", "DEC C", "LD C,n", "RRCA",                                   // 0C
+  "DJNZ r", "LD DE,w", "LD (DE),A", "INC DE",                           // 10
+  "INC D", "DEC D", "LD D,n", "RLA",                                    // 14
+  "JR r", "ADD x,DE", "LD A,(DE)", "DEC DE",                            // 18
+  "INC E", "DEC E", "LD E,n", "RRA",                                    // 1C
+  "JR NZ,r", "LD x,w", "LD (w),x", "INC x",                             // 20
+  "INC h", "DEC h", "LD h,n", "DAA",                                    // 24
+  "JR Z,r", "ADD x,x", "LD x,(w)", "DEC x",                             // 28
+  "INC l", "DEC l", "LD l,n", "CPL",                                    // 2C
+  "JR NC,r", "LD SP,w", "LD (w),A", "INC SP",                           // 30
+  "INC m", "DEC m", "LD m,n", "SCF",                                    // 34
+  "JR C,r", "ADD x,SP", "LD A,(w)", "DEC SP",                           // 38
+  "INC A", "DEC A", "LD A,n", "CCF",                                    // 3C
+  "LD B,B", "LD B,C", "LD B,D", "LD B,E",                               // 40
+  "LD B,h", "LD B,l", "LD B,m", "LD B,A",                               // 44
+  "LD C,B", "LD C,C", "LD C,D", "LD C,E",                               // 48
+  "LD C,h", "LD C,l", "LD C,m", "LD C,A",                               // 4C
+  "LD D,B", "LD D,C", "LD D,D", "LD D,E",                               // 50
+  "LD D,h", "LD D,l", "LD D,m", "LD D,A",                               // 54
+  "LD E,B", "LD E,C", "LD E,D", "LD E,E",                               // 58
+  "LD E,h", "LD E,l", "LD E,m", "LD E,A",                               // 5C
+  "LD h,B", "LD h,C", "LD h,D", "LD h,E",                               // 60
+  "LD h,h", "LD h,l", "LD h,m", "LD h,A",                               // 64
+  "LD l,B", "LD l,C", "LD l,D", "LD l,E",                               // 68
+  "LD l,h", "LD l,l", "LD l,m", "LD l,A",                               // 6C
+  "LD m,B", "LD m,C", "LD m,D", "LD m,E",                               // 70
+  "LD m,h", "LD m,l", "HALT", "LD m,A",                                 // 74
+  "LD A,B", "LD A,C", "LD A,D", "LD A,E",                               // 78
+  "LD A,h", "LD A,l", "LD A,m", "LD A,A",                               // 7C
+  "ADD A,B", "ADD A,C", "ADD A,D", "ADD A,E",                           // 80
+  "ADD A,h", "ADD A,l", "ADD A,m", "ADD A,A",                           // 84
+  "ADC A,B", "ADC A,C", "ADC A,D", "ADC A,E",                           // 88
+  "ADC A,h", "ADC A,l", "ADC A,m", "ADC A,A",                           // 8C
+  "SUB B", "SUB C", "SUB D", "SUB E",                                   // 90
+  "SUB h", "SUB l", "SUB m", "SUB A",                                   // 94
+  "SBC A,B", "SBC A,C", "SBC A,D", "SBC A,E",                           // 98
+  "SBC A,h", "SBC A,l", "SBC A,m", "SBC A,A",                           // 9C
+  "AND B", "AND C", "AND D", "AND E",                                   // A0
+  "AND h", "AND l", "AND m", "AND A",                                   // A4
+  "XOR B", "XOR C", "XOR D", "XOR E",                                   // A8
+  "XOR h", "XOR l", "XOR m", "XOR A",                                   // AC
+  "OR B", "OR C", "OR D", "OR E",                                       // B0
+  "OR h", "OR l", "OR m", "OR A",                                       // B4
+  "CP B", "CP C", "CP D", "CP E",                                       // B8
+  "CP h", "CP l", "CP m", "CP A",                                       // BC
+  "RET NZ", "POP BC", "JP NZ,w", "JP w",                                // C0
+  "CALL NZ,w", "PUSH BC", "ADD A,n", "RST #00",                         // C4
+  "RET Z", "RET", "JP Z,w", "",                                         // C8
+  "CALL Z,w", "CALL w", "ADC A,n", "RST #08",                           // CC
+  "RET NC", "POP DE", "JP NC,w", "OUT (n),A",                           // D0
+  "CALL NC,w", "PUSH DE", "SUB n", "RST #10",                           // D4
+  "RET C", "EXX", "JP C,w", "IN A,(n)",                                 // D8
+  "CALL C,w", "", "SBC A,n", "RST #18",                                 // DC
+  "RET PO", "POP x", "JP PO,w", "EX (SP),x",                            // E0
+  "CALL PO,w", "PUSH x", "AND n", "RST #20",                            // E4
+  "RET PE", "JP (x)", "JP PE,w", "EX DE,HL",                            // E8
+  "CALL PE,w", "", "XOR n", "RST #28",                                  // EC
+  "RET P", "POP AF", "JP P,w", "DI",                                    // F0
+  "CALL P,w", "PUSH AF", "OR n", "RST #30",                             // F4
+  "RET M", "LD SP,x", "JP M,w", "EI",                                   // F8
+  "CALL M,w", "", "CP n", "RST #38"                                     // FC
+};
+
+static constexpr std::string_view formatosCB[256] = {
+  "RLC B", "RLC C", "RLC D", "RLC E",                                   // 00
+  "RLC H", "RLC L", "RLC (HL)", "RLC A",                                // 04
+  "RRC B", "RRC C", "RRC D", "RRC E",                                   // 08
+  "RRC H", "RRC L", "RRC (HL)", "RRC A",                                // 0C
+  "RL B", "RL C", "RL D", "RL E",                                       // 10
+  "RL H", "RL L", "RL (HL)", "RL A",                                    // 14
+  "RR B", "RR C", "RR D", "RR E",                                       // 18
+  "RR H", "RR L", "RR (HL)", "RR A",                                    // 1C
+  "SLA B", "SLA C", "SLA D", "SLA E",                                   // 20
+  "SLA H", "SLA L", "SLA (HL)", "SLA A",                                // 24
+  "SRA B", "SRA C", "SRA D", "SRA E",                                   // 28
+  "SRA H", "SRA L", "SRA (HL)", "SRA A",                                // 2C
+  "SLL B", "SLL C", "SLL D", "SLL E",                                   // 30
+  "SLL H", "SLL L", "SLL (HL)", "SLL A",                                // 34
+  "SRL B", "SRL C", "SRL D", "SRL E",                                   // 38
+  "SRL H", "SRL L", "SRL (HL)", "SRL A",                                // 3C
+  "BIT 0,B", "BIT 0,C", "BIT 0,D", "BIT 0,E",                           // 40
+  "BIT 0,H", "BIT 0,L", "BIT 0,(HL)", "BIT 0,A",                        // 44
+  "BIT 1,B", "BIT 1,C", "BIT 1,D", "BIT 1,E",                           // 48
+  "BIT 1,H", "BIT 1,L", "BIT 1,(HL)", "BIT 1,A",                        // 4C
+  "BIT 2,B", "BIT 2,C", "BIT 2,D", "BIT 2,E",                           // 50
+  "BIT 2,H", "BIT 2,L", "BIT 2,(HL)", "BIT 2,A",                        // 54
+  "BIT 3,B", "BIT 3,C", "BIT 3,D", "BIT 3,E",                           // 58
+  "BIT 3,H", "BIT 3,L", "BIT 3,(HL)", "BIT 3,A",                        // 5C
+  "BIT 4,B", "BIT 4,C", "BIT 4,D", "BIT 4,E",                           // 60
+  "BIT 4,H", "BIT 4,L", "BIT 4,(HL)", "BIT 4,A",                        // 64
+  "BIT 5,B", "BIT 5,C", "BIT 5,D", "BIT 5,E",                           // 68
+  "BIT 5,H", "BIT 5,L", "BIT 5,(HL)", "BIT 5,A",                        // 6C
+  "BIT 6,B", "BIT 6,C", "BIT 6,D", "BIT 6,E",                           // 70
+  "BIT 6,H", "BIT 6,L", "BIT 6,(HL)", "BIT 6,A",                        // 74
+  "BIT 7,B", "BIT 7,C", "BIT 7,D", "BIT 7,E",                           // 78
+  "BIT 7,H", "BIT 7,L", "BIT 7,(HL)", "BIT 7,A",                        // 7C
+  "RES 0,B", "RES 0,C", "RES 0,D", "RES 0,E",                           // 80
+  "RES 0,H", "RES 0,L", "RES 0,(HL)", "RES 0,A",                        // 84
+  "RES 1,B", "RES 1,C", "RES 1,D", "RES 1,E",                           // 88
+  "RES 1,H", "RES 1,L", "RES 1,(HL)", "RES 1,A",                        // 8C
+  "RES 2,B", "RES 2,C", "RES 2,D", "RES 2,E",                           // 90
+  "RES 2,H", "RES 2,L", "RES 2,(HL)", "RES 2,A",                        // 94
+  "RES 3,B", "RES 3,C", "RES 3,D", "RES 3,E",                           // 98
+  "RES 3,H", "RES 3,L", "RES 3,(HL)", "RES 3,A",                        // 9C
+  "RES 4,B", "RES 4,C", "RES 4,D", "RES 4,E",                           // A0
+  "RES 4,H", "RES 4,L", "RES 4,(HL)", "RES 4,A",                        // A4
+  "RES 5,B", "RES 5,C", "RES 5,D", "RES 5,E",                           // A8
+  "RES 5,H", "RES 5,L", "RES 5,(HL)", "RES 5,A",                        // AC
+  "RES 6,B", "RES 6,C", "RES 6,D", "RES 6,E",                           // B0
+  "RES 6,H", "RES 6,L", "RES 6,(HL)", "RES 6,A",                        // B4
+  "RES 7,B", "RES 7,C", "RES 7,D", "RES 7,E",                           // B8
+  "RES 7,H", "RES 7,L", "RES 7,(HL)", "RES 7,A",                        // BC
+  "SET 0,B", "SET 0,C", "SET 0,D", "SET 0,E",                           // C0
+  "SET 0,H", "SET 0,L", "SET 0,(HL)", "SET 0,A",                        // C4
+  "SET 1,B", "SET 1,C", "SET 1,D", "SET 1,E",                           // C8
+  "SET 1,H", "SET 1,L", "SET 1,(HL)", "SET 1,A",                        // CC
+  "SET 2,B", "SET 2,C", "SET 2,D", "SET 2,E",                           // D0
+  "SET 2,H", "SET 2,L", "SET 2,(HL)", "SET 2,A",                        // D4
+  "SET 3,B", "SET 3,C", "SET 3,D", "SET 3,E",                           // D8
+  "SET 3,H", "SET 3,L", "SET 3,(HL)", "SET 3,A",                        // DC
+  "SET 4,B", "SET 4,C", "SET 4,D", "SET 4,E",                           // E0
+  "SET 4,H", "SET 4,L", "SET 4,(HL)", "SET 4,A",                        // E4
+  "SET 5,B", "SET 5,C", "SET 5,D", "SET 5,E",                           // E8
+  "SET 5,H", "SET 5,L", "SET 5,(HL)", "SET 5,A",                        // EC
+  "SET 6,B", "SET 6,C", "SET 6,D", "SET 6,E",                           // F0
+  "SET 6,H", "SET 6,L", "SET 6,(HL)", "SET 6,A",                        // F4
+  "SET 7,B", "SET 7,C", "SET 7,D", "SET 7,E",                           // F8
+  "SET 7,H", "SET 7,L", "SET 7,(HL)", "SET 7,A"                         // FC
+};
+
+static constexpr std::string_view formatosED[256] = {
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 00
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 04
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 08
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 0C
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 10
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 14
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 18
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 1C
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 20
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 24
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 28
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 2C
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 30
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 34
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 38
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 3C
+  "IN B,(C)", "OUT (C),B", "SBC HL,BC", "LD (w),BC",                    // 40
+  "NEG", "RETN", "IM 0", "LD I,A",                                      // 44
+  "IN C,(C)", "OUT (C),C", "ADC HL,BC", "LD BC,(w)",                    // 48
+  "NEG", "RETI", "IM 0", "LD R,A",                                      // 4C
+  "IN D,(C)", "OUT (C),D", "SBC HL,DE", "LD (w),DE",                    // 50
+  "NEG", "RETN", "IM 1", "LD A,I",                                      // 54
+  "IN E,(C)", "OUT (C),E", "ADC HL,DE", "LD DE,(w)",                    // 58
+  "NEG", "RETN", "IM 2", "LD A,R",                                      // 5C
+  "IN H,(C)", "OUT (C),H", "SBC HL,HL", "LD (w),HL",                    // 60
+  "NEG", "RETN", "IM 0", "RRD",                                         // 64
+  "IN L,(C)", "OUT (C),L", "ADC HL,HL", "LD HL,(w)",                    // 68
+  "NEG", "RETN", "IM 0", "RLD",                                         // 6C
+  "IN F,(C)", "OUT (C),0", "SBC HL,SP", "LD (w),SP",                    // 70
+  "NEG", "RETN", "IM 1", "DB #ED,o",                                    // 74
+  "IN A,(C)", "OUT (C),A", "ADC HL,SP", "LD SP,(w)",                    // 78
+  "NEG", "RETN", "IM 2", "DB #ED,o",                                    // 7C
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 80
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 84
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 88
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 8C
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 90
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 94
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 98
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // 9C
+  "LDI", "CPI", "INI", "OUTI",                                          // A0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // A4
+  "LDD", "CPD", "IND", "OUTD",                                          // A8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // AC
+  "LDIR", "CPIR", "INIR", "OTIR",                                       // B0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // B4
+  "LDDR", "CPDR", "INDR", "OTDR",                                       // B8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // BC
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // C0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // C4
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // C8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // CC
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // D0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // D4
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // D8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // DC
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // E0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // E4
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // E8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // EC
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // F0
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // F4
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o",                       // F8
+  "DB #ED,o", "DB #ED,o", "DB #ED,o", "DB #ED,o"                        // FC
+};
+
+static constexpr std::string_view formatosIndiceCB[256] = {
+  "RLC m,B", "RLC m,C", "RLC m,D", "RLC m,E",                           // 00
+  "RLC m,H", "RLC m,L", "RLC m", "RLC m,A",                             // 04
+  "RRC m,B", "RRC m,C", "RRC m,D", "RRC m,E",                           // 08
+  "RRC m,H", "RRC m,L", "RRC m", "RRC m,A",                             // 0C
+  "RL m,B", "RL m,C", "RL m,D", "RL m,E",                               // 10
+  "RL m,H", "RL m,L", "RL m", "RL m,A",                                 // 14
+  "RR m,B", "RR m,C", "RR m,D", "RR m,E",                               // 18
+  "RR m,H", "RR m,L", "RR m", "RR m,A",                                 // 1C
+  "SLA m,B", "SLA m,C", "SLA m,D", "SLA m,E",                           // 20
+  "SLA m,H", "SLA m,L", "SLA m", "SLA m,A",                             // 24
+  "SRA m,B", "SRA m,C", "SRA m,D", "SRA m,E",                           // 28
+  "SRA m,H", "SRA m,L", "SRA m", "SRA m,A",                             // 2C
+  "SLL m,B", "SLL m,C", "SLL m,D", "SLL m,E",                           // 30
+  "SLL m,H", "SLL m,L", "SLL m", "SLL m,A",                             // 34
+  "SRL m,B", "SRL m,C", "SRL m,D", "SRL m,E",                           // 38
+  "SRL m,H", "SRL m,L", "SRL m", "SRL m,A",                             // 3C
+  "BIT 0,m", "BIT 0,m", "BIT 0,m", "BIT 0,m",                           // 40
+  "BIT 0,m", "BIT 0,m", "BIT 0,m", "BIT 0,m",                           // 44
+  "BIT 1,m", "BIT 1,m", "BIT 1,m", "BIT 1,m",                           // 48
+  "BIT 1,m", "BIT 1,m", "BIT 1,m", "BIT 1,m",                           // 4C
+  "BIT 2,m", "BIT 2,m", "BIT 2,m", "BIT 2,m",                           // 50
+  "BIT 2,m", "BIT 2,m", "BIT 2,m", "BIT 2,m",                           // 54
+  "BIT 3,m", "BIT 3,m", "BIT 3,m", "BIT 3,m",                           // 58
+  "BIT 3,m", "BIT 3,m", "BIT 3,m", "BIT 3,m",                           // 5C
+  "BIT 4,m", "BIT 4,m", "BIT 4,m", "BIT 4,m",                           // 60
+  "BIT 4,m", "BIT 4,m", "BIT 4,m", "BIT 4,m",                           // 64
+  "BIT 5,m", "BIT 5,m", "BIT 5,m", "BIT 5,m",                           // 68
+  "BIT 5,m", "BIT 5,m", "BIT 5,m", "BIT 5,m",                           // 6C
+  "BIT 6,m", "BIT 6,m", "BIT 6,m", "BIT 6,m",                           // 70
+  "BIT 6,m", "BIT 6,m", "BIT 6,m", "BIT 6,m",                           // 74
+  "BIT 7,m", "BIT 7,m", "BIT 7,m", "BIT 7,m",                           // 78
+  "BIT 7,m", "BIT 7,m", "BIT 7,m", "BIT 7,m",                           // 7C
+  "RES 0,m,B", "RES 0,m,C", "RES 0,m,D", "RES 0,m,E",                   // 80
+  "RES 0,m,H", "RES 0,m,L", "RES 0,m", "RES 0,m,A",                     // 84
+  "RES 1,m,B", "RES 1,m,C", "RES 1,m,D", "RES 1,m,E",                   // 88
+  "RES 1,m,H", "RES 1,m,L", "RES 1,m", "RES 1,m,A",                     // 8C
+  "RES 2,m,B", "RES 2,m,C", "RES 2,m,D", "RES 2,m,E",                   // 90
+  "RES 2,m,H", "RES 2,m,L", "RES 2,m", "RES 2,m,A",                     // 94
+  "RES 3,m,B", "RES 3,m,C", "RES 3,m,D", "RES 3,m,E",                   // 98
+  "RES 3,m,H", "RES 3,m,L", "RES 3,m", "RES 3,m,A",                     // 9C
+  "RES 4,m,B", "RES 4,m,C", "RES 4,m,D", "RES 4,m,E",                   // A0
+  "RES 4,m,H", "RES 4,m,L", "RES 4,m", "RES 4,m,A",                     // A4
+  "RES 5,m,B", "RES 5,m,C", "RES 5,m,D", "RES 5,m,E",                   // A8
+  "RES 5,m,H", "RES 5,m,L", "RES 5,m", "RES 5,m,A",                     // AC
+  "RES 6,m,B", "RES 6,m,C", "RES 6,m,D", "RES 6,m,E",                   // B0
+  "RES 6,m,H", "RES 6,m,L", "RES 6,m", "RES 6,m,A",                     // B4
+  "RES 7,m,B", "RES 7,m,C", "RES 7,m,D", "RES 7,m,E",                   // B8
+  "RES 7,m,H", "RES 7,m,L", "RES 7,m", "RES 7,m,A",                     // BC
+  "SET 0,m,B", "SET 0,m,C", "SET 0,m,D", "SET 0,m,E",                   // C0
+  "SET 0,m,H", "SET 0,m,L", "SET 0,m", "SET 0,m,A",                     // C4
+  "SET 1,m,B", "SET 1,m,C", "SET 1,m,D", "SET 1,m,E",                   // C8
+  "SET 1,m,H", "SET 1,m,L", "SET 1,m", "SET 1,m,A",                     // CC
+  "SET 2,m,B", "SET 2,m,C", "SET 2,m,D", "SET 2,m,E",                   // D0
+  "SET 2,m,H", "SET 2,m,L", "SET 2,m", "SET 2,m,A",                     // D4
+  "SET 3,m,B", "SET 3,m,C", "SET 3,m,D", "SET 3,m,E",                   // D8
+  "SET 3,m,H", "SET 3,m,L", "SET 3,m", "SET 3,m,A",                     // DC
+  "SET 4,m,B", "SET 4,m,C", "SET 4,m,D", "SET 4,m,E",                   // E0
+  "SET 4,m,H", "SET 4,m,L", "SET 4,m", "SET 4,m,A",                     // E4
+  "SET 5,m,B", "SET 5,m,C", "SET 5,m,D", "SET 5,m,E",                   // E8
+  "SET 5,m,H", "SET 5,m,L", "SET 5,m", "SET 5,m,A",                     // EC
+  "SET 6,m,B", "SET 6,m,C", "SET 6,m,D", "SET 6,m,E",                   // F0
+  "SET 6,m,H", "SET 6,m,L", "SET 6,m", "SET 6,m,A",                     // F4
+  "SET 7,m,B", "SET 7,m,C", "SET 7,m,D", "SET 7,m,E",                   // F8
+  "SET 7,m,H", "SET 7,m,L", "SET 7,m", "SET 7,m,A"                      // FC
+};
+
+// Bytes de operando que seguem o opcode (sem o deslocamento de m).
+static constexpr uint8_t bytesOperando(std::string_view formato) {
+  uint8_t n = 0;
+  for(size_t i = 0; i < formato.size(); i++)
+    if(formato[i] == 'n' || formato[i] == 'r')
+      n += 1;
+    else if(formato[i] == 'w')
+      n += 2;
+  return n;
+}
+
+static constexpr bool temLetra(std::string_view formato, char letra) {
+  for(size_t i = 0; i < formato.size(); i++)
+    if(formato[i] == letra)
+      return true;
+  return false;
+}
+
+static constexpr bool comeca(std::string_view formato, std::string_view inicio) {
+  return formato.substr(0, inicio.size()) == inicio;
+}
+
+static constexpr FluxoZ80 fluxoDe(std::string_view formato) {
+  bool condicional = temLetra(formato, ',');
+
+  if(comeca(formato, "JP ("))
+    return fluxoIndireto;
+  if(comeca(formato, "JP ") || comeca(formato, "JR "))
+    return condicional ? fluxoSaltoCondicional : fluxoSalto;
+  if(comeca(formato, "DJNZ "))
+    return fluxoSaltoCondicional;
+  if(comeca(formato, "CALL "))
+    return condicional ? fluxoChamadaCondicional : fluxoChamada;
+  if(comeca(formato, "RST "))
+    return fluxoChamada;
+  if(formato == "RET" || formato == "RETI" || formato == "RETN")
+    return fluxoRetorno;
+  if(comeca(formato, "RET "))
+    return fluxoRetornoCondicional;
+  return fluxoSegue;
+}
+
+static constexpr std::string_view prefixoInvalido = "DB o";
+static constexpr std::string_view registradoresIndice[3][3] = {
+  {"HL", "H", "L"}, {"IX", "IXH", "IXL"}, {"IY", "IYH", "IYL"}
+};
+
+// Multiplicacoes do R800, em opcodes que no Z80 sao DB.
+static constexpr std::string_view formatoR800(uint8_t opcode) {
+  switch(opcode) {
+    case 0xC1: return "MULUB A,B";
+    case 0xC9: return "MULUB A,C";
+    case 0xD1: return "MULUB A,D";
+    case 0xD9: return "MULUB A,E";
+    case 0xC3: return "MULUW HL,BC";
+    case 0xF3: return "MULUW HL,SP";
+    default: return std::string_view();
+  }
+}
+
+// De onde sai o destino de saltos e chamadas.
+enum Destino : uint8_t { semDestino, destinoPalavra, destinoRelativo, destinoRst };
+
+// Os numeros do texto tem largura fixa (#12, #1234, +#05), entao o texto
+// de cada instrucao fica pronto na tabela e so' os digitos sao trocados.
+enum Remendo : uint8_t { remendoByte, remendoPalavra, remendoRelativo, remendoDeslocamento };
+
+struct Operando {
+  Remendo tipo;
+  // Byte da instrucao e coluna do texto: o primeiro digito, ou o sinal do
+  // deslocamento.
+  uint8_t origem;
+  uint8_t coluna;
+};
+
+// Uma instrucao com prefixos e registradores de indice ja' resolvidos:
+// decodificar so' le os primeiros campos, formatar copia o texto inteiro
+// e escreve os operandos por cima.
+struct Entrada {
+  uint8_t tamanho;
+  uint8_t fluxo;
+  Destino destino;
+  bool valida;
+  // Primeiro byte imediato, de onde sai o destino.
+  uint8_t imediato;
+  uint8_t tamanhoTexto;
+  uint8_t operandos;
+  Operando operando[2];
+  char texto[19];
+};
+static_assert(sizeof(Entrada) == 32, "entrada da tabela do desmontador");
+
+struct TabelaZ80 {
+  Entrada entradas[256];
+};
+
+static constexpr char digitosHexa[] = "0123456789ABCDEF";
+
+// 'inicio' e' a posicao do opcode depois dos prefixos; 'deslocamento', a do
+// d de (IX+d), ou 0 sem ele.
+static constexpr Entrada montar(std::string_view formato, uint8_t opcode, uint8_t inicio, uint8_t indice,
+                                uint8_t deslocamento) {
+  Entrada e{};
+  const std::string_view *nomes = registradoresIndice[indice];
+  uint8_t imediato = uint8_t(inicio + 1 + (deslocamento > inicio ? 1 : 0));
+  uint8_t n = 0;
+  auto poe = [&e, &n](std::string_view texto) {
+    for(char c : texto)
+      e.texto[n++] = c;
+  };
+  auto marca = [&e](Remendo tipo, uint8_t origem, uint8_t coluna) {
+    e.operando[e.operandos++] = Operando{tipo, origem, coluna};
+  };
+
+  e.tamanho = uint8_t(imediato + bytesOperando(formato));
+  e.fluxo = fluxoDe(formato);
+  e.valida = !comeca(formato, "DB ");
+  e.imediato = imediato;
+  if(comeca(formato, "RST "))
+    e.destino = destinoRst;
+  else if(e.fluxo != fluxoSegue && temLetra(formato, 'w'))
+    e.destino = destinoPalavra;
+  else if(temLetra(formato, 'r'))
+    e.destino = destinoRelativo;
+
+  for(char c : formato) {
+    switch(c) {
+      case 'n':
+        marca(remendoByte, imediato++, uint8_t(n + 1));
+        poe("#00");
+        break;
+      case 'w':
+        marca(remendoPalavra, imediato, uint8_t(n + 1));
+        imediato += 2;
+        poe("#0000");
+        break;
+      case 'r':
+        marca(remendoRelativo, imediato++, uint8_t(n + 1));
+        poe("#0000");
+        break;
+      case 'o':
+        poe("#");
+        e.texto[n++] = digitosHexa[opcode >> 4];
+        e.texto[n++] = digitosHexa[opcode & 15];
+        break;
+      case 'x':
+        poe(nomes[0]);
+        break;
+      case 'h':
+        poe(deslocamento ? "H" : nomes[1]);
+        break;
+      case 'l':
+        poe(deslocamento ? "L" : nomes[2]);
+        break;
+      case 'm':
+        if(!deslocamento) {
+          poe("(HL)");
+          break;
+        }
+        poe("(");
+        poe(nomes[0]);
+        marca(remendoDeslocamento, deslocamento, n);
+        poe("+#00)");
+        break;
+      default:
+        e.texto[n++] = c;
+    }
+  }
+  e.tamanhoTexto = n;
+  return e;
+}
+
+static constexpr TabelaZ80 gerarBase() {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++)
+    t.entradas[i] = montar(formatosBase[i], uint8_t(i), 0, 0, 0);
+  return t;
+}
+
+static constexpr TabelaZ80 gerarCB() {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++)
+    t.entradas[i] = montar(formatosCB[i], uint8_t(i), 1, 0, 0);
+  return t;
+}
+
+static constexpr TabelaZ80 gerarED(bool r800) {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++) {
+    std::string_view f = r800 ? formatoR800(uint8_t(i)) : std::string_view();
+    t.entradas[i] = montar(f.empty() ? formatosED[i] : f, uint8_t(i), 1, 0, 0);
+  }
+  return t;
+}
+
+static constexpr TabelaZ80 gerarIndice(uint8_t indice) {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++) {
+    std::string_view f = formatosBase[i];
+    bool memoria = temLetra(f, 'm');
+    if(memoria || temLetra(f, 'x') || temLetra(f, 'h') || temLetra(f, 'l'))
+      t.entradas[i] = montar(f, uint8_t(i), 1, indice, memoria ? 2 : 0);
+    else
+      t.entradas[i] = montar(prefixoInvalido, indice == 1 ? 0xDD : 0xFD, 0, 0, 0);
+  }
+  return t;
+}
+
+static constexpr TabelaZ80 gerarIndiceCB(uint8_t indice) {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++)
+    t.entradas[i] = montar(formatosIndiceCB[i], uint8_t(i), 3, indice, 2);
+  return t;
+}
+
+// O DB de cada byte: prefixo sem instrucao ou instrucao cortada no fim.
+static constexpr TabelaZ80 gerarDados() {
+  TabelaZ80 t{};
+  for(unsigned i = 0; i < 256; i++)
+    t.entradas[i] = montar(prefixoInvalido, uint8_t(i), 0, 0, 0);
+  return t;
+}
+
+static constexpr TabelaZ80 tabelaBase = gerarBase();
+static constexpr TabelaZ80 tabelaCB = gerarCB();
+static constexpr TabelaZ80 tabelaED = gerarED(false);
+static constexpr TabelaZ80 tabelaEDR800 = gerarED(true);
+static constexpr TabelaZ80 tabelaIX = gerarIndice(1);
+static constexpr TabelaZ80 tabelaIY = gerarIndice(2);
+static constexpr TabelaZ80 tabelaIXCB = gerarIndiceCB(1);
+static constexpr TabelaZ80 tabelaIYCB = gerarIndiceCB(2);
+static constexpr TabelaZ80 tabelaDados = gerarDados();
+static_assert(tabelaBase.entradas[0xCD].tamanho == 3 &&
+              tabelaBase.entradas[0xCD].fluxo == fluxoChamada, "CALL w");
+static_assert(tabelaIX.entradas[0x36].tamanho == 4 && tabelaIX.entradas[0x36].operandos == 2,
+              "LD (IX+d),n");
+static_assert(tabelaIY.entradas[0xE9].fluxo == fluxoIndireto && tabelaIY.entradas[0xE9].texto[4] == 'I',
+              "JP (IY)");
+static_assert(tabelaBase.entradas[0x10].destino == destinoRelativo && tabelaBase.entradas[0xFF].destino == destinoRst,
+              "DJNZ, RST");
+static_assert(tabelaED.entradas[0x4D].fluxo == fluxoRetorno && !tabelaED.entradas[0x77].valida,
+              "RETI, DB");
+static_assert(tabelaIXCB.entradas[0x06].tamanho == 4 && tabelaIX.entradas[0x00].tamanho == 1,
+              "DDCB, DB #DD");
+
+// Pares de digitos de cada byte.
+struct ParesHexa {
+  char pares[512];
+};
+
+static constexpr ParesHexa gerarPares() {
+  ParesHexa p{};
+  for(unsigned i = 0; i < 256; i++) {
+    p.pares[i * 2] = digitosHexa[i >> 4];
+    p.pares[i * 2 + 1] = digitosHexa[i & 15];
+  }
+  return p;
+}
+
+static constexpr ParesHexa paresHexa = gerarPares();
+
+static char *escreverPar(char *p, uint8_t valor) {
+  std::memcpy(p, paresHexa.pares + valor * 2, 2);
+  return p + 2;
+}
+
+static char *escreverPalavra(char *p, uint16_t valor) {
+  return escreverPar(escreverPar(p, uint8_t(valor >> 8)), uint8_t(valor));
+}
+
+static char *escreverHex(char *p, uint8_t valor) {
+  *p++ = '#';
+  return escreverPar(p, valor);
+}
+
+static char *escrever(char *p, std::string_view texto) {
+  std::memcpy(p, texto.data(), texto.size());
+  return p + texto.size();
+}
+
+// A entrada da instrucao em p; prefixo sem instrucao e instrucao cortada no
+// fim dos dados viram um DB do primeiro byte.
+static const Entrada &procurar(const uint8_t *p, size_t n, bool r800) {
+  if(!n)
+    return tabelaDados.entradas[0];
+  uint8_t op = p[0];
+  const Entrada *e = &tabelaBase.entradas[op];
+  switch(op) {
+    case 0xCB:
+      e = n >= 2 ? &tabelaCB.entradas[p[1]] : nullptr;
+      break;
+    case 0xED:
+      e = n >= 2 ? &(r800 ? tabelaEDR800 : tabelaED).entradas[p[1]] : nullptr;
+      break;
+    case 0xDD:
+    case 0xFD:
+      if(n < 2)
+        e = nullptr;
+      else if(p[1] != 0xCB)
+        e = &(op == 0xDD ? tabelaIX : tabelaIY).entradas[p[1]];
+      else
+        e = n >= 4 ? &(op == 0xDD ? tabelaIXCB : tabelaIYCB).entradas[p[3]] : nullptr;
+      break;
+  }
+  if(!e || e->tamanho > n)
+    e = &tabelaDados.entradas[op];
+  return *e;
+}
+
+static uint16_t destinoDe(const Entrada &e, const uint8_t *p, uint16_t endereco) {
+  switch(e.destino) {
+    case destinoPalavra:
+      return uint16_t(p[e.imediato] | (p[e.imediato + 1] << 8));
+    case destinoRelativo:
+      return uint16_t(endereco + e.tamanho + int8_t(p[e.imediato]));
+    case destinoRst:
+      return uint16_t(p[0] & 0x38);
+    default:
+      return 0;
+  }
+}
+
+static InstrucaoZ80 instrucaoDe(const Entrada &e, const uint8_t *p, uint16_t endereco) {
+  return InstrucaoZ80{e.tamanho, FluxoZ80(e.fluxo), destinoDe(e, p, endereco), e.valida};
+}
+
+Desmontador::Desmontador(bool r800) : r800(r800), usado(0) {
+}
+
+InstrucaoZ80 Desmontador::decodificar(const uint8_t *p, size_t n, uint16_t endereco) const {
+  return instrucaoDe(procurar(p, n, r800), p, endereco);
+}
+
+size_t Desmontador::formatar(const uint8_t *p, size_t n, uint16_t endereco, char *destino,
+                             InstrucaoZ80 *instrucao) const {
+  static_assert(sizeof(Entrada::texto) <= tamanhoTexto, "texto do desmontador");
+  const Entrada &e = procurar(p, n, r800);
+
+  std::memcpy(destino, e.texto, sizeof(e.texto));
+  for(unsigned i = 0; i < e.operandos; i++) {
+    const Operando &o = e.operando[i];
+    char *d = destino + o.coluna;
+    switch(o.tipo) {
+      case remendoByte:
+        escreverPar(d, p[o.origem]);
+        break;
+      case remendoPalavra:
+        escreverPalavra(d, uint16_t(p[o.origem] | (p[o.origem + 1] << 8)));
+        break;
+      case remendoRelativo:
+        escreverPalavra(d, uint16_t(endereco + e.tamanho + int8_t(p[o.origem])));
+        break;
+      case remendoDeslocamento: {
+        int8_t desl = int8_t(p[o.origem]);
+        d[0] = desl < 0 ? '-' : '+';
+        escreverPar(d + 2, uint8_t(desl < 0 ? -desl : desl));
+        break;
+      }
+    }
+  }
+  if(instrucao)
+    *instrucao = instrucaoDe(e, p, endereco);
+  return e.tamanhoTexto;
+}
+
+// Endereco e ate' 4 bytes em hexa: as 18 primeiras colunas da linha.
+static char *escreverBytes(char *d, uint16_t endereco, const uint8_t *p, unsigned n) {
+  d = escreverPalavra(d, endereco);
+  std::memcpy(d, "              ", 14);
+  for(unsigned i = 0; i < n; i++)
+    escreverPar(d + 2 + i * 3, p[i]);
+  return d + 14;
+}
+
+char *Desmontador::reservar() {
+  // Bytes, instrucao e fim de linha.
+  const size_t maiorLinha = 18 + tamanhoTexto + 1;
+
+  if(saida.size() < usado + maiorLinha)
+    saida.resize(std::max(saida.size() * 2, usado + maiorLinha));
+  return saida.data() + usado;
+}
+
+size_t Desmontador::linha(const uint8_t *p, size_t n, uint16_t endereco) {
+  // O texto vai direto para a coluna dele; os bytes sao preenchidos depois
+  // que o tamanho da instrucao e' conhecido.
+  char *d = reservar();
+  InstrucaoZ80 instrucao;
+  size_t tamanhoInstrucao = formatar(p, n, endereco, d + 18, &instrucao);
+
+  d = escreverBytes(d, endereco, p, instrucao.tamanho) + tamanhoInstrucao;
+  *d++ = '\n';
+  usado = size_t(d - saida.data());
+  return instrucao.tamanho;
+}
+
+void Desmontador::linhaDados(const uint8_t *p, unsigned n, uint16_t endereco) {
+  char *d = escrever(escreverBytes(reservar(), endereco, p, n), "DB ");
+
+  for(unsigned i = 0; i < n; i++) {
+    if(i)
+      *d++ = ',';
+    d = escreverHex(d, p[i]);
+  }
+  *d++ = '\n';
+  usado = size_t(d - saida.data());
+}
+
+size_t Desmontador::desmontar(const uint8_t *dados, size_t n, uint16_t endereco, bool fim) {
+  size_t pos = 0;
+
+  while(fim ? pos < n : n - pos >= 4) {
+    size_t tamanho = linha(dados + pos, n - pos, endereco);
+    pos += tamanho;
+    endereco = uint16_t(endereco + tamanho);
+  }
+  return pos;
+}
+
+void Desmontador::listar(const Rastreador &rastreador) {
+  const uint8_t *rom = rastreador.getRom();
+
+  for(const TrechoRom &t : rastreador.getTrechos()) {
+    if(t.inicio) {
+      char *d = escrever(reservar(), "\n; Banco ");
+      d = escreverHex(d, uint8_t(t.inicio / rastreador.getBytesBanco()));
+      d = escrever(d, " em #");
+      d = escreverPalavra(d, t.endereco);
+      *d++ = '\n';
+      usado = size_t(d - saida.data());
+    }
+    for(size_t i = 0; i < t.tamanho;) {
+      const uint8_t *p = rom + t.inicio + i;
+      uint16_t endereco = uint16_t(t.endereco + i);
+      if(rastreador.regiao(t.inicio + i) == regiaoInicio) {
+        i += linha(p, t.tamanho - i, endereco);
+        continue;
+      }
+      // Dados vao ate' 4 por linha, parando no comeco da proxima instrucao.
+      unsigned n = 1;
+      while(n < 4 && i + n < t.tamanho && rastreador.regiao(t.inicio + i + n) != regiaoInicio)
+        n++;
+      linhaDados(p, n, endereco);
+      i += n;
+    }
+  }
+}
+
+void Desmontador::limpar() {
+  usado = 0;
+}
+
+const char *Desmontador::getTexto() const {
+  return saida.data();
+}
+
+size_t Desmontador::getTamanho() const {
+  return usado;
+}
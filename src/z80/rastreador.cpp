@@ -0,0 +1,300 @@
+#include <algorithm>
+
+#include "tarefas.h"
+#include "z80.h"
+
+static uint16_t le16(const uint8_t *p) {
+  return uint16_t(p[0] | (p[1] << 8));
+}
+
+// Bytes que a BIOS le logo depois do RST: o caractere do SYNCHR e o slot e
+// endereco do CALLF.
+static unsigned bytesEmLinha(uint8_t opcode) {
+  return opcode == 0xCF ? 1 : opcode == 0xF7 ? 3 : 0;
+}
+
+static unsigned contarBits(uint64_t v) {
+  unsigned n = 0;
+  for(; v; v &= v - 1)
+    n++;
+  return n;
+}
+
+Rastreador::Rastreador(unsigned bancoKB, bool r800)
+  : desmontador(r800), bytesBanco(size_t(bancoKB == 16 ? 16 : 8) << 10), rom(nullptr), tamanho(0), megaRom(false) {
+}
+
+Rastreador::~Rastreador() {
+}
+
+bool Rastreador::analisar(const uint8_t *dados, size_t n, MapeadorRom mapeador, unsigned threads) {
+  size_t cabecalho;
+
+  rom = dados;
+  tamanho = n;
+  trechos.clear();
+  janela.clear();
+  mapa.reset();
+  if(tamanho >= 16 && rom[0] == 'A' && rom[1] == 'B')
+    cabecalho = 0;
+  else if(tamanho >= 0x4010 && rom[0x4000] == 'A' && rom[0x4001] == 'B')
+    cabecalho = 0x4000;
+  else
+    return false;
+
+  mapa.reset(new std::atomic<uint64_t>[(tamanho + 31) / 32]);
+  for(size_t i = 0; i < (tamanho + 31) / 32; i++)
+    mapa[i].store(0, std::memory_order_relaxed);
+
+  const uint8_t *h = rom + cabecalho;
+  uint16_t entradas[3] = {le16(h + 2), le16(h + 4), le16(h + 6)};
+  uint16_t texto = le16(h + 8);
+  uint16_t primeira = 0;
+  for(uint16_t e : {entradas[0], entradas[1], entradas[2], texto})
+    if(e && !primeira)
+      primeira = e;
+
+  // Com o cabecalho em #4000 da imagem, ela comeca em #0000; so' com 16 KB
+  // e entradas na pagina 2, em #8000; no resto, em #4000. O tamanho nao
+  // separa uma ROM linear de 64 KB de uma MegaROM: quem diz e' o mapeador.
+  megaRom = cabecalho == 0 && mapeador != mapeadorLinear;
+  if(megaRom) {
+    trechos.push_back(TrechoRom{0, 0x4000, 0x4000});
+    for(size_t pos = 0x4000; pos < tamanho; pos += bytesBanco)
+      trechos.push_back(TrechoRom{pos, std::min(bytesBanco, tamanho - pos), 0x8000});
+  } else if(cabecalho) {
+    trechos.push_back(TrechoRom{0, std::min<size_t>(tamanho, 0x10000), 0});
+  } else {
+    uint16_t base = tamanho <= 0x4000 && (primeira & 0xC000) == 0x8000 ? 0x8000 : 0x4000;
+    trechos.push_back(TrechoRom{0, std::min<size_t>(tamanho, 0x10000 - base), base});
+  }
+
+  for(size_t i = 0; i < 16; i++)
+    elevar(cabecalho + i, regiaoDado);
+  if(texto)
+    marcarTexto(texto);
+
+  PoolTarefas pool(threads);
+  for(uint16_t e : entradas)
+    if(e)
+      pool.adicionar([this, &pool, e] { rastrearFixo(pool, e); });
+  pool.esperar();
+
+  if(megaRom) {
+    std::sort(janela.begin(), janela.end());
+    janela.erase(std::unique(janela.begin(), janela.end()), janela.end());
+    for(size_t i = 1; i < trechos.size(); i++)
+      pool.adicionar([this, i] { rastrearBanco(i); });
+    pool.esperar();
+  }
+  return true;
+}
+
+RegiaoRom Rastreador::regiao(size_t pos) const {
+  return RegiaoRom((mapa[pos / 32].load(std::memory_order_relaxed) >> (pos % 32 * 2)) & 3);
+}
+
+RegiaoRom Rastreador::elevar(size_t pos, RegiaoRom regiao) {
+  // Codigo vale mais que dado e inicio mais que continuacao: a marca so' sobe.
+  std::atomic<uint64_t> &palavra = mapa[pos / 32];
+  unsigned deslocamento = unsigned(pos % 32 * 2);
+  uint64_t antes = palavra.load(std::memory_order_relaxed);
+
+  for(;;) {
+    RegiaoRom atual = RegiaoRom((antes >> deslocamento) & 3);
+    if(atual >= regiao)
+      return atual;
+    uint64_t depois = (antes & ~(uint64_t(3) << deslocamento)) | (uint64_t(regiao) << deslocamento);
+    if(palavra.compare_exchange_weak(antes, depois, std::memory_order_relaxed))
+      return atual;
+  }
+}
+
+bool Rastreador::marcarInstrucao(size_t pos, unsigned n) {
+  if(elevar(pos, regiaoInicio) == regiaoInicio)
+    return false;
+  for(unsigned i = 1; i < n; i++)
+    elevar(pos + i, regiaoCodigo);
+  return true;
+}
+
+void Rastreador::marcarTexto(uint16_t endereco) {
+  const TrechoRom &fixo = trechos[0];
+  size_t pos = uint16_t(endereco - fixo.endereco);
+
+  // O programa pode comecar pelo zero que o BASIC poe antes da primeira linha.
+  if(pos + 3 <= fixo.tamanho && rom[pos] == 0 && le16(rom + pos + 1) > endereco)
+    elevar(pos++, regiaoDado);
+  // Cada linha comeca pelo endereco da seguinte; um endereco zero termina o programa.
+  while(pos + 2 <= fixo.tamanho) {
+    uint16_t seguinte = le16(rom + pos);
+    size_t fim = uint16_t(seguinte - fixo.endereco);
+    if(!seguinte || fim <= pos || fim > fixo.tamanho)
+      fim = pos + 2;
+    for(; pos < fim; pos++)
+      elevar(pos, regiaoDado);
+    if(!seguinte)
+      break;
+  }
+}
+
+void Rastreador::anotarJanela(uint16_t endereco) {
+  if(megaRom && endereco >= 0x8000 && endereco < 0xC000) {
+    std::lock_guard<std::mutex> l(travaJanela);
+    janela.push_back(endereco);
+  }
+}
+
+void Rastreador::rastrearFixo(PoolTarefas &pool, uint16_t entrada) {
+  const TrechoRom &fixo = trechos[0];
+  std::vector<uint16_t> pilha(1, entrada);
+
+  while(!pilha.empty()) {
+    uint16_t pc = pilha.back();
+    pilha.pop_back();
+    for(;;) {
+      size_t pos = uint16_t(pc - fixo.endereco);
+      if(pos >= fixo.tamanho) {
+        anotarJanela(pc);
+        break;
+      }
+
+      InstrucaoZ80 i = desmontador.decodificar(rom + pos, fixo.tamanho - pos, pc);
+      if(!i.valida || !marcarInstrucao(pos, i.tamanho))
+        break;
+      pc = uint16_t(pc + i.tamanho);
+
+      if(i.fluxo == fluxoSalto) {
+        pc = i.destino;
+      } else if(i.fluxo == fluxoSaltoCondicional) {
+        pilha.push_back(i.destino);
+      } else if(i.fluxo == fluxoChamada || i.fluxo == fluxoChamadaCondicional) {
+        unsigned emLinha = bytesEmLinha(rom[pos]);
+        for(unsigned k = 0; k < emLinha && pos + i.tamanho + k < fixo.tamanho; k++)
+          elevar(pos + i.tamanho + k, regiaoDado);
+        pc = uint16_t(pc + emLinha);
+        // Cada rotina nova e' uma tarefa; as ja' vistas nao custam nada.
+        size_t destino = uint16_t(i.destino - fixo.endereco);
+        if(!emLinha && destino >= fixo.tamanho) {
+          anotarJanela(i.destino);
+        } else if(!emLinha && regiao(destino) != regiaoInicio) {
+          uint16_t d = i.destino;
+          pool.adicionar([this, &pool, d] { rastrearFixo(pool, d); });
+        }
+      } else if(i.fluxo == fluxoRetorno || i.fluxo == fluxoIndireto) {
+        break;
+      }
+    }
+  }
+}
+
+void Rastreador::rastrearBanco(size_t indice) {
+  TrechoRom &banco = trechos[indice];
+  std::vector<uint8_t> regioes, escolhidas;
+  size_t melhor = 0;
+
+  // O banco e' tentado em cada posicao da janela; fica a que explica mais codigo.
+  for(uint32_t posicao = 0x8000; posicao < 0xC000; posicao += uint32_t(bytesBanco)) {
+    TrechoRom tentativa{banco.inicio, banco.tamanho, uint16_t(posicao)};
+    regioes.assign(banco.tamanho, regiaoDesconhecida);
+    for(uint16_t e : janela)
+      if(e >= posicao && e - posicao < banco.tamanho)
+        tentar(tentativa, e, regioes);
+
+    size_t codigo = size_t(std::count(regioes.begin(), regioes.end(), uint8_t(regiaoInicio)));
+    if(codigo > melhor) {
+      melhor = codigo;
+      banco.endereco = uint16_t(posicao);
+      escolhidas.swap(regioes);
+    }
+  }
+  for(size_t i = 0; i < escolhidas.size(); i++)
+    if(escolhidas[i] != regiaoDesconhecida)
+      elevar(banco.inicio + i, RegiaoRom(escolhidas[i]));
+}
+
+bool Rastreador::tentar(const TrechoRom &banco, uint16_t entrada, std::vector<uint8_t> &regioes) const {
+  // Tudo o que o caminho marca sai de regiaoDesconhecida; numa falha, volta.
+  std::vector<size_t> marcados;
+  std::vector<uint16_t> pilha(1, entrada);
+  auto desfazer = [&] {
+    for(size_t pos : marcados)
+      regioes[pos] = regiaoDesconhecida;
+    return false;
+  };
+  auto marcar = [&](size_t pos, RegiaoRom regiao) {
+    regioes[pos] = uint8_t(regiao);
+    marcados.push_back(pos);
+  };
+
+  while(!pilha.empty()) {
+    uint16_t pc = pilha.back();
+    pilha.pop_back();
+    for(;;) {
+      // Fora do banco e' a parte fixa ou a BIOS, que nao interessam aqui.
+      size_t pos = uint16_t(pc - banco.endereco);
+      if(pos >= banco.tamanho || regioes[pos] == regiaoInicio)
+        break;
+      if(regioes[pos] != regiaoDesconhecida)
+        return desfazer();
+
+      const uint8_t *p = rom + banco.inicio + pos;
+      InstrucaoZ80 i = desmontador.decodificar(p, banco.tamanho - pos, pc);
+      if(!i.valida || *p == 0xFF)
+        return desfazer();
+      marcar(pos, regiaoInicio);
+      for(unsigned k = 1; k < i.tamanho; k++) {
+        if(regioes[pos + k] != regiaoDesconhecida)
+          return desfazer();
+        marcar(pos + k, regiaoCodigo);
+      }
+      pc = uint16_t(pc + i.tamanho);
+
+      if(i.fluxo == fluxoSalto) {
+        pc = i.destino;
+      } else if(i.fluxo == fluxoSaltoCondicional) {
+        pilha.push_back(i.destino);
+      } else if(i.fluxo == fluxoChamada || i.fluxo == fluxoChamadaCondicional) {
+        unsigned emLinha = bytesEmLinha(*p);
+        for(unsigned k = 0; k < emLinha && pos + i.tamanho + k < banco.tamanho; k++)
+          if(regioes[pos + i.tamanho + k] == regiaoDesconhecida)
+            marcar(pos + i.tamanho + k, regiaoDado);
+        pc = uint16_t(pc + emLinha);
+        if(!emLinha)
+          pilha.push_back(i.destino);
+      } else if(i.fluxo == fluxoRetorno || i.fluxo == fluxoIndireto) {
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+const std::vector<TrechoRom> &Rastreador::getTrechos() const {
+  return trechos;
+}
+
+const uint8_t *Rastreador::getRom() const {
+  return rom;
+}
+
+size_t Rastreador::getTamanho() const {
+  return tamanho;
+}
+
+size_t Rastreador::getBytesBanco() const {
+  return bytesBanco;
+}
+
+bool Rastreador::getMegaRom() const {
+  return megaRom;
+}
+
+size_t Rastreador::getBytesCodigo() const {
+  size_t n = 0;
+
+  if(mapa)
+    for(size_t i = 0; i < (tamanho + 31) / 32; i++)
+      n += contarBits(mapa[i].load(std::memory_order_relaxed) & 0xAAAAAAAAAAAAAAAAull);
+  return n;
+}